@@ -46,7 +46,23 @@ Gw = Lw / (1 + Lw);
 
 %% P Tune of Position Controller
 
-% ???
+Rp.wc = Rw.wb / 10;
+
+Lp1 = Gw * motor.gearbox / s;
+[magnitude, phase] = bode(Lp1, Rp.wc);
+
+Rp.Kp = 1 / magnitude;
+
+Lp = Rp.Kp * Lp1;
+Gp = Lp / (1 + Lp);
+
+% margins with the one tick of delay of the sampled loop
+[Rp.Gm, Rp.Pm] = margin(Lp * exp(-s * uc.Ts));
+Rp.Gm = 20 * log10(Rp.Gm);
+
+
+% figure(2)
+% step(Gp)
 
 
 
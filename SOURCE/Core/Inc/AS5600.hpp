@@ -8,6 +8,10 @@
 #pragma once
 
 #include "i2c_device.hpp"
+#include "angle_source.hpp"
+#include "fixed_point.hpp"
+#include "register_field.hpp"
+#include "async_result.hpp"
 
 
 
@@ -17,11 +21,13 @@
 
 const uint8_t AS5600_DEFAULT_ADDRESS = 0x36;
 
+const int32_t AS5600_Q16_RADIANS_PER_TURN = 411775;		// 2pi in Q16.16
+
 
 
 // --------------------------------------------------------- AS5600 class declaration ---
 
-class AS5600 : public I2C_Device {
+class AS5600 : public I2C_Device, public Angle_Source {
 
 public:
 	// --- Miscellaneous sensor options -------------------------------------------------
@@ -44,7 +50,7 @@ public:
 			I2C_HandleTypeDef *device_handle,
 			uint8_t device_address = AS5600_DEFAULT_ADDRESS,
 			ROTATION_DIRECTION direction = AS5600::CLOCK_WISE,
-			uint32_t response_delay = HAL_MAX_DELAY
+			uint32_t response_delay_us = I2C_DEVICE_RESPONSE_DELAY_US
 			);
 
 
@@ -52,7 +58,7 @@ public:
 
 	// --- Raw values
 
-	uint16_t getRawAngle(void);
+	uint16_t getRawAngle(void) override;	// On a bus error the last good angle
 
 	uint16_t getAngle(void);
 
@@ -60,9 +66,56 @@ public:
 	// --- Real values
 	// TODO float getRealRawAngle ???
 
+	q16_t getRealAngle_Q16(OUTPUT_ANGLE_UNIT unit = AS5600::RADIANS);
+
 	float getRealAngle(OUTPUT_ANGLE_UNIT unit = AS5600::RADIANS);
 
 
+	// --- Snapshot (burst transfers)
+
+	// See data-sheet page 18, figure 21: STATUS to ANGLE are contiguous, AGC and MAGNITUDE
+	// follow reserved registers. A read starting on an output high byte does not
+	// auto-increment (the pointer returns to it), so the angles are read from STATUS.
+
+	enum SNAPSHOT_WINDOW : uint8_t {		// Registers read by a snapshot
+		WINDOW_STATUS_ANGLES 	= 0x01,		// STATUS to ANGLE, 5 bytes
+		WINDOW_FULL 			= 0x02,		// Then AGC to MAGNITUDE, a second read of 3 bytes
+	};
+
+	struct SNAPSHOT {						// Decoded registers, zero if outside the window
+		uint8_t status;
+		uint16_t raw_angle;
+		uint16_t angle;
+		uint8_t agc;
+		uint16_t magnitude;
+	};
+
+	bool getSnapshot(AS5600::SNAPSHOT *snapshot, AS5600::SNAPSHOT_WINDOW window = AS5600::WINDOW_FULL);
+
+
+	// --- Asynchronous reads (queued on the bus engine, e.g. by the bus scheduler)
+
+	bool requestRawAngle(void);				// Raw angle, about 112 us at 400 kHz
+	bool requestStatus(void);				// Magnet status bits, about 90 us
+	bool requestMagnitude(void);			// AGC and magnitude, about 140 us
+
+	uint16_t getSampleRawAngle(void){ return _sample_raw_angle; };	// Latest completed reads
+	uint8_t getSampleStatus(void){ return _sample_status; };
+	uint8_t getSampleAGC(void){ return _sample_agc; };
+	uint16_t getSampleMagnitude(void){ return _sample_magnitude; };
+
+	uint32_t getSampleCount(void){ return _samples; };				// Raw angle reads completed
+	uint32_t getSampleErrors(void){ return _sample_errors; };
+
+
+	// --- Asynchronous reads with a result handle (start, then poll or await)
+
+	// One read of each kind at a time, see async_result.hpp
+
+	bool readRawAngleAsync(Async_Result<uint16_t> &result);	// Also refreshes getSampleRawAngle()
+	bool readRealAngleAsync(Async_Result<q16_t> &result, OUTPUT_ANGLE_UNIT unit = AS5600::RADIANS);
+
+
 	// TODO changing direction methods ???
 
 
@@ -146,8 +199,7 @@ public:
 
 	// --- Sensor configuration methods -------------------------------------------------
 
-	// --- General configuration
-	// TODO better management
+	// --- General configuration (shadowed, getters cost no bus time)
 
 	bool setConfiguration(uint16_t value);
 	uint16_t getConfiguration(void);
@@ -192,6 +244,25 @@ protected:
 	// --- Device variables -------------------------------------------------------------
 
 	ROTATION_DIRECTION _direction;
+	uint16_t _last_angle;					// Last good filtered angle, kept on a bus error
+
+	uint8_t _angle_buffer[2];				// Asynchronous reads destinations
+	uint8_t _status_buffer[1];
+	uint8_t _magnitude_buffer[3];			// AGC, MAGNITUDE_H and MAGNITUDE_L
+
+	volatile uint16_t _sample_raw_angle;
+	volatile uint8_t _sample_status;
+	volatile uint8_t _sample_agc;
+	volatile uint16_t _sample_magnitude;
+
+	uint32_t _samples;
+	uint32_t _sample_errors;
+
+	Async_Result<uint16_t> *volatile _raw_angle_result;	// Pending handle reads
+	Async_Result<q16_t> *volatile _real_angle_result;
+	AS5600::OUTPUT_ANGLE_UNIT _real_angle_unit;
+	uint8_t _raw_result_buffer[2];
+	uint8_t _real_result_buffer[2];
 
 	// --- Sensor register map ----------------------------------------------------------
 
@@ -224,40 +295,60 @@ protected:
 		// Burn is not reported
 	};
 
-	// --- Utility masks ----------------------------------------------------------------
+	// --- Register fields --------------------------------------------------------------
+
+	// Compile-time descriptors, see register_field.hpp (no storage, immediate masks)
 
-	// --- Configuration bits masks
+	// --- Configuration fields (CONF_H and CONF_L read as one 16 bit register)
 
 	// See data-sheet page 19, table 22 for more details on configuration bits
 
-	const uint8_t POWER_MODE_MASK    	= 0x03;
-	const uint8_t HYSTERESIS_MASK    	= 0x0C;
-	const uint8_t OUTPUT_MODE_MASK   	= 0x30;
-	const uint8_t PWM_FREQUENCY_MASK 	= 0xC0;
-	const uint8_t SLOW_FILTER_MASK   	= 0x03;
-	const uint8_t FAST_FILTER_TH_MASK	= 0x1C;
-	const uint8_t WATCHDOG_MASK     	= 0x20;
+	typedef Register_Field<uint16_t, 0x0003> POWER_MODE_FIELD;		// CONF_L
+	typedef Register_Field<uint16_t, 0x000C> HYSTERESIS_FIELD;
+	typedef Register_Field<uint16_t, 0x0030> OUTPUT_MODE_FIELD;
+	typedef Register_Field<uint16_t, 0x00C0> PWM_FREQUENCY_FIELD;
+	typedef Register_Field<uint16_t, 0x0300> SLOW_FILTER_FIELD;		// CONF_H
+	typedef Register_Field<uint16_t, 0x1C00> FAST_FILTER_TH_FIELD;
+	typedef Register_Field<uint16_t, 0x2000> WATCHDOG_FIELD;
+	typedef Register_Field<uint16_t, 0x3FFF> CONFIGURATION_FIELD;
 
+	typedef Register_Field<uint8_t, 0x03> ZMCO_FIELD;					// Burn count
 
-	// --- Magnet status bits masks
+
+	// --- Angle fields (ZPOS, MPOS, MANG, RAW ANGLE, ANGLE and MAGNITUDE)
+
+	typedef Register_Field<uint16_t, 0x0FFF> ANGLE_FIELD;				// 12 bits
+
+
+	// --- Magnet status field
 
 	// See data-sheet page 20, table 23 for more details on status bits
 
-	const uint8_t MAGNET_STRONG   	= 0x08;
-	const uint8_t MAGNET_WEAK    	= 0x10;
-	const uint8_t MAGNET_DETECTED 	= 0x20;
+	typedef Register_Field<uint8_t, 0x38> MAGNET_FIELD;
+
+	enum MAGNET_STATUS : uint8_t {			// Values of MAGNET_FIELD, in place
+		MAGNET_STRONG 	= 0x01 << 3,		// MH, too close
+		MAGNET_WEAK 	= 0x02 << 3,		// ML, too far
+		MAGNET_DETECTED = 0x04 << 3,		// MD
+	};
+
+
+private:
+	// --- Utility methods --------------------------------------------------------------
 
+	uint16_t applyDirection(uint16_t angle);
 
-	// --- Utility conversion constants -------------------------------------------------
+	static q16_t toRealAngle_Q16(uint16_t angle, AS5600::OUTPUT_ANGLE_UNIT unit);
 
-	const float PI = 3.14159265359;
 
-	const float ADC_TO_DEGREES = 360.0 / 4096;
-	const float DEGREES_TO_ADC = 4096 / 360.0;
+	// --- Asynchronous read steps (bus engine callbacks)
 
-	const float ADC_TO_RADIANS = (PI * 2.0) / 4096;
-	const float RADIANS_TO_ADC = 4096 / (PI * 2.0);
+	static void onRawAngleRead(void *context, HAL_StatusTypeDef status);
+	static void onStatusRead(void *context, HAL_StatusTypeDef status);
+	static void onMagnitudeRead(void *context, HAL_StatusTypeDef status);
 
+	static void onRawAngleResult(void *context, HAL_StatusTypeDef status);
+	static void onRealAngleResult(void *context, HAL_StatusTypeDef status);
 };
 
 
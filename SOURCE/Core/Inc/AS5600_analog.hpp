@@ -0,0 +1,87 @@
+/*
+ * AS5600_analog.hpp
+ *
+ * Module to sample the AS5600 OUT pin (analog output modes) with ADC1 in continuous mode,
+ * moved to memory by DMA1 channel 1 in circular mode. Reading the angle costs no bus time
+ * and no interrupts, only the averaging of the last samples.
+ *
+ * The HAL ADC driver is not part of the project, so ADC1 and its DMA channel are set up
+ * directly through the CMSIS registers.
+ *
+ */
+
+#pragma once
+
+#include "AS5600.hpp"
+
+
+
+// --- Acquisition defaults -------------------------------------------------------------
+
+const uint8_t AS5600_ANALOG_DEFAULT_CHANNEL = 0;			// PA0, ADC1_IN0
+const uint8_t AS5600_ANALOG_BUFFER_SIZE = 8;				// Samples averaged per reading
+
+// ADCCLK = 64 MHz (APB2) / 6 = 10.67 MHz (14 MHz max), 239.5 + 12.5 cycles per conversion
+const uint32_t AS5600_ANALOG_ADC_CLOCK = 64000000 / 6;
+const uint16_t AS5600_ANALOG_CONVERSION_CYCLES = 252;
+
+
+
+// -------------------------------------------------- AS5600_Analog class declaration ---
+
+class AS5600_Analog : public Angle_Source {
+
+public:
+	// --- Source constructor -----------------------------------------------------------
+
+	AS5600_Analog(
+			uint8_t channel = AS5600_ANALOG_DEFAULT_CHANNEL,
+			AS5600::OUTPUT_MODE range = AS5600::ANALOG_FULL_RANGE,
+			AS5600::ROTATION_DIRECTION direction = AS5600::CLOCK_WISE
+			);
+
+
+	// --- Source core methods ----------------------------------------------------------
+
+	void begin(void);
+
+	uint16_t getRawAngle(void) override;
+
+	uint16_t getLastSample(void){ return _buffer[0]; };
+
+
+	// --- Calibration ------------------------------------------------------------------
+
+	bool calibrate(Angle_Source &reference);
+
+	int16_t getOffset(void){ return _offset; };
+	void setOffset(int16_t offset){ _offset = offset; };
+
+
+	// --- Benchmark --------------------------------------------------------------------
+
+	float getNominalSampleRate_Hz(void){ return (float)AS5600_ANALOG_ADC_CLOCK / AS5600_ANALOG_CONVERSION_CYCLES; };
+	float measureSampleRate_Hz(uint16_t buffers = 100);
+
+
+private:
+	// --- Source variables -------------------------------------------------------------
+
+	uint8_t _channel;
+	AS5600::OUTPUT_MODE _range;
+	AS5600::ROTATION_DIRECTION _direction;
+
+	int16_t _offset;						// Added to the converted angle [counts]
+
+	volatile uint16_t _buffer[AS5600_ANALOG_BUFFER_SIZE];
+
+
+	// --- Utility methods --------------------------------------------------------------
+
+	uint16_t readAverage(void);
+
+	uint16_t convert(uint16_t sample);
+};
+
+
+// END OF FILE
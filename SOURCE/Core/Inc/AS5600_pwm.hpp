@@ -0,0 +1,104 @@
+/*
+ * AS5600_pwm.hpp
+ *
+ * Module to decode the AS5600 OUT pin in digital PWM mode with TIM2 in PWM input mode:
+ * channel 1 captures the period and resets the counter on the rising edge, channel 2
+ * captures the high time on the falling edge. A DMA burst (DMA1 channel 5, on the CC1
+ * request) copies both captures to memory at every frame, so a new sample costs no CPU
+ * and no I2C bandwidth.
+ *
+ * The counter restarts at each frame, so its value is the age of the latest sample. If
+ * it overflows the signal is gone and readings fall back to the I2C interface: the latest
+ * queued read of the AS5600 (e.g. its bus slot), so the fallback never waits on the bus.
+ *
+ * Like the analog path, TIM2 and its DMA channel are set up through CMSIS registers so
+ * no interrupt is involved.
+ *
+ */
+
+#pragma once
+
+#include "AS5600.hpp"
+
+
+
+// --- Decoding constants ---------------------------------------------------------------
+
+// See data-sheet, PWM output: a frame is 4351 PWM clocks, the output is high for 128
+// clocks plus one per angle count
+
+const uint16_t AS5600_PWM_FRAME_CLOCKS = 4351;
+const uint16_t AS5600_PWM_INIT_CLOCKS = 128;
+
+// Timer clock / 9, 7.11 MHz at 64 MHz: a 115 Hz frame (8.7 ms) fits in the 16-bit counter
+const uint16_t AS5600_PWM_TIMER_PRESCALER = 8;
+
+
+
+// ----------------------------------------------------- AS5600_PWM class declaration ---
+
+class AS5600_PWM : public Angle_Source {
+
+public:
+	// --- Source constructor -----------------------------------------------------------
+
+	AS5600_PWM(
+			AS5600 *fallback = nullptr,
+			AS5600::PWM_FREQUENCY frequency = AS5600::PWM_920Hz,
+			AS5600::ROTATION_DIRECTION direction = AS5600::CLOCK_WISE
+			);
+
+
+	// --- Source core methods ----------------------------------------------------------
+
+	void begin(void);
+
+	uint16_t getRawAngle(void) override;
+
+
+	// --- Signal status ----------------------------------------------------------------
+
+	bool isSignalPresent(void);
+
+	uint32_t getSampleAge_us(void);
+
+	uint32_t getTimerClock_Hz(void){ return _timer_clock; };		// Counter clock, set by begin()
+
+	uint32_t getFallbackCount(void){ return _fallback_count; };
+
+
+	// --- Benchmark --------------------------------------------------------------------
+
+	float getNominalSampleRate_Hz(void);
+	float measureSampleRate_Hz(void);
+
+
+private:
+	// --- Source variables -------------------------------------------------------------
+
+	AS5600 *_fallback;
+	AS5600::PWM_FREQUENCY _frequency;
+	AS5600::ROTATION_DIRECTION _direction;
+
+	uint32_t _timer_clock;					// TIM2 counter clock [Hz]
+
+	bool _signal_present;
+	uint16_t _last_count;
+	uint16_t _last_angle;
+	uint32_t _fallback_count;
+	uint32_t _fallback_samples;				// Sample count of the fallback at the last call
+
+	Async_Result<uint16_t> _fallback_read;
+
+	volatile uint16_t _capture[2];			// CCR1 (period) and CCR2 (high time) [ticks]
+
+
+	// --- Utility methods --------------------------------------------------------------
+
+	bool isPeriodPlausible(uint16_t period);
+
+	uint16_t fallbackAngle(void);
+};
+
+
+// END OF FILE
@@ -8,6 +8,9 @@
 #pragma once
 
 #include "i2c_device.hpp"
+#include "fixed_point.hpp"
+#include "register_field.hpp"
+#include "async_result.hpp"
 
 
 
@@ -18,6 +21,19 @@
 const uint8_t INA219_DEFAULT_ADDRESS = 0x40;
 
 
+// --- Fixed register LSBs in Q16.16 ----------------------------------------------------
+
+// See data-sheet pages 21 and 23
+
+const Q_Gain INA219_BUS_VOLTAGE_LSB_Q16 = qGainFromFloat(4e-3 * 65536);		// 4 mV		[V]
+const Q_Gain INA219_SHUNT_VOLTAGE_LSB_Q16 = qGainFromFloat(1e-2 * 65536);	// 10 uV	[mV]
+
+
+// --- Triggered acquisition limits -----------------------------------------------------
+
+const uint8_t INA219_TRIGGER_MAX_POLLS = 16;	// CNVR reads before a conversion is given up
+
+
 
 // --------------------------------------------------------- INA219 class declaration ---
 
@@ -31,7 +47,7 @@ public:
 			float max_expected_current,
 			float shunt_resistor,
 			uint8_t device_address = INA219_DEFAULT_ADDRESS,
-			uint32_t response_delay = HAL_MAX_DELAY
+			uint32_t response_delay_us = I2C_DEVICE_RESPONSE_DELAY_US
 			);
 
 
@@ -45,15 +61,41 @@ public:
 	int16_t getRawPower(void);
 
 
+	// --- Sensor readings (Q16.16 fixed-point, no float operations)
+
+	q16_t getBusVoltage_Q16(void);			// [V]
+
+	q16_t getShuntVoltage_mV_Q16(void);		// [mV], volts would lose resolution
+
+	q16_t getCurrent_Q16(void);				// [A]
+
+	q16_t getPower_Q16(void);				// [W]
+
+
 	// --- Sensor readings
 
-	float getBusVoltage_V(void);
+	float getBusVoltage_V(void){ return q16ToFloat(getBusVoltage_Q16()); };
+
+	float getShuntVoltage_V(void){ return q16ToFloat(getShuntVoltage_mV_Q16()) * 1e-3f; };
+
+	float getCurrent_A(void){ return q16ToFloat(getCurrent_Q16()); };
+
+	float getPower_W(void){ return q16ToFloat(getPower_Q16()); };
+
 
-	float getShuntVoltage_V(void);
+	// --- Streaming reads (register pointer kept between samples)
 
-	float getCurrent_A(void);
+	void setStreamingMode(bool enable){ _streaming = enable; };
+	bool isStreamingMode(void){ return _streaming; };
 
-	float getPower_W(void);
+
+	// --- Asynchronous reads with a result handle (start, then poll or await)
+
+	// One read of each kind at a time, see async_result.hpp. The calibration watchdog
+	// runs with the blocking reads only.
+
+	bool readCurrentAsync(Async_Result<q16_t> &result);		// [A]
+	bool readBusVoltageAsync(Async_Result<q16_t> &result);	// [V]
 
 
 	// --- Calibration
@@ -62,6 +104,19 @@ public:
 	uint16_t getCalibration(void);
 
 
+	// --- Calibration watchdog
+
+	bool checkCalibration(void);
+
+	void setCalibrationCheckPeriod(uint16_t samples){ _calibration_check_period = samples; };
+	uint16_t getCalibrationCheckPeriod(void){ return _calibration_check_period; };
+
+	uint16_t getCalibrationValue(void){ return _calibration_value; };
+
+	uint32_t getCalibrationChecks(void){ return _calibration_checks; };
+	uint32_t getCalibrationRewrites(void){ return _calibration_rewrites; };
+
+
 	// --- Sensor Parameters
 
 	float getMaxCurrent(void){ return _max_expected_current; };
@@ -72,17 +127,17 @@ public:
 
 	// ---  Sensor readings (smaller measurement units)
 
-	float getBusVoltage_mV(void){ return getBusVoltage_V() * 1e3; };
-	float getBusVoltage_uV(void){ return getBusVoltage_V() * 1e6; };
+	float getBusVoltage_mV(void){ return getBusVoltage_V() * 1e3f; };
+	float getBusVoltage_uV(void){ return getBusVoltage_V() * 1e6f; };
 
-	float getShuntVoltage_mV(void){ return getShuntVoltage_V() * 1e3; };
-	float getShuntVoltage_uV(void){ return getShuntVoltage_V() * 1e6; };
+	float getShuntVoltage_mV(void){ return q16ToFloat(getShuntVoltage_mV_Q16()); };
+	float getShuntVoltage_uV(void){ return q16ToFloat(getShuntVoltage_mV_Q16()) * 1e3f; };
 
-	float getCurrent_mA(void){ return getCurrent_A() * 1e3; };
-	float getCurrent_uA(void){ return getCurrent_A() * 1e6; };
+	float getCurrent_mA(void){ return getCurrent_A() * 1e3f; };
+	float getCurrent_uA(void){ return getCurrent_A() * 1e6f; };
 
-	float getPower_mW(void){ return getPower_W() * 1e3; };
-	float getPower_uW(void){ return getPower_W() * 1e6; };
+	float getPower_mW(void){ return getPower_W() * 1e3f; };
+	float getPower_uW(void){ return getPower_W() * 1e6f; };
 
 
 	// --- LSB getters
@@ -163,8 +218,7 @@ public:
 
 	// --- Sensor configuration methods -------------------------------------------------
 
-	// --- General configuration
-	// TODO better management
+	// --- General configuration (shadowed, getters cost no bus time)
 
 	bool setConfiguration(uint16_t value);
 	uint16_t getConfiguration(void);
@@ -188,6 +242,44 @@ public:
 	INA219::OPERATING_MODE getOperatingMode(void);
 
 
+	// --- Triggered acquisition methods ------------------------------------------------
+
+	// Non-blocking, the steps run on the bus engine interrupts
+
+	enum ACQUISITION_STATE : uint8_t {		// Progress of the triggered conversion
+		ACQUISITION_IDLE 		= 0x00,		// Nothing started
+		ACQUISITION_TRIGGERING 	= 0x01,		// Configuration write queued
+		ACQUISITION_CONVERTING 	= 0x02,		// Polling the CNVR flag
+		ACQUISITION_READING 	= 0x03,		// Reading the shunt voltage
+		ACQUISITION_READY 		= 0x04,		// New sample available
+		ACQUISITION_FAILED 		= 0x05,		// Bus error or conversion timed out
+	};
+
+	bool beginTriggered(INA219::OPERATING_MODE mode = INA219::BOTH_VOLTAGE_TRGD);
+	bool endTriggered(void);
+
+	bool setTriggeredResolution(INA219::SHUNT_ADC_RESOLUTION shunt, INA219::BUS_ADC_RESOLUTION bus);
+	uint32_t getTriggeredConversionTime_us(void);
+
+	bool trigger(bool collect = true);		// Starts a conversion, callable from interrupts
+	bool collect(void);						// Starts polling a conversion triggered without it
+
+	INA219::ACQUISITION_STATE getAcquisitionState(void){ return _acquisition_state; };
+	bool isSampleReady(void){ return _acquisition_state == INA219::ACQUISITION_READY; };
+
+	q16_t getSampleCurrent_Q16(void);		// Latest completed sample [A]
+	q16_t getSampleBusVoltage_Q16(void);	// Latest completed sample [V]
+
+	uint16_t getConversionLatency_us(void){ return _conversion_latency; };	// Trigger written to CNVR seen
+	uint16_t getMaxConversionLatency_us(void){ return _max_conversion_latency; };
+	uint16_t getSampleLatency_us(void){ return _sample_latency; };			// trigger() to sample ready
+	uint8_t getPollCount(void){ return _poll_count; };					// CNVR reads of the last conversion
+
+	uint32_t getCompletedSamples(void){ return _completed_samples; };
+	uint32_t getFailedSamples(void){ return _failed_samples; };
+	uint32_t getTriggerOverruns(void){ return _trigger_overruns; };		// Trigger while the last one is on the bus
+
+
 	// --- Miscellaneous methods --------------------------------------------------------
 
 	bool reset(void);
@@ -204,6 +296,45 @@ protected:
 	float _current_lsb;
 	float _power_lsb;
 
+	Q_Gain _current_lsb_q16;				// Register to Q16.16 amps
+	Q_Gain _power_lsb_q16;					// Register to Q16.16 watts
+
+	uint16_t _calibration_value;			// Cached value, written only when it differs
+	bool _calibration_suspect;				// Verify before the next current or power read
+	uint16_t _calibration_check_period;		// Samples between periodic checks, 0 disables
+	uint16_t _samples_since_check;
+	uint32_t _calibration_checks;
+	uint32_t _calibration_rewrites;
+
+	bool _streaming;
+
+	Q_Gain _shunt_current_q16;				// Shunt register to Q16.16 amps (10 uV / R)
+
+	bool _triggered;						// CONF shadow written by every trigger
+	volatile INA219::ACQUISITION_STATE _acquisition_state;
+	volatile bool _collect_requested;		// Poll as soon as the configuration is written
+	volatile bool _polling;
+	uint8_t _async_buffer[2];
+
+	uint32_t _trigger_cycles;				// Cycle counter at trigger()
+	uint32_t _conversion_cycles;			// Cycle counter when the configuration was written
+	uint8_t _poll_count;
+
+	volatile uint16_t _sample_bus_voltage;	// Raw registers of the latest sample
+	volatile int16_t _sample_shunt_voltage;
+
+	uint16_t _conversion_latency;
+	uint16_t _max_conversion_latency;
+	uint16_t _sample_latency;
+	uint32_t _completed_samples;
+	uint32_t _failed_samples;
+	uint32_t _trigger_overruns;
+
+	Async_Result<q16_t> *volatile _current_result;		// Pending handle reads
+	Async_Result<q16_t> *volatile _bus_voltage_result;
+	uint8_t _current_result_buffer[2];
+	uint8_t _bus_voltage_result_buffer[2];
+
 
 	// --- Sensor register map ----------------------------------------------------------
 
@@ -219,27 +350,65 @@ protected:
 	};
 
 
-	// --- Utility masks ----------------------------------------------------------------
+	// --- Register fields --------------------------------------------------------------
 
-	// --- Configuration bits masks
+	// Compile-time descriptors, see register_field.hpp (no storage, immediate masks)
+
+	// --- Configuration fields
 
 	// See data-sheet page 19 for more details on configuration bits
 
-	const uint16_t RESET_MASK					= 0x8000;
-	const uint16_t BUS_VOLTAGE_RANGE_MASK    	= 0x2000;
-	const uint16_t PGA_MASK    					= 0x1800;
-	const uint16_t BUS_ADC_RESOLUTION_MASK   	= 0x0780;
-	const uint16_t SHUNT_ADC_RESOLUTION_MASK 	= 0x0078;
-	const uint16_t OPERATING_MODE_MASK   		= 0x0007;
+	typedef Register_Field<uint16_t, 0x8000> RESET_FIELD;
+	typedef Register_Field<uint16_t, 0x2000> BUS_VOLTAGE_RANGE_FIELD;
+	typedef Register_Field<uint16_t, 0x1800> PGA_FIELD;
+	typedef Register_Field<uint16_t, 0x0780> BUS_ADC_RESOLUTION_FIELD;
+	typedef Register_Field<uint16_t, 0x0078> SHUNT_ADC_RESOLUTION_FIELD;
+	typedef Register_Field<uint16_t, 0x0007> OPERATING_MODE_FIELD;
 
 
-	// --- Bus voltage register bits masks
+	// --- Bus voltage register fields
 
 	// See data-sheet page 23 for more details on bus voltage flag bits
 
-	const uint16_t BUS_REGISTER_FLAGS_MASK 		= 0x0003;
-	const uint16_t BUS_REGISTER_CNVR_MASK		= 0x0002;
-	const uint16_t BUS_REGISTER_OVF_MASK		= 0x0001;
+	typedef Register_Field<uint16_t, 0xFFF8> BUS_VOLTAGE_FIELD;		// 13 bits, 4 mV LSB
+	typedef Register_Field<uint16_t, 0x0002> CNVR_FIELD;				// Conversion ready
+	typedef Register_Field<uint16_t, 0x0001> OVF_FIELD;				// Math overflow
+
+
+	// --- Bus recovery -----------------------------------------------------------------
+
+	void onBusRecovered(void) override;		// Also verifies the calibration before the next reading
+
+
+private:
+	// --- Utility methods --------------------------------------------------------------
+
+	HAL_StatusTypeDef readRegister(INA219::REGISTER register_address, uint16_t *data_buffer);
+
+	uint16_t _last_register[INA219::CALIBRATION + 1];	// Last good content of each register read
+
+	void maintainCalibration(void);
+
+	static uint32_t conversionTime_us(uint16_t resolution_code);
+
+	q16_t decodeCurrent_Q16(uint16_t register_content);
+	static q16_t decodeBusVoltage_Q16(uint16_t register_content);
+
+
+	// --- Triggered acquisition steps (bus engine callbacks)
+
+	bool pollConversion(void);
+	void failAcquisition(void);
+
+	static void onTriggerWritten(void *context, HAL_StatusTypeDef status);
+	static void onBusVoltageRead(void *context, HAL_StatusTypeDef status);
+	static void onShuntVoltageRead(void *context, HAL_StatusTypeDef status);
+
+
+	// --- Asynchronous read steps (bus engine callbacks)
+
+	static void onCurrentResult(void *context, HAL_StatusTypeDef status);
+	static void onBusVoltageResult(void *context, HAL_StatusTypeDef status);
 };
 
 
@@ -0,0 +1,30 @@
+/*
+ * angle_source.hpp
+ *
+ * Module containing the common interface of the angle acquisition paths (AS5600 over
+ * I2C, AS5600 analog output, ...), so the consumer can switch between them at runtime.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+
+
+// --------------------------------------------------- Angle_Source class declaration ---
+
+class Angle_Source {
+
+public:
+	// --- Angle source methods ---------------------------------------------------------
+
+	virtual uint16_t getRawAngle(void) = 0;	// 12-bit angle in [0, 4095]
+
+
+protected:
+	~Angle_Source(void){};					// Not deleted through the interface
+};
+
+
+// END OF FILE
@@ -0,0 +1,90 @@
+/*
+ * angle_tracker.hpp
+ *
+ * Module containing a type 3 angle tracking loop (PLL style) for 12-bit encoder counts: it
+ * gives a smoothed angle, the velocity and the acceleration with integer math only.
+ *
+ * Loop, per sample, with e the wrapped angle error:
+ *
+ * 			a += Ka e,		w += a + Kw e,		theta += w + Kt e
+ *
+ * The gains place a triple pole at z = exp(-x), x = bandwidth * Ts: with q = 1 - exp(-x),
+ * the characteristic polynomial (z - 1)^3 + (Kt + Kw + Ka)(z - 1)^2 + (Kw + 2 Ka)(z - 1)
+ * + Ka equals (z - 1 + q)^3 for
+ *
+ * 			Ka = q^3,		Kw = 3 q^2 - 2 q^3,		Kt = 3 q - 3 q^2 + q^3
+ *
+ * (3 x, 3 x^2 and x^3 for a small x). States are kept in counts per sample (no Ts
+ * multiplications in the update) in Q32.32, the getters convert them to radians.
+ *
+ */
+
+#pragma once
+
+#include "fixed_point.hpp"
+
+
+
+// --- Tracker defaults -----------------------------------------------------------------
+
+const float ANGLE_TRACKER_DEFAULT_BANDWIDTH = 200;		// Loop bandwidth			[rad/s]
+const float ANGLE_TRACKER_MAX_NORMALIZED = 0.5;			// Bandwidth * Ts limit, count noise	[-]
+
+const int32_t ANGLE_TRACKER_COUNTS = 4096;				// Counts per turn
+
+
+
+// -------------------------------------------------- Angle_Tracker class declaration ---
+
+class Angle_Tracker {
+
+public:
+	// --- Tracker constructor ----------------------------------------------------------
+
+	Angle_Tracker(float sample_rate, float bandwidth = ANGLE_TRACKER_DEFAULT_BANDWIDTH);
+
+
+	// --- Tracker core methods ---------------------------------------------------------
+
+	void update(uint16_t counts);
+
+	void reset(uint16_t counts);
+
+
+	// --- Tracker parameters -----------------------------------------------------------
+
+	bool setBandwidth(float bandwidth);
+	float getBandwidth(void){ return _bandwidth; };
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	q16_t getAngleCounts(void){ return (q16_t)(_angle >> 16); };		// [0, 4096)	[counts]
+
+	q16_t getAngle(void);												// [0, 2pi)		[rad]
+	q16_t getVelocity(void);											// 				[rad/s]
+	q16_t getAcceleration(void);										// 				[rad/s^2]
+
+
+private:
+	// --- Tracker variables ------------------------------------------------------------
+
+	float _sample_rate;
+	float _bandwidth;
+
+	Q_Gain _gain_angle;						// Kt
+	Q_Gain _gain_velocity;					// Kw
+	Q_Gain _gain_acceleration;				// Ka
+
+	Q_Gain _to_velocity;					// Counts/sample in Q16 to rad/s
+	Q_Gain _to_acceleration;				// Counts/sample^2 in Q32 to rad/s^2
+
+	bool _initialized;
+
+	int64_t _angle;							// Counts, Q32.32
+	int64_t _velocity;						// Counts per sample, Q32.32
+	int64_t _acceleration;					// Counts per sample^2, Q32.32
+};
+
+
+// END OF FILE
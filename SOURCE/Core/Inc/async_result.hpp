@@ -0,0 +1,241 @@
+/*
+ * async_result.hpp
+ *
+ * Module containing a lightweight handle for the result of an asynchronous sensor read.
+ * The caller owns the handle, the driver fills it from the bus engine interrupts:
+ *
+ * 			Async_Result<q16_t> current;
+ * 			sensor.readCurrentAsync(current);			start, never blocks
+ * 			...											work overlapping the transfer
+ * 			if(current.await(300)) i = current.getValue();	or poll isDone()
+ *
+ * An optional callback receives the finished result, in interrupt context. A handle can
+ * be started again once it is no longer pending, and must outlive the read. Drivers keep
+ * one pending slot per kind of read, claimed together with the handle (begin) with
+ * interrupts masked, so callers in thread mode and in interrupts cannot both take it.
+ *
+ */
+
+#pragma once
+
+#include "stm32f1xx_hal.h"
+#include "cycle_counter.hpp"
+
+
+
+// ------------------------------------------------ Async_Result template declaration ---
+
+template <typename T>
+class Async_Result {
+
+public:
+	// --- Result description -----------------------------------------------------------
+
+	enum STATE : uint8_t {					// Progress of the read
+		IDLE 	= 0x00,						// Never started
+		PENDING = 0x01,						// Queued or on the wire
+		READY 	= 0x02,						// Value decoded
+		FAILED 	= 0x03,						// Not started or bus error, see getStatus()
+	};
+
+	// Completion callback, runs in interrupt context
+	typedef void (*Callback)(void *context, const Async_Result<T> &result);
+
+
+	// --- Result constructor -----------------------------------------------------------
+
+	Async_Result(Async_Result::Callback callback = nullptr, void *context = nullptr) :
+			_state(Async_Result::IDLE),
+			_value(),
+			_status(HAL_OK),
+			_start_cycles(0),
+			_latency_cycles(0),
+			_callback(callback),
+			_context(context)
+		{}
+
+
+	// --- Caller methods ---------------------------------------------------------------
+
+	Async_Result::STATE getState(void) const { return _state; };
+
+	bool isPending(void) const { return _state == Async_Result::PENDING; };
+	bool isDone(void) const { return _state == Async_Result::READY || _state == Async_Result::FAILED; };
+	bool isReady(void) const { return _state == Async_Result::READY; };
+
+	T getValue(void) const { return _value; };				// Last decoded value
+	HAL_StatusTypeDef getStatus(void) const { return _status; };
+
+	uint16_t getLatency_us(void) const;		// Start to completion
+
+	bool await(uint32_t timeout_us);		// Waits while pending, true if ready
+
+	void setCallback(Async_Result::Callback callback, void *context = nullptr);
+
+
+	// --- Driver methods ---------------------------------------------------------------
+
+	bool begin(void);						// False if still pending
+	bool begin(Async_Result *volatile &slot);	// Also claims the pending slot of the driver
+
+	void complete(T value);
+	void fail(HAL_StatusTypeDef status);
+
+
+private:
+	// --- Result variables -------------------------------------------------------------
+
+	volatile Async_Result::STATE _state;
+	volatile T _value;
+	volatile HAL_StatusTypeDef _status;
+
+	uint32_t _start_cycles;
+	volatile uint32_t _latency_cycles;
+
+	Async_Result::Callback _callback;
+	void *_context;
+
+
+	// --- Completion -------------------------------------------------------------------
+
+	void finish(Async_Result::STATE state);
+};
+
+
+
+// --------------------------------------------- Async_Result template implementation ---
+
+// --- Caller methods -------------------------------------------------------------------
+
+/*
+ * @brief Returns the time from the start of the read to its completion.
+ *
+ */
+template <typename T>
+uint16_t Async_Result<T>::getLatency_us(void) const {
+	uint32_t latency = Async_Result::_latency_cycles / (SystemCoreClock / 1000000);
+
+	return latency > 0xFFFF ? 0xFFFF : latency;
+}
+
+/*
+ * @brief Waits for a pending read to finish, up to a timeout (DWT cycle counter). Not
+ * from interrupts at the bus priority, the read completes in them.
+ *
+ * @param timeout_us	Longest wait [us];
+ *
+ */
+template <typename T>
+bool Async_Result<T>::await(uint32_t timeout_us){
+	uint32_t start = cycleCounterRead();
+	uint32_t timeout = timeout_us * (SystemCoreClock / 1000000);
+
+	while(Async_Result::_state == Async_Result::PENDING){
+		if(cycleCounterElapsed(start) >= timeout) return false;
+	}
+
+	return Async_Result::_state == Async_Result::READY;
+}
+
+/*
+ * @brief Sets the function called when a read finishes.
+ *
+ * @param callback	Function to call, in interrupt context, nullptr to remove it;
+ * @param context	Argument passed to the function;
+ *
+ */
+template <typename T>
+void Async_Result<T>::setCallback(Async_Result::Callback callback, void *context){
+	Async_Result::_callback = callback;
+	Async_Result::_context = context;
+}
+
+
+// --- Driver methods -------------------------------------------------------------------
+
+/*
+ * @brief Marks the handle pending, before the read is queued. Check and mark are atomic,
+ * the same handle may be started from interrupts.
+ *
+ */
+template <typename T>
+bool Async_Result<T>::begin(void){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	bool idle = Async_Result::_state != Async_Result::PENDING;
+	if(idle){
+		Async_Result::_status = HAL_OK;
+		Async_Result::_start_cycles = cycleCounterRead();
+		Async_Result::_state = Async_Result::PENDING;
+	}
+
+	__set_PRIMASK(primask);
+
+	return idle;
+}
+
+/*
+ * @brief Marks the handle pending and claims the pending slot of the driver for it, in
+ * one step with interrupts masked. False if the slot or the handle is taken; the driver
+ * frees the slot (nullptr) when the read finishes or cannot be queued.
+ *
+ * @param slot	Pending handle of the driver for this kind of read;
+ *
+ */
+template <typename T>
+bool Async_Result<T>::begin(Async_Result *volatile &slot){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	bool claimed = slot == nullptr && Async_Result::begin();
+	if(claimed) slot = this;
+
+	__set_PRIMASK(primask);
+
+	return claimed;
+}
+
+/*
+ * @brief Stores the decoded value and finishes the read.
+ *
+ * @param value	Decoded value;
+ *
+ */
+template <typename T>
+void Async_Result<T>::complete(T value){
+	Async_Result::_value = value;
+	Async_Result::finish(Async_Result::READY);
+}
+
+/*
+ * @brief Finishes the read with an error, the previous value is kept.
+ *
+ * @param status	Result of the transfer, or of its start;
+ *
+ */
+template <typename T>
+void Async_Result<T>::fail(HAL_StatusTypeDef status){
+	Async_Result::_status = status;
+	Async_Result::finish(Async_Result::FAILED);
+}
+
+
+// --- Completion -----------------------------------------------------------------------
+
+/*
+ * @brief Records the latency, publishes the state and calls the callback.
+ *
+ * @param state	Final state;
+ *
+ */
+template <typename T>
+void Async_Result<T>::finish(Async_Result::STATE state){
+	Async_Result::_latency_cycles = cycleCounterElapsed(Async_Result::_start_cycles);
+	Async_Result::_state = state;
+
+	if(Async_Result::_callback != nullptr) Async_Result::_callback(Async_Result::_context, *this);
+}
+
+
+// END OF FILE
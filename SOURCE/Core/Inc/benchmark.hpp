@@ -0,0 +1,66 @@
+/*
+ * benchmark.hpp
+ *
+ * Module containing an on-target micro-benchmark probe, to measure code sections in CPU
+ * cycles with the DWT cycle counter and keep running statistics.
+ *
+ * Usage: probe.start(); <code under test>; probe.stop(); then inspect the getters from
+ * the debugger (or read them out in the application).
+ *
+ */
+
+#pragma once
+
+#include "cycle_counter.hpp"
+
+
+
+// ------------------------------------------------------ Benchmark class declaration ---
+
+class Benchmark {
+
+public:
+	// --- Benchmark constructor --------------------------------------------------------
+
+	Benchmark(const char *name);
+
+
+	// --- Measurement methods ----------------------------------------------------------
+
+	void start(void){ _start = cycleCounterRead(); };
+	void stop(void);
+
+	void resetStatistics(void);
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	const char *getName(void){ return _name; };
+
+	uint32_t getCount(void){ return _count; };
+
+	uint32_t getLastCycles(void){ return _last; };
+	uint32_t getMinCycles(void){ return _min; };
+	uint32_t getMaxCycles(void){ return _max; };
+	uint32_t getAvgCycles(void);
+
+	float getAvg_us(void){ return (float)Benchmark::getAvgCycles() / (SystemCoreClock / 1000000); };	// At the current core clock
+	float getMax_us(void){ return (float)_max / (SystemCoreClock / 1000000); };
+
+
+private:
+	// --- Benchmark variables ----------------------------------------------------------
+
+	const char *_name;
+
+	uint32_t _start;
+
+	uint32_t _count;
+	uint32_t _last;
+	uint32_t _min;
+	uint32_t _max;
+	uint64_t _total;
+};
+
+
+// END OF FILE
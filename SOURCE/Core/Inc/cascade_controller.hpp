@@ -0,0 +1,111 @@
+/*
+ * cascade_controller.hpp
+ *
+ * Module containing the cascaded position -> speed -> current controller of the servo.
+ *
+ * Position is the output shaft angle [rad], speed the motor speed [rad/s], current the
+ * motor current [A] and the output the H-bridge duty cycle [-1, 1]. All signals are
+ * Q16.16 values.
+ *
+ */
+
+#pragma once
+
+#include "pi_controller.hpp"
+
+
+
+// --- Default tuning -------------------------------------------------------------------
+
+// See MODELS_AND_SIMULATIONS/Controller_Tune.m and Full_Model_params.m
+
+const float CONTROLLER_SAMPLING_TIME 	= 1e-3;			// uc.Ts						[s]
+
+const float CURRENT_KP 					= 0.6114;		// Ri.Kp						[1/A]
+const float CURRENT_KI 					= 174.68;		// Ri.Ki						[1/(A*s)]
+
+const float SPEED_KP 					= 6.4227e-3;	// Rw.Kp						[A*s/rad]
+const float SPEED_KI 					= 0.96120;		// Rw.Ki						[A/rad]
+
+// Crossover a decade below the speed loop (Rw.wb / 10 = 22 rad/s), with one tick of delay
+// the margins are 88.6 deg and 14.1 dB (Rp.Pm, Rp.Gm)
+const float POSITION_KP 				= 4316.4;		// Rp.Kp						[1/s]
+
+const float SATURATION_DUTY 			= 1.0;			// sat.d						[-]
+const float SATURATION_CURRENT 			= 1.5;			// sat.I						[A]
+const float SATURATION_SPEED 			= 1256.64;		// sat.w, 12000 rpm				[rad/s]
+
+
+
+// --------------------------------------------- Cascade_Controller class declaration ---
+
+class Cascade_Controller {
+
+public:
+	// --- Controller options -----------------------------------------------------------
+
+	enum MODE : uint8_t {					// Outermost closed loop
+		DISABLED 	= 0x00,					// Output forced to zero
+		CURRENT 	= 0x01,					// Current reference given
+		SPEED 		= 0x02,					// Speed reference given
+		POSITION 	= 0x03,					// Position reference given
+	};
+
+
+	// --- Controller constructor -------------------------------------------------------
+
+	Cascade_Controller(float sampling_time = CONTROLLER_SAMPLING_TIME);
+
+
+	// --- Controller core methods ------------------------------------------------------
+
+	q16_t update(q16_t position, q16_t speed, q16_t current);
+
+	void reset(void);
+
+
+	// --- Mode and references ----------------------------------------------------------
+
+	void setMode(Cascade_Controller::MODE mode);
+	Cascade_Controller::MODE getMode(void){ return _mode; };
+
+	void setPositionReference(q16_t position){ _position_reference = position; };
+	void setSpeedReference(q16_t speed){ _speed_reference = speed; };
+	void setCurrentReference(q16_t current){ _current_reference = current; };
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	q16_t getSpeedReference(void){ return _speed_reference; };
+	q16_t getCurrentReference(void){ return _current_reference; };
+	q16_t getDuty(void){ return _duty; };
+
+
+	// --- Loop access (gains and limits) -----------------------------------------------
+
+	void setPositionGain(float kp){ _position_kp = qGainFromFloat(kp); };
+	void setSpeedLimit(float limit){ _speed_limit = q16FromFloat(limit); };
+
+	PI_Controller &getSpeedLoop(void){ return _speed_loop; };
+	PI_Controller &getCurrentLoop(void){ return _current_loop; };
+
+
+protected:
+	// --- Controller variables ---------------------------------------------------------
+
+	Cascade_Controller::MODE _mode;
+
+	Q_Gain _position_kp;
+	q16_t _speed_limit;
+
+	PI_Controller _speed_loop;				// Output limited to sat.I
+	PI_Controller _current_loop;			// Output limited to sat.d
+
+	q16_t _position_reference;
+	q16_t _speed_reference;
+	q16_t _current_reference;
+	q16_t _duty;
+};
+
+
+// END OF FILE
@@ -0,0 +1,119 @@
+/*
+ * control_tick.hpp
+ *
+ * Module containing a class for a fixed-period control tick driven by a hardware
+ * timer update event.
+ *
+ * The timer must count at 1 MHz (one count per microsecond), its period sets the
+ * control period. Overruns and start jitter are measured on every tick.
+ *
+ * Phase hooks can run in the timer interrupt at fixed points of every period (one per
+ * compare channel), e.g. to start sensor conversions and collect them so the samples
+ * are ready, and aligned, at the next tick.
+ *
+ */
+
+#pragma once
+
+#include "stm32f1xx_hal.h"
+
+
+
+// --- Tick limits ----------------------------------------------------------------------
+
+const uint8_t CONTROL_TICK_MAX_COUNT = 2;		// Timers that can drive a tick
+const uint8_t CONTROL_TICK_MAX_HOOKS = 4;		// Phase hooks, one per compare channel
+
+
+
+// --------------------------------------------------- Control_Tick class declaration ---
+
+class Control_Tick {
+
+public:
+	// --- Hook type --------------------------------------------------------------------
+
+	typedef void (*Hook)(void *context);	// Runs in interrupt context
+
+
+	// --- Tick constructor -------------------------------------------------------------
+
+	Control_Tick(TIM_HandleTypeDef *timer_handle);
+	~Control_Tick();
+
+
+	// --- Tick core methods ------------------------------------------------------------
+
+	bool begin(void);
+
+	void wait(void);						// Sleeps until the next tick, then marks its start
+
+	void done(void);						// Marks the end of the tick work
+
+
+	// --- Phase hook -------------------------------------------------------------------
+
+	bool setPhaseHook(uint8_t channel, uint16_t phase_us, Control_Tick::Hook hook, void *context = nullptr);
+	void clearPhaseHook(uint8_t channel);
+
+	uint16_t getPhase_us(uint8_t channel);
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	uint32_t getPeriod_us(void){ return __HAL_TIM_GET_AUTORELOAD(_timer_handle) + 1; };
+	uint16_t getTime_us(void){ return __HAL_TIM_GET_COUNTER(_timer_handle); };	// Since the last timer event
+
+	uint32_t getTickCount(void){ return _ticks; };
+	uint32_t getOverrunCount(void){ return _overruns; };
+
+
+	// --- Timing statistics (microseconds) ---------------------------------------------
+
+	uint16_t getMinLatency_us(void){ return _min_latency; };
+	uint16_t getMaxLatency_us(void){ return _max_latency; };
+	uint16_t getAverageLatency_us(void);
+
+	uint16_t getJitter_us(void);			// Spread of the tick start after the timer event
+
+	uint16_t getLastExecution_us(void){ return _last_execution; };
+	uint16_t getMaxExecution_us(void){ return _max_execution; };
+
+	void resetStatistics(void);
+
+
+	// --- Interrupt hooks --------------------------------------------------------------
+
+	void onTimerUpdate(void);
+	void onTimerCompare(uint8_t channel);
+
+	static Control_Tick *getTick(TIM_HandleTypeDef *timer_handle);
+
+
+private:
+	// --- Variables --------------------------------------------------------------------
+
+	TIM_HandleTypeDef *_timer_handle;
+
+	volatile bool _pending;					// Timer event not yet served
+	volatile bool _running;					// Tick work in progress
+	volatile uint32_t _ticks;
+	volatile uint32_t _overruns;
+
+	uint16_t _min_latency;
+	uint16_t _max_latency;
+	uint32_t _latency_sum;
+	uint32_t _latency_samples;
+
+	uint16_t _last_execution;
+	uint16_t _max_execution;
+
+	uint16_t _phases[CONTROL_TICK_MAX_HOOKS];
+	volatile Control_Tick::Hook _phase_hooks[CONTROL_TICK_MAX_HOOKS];
+	void *volatile _phase_contexts[CONTROL_TICK_MAX_HOOKS];
+
+	static Control_Tick *_control_ticks[CONTROL_TICK_MAX_COUNT];
+};
+
+
+// END OF FILE
@@ -0,0 +1,94 @@
+/*
+ * conversion_policy.hpp
+ *
+ * Module containing the policy that picks the INA219 conversion settings of the power
+ * stage from the controller state:
+ *
+ * 			FAST	 	current transients, shortest conversions (every tick)
+ * 			NORMAL	 	tracking, one more shunt bit (every tick)
+ * 			HOLD	 	position held, averaged shunt readings (one batch every few ticks)
+ * 			MONITOR 	controller disabled, heavy averaging for thermal monitoring
+ *
+ * Faster settings are taken at once, slower ones only after the state lasted a while.
+ * A switch costs no bus access: the settings travel with the next trigger write.
+ *
+ */
+
+#pragma once
+
+#include "cascade_controller.hpp"
+#include "motor_power_stage.hpp"
+
+
+
+// --- Policy thresholds ----------------------------------------------------------------
+
+const q16_t CONVERSION_POLICY_TRANSIENT_CURRENT = q16FromFloat(0.2);	// Current error		[A]
+const q16_t CONVERSION_POLICY_HOLD_SPEED = q16FromFloat(5);			// Motor speed		[rad/s]
+
+const uint16_t CONVERSION_POLICY_SETTLE_TICKS = 20;		// FAST to NORMAL
+const uint16_t CONVERSION_POLICY_HOLD_TICKS = 200;		// NORMAL to HOLD or MONITOR
+
+
+
+// ---------------------------------------------- Conversion_Policy class declaration ---
+
+class Conversion_Policy {
+
+public:
+	// --- Policy profiles --------------------------------------------------------------
+
+	enum PROFILE : uint8_t {
+		FAST 		= 0x00,					// 9-bit shunt, 9-bit bus: 168 us
+		NORMAL 		= 0x01,					// 10-bit shunt, 9-bit bus: 232 us
+		HOLD 		= 0x02,					// 4 shunt samples, 9-bit bus: 2.2 ms
+		MONITOR 	= 0x03,					// 32 samples on both: 34 ms
+	};
+
+	struct Profile_Settings {
+		INA219::SHUNT_ADC_RESOLUTION shunt;
+		INA219::BUS_ADC_RESOLUTION bus;
+	};
+
+
+	// --- Policy constructor -----------------------------------------------------------
+
+	Conversion_Policy(Motor_Power_Stage &stage);
+
+
+	// --- Policy core methods ----------------------------------------------------------
+
+	bool update(Cascade_Controller &controller, q16_t speed, q16_t current);	// True on a switch
+
+	void setOverride(Conversion_Policy::PROFILE profile);		// Fixed profile, e.g. for calibration
+	void clearOverride(void){ _overridden = false; };
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	Conversion_Policy::PROFILE getProfile(void){ return _profile; };
+	uint32_t getSwitchCount(void){ return _switches; };
+
+
+private:
+	// --- Policy variables -------------------------------------------------------------
+
+	Motor_Power_Stage &_stage;
+
+	Conversion_Policy::PROFILE _profile;	// Applied
+	Conversion_Policy::PROFILE _candidate;	// Wanted, waiting for its delay
+	uint16_t _candidate_ticks;
+
+	bool _overridden;
+	uint32_t _switches;
+
+	static const Conversion_Policy::Profile_Settings _settings[4];
+
+
+	// --- Utility methods --------------------------------------------------------------
+
+	bool apply(Conversion_Policy::PROFILE profile);
+};
+
+
+// END OF FILE
@@ -0,0 +1,49 @@
+/*
+ * cycle_counter.hpp
+ *
+ * Module containing helpers for the Cortex-M3 DWT cycle counter, to measure the cost of
+ * code sections in CPU cycles (1 cycle = 1/64 us at the current clock).
+ *
+ */
+
+#pragma once
+
+#include "stm32f1xx_hal.h"
+
+
+
+// --- Cycle counter --------------------------------------------------------------------
+
+/*
+ * @brief Enables the trace unit and starts the cycle counter from zero.
+ *
+ */
+inline void cycleCounterBegin(void){
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+};
+
+/*
+ * @brief Checks if the cycle counter counts: trace unit enabled and counter started
+ * (see cycleCounterBegin). Time-outs measured on a stopped counter never expire.
+ *
+ */
+inline bool cycleCounterIsRunning(void){
+	return (CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) && (DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk);
+};
+
+/*
+ * @brief Returns the current cycle count (wraps every 2^32 cycles, about 67 s).
+ *
+ */
+inline uint32_t cycleCounterRead(void){ return DWT->CYCCNT; };
+
+/*
+ * @brief Returns the cycles elapsed since a previous reading, wrap-around included.
+ *
+ */
+inline uint32_t cycleCounterElapsed(uint32_t start){ return DWT->CYCCNT - start; };
+
+
+// END OF FILE
@@ -0,0 +1,105 @@
+/*
+ * fixed_point.hpp
+ *
+ * Module containing fixed-point types and helpers for the control code.
+ *
+ * The target has no FPU (soft-float build), so signals travel as Q16.16 integers and
+ * constants are converted once, at configuration time.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+
+
+// --- Q16.16 format --------------------------------------------------------------------
+
+typedef int32_t q16_t;						// 16 integer bits (sign included), 16 fractional bits
+
+const q16_t Q16_ONE = 0x00010000;
+const q16_t Q16_MAX = INT32_MAX;
+const q16_t Q16_MIN = INT32_MIN;
+
+
+// --- Conversions
+
+constexpr q16_t q16FromFloat(float value){ return (q16_t)(value * 65536.0f); };
+inline float q16ToFloat(q16_t value){ return value / 65536.0f; };
+
+inline q16_t q16FromInt(int16_t value){ return (q16_t)value << 16; };
+
+
+// --- Arithmetic
+
+/*
+ * @brief Clamps a wide intermediate result to a symmetric limit.
+ *
+ */
+inline q16_t q16Clamp(int64_t value, q16_t limit){
+	if(value > limit) return limit;
+	if(value < -limit) return -limit;
+	return (q16_t)value;
+};
+
+/*
+ * @brief Multiplies two Q16.16 values, saturating the result.
+ *
+ */
+inline q16_t q16Multiply(q16_t a, q16_t b){
+	return q16Clamp(((int64_t)a * b) >> 16, Q16_MAX);
+};
+
+
+
+// --- Scaled gains ---------------------------------------------------------------------
+
+// A gain stored as mantissa / 2^shift, so that both large and very small constants keep
+// about 30 significant bits. Applying it costs one 32x32 multiply and one shift.
+
+struct Q_Gain {
+	int32_t mantissa;
+	uint8_t shift;
+};
+
+/*
+ * @brief Builds a scaled gain from a float (configuration or compile time only).
+ *
+ */
+constexpr Q_Gain qGainFromFloat(float value){
+	Q_Gain gain = {0, 0};
+	if(value == 0.0f) return gain;
+
+	// Raise the shift while the mantissa stays below 2^30
+	float magnitude = value < 0 ? -value : value;
+	while(gain.shift < 62 && magnitude * 2.0f < 1073741824.0f){
+		magnitude *= 2.0f;
+		gain.shift++;
+	}
+
+	// Apply the sign
+	gain.mantissa = (int32_t)(value < 0 ? -magnitude : magnitude);
+	return gain;
+};
+
+/*
+ * @brief Applies a scaled gain to a Q16.16 value, keeping the wide result.
+ *
+ */
+inline int64_t qGainApply(Q_Gain gain, q16_t value){
+	return ((int64_t)gain.mantissa * value) >> gain.shift;
+};
+
+/*
+ * @brief Applies a scaled gain to a Q16.16 value, giving a Q32.32 result (for
+ * accumulators that must not lose small increments).
+ *
+ */
+inline int64_t qGainApplyQ32(Q_Gain gain, q16_t value){
+	if(gain.shift >= 16) return ((int64_t)gain.mantissa * value) >> (gain.shift - 16);
+	return (int64_t)gain.mantissa * value * ((int64_t)1 << (16 - gain.shift));
+};
+
+
+// END OF FILE
@@ -0,0 +1,209 @@
+/*
+ * i2c_bus.hpp
+ *
+ * Module containing a class for asynchronous transactions on an I2C bus.
+ *
+ * Register reads and writes are queued and executed from the I2C event/DMA
+ * interrupts, completion is signalled with a callback. Transactions carrying device
+ * statistics are recorded when they finish (latency from the start on the wire).
+ *
+ * Blocking transfers on the same peripheral hold the queue with acquire()/release(), so
+ * no interrupt can start a queued transfer while the blocking call is inside the HAL.
+ *
+ * A glitch on the bus can leave a slave holding SDA low, or the STM32F1 peripheral with
+ * its BUSY flag stuck, and the HAL then waits 25 ms before every transfer. The queue
+ * checks the flag once before each start (a set flag without a STOP on the wire defers
+ * the start to service()), and recover() frees the bus in bounded time:
+ *
+ * 			release		peripheral de-initialised, a transfer on the wire fails
+ * 			clock out	SCL pulsed as GPIO until the slave releases SDA (up to 9)
+ * 			stop		STOP condition on the free lines
+ * 			reset		peripheral re-initialised (software reset, pins, DMA, IRQs)
+ *
+ * The line steps stop at I2C_BUS_RECOVERY_BUDGET_US, the reset always runs. Devices see
+ * the recovery count change and drop their cached state (see I2C_Device).
+ *
+ */
+
+#pragma once
+
+#include "stm32f1xx_hal.h"
+#include "i2c_statistics.hpp"
+
+
+
+// --- Bus engine limits ----------------------------------------------------------------
+
+const uint8_t I2C_BUS_MAX_COUNT = 2;			// Number of I2C peripherals on the chip
+const uint8_t I2C_BUS_QUEUE_SIZE = 16;			// Transactions waiting on each bus
+const uint8_t I2C_BUS_PAYLOAD_SIZE = 4;			// Bytes copied for small writes
+
+
+
+// --- Fault recovery configuration -----------------------------------------------------
+
+const uint16_t I2C_BUS_RELEASE_TIMEOUT_US = 20;		// BUSY flag after a STOP, longer is a stuck bus
+const uint16_t I2C_BUS_TRANSFER_TIMEOUT_US = 500;	// Queued transfer without completion
+const uint16_t I2C_BUS_RECOVERY_BUDGET_US = 250;	// Line steps, the peripheral reset comes on top
+
+const uint8_t I2C_BUS_RECOVERY_CLOCKS = 9;			// A byte and its acknowledge
+const uint8_t I2C_BUS_RECOVERY_HALF_CLOCK_US = 5;	// 100 kHz, slow enough for every device
+
+
+
+// -------------------------------------------------------- I2C_Bus class declaration ---
+
+class I2C_Bus {
+
+public:
+	// --- Transaction options ----------------------------------------------------------
+
+	enum TRANSFER_MODE : uint8_t {			// How the data phase is moved
+		INTERRUPT 	= 0x00,					// Byte by byte from the event interrupt
+		DMA 		= 0x01,					// DMA channel, for transfers longer than one byte
+	};
+
+	enum DIRECTION : uint8_t {				// Transaction direction
+		READ 	= 0x00,
+		WRITE 	= 0x01,
+	};
+
+	enum RECOVERY_STAGE : uint8_t {			// Last step reached by recover()
+		RECOVERY_NONE 		= 0x00,			// Never recovered
+		RECOVERY_RELEASE 	= 0x01,			// Peripheral released, pins as GPIO
+		RECOVERY_CLOCK_OUT 	= 0x02,			// Pulsing SCL until SDA is high
+		RECOVERY_STOP 		= 0x03,			// Sending a STOP condition
+		RECOVERY_RESET 		= 0x04,			// Peripheral reset and re-initialised
+		RECOVERY_DONE 		= 0x05,			// Bus free
+	};
+
+	// Completion callback, runs in interrupt context
+	typedef void (*Callback)(void *context, HAL_StatusTypeDef status);
+
+	struct Transaction {
+		uint8_t device_address;				// Shifted 8 bit address
+		uint8_t register_address;
+		DIRECTION direction;
+		uint16_t length;
+		uint8_t *data_buffer;				// Destination for reads, source for long writes
+		uint8_t payload[I2C_BUS_PAYLOAD_SIZE];	// Source for short writes
+		Callback callback;
+		void *context;
+		I2C_Statistics *statistics;			// Device statistics to update, optional
+	};
+
+
+	// --- Bus constructor --------------------------------------------------------------
+
+	I2C_Bus(I2C_HandleTypeDef *bus_handle, I2C_Bus::TRANSFER_MODE mode = I2C_Bus::INTERRUPT);
+	~I2C_Bus();
+
+
+	// --- Bus core methods -------------------------------------------------------------
+
+	bool begin(void);
+
+	HAL_StatusTypeDef submit(I2C_Bus::Transaction *transaction);
+
+	void service(void);
+
+	void setIdleCallback(I2C_Bus::Callback callback, void *context = nullptr);	// Queue drained, last status
+
+
+	// --- Blocking transfer hold -------------------------------------------------------
+
+	bool acquire(void);						// Waits for the transfer on the wire, false on timeout
+	void release(void);						// Restarts the queue
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	I2C_HandleTypeDef *getBusHandle(void){ return _bus_handle; };
+
+	I2C_Bus::TRANSFER_MODE getTransferMode(void){ return _mode; };
+
+	bool isIdle(void){ return !_busy && _count == 0; };
+
+	uint8_t getPendingCount(void){ return _count; };
+
+	uint32_t getCompletedCount(void){ return _completed; };
+	uint32_t getErrorCount(void){ return _errors; };
+
+
+	// --- Fault recovery (thread mode only) --------------------------------------------
+
+	bool isStuck(void);						// BUSY flag held with no transfer running
+	bool isFaulted(void){ return _fault; };	// Stuck seen by the queue, or the last recovery failed
+
+	bool recover(void);						// Bounded, see I2C_BUS_RECOVERY_BUDGET_US
+
+	I2C_Bus::RECOVERY_STAGE getRecoveryStage(void){ return _recovery_stage; };
+	uint32_t getRecoveryCount(void){ return _recoveries; };
+	uint32_t getRecoveryFailures(void){ return _recovery_failures; };
+	uint16_t getLastRecovery_us(void){ return _last_recovery_us; };
+	uint16_t getMaxRecovery_us(void){ return _max_recovery_us; };
+
+
+	// --- Interrupt hooks --------------------------------------------------------------
+
+	void onTransferComplete(HAL_StatusTypeDef status);
+
+	static I2C_Bus *getBus(I2C_HandleTypeDef *bus_handle);
+
+
+private:
+	// --- Variables --------------------------------------------------------------------
+
+	I2C_HandleTypeDef *_bus_handle;
+	const I2C_Bus::TRANSFER_MODE _mode;
+
+	I2C_Bus::Transaction _queue[I2C_BUS_QUEUE_SIZE];
+	volatile uint8_t _head;					// Next free slot
+	volatile uint8_t _tail;					// Transaction on the wire or next to start
+	volatile uint8_t _count;
+	volatile bool _busy;
+	volatile uint8_t _holds;				// Blocking transfers in progress, the queue waits
+	uint32_t _start_cycles;					// Start of the transfer on the wire
+
+	volatile uint32_t _completed;
+	volatile uint32_t _errors;
+
+	volatile I2C_Bus::Callback _idle_callback;
+	void *volatile _idle_context;
+
+	volatile bool _recovering;				// Queue held while the bus is recovered
+	volatile bool _fault;
+	I2C_Bus::RECOVERY_STAGE _recovery_stage;
+	uint32_t _recoveries;
+	uint32_t _recovery_failures;
+	uint16_t _last_recovery_us;
+	uint16_t _max_recovery_us;
+
+	static I2C_Bus *_buses[I2C_BUS_MAX_COUNT];
+
+
+	// --- Queue methods ----------------------------------------------------------------
+
+	void startNext(void);
+
+	bool isReleasing(void);					// BUSY flag clear, or held only by a STOP
+
+	HAL_StatusTypeDef startTransfer(I2C_Bus::Transaction *transaction);
+
+	void finishTransaction(HAL_StatusTypeDef status);
+
+	void flush(HAL_StatusTypeDef status);	// Completes all the queued transactions
+
+
+	// --- Fault recovery methods -------------------------------------------------------
+
+	bool getRecoveryPins(GPIO_TypeDef **port, uint16_t *scl, uint16_t *sda);
+
+	bool recoverLines(uint32_t start, uint32_t budget);
+
+	bool waitHalfClock(uint32_t start, uint32_t budget);
+	bool waitLineHigh(GPIO_TypeDef *port, uint16_t pin, uint32_t start, uint32_t budget);
+};
+
+
+// END OF FILE
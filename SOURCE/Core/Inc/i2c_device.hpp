@@ -3,13 +3,44 @@
  *
  * Module containing a class for communicating with a generic I2C device.
  *
- * Contains reading and writing (low-level) functions.
+ * Contains reading and writing (low-level) functions, and a shadow register file: a
+ * write-through cache of the configuration registers, so configuration getters cost no
+ * bus time and setters a single write. The shadow can be invalidated (e.g. after a
+ * device reset), resynchronised, or verified against the device on every access.
+ * Every transfer, blocking or queued, is counted in the device statistics.
+ *
+ * Blocking transfers run on the I2C interrupts and wait for them with a timeout in
+ * microseconds (DWT cycle counter): the bytes on the wire at half the bus speed plus the
+ * response delay of the device, so a failed transfer gives up in a fraction of the
+ * control tick. On timeout the transfer is aborted (bus recovery). They cannot be used
+ * from interrupts at the I2C priority; with interrupts masked or the cycle counter
+ * stopped they fail at once. isConnected() is such a transfer, an address probe.
+ *
+ * Blocking transfers first check the bus: a stuck bus is recovered on the spot (bounded,
+ * see I2C_Bus::recover), and after any recovery of the bus the device drops the state it
+ * cached from before (shadow, register pointer) through onBusRecovered(). The queue of
+ * the bus is then held for the transfer (see I2C_Bus::acquire).
  *
  */
 
 #pragma once
 
 #include "stm32f1xx_hal.h"
+#include "i2c_bus.hpp"
+
+
+
+// --- Shadow register file limits ------------------------------------------------------
+
+const uint8_t I2C_DEVICE_SHADOW_SIZE = 4;		// Shadowed registers per device
+
+
+
+// --- Blocking transfer timeout --------------------------------------------------------
+
+const uint32_t I2C_DEVICE_RESPONSE_DELAY_US = 50;	// Default extra time for the device	[us]
+const uint8_t I2C_DEVICE_ADDRESS_BYTES = 3;		// Device, register and repeated device address
+const uint8_t I2C_DEVICE_PROBE_TRIALS = 3;		// Address probes before a device is missing
 
 
 
@@ -23,7 +54,7 @@ public:
 	I2C_Device(
 			I2C_HandleTypeDef *device_handle,
 			uint8_t device_address,
-			uint32_t response_delay = HAL_MAX_DELAY
+			uint32_t response_delay_us = I2C_DEVICE_RESPONSE_DELAY_US
 			);
 
 
@@ -33,7 +64,9 @@ public:
 
 	I2C_HandleTypeDef getDeviceHandle(void){ return *I2C_Device::_device_handle; };
 
-	uint32_t getResponseDelay(void){ return I2C_Device::_response_delay; };
+	uint32_t getResponseDelay_us(void){ return I2C_Device::_response_delay_us; };
+
+	uint32_t getTransferTimeout_us(uint16_t length);	// Blocking transfer of length data bytes
 
 
 	// --- Utility methods --------------------------------------------------------------
@@ -41,12 +74,49 @@ public:
 	bool isConnected(void);
 
 
+	// --- Shadow register file ---------------------------------------------------------
+
+	void invalidateShadow(void);
+	void invalidateShadow(uint8_t register_address);
+
+	bool resyncShadow(void);				// Reads all shadowed registers from the device
+
+	void setShadowVerify(bool enable){ _shadow_verify = enable; };	// Debug, read back every access
+	bool isShadowVerify(void){ return _shadow_verify; };
+
+	uint32_t getShadowHits(void){ return _shadow_hits; };			// Reads served from the shadow
+	uint32_t getShadowMismatches(void){ return _shadow_mismatches; };	// Found by the verify mode
+
+
+	// --- Transaction statistics -------------------------------------------------------
+
+	// Blocking and queued transfers, see i2c_statistics.hpp
+
+	I2C_Statistics &getStatistics(void){ return _statistics; };
+
+
+	// --- Bus recovery -----------------------------------------------------------------
+
+	uint32_t getRecoveryCount(void){ return _recovery_count; };	// Bus recoveries seen by the device
+
+
 protected:
 	// --- Variables --------------------------------------------------------------------
 
 	I2C_HandleTypeDef *_device_handle;
 	const uint8_t _device_address;
-	const uint32_t _response_delay;
+	const uint32_t _response_delay_us;
+
+	uint8_t _register_pointer;				// Register addressed by the last transfer
+	bool _register_pointer_valid;
+
+	bool _shadow_verify;
+	uint32_t _shadow_hits;
+	uint32_t _shadow_mismatches;
+
+	I2C_Statistics _statistics;
+
+	uint32_t _recovery_count;				// Recovery count of the bus at the last check
 
 
 	// --- Low-level I2C methods --------------------------------------------------------
@@ -55,6 +125,10 @@ protected:
 
 	HAL_StatusTypeDef LLR_8Bits(uint8_t register_address, uint8_t *data_buffer);
 	HAL_StatusTypeDef LLR_16Bits(uint8_t register_address, uint16_t *data_buffer);
+	HAL_StatusTypeDef LLR(uint8_t register_address, uint8_t *data_buffer, uint16_t length);
+
+	// Receive-only when the register pointer is already set (devices without auto-increment)
+	HAL_StatusTypeDef LLR_16Bits_Stream(uint8_t register_address, uint16_t *data_buffer);
 
 
 	// --- Write
@@ -63,16 +137,112 @@ protected:
 	HAL_StatusTypeDef LLW_16Bits(uint8_t register_address, uint16_t data_buffer);
 
 
+	// --- Asynchronous I2C methods (queued on the I2C_Bus of the handle) ---------------
+
+	// --- Read
+
+	HAL_StatusTypeDef LLR_Async(
+			uint8_t register_address,
+			uint8_t *data_buffer,
+			uint16_t length,
+			I2C_Bus::Callback callback,
+			void *context
+			);
+
+
+	// --- Write
+
+	HAL_StatusTypeDef LLW_Async_8Bits(
+			uint8_t register_address,
+			uint8_t data_buffer,
+			I2C_Bus::Callback callback = nullptr,
+			void *context = nullptr
+			);
+	HAL_StatusTypeDef LLW_Async_16Bits(
+			uint8_t register_address,
+			uint16_t data_buffer,
+			I2C_Bus::Callback callback = nullptr,
+			void *context = nullptr
+			);
+
+
+	// --- Shadowed register access -----------------------------------------------------
+
+	// Registers are declared once (constructor), then read from the shadow when valid and
+	// written through it. Registers not declared go straight to the device.
+
+	bool addShadowRegister(uint8_t register_address, uint8_t size);		// Size 1 or 2 bytes
+
+	HAL_StatusTypeDef readShadow_8Bits(uint8_t register_address, uint8_t *data_buffer);
+	HAL_StatusTypeDef readShadow_16Bits(uint8_t register_address, uint16_t *data_buffer);
+
+	HAL_StatusTypeDef writeShadow_8Bits(uint8_t register_address, uint8_t data_buffer);
+	HAL_StatusTypeDef writeShadow_16Bits(uint8_t register_address, uint16_t data_buffer);
+
+	// Read-modify-write of the bits in the mask, a single write when the shadow is valid
+	HAL_StatusTypeDef updateShadow_8Bits(uint8_t register_address, uint8_t mask, uint8_t bits);
+	HAL_StatusTypeDef updateShadow_16Bits(uint8_t register_address, uint16_t mask, uint16_t bits);
+
+	void storeShadow(uint8_t register_address, uint16_t value);	// After a write done elsewhere (async)
+	bool loadShadow(uint8_t register_address, uint16_t *value);	// No bus access, false if not valid
+
+
+	// --- Bus recovery -----------------------------------------------------------------
+
+	// Called before the next blocking transfer after a recovery of the bus. Extend it to
+	// drop more state, keep it short (no transfers).
+	virtual void onBusRecovered(void);
+
+
 	// --- Utility methods for bit operations -------------------------------------------
 
-	uint8_t mask_8Bits(uint8_t data, uint8_t mask, bool invert_mask = false);
-	uint16_t mask_16Bits(uint16_t data, uint16_t mask, bool invert_mask = false);
+	uint16_t concat_8to16Bits(uint8_t *bytes);				// Concatenates two uint8_t to form a uint16_t
 
 
 private:
-	// --- Utility methods for bit operations -------------------------------------------
+	// --- Shadow register file ---------------------------------------------------------
+
+	struct Shadow_Register {
+		uint8_t register_address;
+		uint8_t size;						// Bytes, 0 if the slot is free
+		uint16_t value;
+		bool valid;
+	};
+
+	I2C_Device::Shadow_Register _shadow[I2C_DEVICE_SHADOW_SIZE];
 
-	uint16_t concat_8to16Bits(uint8_t *bytes);				//
+	I2C_Device::Shadow_Register *findShadow(uint8_t register_address);
+
+	HAL_StatusTypeDef readDevice(I2C_Device::Shadow_Register *shadow, uint16_t *data_buffer);
+	HAL_StatusTypeDef writeDevice(I2C_Device::Shadow_Register *shadow, uint16_t data_buffer);
+
+
+	// --- Register pointer tracking ----------------------------------------------------
+
+	void trackRegisterPointer(uint8_t register_address, HAL_StatusTypeDef error);
+
+
+	// --- Bus recovery -----------------------------------------------------------------
+
+	void checkBus(void);
+
+	bool acquireBus(void);					// Before a blocking transfer, false if the queue keeps the bus
+	void releaseBus(void);
+
+
+	// --- Blocking transfer wait -------------------------------------------------------
+
+	HAL_StatusTypeDef waitTransfer(HAL_StatusTypeDef error, uint16_t length, uint32_t start);
+
+	void abortTransfer(void);
+
+
+	// --- Transaction statistics -------------------------------------------------------
+
+	void recordTransfer(HAL_StatusTypeDef error, uint16_t length, uint32_t start);
+
+
+	// --- Utility methods for bit operations -------------------------------------------
 
 	void break_16to8Bits(uint16_t bytes, uint8_t *result);	// Breaks a uint16_t to form two uint8_t
 };
@@ -0,0 +1,164 @@
+/*
+ * i2c_scheduler.hpp
+ *
+ * Module containing a time-triggered scheduler for the devices sharing an I2C bus.
+ *
+ * Each stream is a periodic bus job (e.g. encoder angle every tick, power stage batch
+ * every tick, magnet diagnostics every 100 ticks) described by:
+ *
+ * 			period		ticks between two releases
+ * 			cost		bus time of one release (estimate at the bus speed)
+ * 			release		earliest start in the tick
+ * 			deadline	latest end in the tick
+ *
+ * build() places the streams in rate-monotonic order (shortest period first, then
+ * earliest deadline) into a static slot table: each stream gets a tick of its period
+ * and a start phase so that no two slots share the bus. At run time one compare channel
+ * of the control tick releases the slots, and the bus idle callback closes them, so the
+ * latency of every release is measured and checked against its deadline.
+ *
+ * Jobs only queue asynchronous transactions, all the bus traffic must go through the
+ * scheduler (the latency of a release ends when the bus queue drains).
+ *
+ * Buses are independent, so each has its own scheduler (table, compare channel and idle
+ * callback) on the same tick, e.g. I2C_SCHEDULER_CHANNEL for I2C1 and the next channel
+ * for I2C2: slots of different buses may overlap and run concurrently.
+ *
+ */
+
+#pragma once
+
+#include "i2c_bus.hpp"
+#include "control_tick.hpp"
+#include "cycle_counter.hpp"
+
+
+
+// --- Scheduler limits -----------------------------------------------------------------
+
+const uint8_t I2C_SCHEDULER_MAX_STREAMS = 8;
+const uint8_t I2C_SCHEDULER_NO_STREAM = 0xFF;
+
+const uint8_t I2C_SCHEDULER_CHANNEL = 3;		// Control tick compare channel
+
+
+
+// -------------------------------------------------- I2C_Scheduler class declaration ---
+
+class I2C_Scheduler {
+
+public:
+	// --- Stream description -----------------------------------------------------------
+
+	// Queues the transactions of one release, false if there is nothing to do this time.
+	// Runs in interrupt context.
+	typedef bool (*Job)(void *context);
+
+	struct Stream {
+		const char *name;
+		uint16_t period;					// [ticks]
+		uint16_t cost_us;					// Bus time of one release	[us]
+		uint16_t release_us;				// Earliest start in the tick	[us]
+		uint16_t deadline_us;				// Latest end in the tick		[us]
+		I2C_Scheduler::Job job;
+		void *context;
+
+		// Slot table
+		bool placed;
+		uint16_t offset;					// Tick of the period the slot is in
+		uint16_t phase_us;					// Slot start in that tick		[us]
+
+		// Statistics
+		uint32_t releases;
+		uint32_t skipped;					// Job had nothing to do
+		uint32_t completions;
+		uint32_t missed;					// Ended after the deadline or overran the next slot
+		uint16_t last_latency_us;			// Release to bus idle
+		uint16_t max_latency_us;
+		uint32_t busy_us;					// Sum of the latencies
+	};
+
+
+	// --- Scheduler constructor --------------------------------------------------------
+
+	I2C_Scheduler(I2C_Bus &bus, Control_Tick &tick);
+
+
+	// --- Scheduler core methods -------------------------------------------------------
+
+	uint8_t addStream(
+			const char *name,
+			uint16_t period,
+			uint16_t cost_us,
+			uint16_t release_us,
+			uint16_t deadline_us,
+			I2C_Scheduler::Job job,
+			void *context = nullptr
+			);								// Stream index, I2C_SCHEDULER_NO_STREAM on failure
+
+	bool build(void);						// Slot table, false if a stream does not fit
+
+	bool begin(uint8_t channel = I2C_SCHEDULER_CHANNEL);	// Builds if needed, then runs the table
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	uint8_t getStreamCount(void){ return _count; };
+	const I2C_Scheduler::Stream &getStream(uint8_t stream){ return _streams[stream < _count ? stream : 0]; };
+
+	uint16_t getPhase_us(uint8_t stream);	// Slot start, after build()
+
+	float getUtilization(void){ return _utilization; };	// Bus share planned by the table
+	float getMeasuredUtilization(void);					// Bus share of the measured latencies
+
+	uint32_t getMissedDeadlines(void);		// All streams
+	uint32_t getCollisions(void){ return _collisions; };	// Slot released with the bus still busy
+	uint32_t getFrameCount(void){ return _frames; };
+
+
+	void resetStatistics(void);
+
+
+private:
+	// --- Scheduler variables ----------------------------------------------------------
+
+	I2C_Bus &_bus;
+	Control_Tick &_tick;
+	uint8_t _channel;
+
+	I2C_Scheduler::Stream _streams[I2C_SCHEDULER_MAX_STREAMS];
+	uint8_t _count;
+
+	uint8_t _slots[I2C_SCHEDULER_MAX_STREAMS];	// Placed streams by phase
+	uint8_t _slot_count;
+	uint8_t _cursor;						// Next slot to release
+	bool _built;
+
+	volatile uint8_t _active;				// Stream owning the bus
+	uint16_t _release_phase;				// Tick time of the active release	[us]
+	uint32_t _release_cycles;
+
+	uint32_t _frames;						// Ticks served by the table
+	uint32_t _statistics_frame;				// Frame of the last statistics reset
+	uint32_t _collisions;
+	float _utilization;
+
+
+	// --- Slot table methods -----------------------------------------------------------
+
+	bool place(uint8_t stream, uint16_t period_us);
+	bool shareTick(uint8_t stream, uint16_t offset, uint8_t other);
+
+	void dispatch(void);
+	void release(uint8_t stream);
+	void complete(void);
+
+
+	// --- Hooks ------------------------------------------------------------------------
+
+	static void onSlot(void *context);
+	static void onBusIdle(void *context, HAL_StatusTypeDef status);
+};
+
+
+// END OF FILE
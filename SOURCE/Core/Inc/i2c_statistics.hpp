@@ -0,0 +1,95 @@
+/*
+ * i2c_statistics.hpp
+ *
+ * Module containing the transaction statistics of an I2C device: counters of
+ * transactions, bytes, NACKs, timeouts and retries, and the transaction latency (from
+ * the start of the transfer to its end, DWT cycle counter) as min/average/max and a
+ * histogram with power of two bins:
+ *
+ * 			bin 0: < 32 us, bin 1: < 64 us, ... bin 6: < 2048 us, bin 7: the rest
+ *
+ * Blocking transfers are recorded by I2C_Device, queued ones by I2C_Bus on completion.
+ * The counters can be read from the debugger or dumped with print() (printf, i.e. SWO
+ * on target, stdout on host builds).
+ *
+ */
+
+#pragma once
+
+#include "stm32f1xx_hal.h"
+
+
+
+// --- Histogram configuration ----------------------------------------------------------
+
+const uint8_t I2C_STATISTICS_BINS = 8;
+const uint16_t I2C_STATISTICS_FIRST_BIN_US = 32;	// Upper limit of the first bin, doubled by each bin
+
+
+
+// ------------------------------------------------- I2C_Statistics class declaration ---
+
+class I2C_Statistics {
+
+public:
+	// --- Statistics constructor -------------------------------------------------------
+
+	I2C_Statistics(void);
+
+
+	// --- Recording methods (interrupt safe) -------------------------------------------
+
+	void record(HAL_StatusTypeDef status, uint32_t error_code, uint16_t bytes, uint32_t cycles);
+
+	void recordRetry(void);					// Transfer repeated, device not ready or recovered
+
+	void reset(void);
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	uint32_t getTransactions(void){ return _transactions; };
+	uint32_t getBytes(void){ return _bytes; };				// Data bytes of the successful transfers
+
+	uint32_t getNacks(void){ return _nacks; };
+	uint32_t getTimeouts(void){ return _timeouts; };
+	uint32_t getBusy(void){ return _busy; };				// Peripheral busy, transfer not started
+	uint32_t getErrors(void){ return _errors; };			// All the failed transfers
+	uint32_t getRetries(void){ return _retries; };
+
+	uint16_t getLastLatency_us(void){ return _last_latency; };
+	uint16_t getMinLatency_us(void){ return _transactions == 0 ? 0 : _min_latency; };
+	uint16_t getMaxLatency_us(void){ return _max_latency; };
+	uint16_t getAverageLatency_us(void);
+
+	uint32_t getHistogram(uint8_t bin){ return bin < I2C_STATISTICS_BINS ? _histogram[bin] : 0; };
+	static uint32_t getBinLimit_us(uint8_t bin);	// Upper limit of a bin, 0 for the last one
+
+
+	// --- Dump -------------------------------------------------------------------------
+
+	void print(const char *name);
+
+
+private:
+	// --- Statistics variables ---------------------------------------------------------
+
+	uint32_t _transactions;
+	uint32_t _bytes;
+
+	uint32_t _nacks;
+	uint32_t _timeouts;
+	uint32_t _busy;
+	uint32_t _errors;
+	uint32_t _retries;
+
+	uint16_t _last_latency;
+	uint16_t _min_latency;
+	uint16_t _max_latency;
+	uint32_t _latency_sum;
+
+	uint32_t _histogram[I2C_STATISTICS_BINS];
+};
+
+
+// END OF FILE
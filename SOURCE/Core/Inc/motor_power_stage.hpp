@@ -0,0 +1,188 @@
+/*
+ * motor_power_stage.hpp
+ *
+ * Module containing a class for the H-bridge power measurement: it owns the two INA219
+ * sensors on the bridge legs and acquires them as one batch scheduled on the control
+ * tick, then publishes a single sample of motor current, terminal voltage, direction
+ * and electrical power.
+ *
+ * Batch, on the tick phase hooks or on bus scheduler slots (no blocking access):
+ *
+ * 			trigger phase:	CONF write on both chips (starts both conversions)
+ * 			collect phase:	bus voltage (CNVR check) and shunt voltage of both chips
+ *
+ * i.e. 6 transactions per sample instead of 8 register reads and 2 presence probes.
+ * The collect phase must be after the conversion time, and the reads must end before
+ * the next tick (about 110 us each at 400 kHz).
+ *
+ * The ADC settings can be switched at runtime (see conversion_policy.hpp): they are
+ * folded in the trigger write, and conversions longer than one period (averaging) are
+ * collected a few ticks later, one batch every divider ticks. In between the sample is
+ * repeated and marked not fresh, the consumer must not take it as a new measurement. A
+ * switch to a shorter batch restarts the running one at the next trigger.
+ *
+ * Sensor 1 sees the motor current, sensor 2 the opposite one: current = (i1 - i2) / 2,
+ * voltage = Vbus2 - Vbus1.
+ *
+ */
+
+#pragma once
+
+#include "INA219.hpp"
+#include "control_tick.hpp"
+
+
+
+// --- Batch configuration --------------------------------------------------------------
+
+const uint8_t MOTOR_POWER_STAGE_TRIGGER_CHANNEL = 1;	// Control tick compare channels
+const uint8_t MOTOR_POWER_STAGE_COLLECT_CHANNEL = 2;
+
+// 10-bit shunt (148 us) and 9-bit bus (84 us) conversions, so the batch fits in 1 ms
+
+const INA219::SHUNT_ADC_RESOLUTION MOTOR_POWER_STAGE_SHUNT_RESOLUTION = INA219::SHUNT_ADC_10_BITS;
+const INA219::BUS_ADC_RESOLUTION MOTOR_POWER_STAGE_BUS_RESOLUTION = INA219::BUS_ADC_9_BITS;
+
+const uint32_t MOTOR_POWER_STAGE_WRITE_TIME_US = 90;	// One CONF write at 400 kHz
+const uint8_t MOTOR_POWER_STAGE_MAX_DIVIDER = 100;		// Longest batch [ticks]
+
+const q16_t MOTOR_POWER_STAGE_DIRECTION_THRESHOLD = q16FromFloat(0.2);	// Terminal voltage deadband [V]
+
+
+
+// ---------------------------------------------- Motor_Power_Stage class declaration ---
+
+class Motor_Power_Stage {
+
+public:
+	// --- Sample content ---------------------------------------------------------------
+
+	enum DIRECTION : uint8_t {				// Drive direction, from the terminal voltage
+		STOPPED 	= 0x00,
+		FORWARD 	= 0x01,
+		REVERSE 	= 0x02,
+	};
+
+	struct Sample {
+		q16_t current;						// Motor current					[A]
+		q16_t voltage;						// Terminal voltage					[V]
+		q16_t power;						// Electrical power, voltage * current	[W]
+		Motor_Power_Stage::DIRECTION direction;
+		bool fresh;							// Converted in the last batch, else repeated
+	};
+
+	struct Correction {						// Per chip, corrected = gain * reading + offset
+		float current_gain;
+		float current_offset;				// [A]
+		float voltage_gain;
+		float voltage_offset;				// [V]
+	};
+
+
+	// --- Stage constructor ------------------------------------------------------------
+
+	Motor_Power_Stage(
+			I2C_HandleTypeDef *device_handle,
+			float max_expected_current,
+			float shunt_resistor,
+			uint8_t address_1 = 0x40,
+			uint8_t address_2 = 0x44,
+			uint32_t response_delay_us = I2C_DEVICE_RESPONSE_DELAY_US
+			);
+
+
+	// --- Stage core methods -----------------------------------------------------------
+
+	bool begin(Control_Tick &tick, uint16_t trigger_phase_us, uint16_t collect_phase_us);
+	bool begin(uint16_t period_us, uint16_t trigger_phase_us, uint16_t collect_phase_us);	// Steps run elsewhere (bus scheduler)
+
+	bool update(void);						// At the tick start, publishes the last batch
+
+
+	// --- Conversion settings ----------------------------------------------------------
+
+	bool setConversion(INA219::SHUNT_ADC_RESOLUTION shunt, INA219::BUS_ADC_RESOLUTION bus);
+
+	uint8_t getDivider(void){ return _divider; };		// Ticks per batch
+
+
+	// --- Batch steps (phase hooks, interrupt context) ---------------------------------
+
+	bool trigger(void);						// True if the step has bus traffic to run
+	bool collect(void);
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	const Motor_Power_Stage::Sample &getSample(void){ return _sample; };
+
+	q16_t getCurrent_Q16(void){ return _sample.current; };
+	q16_t getVoltage_Q16(void){ return _sample.voltage; };
+	q16_t getPower_Q16(void){ return _sample.power; };
+	Motor_Power_Stage::DIRECTION getDirection(void){ return _sample.direction; };
+
+	q16_t getSensorCurrent_Q16(uint8_t sensor);		// Corrected chip readings, sensor 1 or 2
+	q16_t getSensorBusVoltage_Q16(uint8_t sensor);
+
+	INA219 &getSensor(uint8_t sensor){ return sensor == 2 ? _sensor_2 : _sensor_1; };
+
+	bool isConnected(void){ return _connected; };	// Both chips answered the last batch
+
+
+	// --- Correction -------------------------------------------------------------------
+
+	bool setCorrection(uint8_t sensor, const Motor_Power_Stage::Correction &correction);
+
+
+	// --- Statistics -------------------------------------------------------------------
+
+	uint32_t getBatchCount(void){ return _batches; };
+	uint32_t getPublishedCount(void){ return _published; };
+	uint32_t getLateCount(void){ return _late; };			// Not ready at the tick start
+	uint32_t getFailedCount(void){ return _failed; };		// Bus error or no conversion
+	uint32_t getRestartCount(void){ return _restarts; };		// Batches dropped for shorter settings
+
+	uint8_t getLastTransactionCount(void){ return _last_transactions; };
+
+
+private:
+	// --- Stage variables --------------------------------------------------------------
+
+	INA219 _sensor_1;
+	INA219 _sensor_2;
+
+	Q_Gain _current_gain[2];
+	q16_t _current_offset[2];
+	Q_Gain _voltage_gain[2];
+	q16_t _voltage_offset[2];
+
+	q16_t _sensor_current[2];				// Corrected readings of the last batch
+	q16_t _sensor_bus_voltage[2];
+
+	Motor_Power_Stage::Sample _sample;
+	bool _connected;
+
+	uint16_t _period;						// Batch timing [us]
+	uint16_t _trigger_phase;
+	uint16_t _collect_phase;
+
+	volatile uint8_t _divider;
+	volatile uint8_t _window;				// Ticks left in the running batch
+	volatile bool _collected;				// Readout queued, publish at the next update
+
+	uint32_t _batches;
+	uint32_t _published;
+	uint32_t _late;
+	uint32_t _failed;
+	uint32_t _restarts;
+	uint8_t _last_transactions;
+
+
+	// --- Hooks ------------------------------------------------------------------------
+
+	static void onTriggerPhase(void *context);
+	static void onCollectPhase(void *context);
+};
+
+
+// END OF FILE
@@ -0,0 +1,83 @@
+/*
+ * multiturn_tracker.hpp
+ *
+ * Module containing a multi-turn accumulator for 12-bit single-turn angle readings (such
+ * as AS5600::getRawAngle), with wrap tracking and missed sample detection.
+ *
+ * Each new reading is unwrapped against the previous one (shortest way round), which is
+ * only unambiguous while the shaft moves less than half a turn between samples. The
+ * maximum expected step is derived from the sample rate and the maximum speed: larger
+ * steps mean that samples were missed (or the reading is corrupt) and are counted.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "fixed_point.hpp"
+
+
+
+// --- Tracker constants ----------------------------------------------------------------
+
+const uint16_t MULTITURN_COUNTS_PER_TURN = 4096;			// 12-bit angle
+const int32_t MULTITURN_HALF_TURN = MULTITURN_COUNTS_PER_TURN / 2;
+
+const int32_t MULTITURN_Q16_RADIANS_PER_TURN = 411775;		// 2pi in Q16.16
+
+
+
+// ---------------------------------------------- Multiturn_Tracker class declaration ---
+
+class Multiturn_Tracker {
+
+public:
+	// --- Tracker constructor ----------------------------------------------------------
+
+	Multiturn_Tracker(float sample_rate, float max_speed);
+
+
+	// --- Tracker core methods ---------------------------------------------------------
+
+	int32_t update(uint16_t raw_angle);
+
+	void reset(uint16_t raw_angle, int32_t turns = 0);
+
+
+	// --- Getter methods (integer only) ------------------------------------------------
+
+	int32_t getCount(void){ return _count; };
+	int32_t getTurns(void){ return _count >> 12; };					// Floor division
+	uint16_t getAngleInTurn(void){ return (uint16_t)(_count & 0x0FFF); };
+
+	int32_t getLastStep(void){ return _last_step; };
+
+	q16_t getPosition(void){ return (q16_t)(((int64_t)_count * MULTITURN_Q16_RADIANS_PER_TURN) >> 12); };	// [rad]
+	q16_t getAngle(void){ return (q16_t)(((int64_t)(_count & 0x0FFF) * MULTITURN_Q16_RADIANS_PER_TURN) >> 12); };	// [0, 2pi) [rad]
+
+
+	// --- Diagnostics ------------------------------------------------------------------
+
+	uint16_t getMaxStep(void){ return _max_step; };
+	bool isUnambiguous(void){ return _max_step < MULTITURN_HALF_TURN; };
+
+	uint32_t getMissedSampleCount(void){ return _missed_samples; };
+	bool isInitialized(void){ return _initialized; };
+
+
+private:
+	// --- Tracker variables ------------------------------------------------------------
+
+	uint16_t _max_step;						// Largest plausible step between samples [counts]
+
+	bool _initialized;
+	uint16_t _last_raw;
+	int32_t _count;
+	int32_t _last_step;
+
+	uint32_t _missed_samples;
+};
+
+
+// END OF FILE
@@ -0,0 +1,90 @@
+/*
+ * observer.hpp
+ *
+ * Module containing the Luenberger observer of the motor (output angle, motor speed and
+ * armature current), designed in MODELS_AND_SIMULATIONS/Observer_Tune.m.
+ *
+ * Model:	d/dt [theta; w; i] = A [theta; w; i] + B v,		y = [theta; i]
+ *
+ * 			A = [0, gearbox, 0; 0, -B/J, Kphi/J; 0, -Kphi/La, -Ra/La],	B = [0; 0; 1/La]
+ *
+ * The poles are the ones of the script (2 * eig(A) + [0; 0; -500], i.e. -364.7, -206.7
+ * and -500 rad/s). The gain uses the structure L = [l1, 0; l2, 0; 0, l3]: the speed is
+ * corrected from the angle error only and keeps the Kphi/J * i model term. The update is
+ * forward Euler at the control period, with every matrix entry a compile-time constant.
+ *
+ */
+
+#pragma once
+
+#include "fixed_point.hpp"
+
+
+
+// --- Observer coefficients ------------------------------------------------------------
+
+// See MODELS_AND_SIMULATIONS/Full_Model_params.m and Observer_Tune.m
+
+const float OBSERVER_SAMPLING_TIME 		= 1e-3;				// uc.Ts						[s]
+
+const float OBSERVER_GEARBOX 			= 11.0 / (61 * 36);	// motor.gearbox				[-]
+const float OBSERVER_KPHI_J 			= 33157.5;			// motor.Kphi / motor.J			[rad/(A*s^2)]
+const float OBSERVER_KPHI_LA 			= 0.568414;			// motor.Kphi / motor.La		[A/rad]
+const float OBSERVER_RA_LA 				= 285.714;			// motor.Ra / motor.La			[1/s]
+const float OBSERVER_1_LA 				= 142.857;			// 1 / motor.La					[1/H]
+
+const float OBSERVER_L_POSITION 		= 1002.65;			// L(1, 1)						[1/s]
+const float OBSERVER_L_SPEED 			= 5.45592e7;		// L(2, 1)						[1/s^2]
+const float OBSERVER_L_CURRENT 			= -216.934;			// L(3, 2)						[1/s]
+
+// Discrete coefficients, Ts * A(r, c) and Ts * L(r, c)
+
+const Q_Gain OBSERVER_A12 	= qGainFromFloat(OBSERVER_SAMPLING_TIME * OBSERVER_GEARBOX);
+const Q_Gain OBSERVER_A23 	= qGainFromFloat(OBSERVER_SAMPLING_TIME * OBSERVER_KPHI_J);
+const Q_Gain OBSERVER_A32 	= qGainFromFloat(-OBSERVER_SAMPLING_TIME * OBSERVER_KPHI_LA);
+const Q_Gain OBSERVER_A33 	= qGainFromFloat(-OBSERVER_SAMPLING_TIME * OBSERVER_RA_LA);
+const Q_Gain OBSERVER_B3 	= qGainFromFloat(OBSERVER_SAMPLING_TIME * OBSERVER_1_LA);
+
+const Q_Gain OBSERVER_L1 	= qGainFromFloat(OBSERVER_SAMPLING_TIME * OBSERVER_L_POSITION);
+const Q_Gain OBSERVER_L2 	= qGainFromFloat(OBSERVER_SAMPLING_TIME * OBSERVER_L_SPEED);
+const Q_Gain OBSERVER_L3 	= qGainFromFloat(OBSERVER_SAMPLING_TIME * OBSERVER_L_CURRENT);
+
+const q16_t OBSERVER_HALF_TURN 			= 205887;			// pi in Q16.16					[rad]
+const q16_t OBSERVER_SPEED_LIMIT 		= q16FromFloat(30000);	// Estimate saturation		[rad/s]
+
+
+
+// ------------------------------------------------------- Observer class declaration ---
+
+class Observer {
+
+public:
+	// --- Observer constructor ---------------------------------------------------------
+
+	Observer(void);
+
+
+	// --- Observer core methods --------------------------------------------------------
+
+	void update(q16_t angle, q16_t current, q16_t voltage, bool current_fresh = true);
+
+	void reset(q16_t angle = 0, q16_t current = 0);
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	q16_t getAngle(void){ return (q16_t)(_angle >> 16); };
+	q16_t getSpeed(void){ return (q16_t)(_speed >> 16); };
+	q16_t getCurrent(void){ return (q16_t)(_current >> 16); };
+
+
+private:
+	// --- Observer variables -----------------------------------------------------------
+
+	int64_t _angle;							// Output shaft angle in [0, 2pi), Q32.32
+	int64_t _speed;							// Motor speed, Q32.32
+	int64_t _current;						// Armature current, Q32.32
+};
+
+
+// END OF FILE
@@ -0,0 +1,62 @@
+/*
+ * pi_controller.hpp
+ *
+ * Module containing a fixed-point PI controller with output saturation and anti-windup.
+ *
+ * Gains are given as floats and converted once, the update only uses integer math.
+ *
+ */
+
+#pragma once
+
+#include "fixed_point.hpp"
+
+
+
+// -------------------------------------------------- PI_Controller class declaration ---
+
+class PI_Controller {
+
+public:
+	// --- Controller constructor -------------------------------------------------------
+
+	PI_Controller(float kp, float ki, float sampling_time, float output_limit);
+
+
+	// --- Controller core methods ------------------------------------------------------
+
+	q16_t update(q16_t reference, q16_t measure);
+
+	void reset(void);
+
+
+	// --- Controller parameters --------------------------------------------------------
+
+	void setGains(float kp, float ki, float sampling_time);
+
+	void setOutputLimit(float output_limit){ _limit = q16FromFloat(output_limit); };
+	q16_t getOutputLimit(void){ return _limit; };
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	q16_t getOutput(void){ return _output; };
+	q16_t getIntegral(void){ return (q16_t)(_integral >> 16); };
+
+	bool isSaturated(void){ return _output == _limit || _output == -_limit; };
+
+
+protected:
+	// --- Controller variables ---------------------------------------------------------
+
+	Q_Gain _kp;								// Proportional gain
+	Q_Gain _ki_ts;							// Integral gain times sampling time
+
+	q16_t _limit;							// Symmetric output saturation
+
+	int64_t _integral;						// Integral term, Q32.32 to keep small increments
+	q16_t _output;
+};
+
+
+// END OF FILE
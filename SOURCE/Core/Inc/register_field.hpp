@@ -0,0 +1,70 @@
+/*
+ * register_field.hpp
+ *
+ * Module containing a compile-time description of the bit fields of a device register.
+ * The mask is a template argument, so a field costs no storage and every access folds to
+ * an immediate AND (plus a shift for right-aligned values):
+ *
+ * 			typedef Register_Field<uint16_t, 0x0078> SHUNT_ADC_RESOLUTION_FIELD;
+ *
+ * 			SHUNT_ADC_RESOLUTION_FIELD::extract(conf)		bits in place (option enums)
+ * 			SHUNT_ADC_RESOLUTION_FIELD::get(conf)			right-aligned value
+ * 			SHUNT_ADC_RESOLUTION_FIELD::insert(conf, bits)	new register content
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+
+
+// --- Field shift ----------------------------------------------------------------------
+
+/*
+ * @brief Returns the position of the lowest bit of a mask (0 for an empty mask).
+ *
+ */
+constexpr uint8_t registerFieldShift(uint32_t mask){
+	uint8_t shift = 0;
+	while(mask != 0 && !(mask & 1)){
+		mask >>= 1;
+		shift++;
+	}
+
+	return shift;
+};
+
+
+
+// ---------------------------------------------- Register_Field template declaration ---
+
+template <typename T, T MASK>
+struct Register_Field {
+
+	static_assert(MASK != 0, "A register field needs at least one bit");
+
+	// --- Field description ------------------------------------------------------------
+
+	static constexpr T mask(void){ return MASK; };
+	static constexpr uint8_t shift(void){ return registerFieldShift(MASK); };
+
+
+	// --- Bits in place (option enums are declared in place)
+
+	static constexpr T extract(T content){ return (T)(content & MASK); };
+
+	static constexpr T insert(T content, T bits){ return (T)((content & ~MASK) | (bits & MASK)); };
+
+	static constexpr bool isSet(T content){ return (content & MASK) != 0; };
+
+
+	// --- Right-aligned values
+
+	static constexpr T get(T content){ return (T)((content & MASK) >> shift()); };
+
+	static constexpr T set(T content, T value){ return insert(content, (T)(value << shift())); };
+};
+
+
+// END OF FILE
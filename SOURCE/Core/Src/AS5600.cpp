@@ -19,18 +19,36 @@
  * @param device_handle		I2C bus handle object;
  * @param device_address	Address of the I2C device;
  * @param direction			Rotation direction for upward counting;
- * @param response_delay	Time to wait for the device response;
+ * @param response_delay_us	Extra time allowed for the device response [us];
  *
  */
 AS5600::AS5600(
 I2C_HandleTypeDef *device_handle,
 uint8_t device_address,
 AS5600::ROTATION_DIRECTION direction,
-uint32_t response_delay
+uint32_t response_delay_us
 ) :
-		I2C_Device(device_handle, device_address, response_delay),
-		_direction(direction)
-	{}
+		I2C_Device(device_handle, device_address, response_delay_us),
+		_direction(direction),
+		_last_angle(0),
+		_sample_raw_angle(0),
+		_sample_status(0),
+		_sample_agc(0),
+		_sample_magnitude(0),
+		_samples(0),
+		_sample_errors(0),
+		_raw_angle_result(nullptr),
+		_real_angle_result(nullptr),
+		_real_angle_unit(AS5600::RADIANS),
+		_raw_result_buffer(),
+		_real_result_buffer()
+	{
+		// Configuration registers are shadowed (CONF_H and CONF_L as one 16 bit register)
+		AS5600::addShadowRegister(AS5600::ZPOS_H, 2);
+		AS5600::addShadowRegister(AS5600::MPOS_H, 2);
+		AS5600::addShadowRegister(AS5600::MANG_H, 2);
+		AS5600::addShadowRegister(AS5600::CONF_H, 2);
+	}
 
 
 // --- Sensor core methods --------------------------------------------------------------
@@ -44,13 +62,14 @@ uint32_t response_delay
 uint16_t AS5600::getRawAngle(void){
 	// Read the register
 	uint16_t register_content;
-	AS5600::LLR_16Bits(AS5600::RAW_ANGLE_H, &register_content);
+	HAL_StatusTypeDef error = AS5600::LLR_16Bits(AS5600::RAW_ANGLE_H, &register_content);
 
-	// If direction is counter clock wise reverse the value
-	if(AS5600::_direction == AS5600::COUNTERCLOCK_WISE) return (0x0FFF - register_content) & 0x0FFF;
+	// If the read failed keep the last good angle (the error is in the statistics)
+	if(error != HAL_OK) return AS5600::_sample_raw_angle;
 
-	// Return result
-	return register_content;
+	// Return result in the selected direction
+	AS5600::_sample_raw_angle = AS5600::applyDirection(register_content);
+	return AS5600::_sample_raw_angle;
 }
 
 /*
@@ -60,18 +79,30 @@ uint16_t AS5600::getRawAngle(void){
 uint16_t AS5600::getAngle(void){
 	// Read the register
 	uint16_t register_content;
-	AS5600::LLR_16Bits(AS5600::ANGLE_H, &register_content);
+	HAL_StatusTypeDef error = AS5600::LLR_16Bits(AS5600::ANGLE_H, &register_content);
 
-	// If direction is counter clock wise reverse the value
-	if(AS5600::_direction == AS5600::COUNTERCLOCK_WISE) return (0x0FFF - register_content) & 0x0FFF;
+	// If the read failed keep the last good angle (the error is in the statistics)
+	if(error != HAL_OK) return AS5600::_last_angle;
 
-	// Return result
-	return register_content;
+	// Return result in the selected direction
+	AS5600::_last_angle = AS5600::applyDirection(register_content);
+	return AS5600::_last_angle;
 }
 
 
 // --- Real values
 
+/*
+ * @brief Returns the sensed position in degrees or radians, as Q16.16 fixed-point.
+ *
+ * @param unit	Unit of measure of the output value;
+ *
+ */
+q16_t AS5600::getRealAngle_Q16(AS5600::OUTPUT_ANGLE_UNIT unit){
+	// Get the ADC value and convert it
+	return AS5600::toRealAngle_Q16(AS5600::getAngle(), unit);
+}
+
 /*
  * @brief Returns the sensed position in degrees or radians.
  *
@@ -79,16 +110,127 @@ uint16_t AS5600::getAngle(void){
  *
  */
 float AS5600::getRealAngle(AS5600::OUTPUT_ANGLE_UNIT unit){
-	// Get the ADC value
-	uint16_t angle = AS5600::getAngle();
+	return q16ToFloat(AS5600::getRealAngle_Q16(unit));
+}
 
-	// If radians is selected, return result in radians
-	if(unit == AS5600::RADIANS){
-		return angle * AS5600::ADC_TO_RADIANS;
+
+// --- Snapshot
+
+/*
+ * @brief Reads the status and output registers in a single auto-incrementing transfer,
+ * and the magnet registers in a second one, then decodes them. Fields outside the
+ * chosen window are set to zero.
+ *
+ * @param snapshot	Structure for the decoded registers;
+ * @param window	Registers to read;
+ *
+ */
+bool AS5600::getSnapshot(AS5600::SNAPSHOT *snapshot, AS5600::SNAPSHOT_WINDOW window){
+	// Buffer indexed by register address
+	uint8_t buffer[AS5600::MAGNITUDE_L + 1] = {};
+
+	// Status and both angles, from STATUS so the pointer increments through the outputs
+	HAL_StatusTypeDef error = AS5600::LLR(AS5600::STATUS, &buffer[AS5600::STATUS], AS5600::ANGLE_L - AS5600::STATUS + 1);
+	if(error != HAL_OK) return false;
+
+	// Magnet registers, skipping the reserved ones in between
+	if(window == AS5600::WINDOW_FULL){
+		error = AS5600::LLR(AS5600::AGC, &buffer[AS5600::AGC], AS5600::MAGNITUDE_L - AS5600::AGC + 1);
+		if(error != HAL_OK) return false;
+	}
+
+	// Decode the registers
+	snapshot->status = buffer[AS5600::STATUS];
+	snapshot->raw_angle = AS5600::applyDirection(AS5600::concat_8to16Bits(&buffer[AS5600::RAW_ANGLE_H]));
+	snapshot->angle = AS5600::applyDirection(AS5600::concat_8to16Bits(&buffer[AS5600::ANGLE_H]));
+	snapshot->agc = buffer[AS5600::AGC];
+	snapshot->magnitude = AS5600::ANGLE_FIELD::extract(AS5600::concat_8to16Bits(&buffer[AS5600::MAGNITUDE_H]));
+
+	// Return success
+	return true;
+}
+
+
+// --- Asynchronous reads
+
+/*
+ * @brief Queues a read of the raw angle register, decoded into getSampleRawAngle() by
+ * the bus engine. Never blocks, callable from interrupts.
+ *
+ */
+bool AS5600::requestRawAngle(void){
+	HAL_StatusTypeDef error = AS5600::LLR_Async(AS5600::RAW_ANGLE_H, AS5600::_angle_buffer, 2, AS5600::onRawAngleRead, this);
+	return error == HAL_OK;
+}
+
+/*
+ * @brief Queues a read of the status register, see getSampleStatus().
+ *
+ */
+bool AS5600::requestStatus(void){
+	HAL_StatusTypeDef error = AS5600::LLR_Async(AS5600::STATUS, AS5600::_status_buffer, 1, AS5600::onStatusRead, this);
+	return error == HAL_OK;
+}
+
+/*
+ * @brief Queues a read of the AGC and magnitude registers (contiguous), see
+ * getSampleAGC() and getSampleMagnitude().
+ *
+ */
+bool AS5600::requestMagnitude(void){
+	HAL_StatusTypeDef error = AS5600::LLR_Async(AS5600::AGC, AS5600::_magnitude_buffer, 3, AS5600::onMagnitudeRead, this);
+	return error == HAL_OK;
+}
+
+
+// --- Asynchronous reads with a result handle
+
+/*
+ * @brief Starts a read of the raw angle, completed into the handle by the bus engine.
+ * Never blocks, callable from interrupts. Returns false if a read of this kind or the
+ * handle is still pending, or if the read cannot be queued (the handle then fails).
+ *
+ * @param result	Handle receiving the angle in the selected direction;
+ *
+ */
+bool AS5600::readRawAngleAsync(Async_Result<uint16_t> &result){
+	// Claim the slot and the handle in one step (callers may preempt each other), the
+	// callback finds the handle there, also if the engine completes the read at once
+	if(!result.begin(AS5600::_raw_angle_result)) return false;
+
+	HAL_StatusTypeDef error = AS5600::LLR_Async(AS5600::RAW_ANGLE_H, AS5600::_raw_result_buffer, 2, AS5600::onRawAngleResult, this);
+	if(error != HAL_OK){
+		AS5600::_raw_angle_result = nullptr;
+		result.fail(error);
+		return false;
 	}
 
-	// Return result in degrees
-	return angle * AS5600::ADC_TO_DEGREES;
+	return true;
+}
+
+/*
+ * @brief Starts a read of the (filtered) angle, completed into the handle in degrees or
+ * radians, as getRealAngle_Q16(). Same rules as readRawAngleAsync().
+ *
+ * @param result	Handle receiving the angle;
+ * @param unit		Unit of measure of the value;
+ *
+ */
+bool AS5600::readRealAngleAsync(Async_Result<q16_t> &result, AS5600::OUTPUT_ANGLE_UNIT unit){
+	// Claim the slot and the handle in one step (callers may preempt each other), the
+	// callback finds the handle there, also if the engine completes the read at once
+	if(!result.begin(AS5600::_real_angle_result)) return false;
+
+	AS5600::_real_angle_unit = unit;
+
+	HAL_StatusTypeDef error = AS5600::LLR_Async(AS5600::ANGLE_H, AS5600::_real_result_buffer, 2, AS5600::onRealAngleResult, this);
+	if(error != HAL_OK){
+		AS5600::_real_angle_result = nullptr;
+		result.fail(error);
+		return false;
+	}
+
+	return true;
 }
 
 
@@ -104,10 +246,10 @@ float AS5600::getRealAngle(AS5600::OUTPUT_ANGLE_UNIT unit){
  */
 bool AS5600::setZPosition(uint16_t value){
 	// If value is over 12 bits return failure
-	if(value > 0x0FFF) return false;
+	if(value > AS5600::ANGLE_FIELD::mask()) return false;
 
 	// Write the register to given value, then if no errors return success
-	HAL_StatusTypeDef error = AS5600::LLW_16Bits(AS5600::ZPOS_H, value);
+	HAL_StatusTypeDef error = AS5600::writeShadow_16Bits(AS5600::ZPOS_H, value);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -119,9 +261,9 @@ bool AS5600::setZPosition(uint16_t value){
  *
  */
 uint16_t AS5600::getZPosition(void){
-	// Read the register
+	// Read the register, from the shadow (its last value if the read fails)
 	uint16_t register_content;
-	AS5600::LLR_16Bits(AS5600::ZPOS_H, &register_content);
+	AS5600::readShadow_16Bits(AS5600::ZPOS_H, &register_content);
 
 	// Return result
 	return register_content;
@@ -136,10 +278,10 @@ uint16_t AS5600::getZPosition(void){
  */
 bool AS5600::setMPosition(uint16_t value){
 	// If value is over 12 bits return failure
-	if(value > 0x0FFF) return false;
+	if(value > AS5600::ANGLE_FIELD::mask()) return false;
 
 	// Write the register to given value, then if no errors return success
-	HAL_StatusTypeDef error = AS5600::LLW_16Bits(AS5600::MPOS_H, value);
+	HAL_StatusTypeDef error = AS5600::writeShadow_16Bits(AS5600::MPOS_H, value);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -151,9 +293,9 @@ bool AS5600::setMPosition(uint16_t value){
  *
  */
 uint16_t AS5600::getMPosition(void){
-	// Read the register
+	// Read the register, from the shadow (its last value if the read fails)
 	uint16_t register_content;
-	AS5600::LLR_16Bits(AS5600::MPOS_H, &register_content);
+	AS5600::readShadow_16Bits(AS5600::MPOS_H, &register_content);
 
 	// Return result
 	return register_content;
@@ -168,10 +310,10 @@ uint16_t AS5600::getMPosition(void){
  */
 bool AS5600::setMaxAngle(uint16_t value){
 	// If value is over 12 bits return failure
-	if(value > 0x0FFF) return false;
+	if(value > AS5600::ANGLE_FIELD::mask()) return false;
 
 	// Write the register to given value, then if no errors return success
-	HAL_StatusTypeDef error = AS5600::LLW_16Bits(AS5600::MANG_H, value);
+	HAL_StatusTypeDef error = AS5600::writeShadow_16Bits(AS5600::MANG_H, value);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -183,9 +325,9 @@ bool AS5600::setMaxAngle(uint16_t value){
  *
  */
 uint16_t AS5600::getMaxAngle(void){
-	// Read the register
+	// Read the register, from the shadow (its last value if the read fails)
 	uint16_t register_content;
-	AS5600::LLR_16Bits(AS5600::MANG_H, &register_content);
+	AS5600::readShadow_16Bits(AS5600::MANG_H, &register_content);
 
 	// Return result
 	return register_content;
@@ -204,8 +346,8 @@ bool AS5600::isMagnetDetected(void){
 	// Read the status register
 	uint8_t status = AS5600::getStatus();
 
-	// Check the status
-	return status == AS5600::MAGNET_DETECTED;
+	// Check the magnet bits
+	return AS5600::MAGNET_FIELD::extract(status) == AS5600::MAGNET_DETECTED;
 }
 
 /*
@@ -216,8 +358,8 @@ bool AS5600::isMagnetStrong(void){
 	// Read the status register
 	uint8_t status = AS5600::getStatus();
 
-	// Check the status
-	return status == AS5600::MAGNET_STRONG;
+	// Check the magnet bits
+	return AS5600::MAGNET_FIELD::extract(status) == AS5600::MAGNET_STRONG;
 }
 
 /*
@@ -228,8 +370,8 @@ bool AS5600::isMagnetWeak(void){
 	// Read the status register
 	uint8_t status = AS5600::getStatus();
 
-	// Check the status
-	return status == AS5600::MAGNET_WEAK;
+	// Check the magnet bits
+	return AS5600::MAGNET_FIELD::extract(status) == AS5600::MAGNET_WEAK;
 }
 
 
@@ -240,17 +382,16 @@ bool AS5600::isMagnetWeak(void){
 /*
  * @brief Sets the configuration register to the given value.
  * (See data-sheet page 18 and 19 for more details on configuration)
- * TODO remove or improve !!!
  *
  * @param value	The configuration to set;
  *
  */
 bool AS5600::setConfiguration(uint16_t value){
 	// If value is out of range return failure
-	if(value > 0x3FFF) return false;
+	if(value > AS5600::CONFIGURATION_FIELD::mask()) return false;
 
 	// Write the configuration register, if no error return success
-	HAL_StatusTypeDef error = AS5600::LLW_16Bits(AS5600::CONF_H, value);
+	HAL_StatusTypeDef error = AS5600::writeShadow_16Bits(AS5600::CONF_H, value);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -260,12 +401,12 @@ bool AS5600::setConfiguration(uint16_t value){
 /*
  * @brief Gets the value in the configuration register.
  * (See data-sheet page 18 and 19 for more details on configuration)
- * TODO cache the configuration for faster reading ???
+ *
  */
 uint16_t AS5600::getConfiguration(void){
-	// Read the register
+	// Read the register, from the shadow (its last value if the read fails)
 	uint16_t register_content;
-	AS5600::LLR_16Bits(AS5600::CONF_H, &register_content);
+	AS5600::readShadow_16Bits(AS5600::CONF_H, &register_content);
 
 	// Return result
 	return register_content;
@@ -281,17 +422,8 @@ uint16_t AS5600::getConfiguration(void){
  *
  */
 bool AS5600::setPowerMode(AS5600::POWER_MODE option){
-	// Read previous configuration to change only interested bits
-	uint8_t previous_configuration;
-	HAL_StatusTypeDef error = AS5600::LLR_8Bits(AS5600::CONF_L, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_8Bits(previous_configuration, AS5600::POWER_MODE_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = AS5600::LLW_8Bits(AS5600::CONF_H, previous_configuration);
+	// Change only interested bits (CONF_L is the low byte), a single write with a valid shadow
+	HAL_StatusTypeDef error = AS5600::updateShadow_16Bits(AS5600::CONF_H, AS5600::POWER_MODE_FIELD::mask(), option);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -303,12 +435,12 @@ bool AS5600::setPowerMode(AS5600::POWER_MODE option){
  *
  */
 AS5600::POWER_MODE AS5600::getPowerMode(void){
-	// Read the register
-	uint8_t register_content;
-	AS5600::LLR_8Bits(AS5600::CONF_L, &register_content);
+	// Read the register, from the shadow (its last value if the read fails)
+	uint16_t register_content;
+	AS5600::readShadow_16Bits(AS5600::CONF_H, &register_content);
 
-	// Mask bits of interest
-	uint8_t result = AS5600::mask_8Bits(register_content, AS5600::POWER_MODE_MASK);
+	// Extract bits of interest (CONF_L is the low byte)
+	uint8_t result = AS5600::POWER_MODE_FIELD::extract(register_content);
 
 	// Find and return the corresponding enumeration
 	return AS5600::POWER_MODE(result);
@@ -320,17 +452,8 @@ AS5600::POWER_MODE AS5600::getPowerMode(void){
  *
  */
 bool AS5600::setHysteresis(AS5600::HYSTERESIS option){
-	// Read previous configuration to change only interested bits
-	uint8_t previous_configuration;
-	HAL_StatusTypeDef error = AS5600::LLR_8Bits(AS5600::CONF_L, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_8Bits(previous_configuration, AS5600::HYSTERESIS_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = AS5600::LLW_8Bits(AS5600::CONF_H, previous_configuration);
+	// Change only interested bits (CONF_L is the low byte), a single write with a valid shadow
+	HAL_StatusTypeDef error = AS5600::updateShadow_16Bits(AS5600::CONF_H, AS5600::HYSTERESIS_FIELD::mask(), option);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -342,12 +465,12 @@ bool AS5600::setHysteresis(AS5600::HYSTERESIS option){
  *
  */
 AS5600::HYSTERESIS AS5600::getHysteresis(void){
-	// Read the register
-	uint8_t register_content;
-	AS5600::LLR_8Bits(AS5600::CONF_L, &register_content);
+	// Read the register, from the shadow (its last value if the read fails)
+	uint16_t register_content;
+	AS5600::readShadow_16Bits(AS5600::CONF_H, &register_content);
 
-	// Mask bits of interest
-	uint8_t result = AS5600::mask_8Bits(register_content, AS5600::HYSTERESIS_MASK);
+	// Extract bits of interest (CONF_L is the low byte)
+	uint8_t result = AS5600::HYSTERESIS_FIELD::extract(register_content);
 
 	// Find and return the corresponding enumeration
 	return AS5600::HYSTERESIS(result);
@@ -359,17 +482,8 @@ AS5600::HYSTERESIS AS5600::getHysteresis(void){
  *
  */
 bool AS5600::setOutputMode(AS5600::OUTPUT_MODE option){
-	// Read previous configuration to change only interested bits
-	uint8_t previous_configuration;
-	HAL_StatusTypeDef error = AS5600::LLR_8Bits(AS5600::CONF_L, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_8Bits(previous_configuration, AS5600::OUTPUT_MODE_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = AS5600::LLW_8Bits(AS5600::CONF_H, previous_configuration);
+	// Change only interested bits (CONF_L is the low byte), a single write with a valid shadow
+	HAL_StatusTypeDef error = AS5600::updateShadow_16Bits(AS5600::CONF_H, AS5600::OUTPUT_MODE_FIELD::mask(), option);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -381,12 +495,12 @@ bool AS5600::setOutputMode(AS5600::OUTPUT_MODE option){
  *
  */
 AS5600::OUTPUT_MODE AS5600::getOutputMode(void){
-	// Read the register
-	uint8_t register_content;
-	AS5600::LLR_8Bits(AS5600::CONF_L, &register_content);
+	// Read the register, from the shadow (its last value if the read fails)
+	uint16_t register_content;
+	AS5600::readShadow_16Bits(AS5600::CONF_H, &register_content);
 
-	// Mask bits of interest
-	uint8_t result = AS5600::mask_8Bits(register_content, AS5600::OUTPUT_MODE_MASK);
+	// Extract bits of interest (CONF_L is the low byte)
+	uint8_t result = AS5600::OUTPUT_MODE_FIELD::extract(register_content);
 
 	// Find and return the corresponding enumeration
 	return AS5600::OUTPUT_MODE(result);
@@ -398,17 +512,8 @@ AS5600::OUTPUT_MODE AS5600::getOutputMode(void){
  *
  */
 bool AS5600::setPWMFrequency(AS5600::PWM_FREQUENCY option){
-	// Read previous configuration to change only interested bits
-	uint8_t previous_configuration;
-	HAL_StatusTypeDef error = AS5600::LLR_8Bits(AS5600::CONF_L, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_8Bits(previous_configuration, AS5600::PWM_FREQUENCY_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = AS5600::LLW_8Bits(AS5600::CONF_H, previous_configuration);
+	// Change only interested bits (CONF_L is the low byte), a single write with a valid shadow
+	HAL_StatusTypeDef error = AS5600::updateShadow_16Bits(AS5600::CONF_H, AS5600::PWM_FREQUENCY_FIELD::mask(), option);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -420,12 +525,12 @@ bool AS5600::setPWMFrequency(AS5600::PWM_FREQUENCY option){
  *
  */
 AS5600::PWM_FREQUENCY AS5600::getPWMFrequency(void){
-	// Read the register
-	uint8_t register_content;
-	AS5600::LLR_8Bits(AS5600::CONF_L, &register_content);
+	// Read the register, from the shadow (its last value if the read fails)
+	uint16_t register_content;
+	AS5600::readShadow_16Bits(AS5600::CONF_H, &register_content);
 
-	// Mask bits of interest
-	uint8_t result = AS5600::mask_8Bits(register_content, AS5600::PWM_FREQUENCY_MASK);
+	// Extract bits of interest (CONF_L is the low byte)
+	uint8_t result = AS5600::PWM_FREQUENCY_FIELD::extract(register_content);
 
 	// Find and return the corresponding enumeration
 	return AS5600::PWM_FREQUENCY(result);
@@ -437,17 +542,8 @@ AS5600::PWM_FREQUENCY AS5600::getPWMFrequency(void){
  *
  */
 bool AS5600::setSlowFilter(AS5600::SLOW_FILTER option){
-	// Read previous configuration to change only interested bits
-	uint8_t previous_configuration;
-	HAL_StatusTypeDef error = AS5600::LLR_8Bits(AS5600::CONF_L, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_8Bits(previous_configuration, AS5600::SLOW_FILTER_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = AS5600::LLW_8Bits(AS5600::CONF_H, previous_configuration);
+	// Change only interested bits (CONF_H is the high byte), a single write with a valid shadow
+	HAL_StatusTypeDef error = AS5600::updateShadow_16Bits(AS5600::CONF_H, AS5600::SLOW_FILTER_FIELD::mask(), option << 8);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -459,12 +555,12 @@ bool AS5600::setSlowFilter(AS5600::SLOW_FILTER option){
  *
  */
 AS5600::SLOW_FILTER AS5600::getSlowFilter(void){
-	// Read the register
-	uint8_t register_content;
-	AS5600::LLR_8Bits(AS5600::CONF_H, &register_content);
+	// Read the register, from the shadow (its last value if the read fails)
+	uint16_t register_content;
+	AS5600::readShadow_16Bits(AS5600::CONF_H, &register_content);
 
-	// Mask bits of interest
-	uint8_t result = AS5600::mask_8Bits(register_content, AS5600::SLOW_FILTER_MASK);
+	// Extract bits of interest (CONF_H is the high byte)
+	uint8_t result = AS5600::SLOW_FILTER_FIELD::extract(register_content) >> 8;
 
 	// Find and return the corresponding enumeration
 	return AS5600::SLOW_FILTER(result);
@@ -476,17 +572,8 @@ AS5600::SLOW_FILTER AS5600::getSlowFilter(void){
  *
  */
 bool AS5600::setFastFilter(AS5600::FAST_FILTER_TH option){
-	// Read previous configuration to change only interested bits
-	uint8_t previous_configuration;
-	HAL_StatusTypeDef error = AS5600::LLR_8Bits(AS5600::CONF_L, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_8Bits(previous_configuration, AS5600::FAST_FILTER_TH_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = AS5600::LLW_8Bits(AS5600::CONF_H, previous_configuration);
+	// Change only interested bits (CONF_H is the high byte), a single write with a valid shadow
+	HAL_StatusTypeDef error = AS5600::updateShadow_16Bits(AS5600::CONF_H, AS5600::FAST_FILTER_TH_FIELD::mask(), option << 8);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -498,12 +585,12 @@ bool AS5600::setFastFilter(AS5600::FAST_FILTER_TH option){
  *
  */
 AS5600::FAST_FILTER_TH AS5600::getFastFilterThresh(void){
-	// Read the register
-	uint8_t register_content;
-	AS5600::LLR_8Bits(AS5600::CONF_H, &register_content);
+	// Read the register, from the shadow (its last value if the read fails)
+	uint16_t register_content;
+	AS5600::readShadow_16Bits(AS5600::CONF_H, &register_content);
 
-	// Mask bits of interest
-	uint8_t result = AS5600::mask_8Bits(register_content, AS5600::FAST_FILTER_TH_MASK);
+	// Extract bits of interest (CONF_H is the high byte)
+	uint8_t result = AS5600::FAST_FILTER_TH_FIELD::extract(register_content) >> 8;
 
 	// Find and return the corresponding enumeration
 	return AS5600::FAST_FILTER_TH(result);
@@ -515,17 +602,8 @@ AS5600::FAST_FILTER_TH AS5600::getFastFilterThresh(void){
  *
  */
 bool AS5600::setWatchDog(AS5600::WATCHDOG option){
-	// Read previous configuration to change only interested bits
-	uint8_t previous_configuration;
-	HAL_StatusTypeDef error = AS5600::LLR_8Bits(AS5600::CONF_L, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_8Bits(previous_configuration, AS5600::WATCHDOG_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = AS5600::LLW_8Bits(AS5600::CONF_H, previous_configuration);
+	// Change only interested bits (CONF_H is the high byte), a single write with a valid shadow
+	HAL_StatusTypeDef error = AS5600::updateShadow_16Bits(AS5600::CONF_H, AS5600::WATCHDOG_FIELD::mask(), option << 8);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -537,12 +615,12 @@ bool AS5600::setWatchDog(AS5600::WATCHDOG option){
  *
  */
 AS5600::WATCHDOG AS5600::getWatchDog(void){
-	// Read the register
-	uint8_t register_content;
-	AS5600::LLR_8Bits(AS5600::CONF_H, &register_content);
+	// Read the register, from the shadow (its last value if the read fails)
+	uint16_t register_content;
+	AS5600::readShadow_16Bits(AS5600::CONF_H, &register_content);
 
-	// Mask bits of interest
-	uint8_t result = AS5600::mask_8Bits(register_content, AS5600::WATCHDOG_MASK);
+	// Extract bits of interest (CONF_H is the high byte)
+	uint8_t result = AS5600::WATCHDOG_FIELD::extract(register_content) >> 8;
 
 	// Find and return the corresponding enumeration
 	return AS5600::WATCHDOG(result);
@@ -557,11 +635,11 @@ AS5600::WATCHDOG AS5600::getWatchDog(void){
  */
 uint8_t AS5600::getZMCO(void){
 	// Read the value
-	uint8_t register_content;
+	uint8_t register_content = 0;
 	AS5600::LLR_8Bits(AS5600::ZMCO, &register_content);
 
-	// Return result
-	return register_content;
+	// Return the burn count, without the unused bits
+	return AS5600::ZMCO_FIELD::extract(register_content);
 }
 
 /*
@@ -570,7 +648,7 @@ uint8_t AS5600::getZMCO(void){
  */
 uint8_t AS5600::getStatus(void){
 	// Read the value
-	uint8_t register_content;
+	uint8_t register_content = 0;
 	AS5600::LLR_8Bits(AS5600::STATUS, &register_content);
 
 	// Return result
@@ -583,7 +661,7 @@ uint8_t AS5600::getStatus(void){
  */
 uint8_t AS5600::getAGC(void){
 	// Read the value
-	uint8_t register_content;
+	uint8_t register_content = 0;
 	AS5600::LLR_8Bits(AS5600::AGC, &register_content);
 
 	// Return result
@@ -597,10 +675,144 @@ uint8_t AS5600::getAGC(void){
 uint16_t AS5600::getMagnitude(void){
 	// Read the value
 	uint16_t register_content;
-	AS5600::LLR_16Bits(AS5600::MAGNITUDE_H, &register_content);
+	HAL_StatusTypeDef error = AS5600::LLR_16Bits(AS5600::MAGNITUDE_H, &register_content);
 
-	// Return result
-	return register_content;
+	// If the read failed keep the last good magnitude (the error is in the statistics)
+	if(error != HAL_OK) return AS5600::_sample_magnitude;
+
+	// Return the 12 bit value
+	AS5600::_sample_magnitude = AS5600::ANGLE_FIELD::extract(register_content);
+	return AS5600::_sample_magnitude;
+}
+
+
+// --- Utility methods ------------------------------------------------------------------
+
+/*
+ * @brief Reverses an angle value if the direction is counter clock wise.
+ *
+ * @param angle	Angle in ADC format;
+ *
+ */
+uint16_t AS5600::applyDirection(uint16_t angle){
+	// If direction is counter clock wise reverse the value
+	if(AS5600::_direction == AS5600::COUNTERCLOCK_WISE) return AS5600::ANGLE_FIELD::extract(AS5600::ANGLE_FIELD::mask() - angle);
+
+	// Return value as default
+	return AS5600::ANGLE_FIELD::extract(angle);
+}
+
+/*
+ * @brief Converts an angle to degrees or radians, as Q16.16 fixed-point.
+ *
+ * @param angle	Angle in ADC format;
+ * @param unit	Unit of measure of the output value;
+ *
+ */
+q16_t AS5600::toRealAngle_Q16(uint16_t angle, AS5600::OUTPUT_ANGLE_UNIT unit){
+	// If radians is selected, return result in radians (2pi in Q16.16 over 4096 counts)
+	if(unit == AS5600::RADIANS){
+		return (q16_t)(((int64_t)angle * AS5600_Q16_RADIANS_PER_TURN) >> 12);
+	}
+
+	// Return result in degrees (360 in Q16.16 over 4096 counts is exactly 5760)
+	return (q16_t)angle * 5760;
+}
+
+
+// --- Asynchronous read steps
+
+/*
+ * @brief Raw angle read, stores the sample in the selected direction.
+ *
+ */
+void AS5600::onRawAngleRead(void *context, HAL_StatusTypeDef status){
+	AS5600 *sensor = (AS5600 *)context;
+	if(status != HAL_OK){
+		sensor->_sample_errors++;
+		return;
+	}
+
+	sensor->_sample_raw_angle = sensor->applyDirection(sensor->concat_8to16Bits(sensor->_angle_buffer));
+	sensor->_samples++;
+}
+
+/*
+ * @brief Status read, stores the magnet bits.
+ *
+ */
+void AS5600::onStatusRead(void *context, HAL_StatusTypeDef status){
+	AS5600 *sensor = (AS5600 *)context;
+	if(status != HAL_OK){
+		sensor->_sample_errors++;
+		return;
+	}
+
+	sensor->_sample_status = AS5600::MAGNET_FIELD::extract(sensor->_status_buffer[0]);
+}
+
+/*
+ * @brief AGC and magnitude read.
+ *
+ */
+void AS5600::onMagnitudeRead(void *context, HAL_StatusTypeDef status){
+	AS5600 *sensor = (AS5600 *)context;
+	if(status != HAL_OK){
+		sensor->_sample_errors++;
+		return;
+	}
+
+	sensor->_sample_agc = sensor->_magnitude_buffer[0];
+	sensor->_sample_magnitude = AS5600::ANGLE_FIELD::extract(sensor->concat_8to16Bits(&(sensor->_magnitude_buffer[1])));
+}
+
+/*
+ * @brief Raw angle handle read, also stores the sample. The handle is released before
+ * it completes, so its callback can start the next read.
+ *
+ */
+void AS5600::onRawAngleResult(void *context, HAL_StatusTypeDef status){
+	AS5600 *sensor = (AS5600 *)context;
+
+	Async_Result<uint16_t> *result = sensor->_raw_angle_result;
+	sensor->_raw_angle_result = nullptr;
+	if(result == nullptr) return;
+
+	if(status != HAL_OK){
+		sensor->_sample_errors++;
+		result->fail(status);
+		return;
+	}
+
+	uint16_t angle = sensor->applyDirection(sensor->concat_8to16Bits(sensor->_raw_result_buffer));
+	sensor->_sample_raw_angle = angle;
+	sensor->_samples++;
+
+	result->complete(angle);
+}
+
+/*
+ * @brief Angle handle read, also kept as the last good angle, converted to the
+ * requested unit.
+ *
+ */
+void AS5600::onRealAngleResult(void *context, HAL_StatusTypeDef status){
+	AS5600 *sensor = (AS5600 *)context;
+
+	Async_Result<q16_t> *result = sensor->_real_angle_result;
+	sensor->_real_angle_result = nullptr;
+	if(result == nullptr) return;
+
+	if(status != HAL_OK){
+		sensor->_sample_errors++;
+		result->fail(status);
+		return;
+	}
+
+	uint16_t angle = sensor->applyDirection(sensor->concat_8to16Bits(sensor->_real_result_buffer));
+	sensor->_last_angle = angle;
+
+	result->complete(AS5600::toRealAngle_Q16(angle, sensor->_real_angle_unit));
 }
 
 
@@ -0,0 +1,204 @@
+/*
+ * AS5600_analog.cpp
+ *
+ * Implementation of AS5600_analog.hpp header file.
+ *
+ */
+
+#include "AS5600_analog.hpp"
+#include "cycle_counter.hpp"
+
+
+
+// ----------------------------------------------- AS5600_Analog class implementation ---
+
+// --- Source constructor ---------------------------------------------------------------
+
+/*
+ * @brief Constructor for the analog angle path. Nothing is touched until begin().
+ *
+ * @param channel		ADC1 channel wired to the AS5600 OUT pin (0 to 7, on GPIOA);
+ * @param range			Analog output mode programmed in the AS5600;
+ * @param direction		Rotation direction for upward counting;
+ *
+ */
+AS5600_Analog::AS5600_Analog(
+uint8_t channel,
+AS5600::OUTPUT_MODE range,
+AS5600::ROTATION_DIRECTION direction
+) :
+		_channel(channel),
+		_range(range),
+		_direction(direction),
+		_offset(0)
+	{
+		for(uint8_t i = 0; i < AS5600_ANALOG_BUFFER_SIZE; i++) AS5600_Analog::_buffer[i] = 0;
+	}
+
+
+// --- Source core methods --------------------------------------------------------------
+
+/*
+ * @brief Configures the pin, ADC1 (continuous, longest sample time) and DMA1 channel 1
+ * (circular, half-word) and starts the conversions. Call it after the clock setup.
+ *
+ */
+void AS5600_Analog::begin(void){
+	// Clocks: GPIOA, ADC1, DMA1, ADC prescaler to stay below 14 MHz
+	RCC->APB2ENR |= RCC_APB2ENR_IOPAEN | RCC_APB2ENR_ADC1EN;
+	RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_ADCPRE) | RCC_CFGR_ADCPRE_DIV6;
+
+	// Pin as analog input (mode and configuration bits cleared)
+	GPIOA->CRL &= ~(0x0FUL << (AS5600_Analog::_channel * 4));
+
+	// DMA: ADC data register to the buffer, circular, no interrupts
+	DMA1_Channel1->CCR = 0;
+	DMA1_Channel1->CPAR = (uintptr_t)&ADC1->DR;
+	DMA1_Channel1->CMAR = (uintptr_t)AS5600_Analog::_buffer;
+	DMA1_Channel1->CNDTR = AS5600_ANALOG_BUFFER_SIZE;
+	DMA1_Channel1->CCR = DMA_CCR_PL_0 | DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0 | DMA_CCR_MINC | DMA_CCR_CIRC;
+	DMA1_Channel1->CCR |= DMA_CCR_EN;
+
+	// ADC: single channel sequence, 239.5 cycles sample time
+	ADC1->CR1 = 0;
+	ADC1->SMPR2 = (ADC1->SMPR2 & ~(0x07UL << (AS5600_Analog::_channel * 3))) | (0x07UL << (AS5600_Analog::_channel * 3));
+	ADC1->SQR1 = 0;
+	ADC1->SQR3 = AS5600_Analog::_channel;
+
+	// Power on and calibrate (see reference manual RM0008, 11.4)
+	ADC1->CR2 = ADC_CR2_ADON;
+	HAL_Delay(1);
+
+	ADC1->CR2 |= ADC_CR2_RSTCAL;
+	while(ADC1->CR2 & ADC_CR2_RSTCAL);
+	ADC1->CR2 |= ADC_CR2_CAL;
+	while(ADC1->CR2 & ADC_CR2_CAL);
+
+	// Continuous conversions moved by DMA, started by software
+	ADC1->CR2 |= ADC_CR2_CONT | ADC_CR2_DMA | ADC_CR2_EXTSEL | ADC_CR2_EXTTRIG;
+	ADC1->CR2 |= ADC_CR2_SWSTART;
+
+	// Let the buffer fill before the first reading
+	HAL_Delay(1);
+}
+
+/*
+ * @brief Returns the angle from the latest samples, in the I2C raw angle scale.
+ *
+ */
+uint16_t AS5600_Analog::getRawAngle(void){
+	// Convert to the direction and then to the reference with the calibration offset
+	uint16_t angle = AS5600_Analog::convert(AS5600_Analog::readAverage());
+
+	if(AS5600_Analog::_direction == AS5600::COUNTERCLOCK_WISE) angle = 0x0FFF - angle;
+
+	return (uint16_t)(angle + AS5600_Analog::_offset) & 0x0FFF;
+}
+
+
+// --- Calibration ----------------------------------------------------------------------
+
+/*
+ * @brief Aligns this path to another source (typically the AS5600 over I2C) with the shaft
+ * still. Returns false if the reference and the samples do not settle.
+ *
+ * @param reference		Source to align to;
+ *
+ */
+bool AS5600_Analog::calibrate(Angle_Source &reference){
+	AS5600_Analog::_offset = 0;
+
+	// Take the difference between the two paths, the shortest way round
+	int32_t difference = (int32_t)reference.getRawAngle() - AS5600_Analog::getRawAngle();
+	if(difference >= 2048) difference -= 4096;
+	if(difference < -2048) difference += 4096;
+
+	// Check that the difference is stable (shaft still, output enabled)
+	int32_t check = (int32_t)reference.getRawAngle() - AS5600_Analog::getRawAngle() - difference;
+	check &= 0x0FFF;
+	if(check > 8 && check < 4096 - 8) return false;
+
+	AS5600_Analog::_offset = (int16_t)difference;
+	return true;
+}
+
+
+// --- Benchmark ------------------------------------------------------------------------
+
+/*
+ * @brief Measures the conversion rate by timing DMA buffer wrap-arounds with the cycle
+ * counter (cycleCounterBegin() must have been called). Blocking, returns 0 on timeout.
+ *
+ * @param buffers	Number of full buffers to time;
+ *
+ */
+float AS5600_Analog::measureSampleRate_Hz(uint16_t buffers){
+	const uint32_t timeout = SystemCoreClock;					// 1 s
+
+	uint32_t start = cycleCounterRead();
+	uint32_t first = 0;
+	uint16_t wraps = 0;
+
+	// Count transfers to go, the counter reloads at the end of each buffer
+	uint16_t previous = DMA1_Channel1->CNDTR;
+
+	while(wraps <= buffers){
+		if(cycleCounterElapsed(start) > timeout) return 0;
+
+		uint16_t current = DMA1_Channel1->CNDTR;
+		if(current > previous){
+			if(wraps == 0) first = cycleCounterRead();
+			wraps++;
+		}
+		previous = current;
+	}
+
+	uint32_t cycles = cycleCounterElapsed(first);
+
+	return (float)buffers * AS5600_ANALOG_BUFFER_SIZE * SystemCoreClock / cycles;
+}
+
+
+// --- Utility methods ------------------------------------------------------------------
+
+/*
+ * @brief Averages the buffer around its first sample, so that readings on both sides of
+ * the 4095 -> 0 wrap do not average to half a turn.
+ *
+ */
+uint16_t AS5600_Analog::readAverage(void){
+	int32_t first = AS5600_Analog::_buffer[0];
+	int32_t sum = 0;
+
+	for(uint8_t i = 1; i < AS5600_ANALOG_BUFFER_SIZE; i++){
+		int32_t difference = (int32_t)AS5600_Analog::_buffer[i] - first;
+		if(difference >= 2048) difference -= 4096;
+		if(difference < -2048) difference += 4096;
+		sum += difference;
+	}
+
+	return (uint16_t)(first + sum / AS5600_ANALOG_BUFFER_SIZE) & 0x0FFF;
+}
+
+/*
+ * @brief Converts an ADC sample to the 12-bit angle scale (reduced range spans 10% to
+ * 90% of VDD, full range GND to VDD).
+ *
+ * @param sample	ADC reading;
+ *
+ */
+uint16_t AS5600_Analog::convert(uint16_t sample){
+	// If full range the scales match
+	if(AS5600_Analog::_range != AS5600::ANALOG_REDUCED_RANGE) return sample & 0x0FFF;
+
+	// Remove the 10% offset and stretch 80% to the full scale
+	int32_t angle = ((int32_t)sample - 410) * 4096 / 3276;
+	if(angle < 0) angle = 0;
+	if(angle > 0x0FFF) angle = 0x0FFF;
+
+	return (uint16_t)angle;
+}
+
+
+// END OF FILE
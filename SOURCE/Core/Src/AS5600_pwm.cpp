@@ -0,0 +1,212 @@
+/*
+ * AS5600_pwm.cpp
+ *
+ * Implementation of AS5600_pwm.hpp header file.
+ *
+ */
+
+#include "AS5600_pwm.hpp"
+
+
+
+// -------------------------------------------------- AS5600_PWM class implementation ---
+
+// --- Source constructor ---------------------------------------------------------------
+
+/*
+ * @brief Constructor for the PWM angle path. Nothing is touched until begin().
+ *
+ * @param fallback		AS5600 read over I2C while the PWM signal is missing (can be null);
+ * @param frequency		PWM frequency programmed in the AS5600;
+ * @param direction		Rotation direction for upward counting;
+ *
+ */
+AS5600_PWM::AS5600_PWM(
+AS5600 *fallback,
+AS5600::PWM_FREQUENCY frequency,
+AS5600::ROTATION_DIRECTION direction
+) :
+		_fallback(fallback),
+		_frequency(frequency),
+		_direction(direction),
+		_timer_clock(0),
+		_signal_present(false),
+		_last_count(0),
+		_last_angle(0),
+		_fallback_count(0),
+		_fallback_samples(0)
+	{
+		AS5600_PWM::_capture[0] = 0;
+		AS5600_PWM::_capture[1] = 0;
+	}
+
+
+// --- Source core methods --------------------------------------------------------------
+
+/*
+ * @brief Configures PA0, TIM2 (PWM input, reset on rising edge, DMA burst of CCR1 and
+ * CCR2 on the CC1 request) and DMA1 channel 5 (circular), then starts the timer.
+ *
+ */
+void AS5600_PWM::begin(void){
+	// Clocks: GPIOA, TIM2, DMA1
+	RCC->APB2ENR |= RCC_APB2ENR_IOPAEN;
+	RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+	RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+	// TIM2 runs at twice PCLK1 when APB1 is divided
+	uint32_t clock = HAL_RCC_GetPCLK1Freq();
+	if((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) clock *= 2;
+	AS5600_PWM::_timer_clock = clock / (AS5600_PWM_TIMER_PRESCALER + 1);
+
+	// PA0 as floating input
+	GPIOA->CRL = (GPIOA->CRL & ~0x0FUL) | 0x04UL;
+
+	// DMA: TIM2 burst register to the capture buffer, circular, no interrupts
+	DMA1_Channel5->CCR = 0;
+	DMA1_Channel5->CPAR = (uintptr_t)&TIM2->DMAR;
+	DMA1_Channel5->CMAR = (uintptr_t)AS5600_PWM::_capture;
+	DMA1_Channel5->CNDTR = 2;
+	DMA1_Channel5->CCR = DMA_CCR_PL_0 | DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0 | DMA_CCR_MINC | DMA_CCR_CIRC;
+	DMA1_Channel5->CCR |= DMA_CCR_EN;
+
+	// Time base, only a counter overflow sets the update flag
+	TIM2->CR1 = TIM_CR1_URS;
+	TIM2->PSC = AS5600_PWM_TIMER_PRESCALER;
+	TIM2->ARR = 0xFFFF;
+
+	// IC1 on TI1 rising edge (period), IC2 on TI1 falling edge (high time), light filter
+	TIM2->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_IC1F_1 | TIM_CCMR1_CC2S_1 | TIM_CCMR1_IC2F_1;
+	TIM2->CCER = TIM_CCER_CC1E | TIM_CCER_CC2E | TIM_CCER_CC2P;
+
+	// Slave reset mode on TI1FP1: the counter restarts at every frame
+	TIM2->SMCR = TIM_SMCR_TS_2 | TIM_SMCR_TS_0 | TIM_SMCR_SMS_2;
+
+	// DMA burst of 2 registers from CCR1 (offset 0x34 / 4) on the CC1 request
+	TIM2->DCR = (1 << TIM_DCR_DBL_Pos) | ((0x34 / 4) << TIM_DCR_DBA_Pos);
+	TIM2->DIER = TIM_DIER_CC1DE;
+
+	// Load the prescaler, clear the flags and start
+	TIM2->EGR = TIM_EGR_UG;
+	TIM2->SR = 0;
+	TIM2->CR1 |= TIM_CR1_CEN;
+}
+
+/*
+ * @brief Returns the angle decoded from the latest frame, or the fallback reading if
+ * the signal is missing or the frame is not plausible.
+ *
+ */
+uint16_t AS5600_PWM::getRawAngle(void){
+	// If no signal use the fallback
+	if(!AS5600_PWM::isSignalPresent()) return AS5600_PWM::fallbackAngle();
+
+	uint16_t period = AS5600_PWM::_capture[0];
+	uint16_t high_time = AS5600_PWM::_capture[1];
+
+	if(!AS5600_PWM::isPeriodPlausible(period) || high_time >= period) return AS5600_PWM::fallbackAngle();
+
+	// Convert high time to PWM clocks and remove the initial ones
+	int32_t angle = ((uint32_t)high_time * AS5600_PWM_FRAME_CLOCKS + period / 2) / period - AS5600_PWM_INIT_CLOCKS;
+	if(angle < 0) angle = 0;
+	if(angle > 0x0FFF) angle = 0x0FFF;
+
+	// Apply the direction
+	if(AS5600_PWM::_direction == AS5600::COUNTERCLOCK_WISE) angle = 0x0FFF - angle;
+
+	AS5600_PWM::_last_angle = (uint16_t)angle;
+	return AS5600_PWM::_last_angle;
+}
+
+
+// --- Signal status --------------------------------------------------------------------
+
+/*
+ * @brief Checks for the signal: an overflow of the counter (no edge for 9.2 ms) means it
+ * is lost, a counter that went back (reset by an edge) means it is present again.
+ *
+ */
+bool AS5600_PWM::isSignalPresent(void){
+	uint16_t count = TIM2->CNT;
+
+	if(TIM2->SR & TIM_SR_UIF){
+		TIM2->SR = ~(uint32_t)TIM_SR_UIF;
+		AS5600_PWM::_signal_present = false;
+	}
+	else if(count < AS5600_PWM::_last_count) AS5600_PWM::_signal_present = true;
+
+	AS5600_PWM::_last_count = count;
+
+	return AS5600_PWM::_signal_present;
+}
+
+/*
+ * @brief Returns the time since the latest frame started (counter value, up to 9.2 ms).
+ *
+ */
+uint32_t AS5600_PWM::getSampleAge_us(void){
+	if(AS5600_PWM::_timer_clock == 0) return 0xFFFFFFFF;
+
+	return (uint64_t)TIM2->CNT * 1000000 / AS5600_PWM::_timer_clock;
+}
+
+
+// --- Benchmark ------------------------------------------------------------------------
+
+/*
+ * @brief Returns the sample rate expected for the configured PWM frequency.
+ *
+ */
+float AS5600_PWM::getNominalSampleRate_Hz(void){
+	// 115 Hz doubled for each step of the option
+	return 115.0f * (1 << (AS5600_PWM::_frequency >> 6));
+}
+
+/*
+ * @brief Returns the sample rate measured from the latest frame, 0 if not valid.
+ *
+ */
+float AS5600_PWM::measureSampleRate_Hz(void){
+	uint16_t period = AS5600_PWM::_capture[0];
+	if(!AS5600_PWM::isPeriodPlausible(period)) return 0;
+
+	return (float)AS5600_PWM::_timer_clock / period;
+}
+
+
+// --- Utility methods ------------------------------------------------------------------
+
+/*
+ * @brief Checks a captured period against the configured frequency (the AS5600 clock
+ * tolerance is well within 20%).
+ *
+ * @param period	Captured period [ticks];
+ *
+ */
+bool AS5600_PWM::isPeriodPlausible(uint16_t period){
+	uint32_t expected = AS5600_PWM::_timer_clock / (115UL << (AS5600_PWM::_frequency >> 6));
+
+	return period > expected * 4 / 5 && period < expected * 6 / 5;
+}
+
+/*
+ * @brief Returns the latest queued I2C read of the angle, or repeats the last angle if
+ * there is no fallback. A read is queued when nothing refreshed the sample since the last
+ * call (no bus slot), its result is used by the next call: never waits on the bus.
+ *
+ */
+uint16_t AS5600_PWM::fallbackAngle(void){
+	AS5600_PWM::_fallback_count++;
+
+	if(AS5600_PWM::_fallback == nullptr) return AS5600_PWM::_last_angle;
+
+	uint32_t samples = AS5600_PWM::_fallback->getSampleCount();
+	if(samples == AS5600_PWM::_fallback_samples) AS5600_PWM::_fallback->readRawAngleAsync(AS5600_PWM::_fallback_read);
+	AS5600_PWM::_fallback_samples = samples;
+
+	if(samples > 0) AS5600_PWM::_last_angle = AS5600_PWM::_fallback->getSampleRawAngle();
+	return AS5600_PWM::_last_angle;
+}
+
+
+// END OF FILE
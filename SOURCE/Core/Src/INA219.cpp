@@ -6,6 +6,18 @@
  */
 
 #include "INA219.hpp"
+#include "cycle_counter.hpp"
+
+
+
+// --- Conversion times -----------------------------------------------------------------
+
+// See data-sheet page 19, table 5: conversion time for each 4 bit ADC setting [us]
+
+const uint32_t INA219_CONVERSION_TIME_US[16] = {
+		84, 148, 276, 532, 84, 148, 276, 532,
+		532, 1060, 2130, 4260, 8510, 17020, 34050, 68100
+};
 
 
 
@@ -20,7 +32,7 @@
  * @param max_expexted_current 	Value of highest current passing through shunt resistor;
  * @oaram shunt_resistor 		Value of shunt resistor used to measure current;
  * @param device_address		Address of the I2C device;
- * @param response_delay		Time to wait for the device response;
+ * @param response_delay_us		Extra time allowed for the device response [us];
  *
  */
 INA219::INA219(
@@ -28,10 +40,43 @@ I2C_HandleTypeDef *device_handle,
 float max_expected_current,
 float shunt_resistor,
 uint8_t device_address,
-uint32_t response_delay
+uint32_t response_delay_us
 ) :
-		I2C_Device(device_handle, device_address, response_delay)
+		I2C_Device(device_handle, device_address, response_delay_us),
+		_calibration_value(0),
+		_calibration_suspect(true),
+		_calibration_check_period(1000),
+		_samples_since_check(0),
+		_calibration_checks(0),
+		_calibration_rewrites(0),
+		_streaming(false),
+		_triggered(false),
+		_acquisition_state(INA219::ACQUISITION_IDLE),
+		_collect_requested(false),
+		_polling(false),
+		_trigger_cycles(0),
+		_conversion_cycles(0),
+		_poll_count(0),
+		_sample_bus_voltage(0),
+		_sample_shunt_voltage(0),
+		_conversion_latency(0),
+		_max_conversion_latency(0),
+		_sample_latency(0),
+		_completed_samples(0),
+		_failed_samples(0),
+		_trigger_overruns(0),
+		_current_result(nullptr),
+		_bus_voltage_result(nullptr),
+		_current_result_buffer(),
+		_bus_voltage_result_buffer(),
+		_last_register()
 	{
+		INA219::_async_buffer[0] = 0;
+		INA219::_async_buffer[1] = 0;
+
+		// Configuration register is shadowed
+		INA219::addShadowRegister(INA219::CONF, 2);
+
 		// Calibrate sensor with given current and resistor values
 		INA219::calibrateSensor(max_expected_current, shunt_resistor);
 	}
@@ -46,12 +91,12 @@ uint32_t response_delay
  *
  */
 int16_t INA219::getRawBusVoltage(void){
-	// Read the register
+	// Read the register (the last good content if it fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::BUS_VOLTAGE, &register_content);
+	INA219::readRegister(INA219::BUS_VOLTAGE, &register_content);
 
 	// Remove flag bits, multiply by the LSB and then return result (see data-sheet page 23)
-	return (int16_t)(register_content >> 3) * 4;
+	return (int16_t)INA219::BUS_VOLTAGE_FIELD::get(register_content) * 4;
 }
 
 /*
@@ -59,9 +104,9 @@ int16_t INA219::getRawBusVoltage(void){
  *
  */
 int16_t INA219::getRawShuntVoltage(void){
-	// Read the register
+	// Read the register (the last good content if it fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::SHUNT_VOLTAGE, &register_content);
+	INA219::readRegister(INA219::SHUNT_VOLTAGE, &register_content);
 
 	// Return result
 	return (int16_t)register_content;
@@ -72,12 +117,12 @@ int16_t INA219::getRawShuntVoltage(void){
  *
  */
 int16_t INA219::getRawCurrent(void){
-	// Re-calibration to avoid problems (based on Adafruit library)
-	INA219::calibrateSensor(INA219::_max_expected_current, INA219::_shunt_resistor);
+	// Make sure the calibration register holds the cached value
+	INA219::maintainCalibration();
 
-	// Read the register
+	// Read the register (the last good content if it fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::CURRENT, &register_content);
+	INA219::readRegister(INA219::CURRENT, &register_content);
 
 	// Return result
 	return (int16_t)register_content;
@@ -88,12 +133,12 @@ int16_t INA219::getRawCurrent(void){
  *
  */
 int16_t INA219::getRawPower(void){
-	// Re-calibration to avoid problems (based on Adafruit library)
-	INA219::calibrateSensor(INA219::_max_expected_current, INA219::_shunt_resistor);
+	// Make sure the calibration register holds the cached value
+	INA219::maintainCalibration();
 
-	// Read the register
+	// Read the register (the last good content if it fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::POWER, &register_content);
+	INA219::readRegister(INA219::POWER, &register_content);
 
 	// Return result
 	return (int16_t)register_content;
@@ -103,65 +148,110 @@ int16_t INA219::getRawPower(void){
 // --- Sensor readings
 
 /*
- * @brief Returns the sensed bus voltage after proper conversion.
+ * @brief Returns the sensed bus voltage in volts, as Q16.16 fixed-point.
  *
  */
-float INA219::getBusVoltage_V(void){
-	// Read the register
+q16_t INA219::getBusVoltage_Q16(void){
+	// Read the register (the last good content if it fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::BUS_VOLTAGE, &register_content);
-
-	// Checks flags: return -100 if overflow
-	uint16_t register_flags = INA219::mask_16Bits(register_content, INA219::BUS_REGISTER_FLAGS_MASK);
-	if(register_flags & INA219::BUS_REGISTER_OVF_MASK) return -100;
+	INA219::readRegister(INA219::BUS_VOLTAGE, &register_content);
 
-	// Remove flag bits, multiply by fixed 4 mV LSB and return result (see data-sheet page 23)
-	return (register_content >> 3) * 4e-3;
+	// Decode and return result
+	return INA219::decodeBusVoltage_Q16(register_content);
 }
 
 /*
- * @brief Returns the sensed shunt voltage after proper conversion.
+ * @brief Returns the sensed shunt voltage in millivolts, as Q16.16 fixed-point.
  *
  */
-float INA219::getShuntVoltage_V(void){
-	// Read the register
+q16_t INA219::getShuntVoltage_mV_Q16(void){
+	// Read the register (the last good content if it fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::SHUNT_VOLTAGE, &register_content);
+	INA219::readRegister(INA219::SHUNT_VOLTAGE, &register_content);
 
 	// Multiply by fixed 10 uV LSB and return the result (see data-sheet page 21)
-	return (int16_t)register_content * 1e-5;
+	return (q16_t)qGainApply(INA219_SHUNT_VOLTAGE_LSB_Q16, (int16_t)register_content);
 }
 
 /*
- * @brief Return the sensed current after proper conversion.
+ * @brief Return the sensed current in amps, as Q16.16 fixed-point.
  *
  */
-float INA219::getCurrent_A(void){
-	// Re-calibration to avoid problems (based on Adafruit library)
-	INA219::calibrateSensor(INA219::_max_expected_current, INA219::_shunt_resistor);
+q16_t INA219::getCurrent_Q16(void){
+	// Make sure the calibration register holds the cached value
+	INA219::maintainCalibration();
 
-	// Read the register
+	// Read the register (the last good content if it fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::CURRENT, &register_content);
+	INA219::readRegister(INA219::CURRENT, &register_content);
 
-	// Multiply by the current LSB and return the result
-	return (int16_t)register_content * INA219::_current_lsb;
+	// Decode and return result
+	return INA219::decodeCurrent_Q16(register_content);
 }
 
 /*
- * @brief Return the sensed power after proper conversion.
+ * @brief Return the sensed power in watts, as Q16.16 fixed-point.
  *
  */
-float INA219::getPower_W(void){
-	// Re-calibration to avoid problems (based on Adafruit library)
-	INA219::calibrateSensor(INA219::_max_expected_current, INA219::_shunt_resistor);
+q16_t INA219::getPower_Q16(void){
+	// Make sure the calibration register holds the cached value
+	INA219::maintainCalibration();
 
-	// Read the register
+	// Read the register (the last good content if it fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::POWER, &register_content);
+	INA219::readRegister(INA219::POWER, &register_content);
 
 	// Multiply by the power LSB and return the result
-	return (int16_t)register_content * INA219::_power_lsb;
+	return (q16_t)qGainApply(INA219::_power_lsb_q16, (int16_t)register_content);
+}
+
+
+// --- Asynchronous reads with a result handle
+
+/*
+ * @brief Starts a read of the current register, completed into the handle (in amps) by
+ * the bus engine. Never blocks, callable from interrupts. Returns false if a read of
+ * this kind or the handle is still pending, or if the read cannot be queued (the handle
+ * then fails).
+ *
+ * @param result	Handle receiving the current;
+ *
+ */
+bool INA219::readCurrentAsync(Async_Result<q16_t> &result){
+	// Claim the slot and the handle in one step (callers may preempt each other), the
+	// callback finds the handle there, also if the engine completes the read at once
+	if(!result.begin(INA219::_current_result)) return false;
+
+	HAL_StatusTypeDef error = INA219::LLR_Async(INA219::CURRENT, INA219::_current_result_buffer, 2, INA219::onCurrentResult, this);
+	if(error != HAL_OK){
+		INA219::_current_result = nullptr;
+		result.fail(error);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * @brief Starts a read of the bus voltage register, completed into the handle (in volts,
+ * -100 on overflow as getBusVoltage_Q16()). Same rules as readCurrentAsync().
+ *
+ * @param result	Handle receiving the bus voltage;
+ *
+ */
+bool INA219::readBusVoltageAsync(Async_Result<q16_t> &result){
+	// Claim the slot and the handle in one step (callers may preempt each other), the
+	// callback finds the handle there, also if the engine completes the read at once
+	if(!result.begin(INA219::_bus_voltage_result)) return false;
+
+	HAL_StatusTypeDef error = INA219::LLR_Async(INA219::BUS_VOLTAGE, INA219::_bus_voltage_result_buffer, 2, INA219::onBusVoltageResult, this);
+	if(error != HAL_OK){
+		INA219::_bus_voltage_result = nullptr;
+		result.fail(error);
+		return false;
+	}
+
+	return true;
 }
 
 
@@ -183,11 +273,17 @@ void INA219::calibrateSensor(float max_expected_current, float shunt_resistor){
 	INA219::_current_lsb = INA219::_max_expected_current / 32768;
 	INA219::_power_lsb = 20 * INA219::_current_lsb;
 
-	// Compute calibration value (see data-sheet page 12, equation 1)
-	uint16_t calibration_value = (uint16_t)(0.04096 / (INA219::_current_lsb * INA219::_shunt_resistor));
+	INA219::_current_lsb_q16 = qGainFromFloat(INA219::_current_lsb * 65536);
+	INA219::_power_lsb_q16 = qGainFromFloat(INA219::_power_lsb * 65536);
+	INA219::_shunt_current_q16 = qGainFromFloat(1e-5f / INA219::_shunt_resistor * 65536);
+
+	// Compute and cache calibration value (see data-sheet page 12, equation 1)
+	INA219::_calibration_value = (uint16_t)(0.04096 / (INA219::_current_lsb * INA219::_shunt_resistor));
 
-	// Write computed calibration value
-	INA219::LLW_16Bits(INA219::CALIBRATION, calibration_value);
+	// Write computed calibration value, if it fails verify it before the next reading
+	HAL_StatusTypeDef error = INA219::LLW_16Bits(INA219::CALIBRATION, INA219::_calibration_value);
+	INA219::_calibration_suspect = (error != HAL_OK);
+	INA219::_samples_since_check = 0;
 }
 
 /*
@@ -195,15 +291,53 @@ void INA219::calibrateSensor(float max_expected_current, float shunt_resistor){
  *
  */
 uint16_t INA219::getCalibration(void){
-	// Read the register
+	// Read the register, if it fails give the cached value and verify it before the next reading
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::CALIBRATION, &register_content);
+	HAL_StatusTypeDef error = INA219::LLR_16Bits(INA219::CALIBRATION, &register_content);
+	if(error != HAL_OK){
+		INA219::_calibration_suspect = true;
+		return INA219::_calibration_value;
+	}
 
 	// Return result
 	return register_content;
 }
 
 
+// --- Calibration watchdog
+
+/*
+ * @brief Reads back the calibration register and rewrites the cached value only if it
+ * differs (e.g. after a sensor reset or a power glitch). Counts checks and rewrites.
+ *
+ */
+bool INA219::checkCalibration(void){
+	INA219::_calibration_checks++;
+	INA219::_samples_since_check = 0;
+
+	// Read the register, if it fails keep the calibration suspect
+	uint16_t register_content;
+	HAL_StatusTypeDef error = INA219::LLR_16Bits(INA219::CALIBRATION, &register_content);
+	if(error != HAL_OK){
+		INA219::_calibration_suspect = true;
+		return false;
+	}
+
+	// If the register holds the cached value nothing to do
+	if(register_content == INA219::_calibration_value){
+		INA219::_calibration_suspect = false;
+		return true;
+	}
+
+	// Rewrite the cached value
+	INA219::_calibration_rewrites++;
+	error = INA219::LLW_16Bits(INA219::CALIBRATION, INA219::_calibration_value);
+	INA219::_calibration_suspect = (error != HAL_OK);
+
+	return error == HAL_OK;
+}
+
+
 // --- Sensor utility methods -----------------------------------------------------------
 
 // Empty for now
@@ -216,14 +350,13 @@ uint16_t INA219::getCalibration(void){
 /*
  * @brief Sets the configuration register to the given value.
  * (See data-sheet page 19 and 20 for more details on configuration)
- * TODO remove or improve !!!
  *
  * @param value	The configuration to set;
  *
  */
 bool INA219::setConfiguration(uint16_t value){
 	// Write configuration
-	HAL_StatusTypeDef error = INA219::LLW_16Bits(INA219::CONF, value);
+	HAL_StatusTypeDef error = INA219::writeShadow_16Bits(INA219::CONF, value);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -233,12 +366,12 @@ bool INA219::setConfiguration(uint16_t value){
 /*
  * @brief Gets the value in the configuration register.
  * (See data-sheet page 19 and 20 for more details on configuration)
- * TODO cache the configuration for faster reading ???
+ *
  */
 uint16_t INA219::getConfiguration(void){
-	// Read the register
+	// Read the register, from the shadow (its last value if the read fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::CONF, &register_content);
+	INA219::readShadow_16Bits(INA219::CONF, &register_content);
 
 	// Return result
 	return register_content;
@@ -253,17 +386,8 @@ uint16_t INA219::getConfiguration(void){
  *
  */
 bool INA219::setBusVoltageRange(INA219::BUS_VOLTAGE_RANGE option){
-	// Read previous configuration to change only interested bits
-	uint16_t previous_configuration;
-	HAL_StatusTypeDef error = INA219::LLR_16Bits(INA219::CONF, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_16Bits(previous_configuration, INA219::BUS_VOLTAGE_RANGE_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = INA219::LLW_16Bits(INA219::CONF, previous_configuration);
+	// Change only interested bits, a single write with a valid shadow
+	HAL_StatusTypeDef error = INA219::updateShadow_16Bits(INA219::CONF, INA219::BUS_VOLTAGE_RANGE_FIELD::mask(), option);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -276,12 +400,12 @@ bool INA219::setBusVoltageRange(INA219::BUS_VOLTAGE_RANGE option){
  *
  */
 INA219::BUS_VOLTAGE_RANGE INA219::getBusVoltageRange(void){
-	// Read the register
+	// Read the register, from the shadow (its last value if the read fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::CONF, &register_content);
+	INA219::readShadow_16Bits(INA219::CONF, &register_content);
 
-	// Mask bits of interest
-	uint16_t result = INA219::mask_16Bits(register_content, INA219::BUS_VOLTAGE_RANGE_MASK);
+	// Extract bits of interest
+	uint16_t result = INA219::BUS_VOLTAGE_RANGE_FIELD::extract(register_content);
 
 	// Find and return the corresponding enumeration
 	return INA219::BUS_VOLTAGE_RANGE(result);
@@ -294,17 +418,8 @@ INA219::BUS_VOLTAGE_RANGE INA219::getBusVoltageRange(void){
  *
  */
 bool INA219::setPGA(INA219::PGA option){
-	// Read previous configuration to change only interested bits
-	uint16_t previous_configuration;
-	HAL_StatusTypeDef error = INA219::LLR_16Bits(INA219::CONF, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_16Bits(previous_configuration, INA219::PGA_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = INA219::LLW_16Bits(INA219::CONF, previous_configuration);
+	// Change only interested bits, a single write with a valid shadow
+	HAL_StatusTypeDef error = INA219::updateShadow_16Bits(INA219::CONF, INA219::PGA_FIELD::mask(), option);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -317,12 +432,12 @@ bool INA219::setPGA(INA219::PGA option){
  *
  */
 INA219::PGA INA219::getPGA(void){
-	// Read the register
+	// Read the register, from the shadow (its last value if the read fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::CONF, &register_content);
+	INA219::readShadow_16Bits(INA219::CONF, &register_content);
 
-	// Mask bits of interest
-	uint16_t result = INA219::mask_16Bits(register_content, INA219::PGA_MASK);
+	// Extract bits of interest
+	uint16_t result = INA219::PGA_FIELD::extract(register_content);
 
 	// Find and return the corresponding enumeration
 	return INA219::PGA(result);
@@ -335,17 +450,8 @@ INA219::PGA INA219::getPGA(void){
  *
  */
 bool INA219::setBusADCResolution(INA219::BUS_ADC_RESOLUTION option){
-	// Read previous configuration to change only interested bits
-	uint16_t previous_configuration;
-	HAL_StatusTypeDef error = INA219::LLR_16Bits(INA219::CONF, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_16Bits(previous_configuration, INA219::BUS_ADC_RESOLUTION_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = INA219::LLW_16Bits(INA219::CONF, previous_configuration);
+	// Change only interested bits, a single write with a valid shadow
+	HAL_StatusTypeDef error = INA219::updateShadow_16Bits(INA219::CONF, INA219::BUS_ADC_RESOLUTION_FIELD::mask(), option);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -358,12 +464,12 @@ bool INA219::setBusADCResolution(INA219::BUS_ADC_RESOLUTION option){
  *
  */
 INA219::BUS_ADC_RESOLUTION INA219::getBusADCResolution(void){
-	// Read the register
+	// Read the register, from the shadow (its last value if the read fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::CONF, &register_content);
+	INA219::readShadow_16Bits(INA219::CONF, &register_content);
 
-	// Mask bits of interest
-	uint16_t result = INA219::mask_16Bits(register_content, INA219::BUS_ADC_RESOLUTION_MASK);
+	// Extract bits of interest
+	uint16_t result = INA219::BUS_ADC_RESOLUTION_FIELD::extract(register_content);
 
 	// Find and return the corresponding enumeration
 	return INA219::BUS_ADC_RESOLUTION(result);
@@ -376,17 +482,8 @@ INA219::BUS_ADC_RESOLUTION INA219::getBusADCResolution(void){
  *
  */
 bool INA219::setShuntADCResolution(INA219::SHUNT_ADC_RESOLUTION option){
-	// Read previous configuration to change only interested bits
-	uint16_t previous_configuration;
-	HAL_StatusTypeDef error = INA219::LLR_16Bits(INA219::CONF, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_16Bits(previous_configuration, INA219::SHUNT_ADC_RESOLUTION_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = INA219::LLW_16Bits(INA219::CONF, previous_configuration);
+	// Change only interested bits, a single write with a valid shadow
+	HAL_StatusTypeDef error = INA219::updateShadow_16Bits(INA219::CONF, INA219::SHUNT_ADC_RESOLUTION_FIELD::mask(), option);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -399,12 +496,12 @@ bool INA219::setShuntADCResolution(INA219::SHUNT_ADC_RESOLUTION option){
  *
  */
 INA219::SHUNT_ADC_RESOLUTION INA219::getShuntADCResolution(void){
-	// Read the register
+	// Read the register, from the shadow (its last value if the read fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::CONF, &register_content);
+	INA219::readShadow_16Bits(INA219::CONF, &register_content);
 
-	// Mask bits of interest
-	uint16_t result = INA219::mask_16Bits(register_content, INA219::SHUNT_ADC_RESOLUTION_MASK);
+	// Extract bits of interest
+	uint16_t result = INA219::SHUNT_ADC_RESOLUTION_FIELD::extract(register_content);
 
 	// Find and return the corresponding enumeration
 	return INA219::SHUNT_ADC_RESOLUTION(result);
@@ -417,17 +514,8 @@ INA219::SHUNT_ADC_RESOLUTION INA219::getShuntADCResolution(void){
  *
  */
 bool INA219::setOperatingMode(INA219::OPERATING_MODE option){
-	// Read previous configuration to change only interested bits
-	uint16_t previous_configuration;
-	HAL_StatusTypeDef error = INA219::LLR_16Bits(INA219::CONF, &previous_configuration);
-	if(error != HAL_OK) return false;
-
-	// Mask and set configuration bits of interest
-	previous_configuration = mask_16Bits(previous_configuration, INA219::OPERATING_MODE_MASK, true);
-	previous_configuration |= option;
-
-	// Set new configuration
-	error = INA219::LLW_16Bits(INA219::CONF, previous_configuration);
+	// Change only interested bits, a single write with a valid shadow
+	HAL_StatusTypeDef error = INA219::updateShadow_16Bits(INA219::CONF, INA219::OPERATING_MODE_FIELD::mask(), option);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -440,18 +528,179 @@ bool INA219::setOperatingMode(INA219::OPERATING_MODE option){
  *
  */
 INA219::OPERATING_MODE INA219::getOperatingMode(void){
-	// Read the register
+	// Read the register, from the shadow (its last value if the read fails)
 	uint16_t register_content;
-	INA219::LLR_16Bits(INA219::CONF, &register_content);
+	INA219::readShadow_16Bits(INA219::CONF, &register_content);
 
-	// Mask bits of interest
-	uint16_t result = INA219::mask_16Bits(register_content, INA219::OPERATING_MODE_MASK);
+	// Extract bits of interest
+	uint16_t result = INA219::OPERATING_MODE_FIELD::extract(register_content);
 
 	// Find and return the corresponding enumeration
 	return INA219::OPERATING_MODE(result);
 }
 
 
+// --- Triggered acquisition methods ----------------------------------------------------
+
+/*
+ * @brief Switches the sensor to a triggered mode: every trigger() then writes back the
+ * configuration held by the CONF shadow (a write starts one conversion). Uses blocking
+ * accesses, call it before the bus engine traffic starts.
+ *
+ * @param mode	SHUNT_VOLTAGE_TRGD or BOTH_VOLTAGE_TRGD;
+ *
+ */
+bool INA219::beginTriggered(INA219::OPERATING_MODE mode){
+	// Refuse continuous and power-down modes
+	if(mode != INA219::SHUNT_VOLTAGE_TRGD && mode != INA219::BOTH_VOLTAGE_TRGD) return false;
+
+	// Change only the mode bits, the shadow then holds the configuration
+	HAL_StatusTypeDef error = INA219::updateShadow_16Bits(INA219::CONF, INA219::OPERATING_MODE_FIELD::mask(), mode);
+	if(error != HAL_OK) return false;
+
+	INA219::_triggered = true;
+	INA219::_acquisition_state = INA219::ACQUISITION_IDLE;
+	return true;
+}
+
+/*
+ * @brief Goes back to continuous conversions of both voltages. Fails while a triggered
+ * conversion is in progress.
+ *
+ */
+bool INA219::endTriggered(void){
+	// If a conversion is running the bus engine still owns the sensor
+	INA219::ACQUISITION_STATE state = INA219::_acquisition_state;
+	if(state != INA219::ACQUISITION_IDLE && state != INA219::ACQUISITION_READY && state != INA219::ACQUISITION_FAILED) return false;
+
+	INA219::_triggered = false;
+	INA219::_acquisition_state = INA219::ACQUISITION_IDLE;
+	return INA219::setOperatingMode(INA219::BOTH_VOLTAGE_CONT);
+}
+
+/*
+ * @brief Changes the ADC settings in the CONF shadow, no bus access: the next trigger()
+ * writes them with the conversion start, so switching is free. Fails if the sensor is
+ * not in triggered mode.
+ *
+ * @param shunt		Shunt ADC resolution or averaging;
+ * @param bus		Bus ADC resolution or averaging;
+ *
+ */
+bool INA219::setTriggeredResolution(INA219::SHUNT_ADC_RESOLUTION shunt, INA219::BUS_ADC_RESOLUTION bus){
+	if(!INA219::_triggered) return false;
+
+	// Set configuration bits of interest
+	uint16_t configuration;
+	if(!INA219::loadShadow(INA219::CONF, &configuration)) return false;
+
+	configuration = INA219::SHUNT_ADC_RESOLUTION_FIELD::insert(configuration, shunt);
+	INA219::storeShadow(INA219::CONF, INA219::BUS_ADC_RESOLUTION_FIELD::insert(configuration, bus));
+
+	return true;
+}
+
+/*
+ * @brief Returns the time of one triggered conversion with the shadowed configuration,
+ * shunt plus bus in the both-voltage mode. Returns 0 if the shadow is not valid.
+ *
+ */
+uint32_t INA219::getTriggeredConversionTime_us(void){
+	uint16_t configuration;
+	if(!INA219::loadShadow(INA219::CONF, &configuration)) return 0;
+
+	uint32_t time = INA219::conversionTime_us(INA219::SHUNT_ADC_RESOLUTION_FIELD::get(configuration));
+	if(INA219::OPERATING_MODE_FIELD::extract(configuration) == INA219::BOTH_VOLTAGE_TRGD){
+		time += INA219::conversionTime_us(INA219::BUS_ADC_RESOLUTION_FIELD::get(configuration));
+	}
+
+	return time;
+}
+
+/*
+ * @brief Starts a conversion by queueing the configuration write, then polls the CNVR
+ * flag and reads the shunt voltage from the bus engine callbacks. Never blocks, so it
+ * can be called from a timer interrupt. A conversion left for collect() and not polled
+ * yet is restarted (e.g. with new settings). Returns false if the previous conversion is
+ * still on the bus or the bus queue is full.
+ *
+ * @param collect	Poll right after the write, otherwise wait for collect() (no bus
+ * 					traffic while converting);
+ *
+ */
+bool INA219::trigger(bool collect){
+	// If the previous conversion has bus traffic running count the overrun
+	INA219::ACQUISITION_STATE state = INA219::_acquisition_state;
+	bool restartable = state == INA219::ACQUISITION_CONVERTING && !INA219::_polling;
+	if(state == INA219::ACQUISITION_TRIGGERING || state == INA219::ACQUISITION_READING || (state == INA219::ACQUISITION_CONVERTING && !restartable)){
+		INA219::_trigger_overruns++;
+		return false;
+	}
+
+	// Configuration to write back, known while in a triggered mode
+	uint16_t configuration;
+	if(!INA219::_triggered || !INA219::loadShadow(INA219::CONF, &configuration)){
+		INA219::failAcquisition();
+		return false;
+	}
+
+	INA219::_trigger_cycles = cycleCounterRead();
+	INA219::_collect_requested = collect;
+	INA219::_polling = false;
+	INA219::_acquisition_state = INA219::ACQUISITION_TRIGGERING;
+
+	// Writing the configuration in a triggered mode starts the conversion and clears CNVR
+	HAL_StatusTypeDef error = INA219::LLW_Async_16Bits(INA219::CONF, configuration, INA219::onTriggerWritten, this);
+	if(error == HAL_OK) return true;
+
+	// Return failure as default
+	INA219::failAcquisition();
+	return false;
+}
+
+/*
+ * @brief Starts polling a conversion triggered with collect set to false, best called
+ * once the conversion time elapsed so the first CNVR read succeeds. Returns false if no
+ * conversion is running.
+ *
+ */
+bool INA219::collect(void){
+	// The bus engine callbacks move the state too
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	bool running = true;
+	if(INA219::_acquisition_state == INA219::ACQUISITION_TRIGGERING) INA219::_collect_requested = true;
+	else if(INA219::_acquisition_state == INA219::ACQUISITION_CONVERTING){
+		if(!INA219::_polling){
+			INA219::_polling = true;
+			INA219::pollConversion();
+		}
+	}
+	else running = false;
+
+	__set_PRIMASK(primask);
+	return running;
+}
+
+/*
+ * @brief Returns the current of the latest completed sample in amps, as Q16.16. It is
+ * computed from the shunt voltage, so it does not depend on the calibration register.
+ *
+ */
+q16_t INA219::getSampleCurrent_Q16(void){
+	return (q16_t)qGainApply(INA219::_shunt_current_q16, INA219::_sample_shunt_voltage);
+}
+
+/*
+ * @brief Returns the bus voltage of the latest completed sample in volts, as Q16.16.
+ *
+ */
+q16_t INA219::getSampleBusVoltage_Q16(void){
+	return (q16_t)qGainApply(INA219_BUS_VOLTAGE_LSB_Q16, INA219::BUS_VOLTAGE_FIELD::get(INA219::_sample_bus_voltage));
+}
+
+
 // --- Miscellaneous methods ------------------------------------------------------------
 
 /*
@@ -460,8 +709,12 @@ INA219::OPERATING_MODE INA219::getOperatingMode(void){
  *
  */
 bool INA219::reset(void){
-	// Set reset bit
-	HAL_StatusTypeDef error = INA219::LLW_16Bits(INA219::CONF, INA219::RESET_MASK);
+	// Set reset bit, this clears the calibration register too
+	HAL_StatusTypeDef error = INA219::LLW_16Bits(INA219::CONF, INA219::RESET_FIELD::mask());
+	INA219::_calibration_suspect = true;
+
+	// The configuration is back to default, read it again when needed
+	INA219::invalidateShadow(INA219::CONF);
 	if(error == HAL_OK) return true;
 
 	// Return failure as default
@@ -469,4 +722,254 @@ bool INA219::reset(void){
 }
 
 
+// --- Utility methods ------------------------------------------------------------------
+
+/*
+ * @brief Reads a 16 bit register, skipping the pointer write when streaming mode is on
+ * and the same register was addressed last (the device keeps its pointer). If the read
+ * fails the buffer gets the last good content of the register (the error is returned and
+ * counted in the bus statistics).
+ *
+ * @param register_address	Register to read;
+ * @param data_buffer		Buffer for the read data;
+ *
+ */
+HAL_StatusTypeDef INA219::readRegister(INA219::REGISTER register_address, uint16_t *data_buffer){
+	// Receive-only read if streaming, full register read otherwise
+	HAL_StatusTypeDef error;
+	if(INA219::_streaming) error = INA219::LLR_16Bits_Stream(register_address, data_buffer);
+	else error = INA219::LLR_16Bits(register_address, data_buffer);
+
+	// Keep the good content, or give back the last one
+	if(error == HAL_OK) INA219::_last_register[register_address] = *data_buffer;
+	else *data_buffer = INA219::_last_register[register_address];
+
+	// A bus error may hide a sensor reset: verify the calibration before trusting it again
+	if(error != HAL_OK) INA219::_calibration_suspect = true;
+
+	// Return error if any
+	return error;
+}
+
+/*
+ * @brief Drops the state cached before a bus recovery. The fault may hide a sensor
+ * reset, so the calibration is verified before the next current or power reading. In a
+ * triggered mode the configuration is kept, the next trigger writes it whole.
+ *
+ */
+void INA219::onBusRecovered(void){
+	// In a triggered mode every trigger writes the whole configuration, keep it
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint16_t configuration;
+	bool keep = INA219::_triggered && INA219::loadShadow(INA219::CONF, &configuration);
+
+	I2C_Device::onBusRecovered();
+	if(keep) INA219::storeShadow(INA219::CONF, configuration);
+
+	__set_PRIMASK(primask);
+
+	INA219::_calibration_suspect = true;
+}
+
+/*
+ * @brief Verifies the calibration if it is suspect or if the check period elapsed.
+ * Called before every current or power reading.
+ *
+ */
+void INA219::maintainCalibration(void){
+	// Count the sample
+	INA219::_samples_since_check++;
+
+	// Check only when needed
+	bool period_elapsed = INA219::_calibration_check_period != 0 &&
+			INA219::_samples_since_check >= INA219::_calibration_check_period;
+
+	if(INA219::_calibration_suspect || period_elapsed) INA219::checkCalibration();
+}
+
+/*
+ * @brief Returns the conversion time of a 4 bit ADC setting.
+ *
+ * @param resolution_code	ADC setting, right aligned;
+ *
+ */
+uint32_t INA219::conversionTime_us(uint16_t resolution_code){
+	return INA219_CONVERSION_TIME_US[resolution_code & 0x0F];
+}
+
+/*
+ * @brief Converts the current register to amps, as Q16.16 fixed-point.
+ *
+ * @param register_content	Current register;
+ *
+ */
+q16_t INA219::decodeCurrent_Q16(uint16_t register_content){
+	// Multiply by the current LSB and return the result
+	return (q16_t)qGainApply(INA219::_current_lsb_q16, (int16_t)register_content);
+}
+
+/*
+ * @brief Converts the bus voltage register to volts, as Q16.16 fixed-point.
+ *
+ * @param register_content	Bus voltage register, with its flags;
+ *
+ */
+q16_t INA219::decodeBusVoltage_Q16(uint16_t register_content){
+	// Checks flags: return -100 if overflow
+	if(INA219::OVF_FIELD::isSet(register_content)) return q16FromInt(-100);
+
+	// Remove flag bits, multiply by fixed 4 mV LSB and return result (see data-sheet page 23)
+	return (q16_t)qGainApply(INA219_BUS_VOLTAGE_LSB_Q16, INA219::BUS_VOLTAGE_FIELD::get(register_content));
+}
+
+
+// --- Triggered acquisition steps
+
+/*
+ * @brief Queues a read of the bus voltage register to check the CNVR flag.
+ *
+ */
+bool INA219::pollConversion(void){
+	INA219::_poll_count++;
+
+	HAL_StatusTypeDef error = INA219::LLR_Async(INA219::BUS_VOLTAGE, INA219::_async_buffer, 2, INA219::onBusVoltageRead, this);
+	if(error == HAL_OK) return true;
+
+	// Return failure as default
+	INA219::failAcquisition();
+	return false;
+}
+
+/*
+ * @brief Drops the running conversion. A bus error may hide a sensor reset, so the
+ * calibration is verified before the next blocking current reading.
+ *
+ */
+void INA219::failAcquisition(void){
+	INA219::_failed_samples++;
+	INA219::_calibration_suspect = true;
+	INA219::_acquisition_state = INA219::ACQUISITION_FAILED;
+}
+
+/*
+ * @brief Configuration written: the conversion is running.
+ *
+ */
+void INA219::onTriggerWritten(void *context, HAL_StatusTypeDef status){
+	INA219 *sensor = (INA219 *)context;
+	if(status != HAL_OK){
+		sensor->failAcquisition();
+		return;
+	}
+
+	sensor->_conversion_cycles = cycleCounterRead();
+	sensor->_poll_count = 0;
+	sensor->_acquisition_state = INA219::ACQUISITION_CONVERTING;
+
+	// Poll now or wait for collect()
+	if(sensor->_collect_requested){
+		sensor->_polling = true;
+		sensor->pollConversion();
+	}
+}
+
+/*
+ * @brief Bus voltage read: poll again until CNVR is set, then read the shunt voltage.
+ *
+ */
+void INA219::onBusVoltageRead(void *context, HAL_StatusTypeDef status){
+	INA219 *sensor = (INA219 *)context;
+	if(status != HAL_OK){
+		sensor->failAcquisition();
+		return;
+	}
+
+	uint16_t register_content = sensor->concat_8to16Bits(sensor->_async_buffer);
+
+	// If not converted yet poll again, up to the limit
+	if(!INA219::CNVR_FIELD::isSet(register_content)){
+		if(sensor->_poll_count >= INA219_TRIGGER_MAX_POLLS) sensor->failAcquisition();
+		else {
+			sensor->_statistics.recordRetry();
+			sensor->pollConversion();
+		}
+		return;
+	}
+
+	// Conversion time as seen on the bus (resolution of one register read)
+	uint16_t latency = cycleCounterElapsed(sensor->_conversion_cycles) / (SystemCoreClock / 1000000);
+	sensor->_conversion_latency = latency;
+	if(latency > sensor->_max_conversion_latency) sensor->_max_conversion_latency = latency;
+
+	sensor->_sample_bus_voltage = register_content;
+	sensor->_acquisition_state = INA219::ACQUISITION_READING;
+
+	HAL_StatusTypeDef error = sensor->LLR_Async(INA219::SHUNT_VOLTAGE, sensor->_async_buffer, 2, INA219::onShuntVoltageRead, sensor);
+	if(error != HAL_OK) sensor->failAcquisition();
+}
+
+/*
+ * @brief Shunt voltage read: the sample is complete.
+ *
+ */
+void INA219::onShuntVoltageRead(void *context, HAL_StatusTypeDef status){
+	INA219 *sensor = (INA219 *)context;
+	if(status != HAL_OK){
+		sensor->failAcquisition();
+		return;
+	}
+
+	sensor->_sample_shunt_voltage = (int16_t)sensor->concat_8to16Bits(sensor->_async_buffer);
+	sensor->_sample_latency = cycleCounterElapsed(sensor->_trigger_cycles) / (SystemCoreClock / 1000000);
+
+	sensor->_completed_samples++;
+	sensor->_acquisition_state = INA219::ACQUISITION_READY;
+}
+
+
+
+// --- Asynchronous read steps
+
+/*
+ * @brief Current handle read. The handle is released before it completes, so its
+ * callback can start the next read.
+ *
+ */
+void INA219::onCurrentResult(void *context, HAL_StatusTypeDef status){
+	INA219 *sensor = (INA219 *)context;
+
+	Async_Result<q16_t> *result = sensor->_current_result;
+	sensor->_current_result = nullptr;
+	if(result == nullptr) return;
+
+	if(status != HAL_OK){
+		result->fail(status);
+		return;
+	}
+
+	result->complete(sensor->decodeCurrent_Q16(sensor->concat_8to16Bits(sensor->_current_result_buffer)));
+}
+
+/*
+ * @brief Bus voltage handle read.
+ *
+ */
+void INA219::onBusVoltageResult(void *context, HAL_StatusTypeDef status){
+	INA219 *sensor = (INA219 *)context;
+
+	Async_Result<q16_t> *result = sensor->_bus_voltage_result;
+	sensor->_bus_voltage_result = nullptr;
+	if(result == nullptr) return;
+
+	if(status != HAL_OK){
+		result->fail(status);
+		return;
+	}
+
+	result->complete(INA219::decodeBusVoltage_Q16(sensor->concat_8to16Bits(sensor->_bus_voltage_result_buffer)));
+}
+
+
 // END OF FILE
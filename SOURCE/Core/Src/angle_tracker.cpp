@@ -0,0 +1,142 @@
+/*
+ * angle_tracker.cpp
+ *
+ * Implementation of angle_tracker.hpp header file.
+ *
+ */
+
+#include "angle_tracker.hpp"
+
+#include <math.h>
+
+
+
+// ----------------------------------------------- Angle_Tracker class implementation ---
+
+// --- Tracker constructor --------------------------------------------------------------
+
+/*
+ * @brief Constructs the tracking loop. The first update() sets the starting angle.
+ *
+ * @param sample_rate	Rate of the update() calls [Hz];
+ * @param bandwidth		Loop bandwidth [rad/s];
+ *
+ */
+Angle_Tracker::Angle_Tracker(float sample_rate, float bandwidth) :
+		_sample_rate(sample_rate),
+		_initialized(false),
+		_angle(0),
+		_velocity(0),
+		_acceleration(0)
+	{
+		// Output conversions, 2pi / 4096 rad per count
+		float radians_per_count = 6.2831853f / ANGLE_TRACKER_COUNTS;
+
+		Angle_Tracker::_to_velocity = qGainFromFloat(radians_per_count * sample_rate);
+		Angle_Tracker::_to_acceleration = qGainFromFloat(radians_per_count * sample_rate * sample_rate / 65536);
+
+		Angle_Tracker::setBandwidth(bandwidth);
+	}
+
+
+// --- Tracker core methods -------------------------------------------------------------
+
+/*
+ * @brief Runs one step of the loop on a new reading.
+ *
+ * @param counts	12-bit angle reading [counts];
+ *
+ */
+void Angle_Tracker::update(uint16_t counts){
+	// If first sample start from it
+	if(!Angle_Tracker::_initialized){
+		Angle_Tracker::reset(counts);
+		return;
+	}
+
+	// Compute error in Q16.16 counts, the shortest way round
+	int32_t error = ((int32_t)(counts & 0x0FFF) << 16) - (int32_t)(Angle_Tracker::_angle >> 16);
+	if(error >= (ANGLE_TRACKER_COUNTS / 2) << 16) error -= ANGLE_TRACKER_COUNTS << 16;
+	if(error < -((ANGLE_TRACKER_COUNTS / 2) << 16)) error += ANGLE_TRACKER_COUNTS << 16;
+
+	// Integrator chain
+	Angle_Tracker::_acceleration += qGainApplyQ32(Angle_Tracker::_gain_acceleration, error);
+	Angle_Tracker::_velocity += Angle_Tracker::_acceleration + qGainApplyQ32(Angle_Tracker::_gain_velocity, error);
+	Angle_Tracker::_angle += Angle_Tracker::_velocity + qGainApplyQ32(Angle_Tracker::_gain_angle, error);
+
+	// Keep the angle in one turn
+	const int64_t turn = (int64_t)ANGLE_TRACKER_COUNTS << 32;
+	if(Angle_Tracker::_angle >= turn) Angle_Tracker::_angle -= turn;
+	if(Angle_Tracker::_angle < 0) Angle_Tracker::_angle += turn;
+}
+
+/*
+ * @brief Restarts the loop from a reading, at standstill.
+ *
+ * @param counts	12-bit angle reading [counts];
+ *
+ */
+void Angle_Tracker::reset(uint16_t counts){
+	Angle_Tracker::_angle = (int64_t)(counts & 0x0FFF) << 32;
+	Angle_Tracker::_velocity = 0;
+	Angle_Tracker::_acceleration = 0;
+	Angle_Tracker::_initialized = true;
+}
+
+
+// --- Tracker parameters ---------------------------------------------------------------
+
+/*
+ * @brief Sets the loop bandwidth (gains converted here, not in the update), a triple pole
+ * at exp(-bandwidth * Ts). Returns false if it is too high for the sample rate, leaving
+ * the previous one.
+ *
+ * @param bandwidth		Loop bandwidth [rad/s];
+ *
+ */
+bool Angle_Tracker::setBandwidth(float bandwidth){
+	float x = bandwidth / Angle_Tracker::_sample_rate;
+	if(x <= 0 || x > ANGLE_TRACKER_MAX_NORMALIZED) return false;
+
+	Angle_Tracker::_bandwidth = bandwidth;
+
+	float q = 1 - expf(-x);
+
+	Angle_Tracker::_gain_angle = qGainFromFloat(3 * q - 3 * q * q + q * q * q);
+	Angle_Tracker::_gain_velocity = qGainFromFloat(3 * q * q - 2 * q * q * q);
+	Angle_Tracker::_gain_acceleration = qGainFromFloat(q * q * q);
+
+	return true;
+}
+
+
+// --- Getter methods -------------------------------------------------------------------
+
+/*
+ * @brief Returns the tracked angle in radians.
+ *
+ */
+q16_t Angle_Tracker::getAngle(void){
+	return (q16_t)(((Angle_Tracker::_angle >> 16) * 411775) >> 28);		// Counts (Q16) * 2pi (Q16) / 4096
+}
+
+/*
+ * @brief Returns the tracked velocity in radians per second.
+ *
+ */
+q16_t Angle_Tracker::getVelocity(void){
+	q16_t velocity = q16Clamp(Angle_Tracker::_velocity >> 16, Q16_MAX);
+	return q16Clamp(qGainApply(Angle_Tracker::_to_velocity, velocity), Q16_MAX);
+}
+
+/*
+ * @brief Returns the tracked acceleration in radians per second squared.
+ *
+ */
+q16_t Angle_Tracker::getAcceleration(void){
+	q16_t acceleration = q16Clamp(Angle_Tracker::_acceleration, Q16_MAX);
+	return q16Clamp(qGainApply(Angle_Tracker::_to_acceleration, acceleration), Q16_MAX);
+}
+
+
+// END OF FILE
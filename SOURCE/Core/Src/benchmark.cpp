@@ -0,0 +1,73 @@
+/*
+ * benchmark.cpp
+ *
+ * Implementation of benchmark.hpp header file.
+ *
+ */
+
+#include "benchmark.hpp"
+
+
+
+// --------------------------------------------------- Benchmark class implementation ---
+
+// --- Benchmark constructor ------------------------------------------------------------
+
+/*
+ * @brief Constructs a probe. The cycle counter must be started with cycleCounterBegin()
+ * before the first measurement.
+ *
+ * @param name	Label shown in the debugger;
+ *
+ */
+Benchmark::Benchmark(const char *name) :
+		_name(name),
+		_start(0)
+	{
+		Benchmark::resetStatistics();
+	}
+
+
+// --- Measurement methods --------------------------------------------------------------
+
+/*
+ * @brief Ends the measurement started with start() and updates the statistics.
+ *
+ */
+void Benchmark::stop(void){
+	uint32_t elapsed = cycleCounterElapsed(Benchmark::_start);
+
+	Benchmark::_last = elapsed;
+	Benchmark::_count++;
+	Benchmark::_total += elapsed;
+
+	if(elapsed < Benchmark::_min) Benchmark::_min = elapsed;
+	if(elapsed > Benchmark::_max) Benchmark::_max = elapsed;
+}
+
+/*
+ * @brief Clears the statistics.
+ *
+ */
+void Benchmark::resetStatistics(void){
+	Benchmark::_count = 0;
+	Benchmark::_last = 0;
+	Benchmark::_min = UINT32_MAX;
+	Benchmark::_max = 0;
+	Benchmark::_total = 0;
+}
+
+
+// --- Getter methods -------------------------------------------------------------------
+
+/*
+ * @brief Returns the average duration of the measurements.
+ *
+ */
+uint32_t Benchmark::getAvgCycles(void){
+	if(Benchmark::_count == 0) return 0;
+	return (uint32_t)(Benchmark::_total / Benchmark::_count);
+}
+
+
+// END OF FILE
@@ -0,0 +1,100 @@
+/*
+ * cascade_controller.cpp
+ *
+ * Implementation of cascade_controller.hpp header file.
+ *
+ */
+
+#include "cascade_controller.hpp"
+
+
+
+// ------------------------------------------ Cascade_Controller class implementation ---
+
+// --- Controller constructor -----------------------------------------------------------
+
+/*
+ * @brief Constructs the cascaded controller with the default tuning, disabled.
+ *
+ * @param sampling_time	Time between updates [s];
+ *
+ */
+Cascade_Controller::Cascade_Controller(float sampling_time) :
+		_mode(Cascade_Controller::DISABLED),
+		_position_kp(qGainFromFloat(POSITION_KP)),
+		_speed_limit(q16FromFloat(SATURATION_SPEED)),
+		_speed_loop(SPEED_KP, SPEED_KI, sampling_time, SATURATION_CURRENT),
+		_current_loop(CURRENT_KP, CURRENT_KI, sampling_time, SATURATION_DUTY),
+		_position_reference(0),
+		_speed_reference(0),
+		_current_reference(0),
+		_duty(0)
+	{}
+
+
+// --- Controller core methods ----------------------------------------------------------
+
+/*
+ * @brief Runs the loops from the selected one inwards and returns the duty cycle.
+ * Call it once per control tick with the latest measurements.
+ *
+ * @param position	Output shaft angle [rad];
+ * @param speed		Motor speed [rad/s];
+ * @param current	Motor current [A];
+ *
+ */
+q16_t Cascade_Controller::update(q16_t position, q16_t speed, q16_t current){
+	// If disabled force zero output
+	if(Cascade_Controller::_mode == Cascade_Controller::DISABLED){
+		Cascade_Controller::_duty = 0;
+		return 0;
+	}
+
+	// Position loop (proportional), gives the speed reference
+	if(Cascade_Controller::_mode == Cascade_Controller::POSITION){
+		int64_t error = (int64_t)Cascade_Controller::_position_reference - position;
+		int64_t speed_reference = ((int64_t)Cascade_Controller::_position_kp.mantissa * error) >> Cascade_Controller::_position_kp.shift;
+		Cascade_Controller::_speed_reference = q16Clamp(speed_reference, Cascade_Controller::_speed_limit);
+	}
+
+	// Speed loop, gives the current reference
+	if(Cascade_Controller::_mode >= Cascade_Controller::SPEED){
+		Cascade_Controller::_current_reference = Cascade_Controller::_speed_loop.update(Cascade_Controller::_speed_reference, speed);
+	}
+
+	// Current loop, gives the duty cycle
+	Cascade_Controller::_duty = Cascade_Controller::_current_loop.update(Cascade_Controller::_current_reference, current);
+
+	return Cascade_Controller::_duty;
+}
+
+/*
+ * @brief Clears the integrators and the output.
+ *
+ */
+void Cascade_Controller::reset(void){
+	Cascade_Controller::_speed_loop.reset();
+	Cascade_Controller::_current_loop.reset();
+
+	Cascade_Controller::_duty = 0;
+}
+
+
+// --- Mode and references --------------------------------------------------------------
+
+/*
+ * @brief Changes the outermost loop. Integrators restart from zero.
+ *
+ * @param mode	Loop to close;
+ *
+ */
+void Cascade_Controller::setMode(Cascade_Controller::MODE mode){
+	// If nothing changes keep the state
+	if(mode == Cascade_Controller::_mode) return;
+
+	Cascade_Controller::_mode = mode;
+	Cascade_Controller::reset();
+}
+
+
+// END OF FILE
@@ -0,0 +1,303 @@
+/*
+ * control_tick.cpp
+ *
+ * Implementation of control_tick.hpp header file.
+ *
+ */
+
+#include "control_tick.hpp"
+
+
+
+// --- Static variables -----------------------------------------------------------------
+
+Control_Tick *Control_Tick::_control_ticks[CONTROL_TICK_MAX_COUNT] = {};
+
+
+
+// ------------------------------------------------ Control_Tick class implementation ---
+
+// --- Tick constructor -----------------------------------------------------------------
+
+/*
+ * @brief Constructs a control tick. Call begin() once the timer is initialised.
+ *
+ * @param timer_handle	Timer handle object, counting at 1 MHz;
+ *
+ */
+Control_Tick::Control_Tick(TIM_HandleTypeDef *timer_handle) :
+		_timer_handle(timer_handle),
+		_pending(false),
+		_running(false),
+		_ticks(0),
+		_overruns(0)
+	{
+		for(uint8_t i = 0; i < CONTROL_TICK_MAX_HOOKS; i++){
+			Control_Tick::_phases[i] = 0;
+			Control_Tick::_phase_hooks[i] = nullptr;
+			Control_Tick::_phase_contexts[i] = nullptr;
+		}
+
+		Control_Tick::resetStatistics();
+	}
+
+/*
+ * @brief Unregisters the tick, the timer callbacks no longer reach it.
+ *
+ */
+Control_Tick::~Control_Tick(){
+	for(uint8_t i = 0; i < CONTROL_TICK_MAX_COUNT; i++){
+		if(Control_Tick::_control_ticks[i] == this) Control_Tick::_control_ticks[i] = nullptr;
+	}
+}
+
+
+// --- Tick core methods ----------------------------------------------------------------
+
+/*
+ * @brief Registers the tick and starts the timer with its update interrupt.
+ *
+ */
+bool Control_Tick::begin(void){
+	// Take the first free slot
+	bool registered = false;
+	for(uint8_t i = 0; i < CONTROL_TICK_MAX_COUNT && !registered; i++){
+		if(Control_Tick::_control_ticks[i] == nullptr || Control_Tick::_control_ticks[i] == this){
+			Control_Tick::_control_ticks[i] = this;
+			registered = true;
+		}
+	}
+	if(!registered) return false;
+
+	// Start the timer
+	HAL_StatusTypeDef error = HAL_TIM_Base_Start_IT(Control_Tick::_timer_handle);
+	if(error == HAL_OK) return true;
+
+	// Return failure as default
+	return false;
+}
+
+/*
+ * @brief Sleeps until the timer event, then records how late the tick starts.
+ *
+ */
+void Control_Tick::wait(void){
+	// Sleep until the interrupt marks a tick (interrupts masked so the check and the
+	// sleep cannot miss the event, a pending interrupt still wakes the core)
+	__disable_irq();
+	while(!Control_Tick::_pending){
+		__WFI();
+		__enable_irq();
+		__disable_irq();
+	}
+	__enable_irq();
+
+	// Time since the update event, the counter restarts from zero on every period
+	uint16_t latency = __HAL_TIM_GET_COUNTER(Control_Tick::_timer_handle);
+
+	Control_Tick::_pending = false;
+	Control_Tick::_running = true;
+
+	// Update statistics
+	if(latency < Control_Tick::_min_latency) Control_Tick::_min_latency = latency;
+	if(latency > Control_Tick::_max_latency) Control_Tick::_max_latency = latency;
+	Control_Tick::_latency_sum += latency;
+	Control_Tick::_latency_samples++;
+}
+
+/*
+ * @brief Marks the end of the tick work and records the execution time. If the next
+ * timer event already happened the tick is counted as an overrun by the interrupt.
+ *
+ */
+void Control_Tick::done(void){
+	// Time since the update event, valid only if no other event happened
+	uint16_t execution = __HAL_TIM_GET_COUNTER(Control_Tick::_timer_handle);
+
+	Control_Tick::_running = false;
+
+	// If overrun the execution is at least a full period
+	if(Control_Tick::_pending) execution = Control_Tick::getPeriod_us();
+
+	Control_Tick::_last_execution = execution;
+	if(execution > Control_Tick::_max_execution) Control_Tick::_max_execution = execution;
+}
+
+
+// --- Phase hook -----------------------------------------------------------------------
+
+/*
+ * @brief Runs a function at a fixed point of every period, from the interrupt of a
+ * compare channel (left frozen, no pin is driven). Replaces the previous hook of the
+ * channel.
+ *
+ * @param channel	Compare channel, 1 to 4;
+ * @param phase_us	Delay from the timer update event, less than the period [us];
+ * @param hook		Function to run, in interrupt context;
+ * @param context	Argument passed to the function;
+ *
+ */
+bool Control_Tick::setPhaseHook(uint8_t channel, uint16_t phase_us, Control_Tick::Hook hook, void *context){
+	// Refuse a missing channel or a phase outside the period
+	if(channel < 1 || channel > CONTROL_TICK_MAX_HOOKS) return false;
+	if(hook == nullptr || phase_us >= Control_Tick::getPeriod_us()) return false;
+
+	uint8_t index = channel - 1;
+
+	// Stop the previous hook before swapping it
+	__HAL_TIM_DISABLE_IT(Control_Tick::_timer_handle, TIM_IT_CC1 << index);
+
+	Control_Tick::_phases[index] = phase_us;
+	Control_Tick::_phase_hooks[index] = hook;
+	Control_Tick::_phase_contexts[index] = context;
+
+	// Set the compare value, clear a stale match and enable the interrupt
+	__HAL_TIM_SET_COMPARE(Control_Tick::_timer_handle, TIM_CHANNEL_1 + 4 * index, phase_us);
+	__HAL_TIM_CLEAR_FLAG(Control_Tick::_timer_handle, TIM_FLAG_CC1 << index);
+	__HAL_TIM_ENABLE_IT(Control_Tick::_timer_handle, TIM_IT_CC1 << index);
+
+	return true;
+}
+
+/*
+ * @brief Stops the phase hook of a channel.
+ *
+ * @param channel	Compare channel, 1 to 4;
+ *
+ */
+void Control_Tick::clearPhaseHook(uint8_t channel){
+	if(channel < 1 || channel > CONTROL_TICK_MAX_HOOKS) return;
+
+	uint8_t index = channel - 1;
+	__HAL_TIM_DISABLE_IT(Control_Tick::_timer_handle, TIM_IT_CC1 << index);
+
+	Control_Tick::_phase_hooks[index] = nullptr;
+	Control_Tick::_phase_contexts[index] = nullptr;
+}
+
+/*
+ * @brief Returns the phase of a channel hook.
+ *
+ * @param channel	Compare channel, 1 to 4;
+ *
+ */
+uint16_t Control_Tick::getPhase_us(uint8_t channel){
+	if(channel < 1 || channel > CONTROL_TICK_MAX_HOOKS) return 0;
+
+	return Control_Tick::_phases[channel - 1];
+}
+
+
+// --- Timing statistics ----------------------------------------------------------------
+
+/*
+ * @brief Returns the average delay between the timer event and the tick start.
+ *
+ */
+uint16_t Control_Tick::getAverageLatency_us(void){
+	// If no samples return zero
+	if(Control_Tick::_latency_samples == 0) return 0;
+
+	return Control_Tick::_latency_sum / Control_Tick::_latency_samples;
+}
+
+/*
+ * @brief Returns the jitter of the tick start, as the spread between the earliest and
+ * the latest start after the timer event.
+ *
+ */
+uint16_t Control_Tick::getJitter_us(void){
+	// If no samples return zero
+	if(Control_Tick::_latency_samples == 0) return 0;
+
+	return Control_Tick::_max_latency - Control_Tick::_min_latency;
+}
+
+/*
+ * @brief Clears the timing statistics (tick and overrun counters are kept).
+ *
+ */
+void Control_Tick::resetStatistics(void){
+	Control_Tick::_min_latency = 0xFFFF;
+	Control_Tick::_max_latency = 0;
+	Control_Tick::_latency_sum = 0;
+	Control_Tick::_latency_samples = 0;
+
+	Control_Tick::_last_execution = 0;
+	Control_Tick::_max_execution = 0;
+}
+
+
+// --- Interrupt hooks ------------------------------------------------------------------
+
+/*
+ * @brief Marks a new tick. If the previous one is still pending or running it is
+ * counted as an overrun.
+ *
+ */
+void Control_Tick::onTimerUpdate(void){
+	if(Control_Tick::_pending || Control_Tick::_running) Control_Tick::_overruns++;
+
+	Control_Tick::_ticks++;
+	Control_Tick::_pending = true;
+}
+
+/*
+ * @brief Runs the phase hook of a channel, if any.
+ *
+ * @param channel	Compare channel, 1 to 4;
+ *
+ */
+void Control_Tick::onTimerCompare(uint8_t channel){
+	if(channel < 1 || channel > CONTROL_TICK_MAX_HOOKS) return;
+
+	Control_Tick::Hook hook = Control_Tick::_phase_hooks[channel - 1];
+	if(hook != nullptr) hook(Control_Tick::_phase_contexts[channel - 1]);
+}
+
+/*
+ * @brief Finds the tick registered for a timer handle.
+ *
+ * @param timer_handle	Timer handle object;
+ *
+ */
+Control_Tick *Control_Tick::getTick(TIM_HandleTypeDef *timer_handle){
+	for(uint8_t i = 0; i < CONTROL_TICK_MAX_COUNT; i++){
+		if(Control_Tick::_control_ticks[i] != nullptr && Control_Tick::_control_ticks[i]->_timer_handle == timer_handle) return Control_Tick::_control_ticks[i];
+	}
+
+	// Return nothing as default
+	return nullptr;
+}
+
+
+
+// -------------------------------------------------------------------- HAL callbacks ---
+
+// Weak HAL callbacks overridden to dispatch the update and compare events to the right tick
+
+extern "C" {
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim){
+	Control_Tick *tick = Control_Tick::getTick(htim);
+	if(tick != nullptr) tick->onTimerUpdate();
+}
+
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim){
+	Control_Tick *tick = Control_Tick::getTick(htim);
+	if(tick == nullptr) return;
+
+	// Dispatch by compare channel
+	switch(htim->Channel){
+		case HAL_TIM_ACTIVE_CHANNEL_1: tick->onTimerCompare(1); break;
+		case HAL_TIM_ACTIVE_CHANNEL_2: tick->onTimerCompare(2); break;
+		case HAL_TIM_ACTIVE_CHANNEL_3: tick->onTimerCompare(3); break;
+		case HAL_TIM_ACTIVE_CHANNEL_4: tick->onTimerCompare(4); break;
+		default: break;
+	}
+}
+
+}
+
+
+// END OF FILE
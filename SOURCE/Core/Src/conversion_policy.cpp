@@ -0,0 +1,135 @@
+/*
+ * conversion_policy.cpp
+ *
+ * Implementation of conversion_policy.hpp header file.
+ *
+ */
+
+#include "conversion_policy.hpp"
+
+
+
+// --- Static variables -----------------------------------------------------------------
+
+const Conversion_Policy::Profile_Settings Conversion_Policy::_settings[4] = {
+		{INA219::SHUNT_ADC_9_BITS, INA219::BUS_ADC_9_BITS},			// FAST
+		{INA219::SHUNT_ADC_10_BITS, INA219::BUS_ADC_9_BITS},		// NORMAL
+		{INA219::SHUNT_ADC_4_SMPL, INA219::BUS_ADC_9_BITS},			// HOLD
+		{INA219::SHUNT_ADC_32_SMPL, INA219::BUS_ADC_32_SMPL},		// MONITOR
+};
+
+
+
+// ------------------------------------------- Conversion_Policy class implementation ---
+
+// --- Policy constructor ---------------------------------------------------------------
+
+/*
+ * @brief Constructs the policy. The stage keeps its settings until the first switch.
+ *
+ * @param stage		Power stage to drive;
+ *
+ */
+Conversion_Policy::Conversion_Policy(Motor_Power_Stage &stage) :
+		_stage(stage),
+		_profile(Conversion_Policy::NORMAL),
+		_candidate(Conversion_Policy::NORMAL),
+		_candidate_ticks(0),
+		_overridden(false),
+		_switches(0)
+	{}
+
+
+// --- Policy core methods --------------------------------------------------------------
+
+/*
+ * @brief Classifies the controller state and switches the profile if needed. Call it
+ * once per tick, after the controller update.
+ *
+ * @param controller	Controller in use;
+ * @param speed			Motor speed [rad/s];
+ * @param current		Motor current [A];
+ *
+ */
+bool Conversion_Policy::update(Cascade_Controller &controller, q16_t speed, q16_t current){
+	// If overridden keep the profile
+	if(Conversion_Policy::_overridden) return false;
+
+	// Classify the state
+	Conversion_Policy::PROFILE wanted = Conversion_Policy::NORMAL;
+
+	Cascade_Controller::MODE mode = controller.getMode();
+	q16_t current_error = controller.getCurrentReference() - current;
+	q16_t speed_reference = controller.getSpeedReference();
+
+	if(mode == Cascade_Controller::DISABLED) wanted = Conversion_Policy::MONITOR;
+	else if(current_error > CONVERSION_POLICY_TRANSIENT_CURRENT || current_error < -CONVERSION_POLICY_TRANSIENT_CURRENT){
+		wanted = Conversion_Policy::FAST;
+	}
+	else if(mode == Cascade_Controller::POSITION &&
+			speed_reference < CONVERSION_POLICY_HOLD_SPEED && speed_reference > -CONVERSION_POLICY_HOLD_SPEED &&
+			speed < CONVERSION_POLICY_HOLD_SPEED && speed > -CONVERSION_POLICY_HOLD_SPEED){
+		wanted = Conversion_Policy::HOLD;
+	}
+
+	// Faster settings at once
+	if(wanted < Conversion_Policy::_profile){
+		Conversion_Policy::_candidate = wanted;
+		Conversion_Policy::_candidate_ticks = 0;
+		return Conversion_Policy::apply(wanted);
+	}
+
+	// Slower settings once the state lasted long enough
+	if(wanted == Conversion_Policy::_profile){
+		Conversion_Policy::_candidate_ticks = 0;
+		return false;
+	}
+
+	if(wanted != Conversion_Policy::_candidate){
+		Conversion_Policy::_candidate = wanted;
+		Conversion_Policy::_candidate_ticks = 0;
+	}
+	Conversion_Policy::_candidate_ticks++;
+
+	uint16_t delay = wanted == Conversion_Policy::NORMAL ? CONVERSION_POLICY_SETTLE_TICKS : CONVERSION_POLICY_HOLD_TICKS;
+	if(Conversion_Policy::_candidate_ticks < delay) return false;
+
+	Conversion_Policy::_candidate_ticks = 0;
+	return Conversion_Policy::apply(wanted);
+}
+
+/*
+ * @brief Applies a fixed profile until clearOverride().
+ *
+ * @param profile	Profile to apply;
+ *
+ */
+void Conversion_Policy::setOverride(Conversion_Policy::PROFILE profile){
+	Conversion_Policy::_overridden = true;
+	Conversion_Policy::apply(profile);
+}
+
+
+// --- Utility methods ------------------------------------------------------------------
+
+/*
+ * @brief Pushes the settings of a profile to the stage, if different from the applied
+ * ones.
+ *
+ * @param profile	Profile to apply;
+ *
+ */
+bool Conversion_Policy::apply(Conversion_Policy::PROFILE profile){
+	if(profile == Conversion_Policy::_profile) return false;
+
+	const Conversion_Policy::Profile_Settings &settings = Conversion_Policy::_settings[profile];
+	if(!Conversion_Policy::_stage.setConversion(settings.shunt, settings.bus)) return false;
+
+	Conversion_Policy::_profile = profile;
+	Conversion_Policy::_switches++;
+
+	return true;
+}
+
+
+// END OF FILE
@@ -0,0 +1,657 @@
+/*
+ * i2c_bus.cpp
+ *
+ * Implementation of i2c_bus.hpp header file.
+ *
+ */
+
+#include "i2c_bus.hpp"
+
+#include "cycle_counter.hpp"
+
+#include <string.h>
+
+
+
+// --- Static variables -----------------------------------------------------------------
+
+I2C_Bus *I2C_Bus::_buses[I2C_BUS_MAX_COUNT] = {};
+
+
+
+// ----------------------------------------------------- I2C_Bus class implementation ---
+
+// --- Bus constructor ------------------------------------------------------------------
+
+/*
+ * @brief Constructs an asynchronous transaction engine for an I2C peripheral.
+ * Call begin() once the peripheral is initialised.
+ *
+ * @param bus_handle	I2C bus handle object;
+ * @param mode			Transfer mode used for the data phase;
+ *
+ */
+I2C_Bus::I2C_Bus(I2C_HandleTypeDef *bus_handle, I2C_Bus::TRANSFER_MODE mode) :
+		_bus_handle(bus_handle),
+		_mode(mode),
+		_head(0),
+		_tail(0),
+		_count(0),
+		_busy(false),
+		_holds(0),
+		_start_cycles(0),
+		_completed(0),
+		_errors(0),
+		_idle_callback(nullptr),
+		_idle_context(nullptr),
+		_recovering(false),
+		_fault(false),
+		_recovery_stage(I2C_Bus::RECOVERY_NONE),
+		_recoveries(0),
+		_recovery_failures(0),
+		_last_recovery_us(0),
+		_max_recovery_us(0)
+	{}
+
+/*
+ * @brief Unregisters the bus, the HAL callbacks no longer reach it.
+ *
+ */
+I2C_Bus::~I2C_Bus(){
+	for(uint8_t i = 0; i < I2C_BUS_MAX_COUNT; i++){
+		if(I2C_Bus::_buses[i] == this) I2C_Bus::_buses[i] = nullptr;
+	}
+}
+
+
+// --- Bus core methods -----------------------------------------------------------------
+
+/*
+ * @brief Registers the bus, so that the HAL callbacks can reach it.
+ *
+ */
+bool I2C_Bus::begin(void){
+	// Check if the handle is already registered
+	for(uint8_t i = 0; i < I2C_BUS_MAX_COUNT; i++){
+		if(I2C_Bus::_buses[i] == this) return true;
+		if(I2C_Bus::_buses[i] != nullptr && I2C_Bus::_buses[i]->_bus_handle == I2C_Bus::_bus_handle) return false;
+	}
+
+	// Take the first free slot
+	for(uint8_t i = 0; i < I2C_BUS_MAX_COUNT; i++){
+		if(I2C_Bus::_buses[i] == nullptr){
+			I2C_Bus::_buses[i] = this;
+			return true;
+		}
+	}
+
+	// Return failure as default
+	return false;
+}
+
+/*
+ * @brief Queues a transaction. The transaction is copied, short writes (up to
+ * I2C_BUS_PAYLOAD_SIZE bytes) can pass the data in the payload field instead of a buffer.
+ * Read buffers must stay valid until the callback is called.
+ *
+ * @param transaction	Transaction to queue;
+ *
+ */
+HAL_StatusTypeDef I2C_Bus::submit(I2C_Bus::Transaction *transaction){
+	// Refuse empty transfers and long writes without a buffer
+	if(transaction->length == 0) return HAL_ERROR;
+	if(transaction->data_buffer == nullptr){
+		if(transaction->direction == I2C_Bus::READ) return HAL_ERROR;
+		if(transaction->length > I2C_BUS_PAYLOAD_SIZE) return HAL_ERROR;
+	}
+
+	// The queue is shared with the interrupts
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	// If the queue is full return busy
+	if(I2C_Bus::_count >= I2C_BUS_QUEUE_SIZE){
+		__set_PRIMASK(primask);
+		return HAL_BUSY;
+	}
+
+	// Copy the transaction in the queue
+	memcpy(&I2C_Bus::_queue[I2C_Bus::_head], transaction, sizeof(I2C_Bus::Transaction));
+	I2C_Bus::_head = (I2C_Bus::_head + 1) % I2C_BUS_QUEUE_SIZE;
+	I2C_Bus::_count++;
+
+	// If the bus is idle start right away
+	if(!I2C_Bus::_busy) I2C_Bus::startNext();
+
+	__set_PRIMASK(primask);
+	return HAL_OK;
+}
+
+/*
+ * @brief Restarts the queue if a transfer could not start because the peripheral was
+ * busy with a blocking call or its BUSY flag was set, and recovers the bus if it is
+ * stuck or a transfer never completed. Call it periodically from the main loop.
+ *
+ */
+void I2C_Bus::service(void){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	// Look for a stuck bus or a lost completion interrupt
+	uint32_t timeout = I2C_BUS_TRANSFER_TIMEOUT_US * (SystemCoreClock / 1000000);
+	bool hung = I2C_Bus::_busy && cycleCounterElapsed(I2C_Bus::_start_cycles) > timeout;
+	bool fault = I2C_Bus::_fault;
+	bool waiting = !I2C_Bus::_busy && I2C_Bus::_count > 0 && I2C_Bus::_holds == 0;
+
+	__set_PRIMASK(primask);
+
+	// A queue left waiting by the interrupts: the flag is given time to clear here
+	if(!hung && !fault && waiting && I2C_Bus::isStuck()) fault = true;
+
+	if(hung || fault) I2C_Bus::recover();
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(!I2C_Bus::_busy && I2C_Bus::_count > 0) I2C_Bus::startNext();
+
+	__set_PRIMASK(primask);
+}
+
+
+// --- Blocking transfer hold -----------------------------------------------------------
+
+/*
+ * @brief Holds the queue before a blocking transfer on the same peripheral: the
+ * interrupts no longer start queued transfers, so none enters the HAL while the blocking
+ * call is in it. Waits for the transfer on the wire up to I2C_BUS_TRANSFER_TIMEOUT_US,
+ * on timeout the queue is released and false returned. Pair with release(), not from the
+ * I2C interrupts.
+ *
+ */
+bool I2C_Bus::acquire(void){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	I2C_Bus::_holds++;
+
+	__set_PRIMASK(primask);
+
+	// Wait for the transfer on the wire
+	uint32_t start = cycleCounterRead();
+	uint32_t timeout = I2C_BUS_TRANSFER_TIMEOUT_US * (SystemCoreClock / 1000000);
+
+	while(I2C_Bus::_busy){
+		if(cycleCounterElapsed(start) >= timeout){
+			I2C_Bus::release();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * @brief Ends a hold taken by acquire() and restarts the queue.
+ *
+ */
+void I2C_Bus::release(void){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(I2C_Bus::_holds > 0) I2C_Bus::_holds--;
+	if(I2C_Bus::_holds == 0 && !I2C_Bus::_busy && I2C_Bus::_count > 0) I2C_Bus::startNext();
+
+	__set_PRIMASK(primask);
+}
+
+/*
+ * @brief Sets a function called when the queue drains, after the callback of the last
+ * transaction (so transactions chained by that callback keep the bus busy).
+ *
+ * @param callback	Function to call, in interrupt context, nullptr to remove it;
+ * @param context	Argument passed to the function;
+ *
+ */
+void I2C_Bus::setIdleCallback(I2C_Bus::Callback callback, void *context){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	I2C_Bus::_idle_callback = callback;
+	I2C_Bus::_idle_context = context;
+
+	__set_PRIMASK(primask);
+}
+
+
+// --- Fault recovery -------------------------------------------------------------------
+
+/*
+ * @brief Checks if the bus is held with no transfer running. The BUSY flag stays set
+ * for a few microseconds after a STOP, so it is given I2C_BUS_RELEASE_TIMEOUT_US to
+ * clear.
+ *
+ */
+bool I2C_Bus::isStuck(void){
+	// A transfer in progress owns the flag
+	if(HAL_I2C_GetState(I2C_Bus::_bus_handle) != HAL_I2C_STATE_READY) return false;
+
+	uint32_t start = cycleCounterRead();
+	uint32_t timeout = I2C_BUS_RELEASE_TIMEOUT_US * (SystemCoreClock / 1000000);
+
+	while(__HAL_I2C_GET_FLAG(I2C_Bus::_bus_handle, I2C_FLAG_BUSY)){
+		if(cycleCounterElapsed(start) >= timeout) return true;
+	}
+
+	return false;
+}
+
+/*
+ * @brief Frees a stuck bus and re-initialises the peripheral. The queue is held during
+ * the recovery and restarted after it, a transfer that was on the wire completes with
+ * HAL_TIMEOUT. If the bus cannot be freed the queue is completed with HAL_ERROR and the
+ * bus stays faulted, so service() tries again on its next call.
+ * Takes at most I2C_BUS_RECOVERY_BUDGET_US plus the peripheral reset, thread mode only.
+ *
+ */
+bool I2C_Bus::recover(void){
+	// Refuse interrupt context, the recovery waits on the lines
+	if(__get_IPSR() != 0) return false;
+
+	uint32_t start = cycleCounterRead();
+	uint32_t budget = I2C_BUS_RECOVERY_BUDGET_US * (SystemCoreClock / 1000000);
+
+	// Hold the queue and release the peripheral
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	I2C_Bus::_recovering = true;
+	I2C_Bus::_recovery_stage = I2C_Bus::RECOVERY_RELEASE;
+
+	HAL_I2C_DeInit(I2C_Bus::_bus_handle);
+	if(I2C_Bus::_busy) I2C_Bus::finishTransaction(HAL_TIMEOUT);
+
+	__set_PRIMASK(primask);
+
+	// Free the lines within the budget
+	bool success = I2C_Bus::recoverLines(start, budget);
+
+	// Reset and re-initialise the peripheral (pins, DMA and interrupts through the MSP),
+	// the software reset also clears a BUSY flag latched by the analog filter
+	I2C_Bus::_recovery_stage = I2C_Bus::RECOVERY_RESET;
+	if(HAL_I2C_Init(I2C_Bus::_bus_handle) != HAL_OK) success = false;
+	if(__HAL_I2C_GET_FLAG(I2C_Bus::_bus_handle, I2C_FLAG_BUSY)) success = false;
+	if(success) I2C_Bus::_recovery_stage = I2C_Bus::RECOVERY_DONE;
+
+	// Update timing
+	uint32_t elapsed = cycleCounterElapsed(start) / (SystemCoreClock / 1000000);
+	I2C_Bus::_last_recovery_us = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+	if(I2C_Bus::_last_recovery_us > I2C_Bus::_max_recovery_us) I2C_Bus::_max_recovery_us = I2C_Bus::_last_recovery_us;
+
+	// Restart the queue, or drop it if the bus is still unusable
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	I2C_Bus::_recoveries++;
+	I2C_Bus::_recovering = false;
+	I2C_Bus::_fault = !success;
+
+	if(!success){
+		I2C_Bus::_recovery_failures++;
+		I2C_Bus::flush(HAL_ERROR);
+	}
+	else if(!I2C_Bus::_busy) I2C_Bus::startNext();
+
+	__set_PRIMASK(primask);
+
+	return success;
+}
+
+
+// --- Interrupt hooks ------------------------------------------------------------------
+
+/*
+ * @brief Completes the transaction on the wire and starts the next one.
+ *
+ * @param status	Result of the transfer;
+ *
+ */
+void I2C_Bus::onTransferComplete(HAL_StatusTypeDef status){
+	// Ignore events of transfers not started by the engine
+	if(!I2C_Bus::_busy) return;
+
+	I2C_Bus::finishTransaction(status);
+}
+
+/*
+ * @brief Finds the bus registered for a HAL handle.
+ *
+ * @param bus_handle	I2C bus handle object;
+ *
+ */
+I2C_Bus *I2C_Bus::getBus(I2C_HandleTypeDef *bus_handle){
+	for(uint8_t i = 0; i < I2C_BUS_MAX_COUNT; i++){
+		if(I2C_Bus::_buses[i] != nullptr && I2C_Bus::_buses[i]->_bus_handle == bus_handle) return I2C_Bus::_buses[i];
+	}
+
+	// Return nothing as default
+	return nullptr;
+}
+
+
+// --- Queue methods --------------------------------------------------------------------
+
+/*
+ * @brief Starts the transaction at the tail of the queue. Transactions that fail to
+ * start are completed with the error, a busy peripheral or a BUSY flag not released by
+ * a STOP is retried by service().
+ * Must be called with interrupts disabled or from the I2C interrupts.
+ *
+ */
+void I2C_Bus::startNext(void){
+	while(I2C_Bus::_count > 0){
+		// Hold the queue during recoveries and blocking transfers
+		if(I2C_Bus::_recovering || I2C_Bus::_fault || I2C_Bus::_holds > 0) break;
+
+		// Leave a held bus to service(), the HAL would wait 25 ms for the BUSY flag
+		if(!I2C_Bus::isReleasing()) break;
+
+		// Try to start the transfer
+		I2C_Bus::_start_cycles = cycleCounterRead();
+		HAL_StatusTypeDef error = I2C_Bus::startTransfer(&I2C_Bus::_queue[I2C_Bus::_tail]);
+
+		// If started, wait for the interrupt
+		if(error == HAL_OK){
+			I2C_Bus::_busy = true;
+			return;
+		}
+
+		// If the peripheral is in use, leave the transaction queued
+		if(error == HAL_BUSY) break;
+
+		// Otherwise drop it reporting the error
+		I2C_Bus::_busy = true;
+		I2C_Bus::finishTransaction(error);
+		return;
+	}
+
+	I2C_Bus::_busy = false;
+}
+
+/*
+ * @brief Checks the BUSY flag once, without waiting: a flag set while the peripheral
+ * sends a STOP clears within a bit, any other is a transfer not started by the engine or
+ * a stuck bus.
+ *
+ */
+bool I2C_Bus::isReleasing(void){
+	if(!__HAL_I2C_GET_FLAG(I2C_Bus::_bus_handle, I2C_FLAG_BUSY)) return true;
+
+	return (I2C_Bus::_bus_handle->Instance->CR1 & I2C_CR1_STOP) != 0;
+}
+
+/*
+ * @brief Starts the HAL transfer for a transaction.
+ *
+ * @param transaction	Transaction to start;
+ *
+ */
+HAL_StatusTypeDef I2C_Bus::startTransfer(I2C_Bus::Transaction *transaction){
+	// Use DMA only if requested, linked and worth it (single bytes go through interrupts)
+	bool use_dma = I2C_Bus::_mode == I2C_Bus::DMA && transaction->length > 1;
+
+	// Start read
+	if(transaction->direction == I2C_Bus::READ){
+		if(use_dma && I2C_Bus::_bus_handle->hdmarx != nullptr){
+			return HAL_I2C_Mem_Read_DMA(
+					I2C_Bus::_bus_handle,
+					transaction->device_address,
+					transaction->register_address,
+					I2C_MEMADD_SIZE_8BIT,
+					transaction->data_buffer,
+					transaction->length
+					);
+		}
+
+		return HAL_I2C_Mem_Read_IT(
+				I2C_Bus::_bus_handle,
+				transaction->device_address,
+				transaction->register_address,
+				I2C_MEMADD_SIZE_8BIT,
+				transaction->data_buffer,
+				transaction->length
+				);
+	}
+
+	// Start write, from the payload if no buffer is given
+	uint8_t *source = transaction->data_buffer;
+	if(source == nullptr) source = transaction->payload;
+
+	if(use_dma && I2C_Bus::_bus_handle->hdmatx != nullptr){
+		return HAL_I2C_Mem_Write_DMA(
+				I2C_Bus::_bus_handle,
+				transaction->device_address,
+				transaction->register_address,
+				I2C_MEMADD_SIZE_8BIT,
+				source,
+				transaction->length
+				);
+	}
+
+	return HAL_I2C_Mem_Write_IT(
+			I2C_Bus::_bus_handle,
+			transaction->device_address,
+			transaction->register_address,
+			I2C_MEMADD_SIZE_8BIT,
+			source,
+			transaction->length
+			);
+}
+
+/*
+ * @brief Pops the transaction on the wire, starts the next one and then calls the
+ * completion callback, so the bus keeps working while the callback runs.
+ *
+ * @param status	Result of the transfer;
+ *
+ */
+void I2C_Bus::finishTransaction(HAL_StatusTypeDef status){
+	// Pop the finished transaction
+	I2C_Bus::Transaction *finished = &I2C_Bus::_queue[I2C_Bus::_tail];
+	I2C_Bus::Callback callback = finished->callback;
+	void *context = finished->context;
+
+	if(finished->statistics != nullptr){
+		uint32_t error_code = status == HAL_OK ? 0 : HAL_I2C_GetError(I2C_Bus::_bus_handle);
+		finished->statistics->record(status, error_code, finished->length, cycleCounterElapsed(I2C_Bus::_start_cycles));
+	}
+
+	I2C_Bus::_tail = (I2C_Bus::_tail + 1) % I2C_BUS_QUEUE_SIZE;
+	I2C_Bus::_count--;
+
+	// Update counters
+	if(status == HAL_OK) I2C_Bus::_completed++;
+	else I2C_Bus::_errors++;
+
+	// Keep the bus busy
+	I2C_Bus::startNext();
+
+	// Notify the owner
+	if(callback != nullptr) callback(context, status);
+
+	// If nothing was chained the bus is idle
+	I2C_Bus::Callback idle_callback = I2C_Bus::_idle_callback;
+	if(idle_callback != nullptr && !I2C_Bus::_busy && I2C_Bus::_count == 0) idle_callback(I2C_Bus::_idle_context, status);
+}
+
+/*
+ * @brief Completes the queued transactions with an error. Transactions queued again by
+ * the callbacks are left for later. Must be called with interrupts disabled and the
+ * queue held.
+ *
+ * @param status	Result reported to the owners;
+ *
+ */
+void I2C_Bus::flush(HAL_StatusTypeDef status){
+	for(uint8_t pending = I2C_Bus::_count; pending > 0 && I2C_Bus::_count > 0; pending--){
+		I2C_Bus::_busy = true;
+		I2C_Bus::finishTransaction(status);
+	}
+}
+
+
+// --- Fault recovery methods -----------------------------------------------------------
+
+/*
+ * @brief Returns the pins of the peripheral (I2C1 on PB6/PB7 or remapped on PB8/PB9,
+ * I2C2 on PB10/PB11).
+ *
+ */
+bool I2C_Bus::getRecoveryPins(GPIO_TypeDef **port, uint16_t *scl, uint16_t *sda){
+	*port = GPIOB;
+
+	if(I2C_Bus::_bus_handle->Instance == I2C1){
+		bool remapped = (AFIO->MAPR & AFIO_MAPR_I2C1_REMAP) != 0;
+		*scl = remapped ? GPIO_PIN_8 : GPIO_PIN_6;
+		*sda = remapped ? GPIO_PIN_9 : GPIO_PIN_7;
+		return true;
+	}
+
+	if(I2C_Bus::_bus_handle->Instance == I2C2){
+		*scl = GPIO_PIN_10;
+		*sda = GPIO_PIN_11;
+		return true;
+	}
+
+	// Return failure as default
+	return false;
+}
+
+/*
+ * @brief Drives the released lines as GPIO: clocks SCL until the slave lets SDA go,
+ * then sends a STOP. Returns false if the lines are still held or the budget runs out.
+ *
+ * @param start		Cycle counter at the start of the recovery;
+ * @param budget	Cycles allowed for the recovery;
+ *
+ */
+bool I2C_Bus::recoverLines(uint32_t start, uint32_t budget){
+	GPIO_TypeDef *port;
+	uint16_t scl, sda;
+	if(!I2C_Bus::getRecoveryPins(&port, &scl, &sda)) return false;
+
+	// Lines as open-drain outputs, released
+	HAL_GPIO_WritePin(port, scl | sda, GPIO_PIN_SET);
+
+	GPIO_InitTypeDef GPIO_InitStruct = {};
+	GPIO_InitStruct.Pin = scl | sda;
+	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+	HAL_GPIO_Init(port, &GPIO_InitStruct);
+
+	// Clock out the byte the slave was sending, until it releases SDA
+	I2C_Bus::_recovery_stage = I2C_Bus::RECOVERY_CLOCK_OUT;
+	for(uint8_t i = 0; i < I2C_BUS_RECOVERY_CLOCKS; i++){
+		if(HAL_GPIO_ReadPin(port, sda) == GPIO_PIN_SET) break;
+
+		HAL_GPIO_WritePin(port, scl, GPIO_PIN_RESET);
+		if(!I2C_Bus::waitHalfClock(start, budget)) return false;
+
+		HAL_GPIO_WritePin(port, scl, GPIO_PIN_SET);
+		if(!I2C_Bus::waitLineHigh(port, scl, start, budget)) return false;
+		if(!I2C_Bus::waitHalfClock(start, budget)) return false;
+	}
+
+	// STOP condition, SDA rising while SCL is high
+	I2C_Bus::_recovery_stage = I2C_Bus::RECOVERY_STOP;
+
+	HAL_GPIO_WritePin(port, scl, GPIO_PIN_RESET);
+	if(!I2C_Bus::waitHalfClock(start, budget)) return false;
+
+	HAL_GPIO_WritePin(port, sda, GPIO_PIN_RESET);
+	if(!I2C_Bus::waitHalfClock(start, budget)) return false;
+
+	HAL_GPIO_WritePin(port, scl, GPIO_PIN_SET);
+	if(!I2C_Bus::waitLineHigh(port, scl, start, budget)) return false;
+	if(!I2C_Bus::waitHalfClock(start, budget)) return false;
+
+	HAL_GPIO_WritePin(port, sda, GPIO_PIN_SET);
+	if(!I2C_Bus::waitHalfClock(start, budget)) return false;
+
+	// Both lines must be free
+	return HAL_GPIO_ReadPin(port, scl) == GPIO_PIN_SET && HAL_GPIO_ReadPin(port, sda) == GPIO_PIN_SET;
+}
+
+/*
+ * @brief Waits half a recovery clock period. Returns false if the budget runs out.
+ *
+ * @param start		Cycle counter at the start of the recovery;
+ * @param budget	Cycles allowed for the recovery;
+ *
+ */
+bool I2C_Bus::waitHalfClock(uint32_t start, uint32_t budget){
+	uint32_t begin = cycleCounterRead();
+	uint32_t half_clock = I2C_BUS_RECOVERY_HALF_CLOCK_US * (SystemCoreClock / 1000000);
+
+	while(cycleCounterElapsed(begin) < half_clock){
+		if(cycleCounterElapsed(start) >= budget) return false;
+	}
+
+	return true;
+}
+
+/*
+ * @brief Waits for a released line to go high (a slave may stretch the clock). Returns
+ * false if the budget runs out.
+ *
+ * @param port		GPIO port of the line;
+ * @param pin		GPIO pin of the line;
+ * @param start		Cycle counter at the start of the recovery;
+ * @param budget	Cycles allowed for the recovery;
+ *
+ */
+bool I2C_Bus::waitLineHigh(GPIO_TypeDef *port, uint16_t pin, uint32_t start, uint32_t budget){
+	while(HAL_GPIO_ReadPin(port, pin) != GPIO_PIN_SET){
+		if(cycleCounterElapsed(start) >= budget) return false;
+	}
+
+	return true;
+}
+
+
+
+// -------------------------------------------------------------------- HAL callbacks ---
+
+// Weak HAL callbacks overridden to dispatch the interrupts to the right bus
+
+extern "C" {
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c){
+	I2C_Bus *bus = I2C_Bus::getBus(hi2c);
+	if(bus != nullptr) bus->onTransferComplete(HAL_OK);
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c){
+	I2C_Bus *bus = I2C_Bus::getBus(hi2c);
+	if(bus != nullptr) bus->onTransferComplete(HAL_OK);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c){
+	I2C_Bus *bus = I2C_Bus::getBus(hi2c);
+	if(bus == nullptr) return;
+
+	// Report timeouts separately from bus errors and NACKs
+	if(HAL_I2C_GetError(hi2c) & HAL_I2C_ERROR_TIMEOUT) bus->onTransferComplete(HAL_TIMEOUT);
+	else bus->onTransferComplete(HAL_ERROR);
+}
+
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c){
+	I2C_Bus *bus = I2C_Bus::getBus(hi2c);
+	if(bus != nullptr) bus->onTransferComplete(HAL_ERROR);
+}
+
+}
+
+
+// END OF FILE
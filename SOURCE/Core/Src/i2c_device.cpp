@@ -6,6 +6,7 @@
  */
 
 #include "i2c_device.hpp"
+#include "cycle_counter.hpp"
 
 
 
@@ -17,14 +18,27 @@
  *
  * @param device_handle		I2C bus handle object;
  * @param device_address	Address of the I2C device;
- * @param response_delay	Time to wait for the device response;
+ * @param response_delay_us	Extra time allowed for the device response [us];
  *
  */
-I2C_Device::I2C_Device(I2C_HandleTypeDef *device_handle, uint8_t device_address, uint32_t response_delay) :
+I2C_Device::I2C_Device(I2C_HandleTypeDef *device_handle, uint8_t device_address, uint32_t response_delay_us) :
 		_device_handle(device_handle),
 		_device_address(device_address << 1),
-		_response_delay(response_delay)
-	{}
+		_response_delay_us(response_delay_us),
+		_register_pointer(0),
+		_register_pointer_valid(false),
+		_shadow_verify(false),
+		_shadow_hits(0),
+		_shadow_mismatches(0),
+		_recovery_count(0)
+	{
+		for(uint8_t i = 0; i < I2C_DEVICE_SHADOW_SIZE; i++){
+			I2C_Device::_shadow[i].register_address = 0;
+			I2C_Device::_shadow[i].size = 0;
+			I2C_Device::_shadow[i].value = 0;
+			I2C_Device::_shadow[i].valid = false;
+		}
+	}
 
 
 // --- Low-level I2C methods ------------------------------------------------------------
@@ -36,16 +50,26 @@ I2C_Device::I2C_Device(I2C_HandleTypeDef *device_handle, uint8_t device_address,
  *
  */
 HAL_StatusTypeDef I2C_Device::LLR_8Bits(uint8_t register_address, uint8_t *data_buffer){
-	// I2C read
-	return HAL_I2C_Mem_Read(
+	// Clear a stuck bus first and hold its queue
+	if(!I2C_Device::acquireBus()) return HAL_BUSY;
+
+	// I2C read, completed by the interrupts within the timeout
+	uint32_t start = cycleCounterRead();
+	HAL_StatusTypeDef error = HAL_I2C_Mem_Read_IT(
 			I2C_Device::_device_handle,
 			I2C_Device::_device_address,
 			register_address,
 			I2C_MEMADD_SIZE_8BIT,
 			data_buffer,
-			1,
-			I2C_Device::_response_delay
+			1
 			);
+	error = I2C_Device::waitTransfer(error, 1, start);
+
+	// Update statistics and register pointer, release the bus, then return error if any
+	I2C_Device::recordTransfer(error, 1, start);
+	I2C_Device::trackRegisterPointer(register_address, error);
+	I2C_Device::releaseBus();
+	return error;
 }
 
 /*
@@ -53,24 +77,105 @@ HAL_StatusTypeDef I2C_Device::LLR_8Bits(uint8_t register_address, uint8_t *data_
  *
  */
 HAL_StatusTypeDef I2C_Device::LLR_16Bits(uint8_t register_address, uint16_t *data_buffer){
-	// Create buffer for data
-	uint8_t buffer[2];
+	// Create buffer for data, zero if the read fails
+	uint8_t buffer[2] = {};
+
+	// Clear a stuck bus first and hold its queue
+	if(!I2C_Device::acquireBus()) return HAL_BUSY;
 
-	// I2C read
-	HAL_StatusTypeDef error = HAL_I2C_Mem_Read(
+	// I2C read, completed by the interrupts within the timeout
+	uint32_t start = cycleCounterRead();
+	HAL_StatusTypeDef error = HAL_I2C_Mem_Read_IT(
 			I2C_Device::_device_handle,
 			I2C_Device::_device_address,
 			register_address,
 			I2C_MEMADD_SIZE_8BIT,
 			buffer,
-			2,
-			I2C_Device::_response_delay
+			2
 			);
+	error = I2C_Device::waitTransfer(error, 2, start);
 
 	// Concatenate and save data
 	*data_buffer = I2C_Device::concat_8to16Bits(buffer);
 
-	// Return error if any
+	// Update statistics and register pointer, release the bus, then return error if any
+	I2C_Device::recordTransfer(error, 2, start);
+	I2C_Device::trackRegisterPointer(register_address, error);
+	I2C_Device::releaseBus();
+	return error;
+}
+
+/*
+ * @brief Read a block of consecutive registers in a single transfer, relying on the
+ * device address auto-increment.
+ *
+ * @param register_address	Address of the first register;
+ * @param data_buffer		Buffer for the read bytes;
+ * @param length			Number of bytes to read;
+ *
+ */
+HAL_StatusTypeDef I2C_Device::LLR(uint8_t register_address, uint8_t *data_buffer, uint16_t length){
+	// Clear a stuck bus first and hold its queue
+	if(!I2C_Device::acquireBus()) return HAL_BUSY;
+
+	// I2C read, completed by the interrupts within the timeout
+	uint32_t start = cycleCounterRead();
+	HAL_StatusTypeDef error = HAL_I2C_Mem_Read_IT(
+			I2C_Device::_device_handle,
+			I2C_Device::_device_address,
+			register_address,
+			I2C_MEMADD_SIZE_8BIT,
+			data_buffer,
+			length
+			);
+	error = I2C_Device::waitTransfer(error, length, start);
+
+	// Update statistics and register pointer, release the bus, then return error if any
+	I2C_Device::recordTransfer(error, length, start);
+	I2C_Device::trackRegisterPointer(register_address, error);
+	I2C_Device::releaseBus();
+	return error;
+}
+
+/*
+ * @brief Read multiple-byte data from a device that keeps its register pointer between
+ * transfers. If the pointer already addresses the register only the receive phase is
+ * sent (address byte and data), otherwise a normal register read sets it first.
+ *
+ * @param register_address	Address of the register;
+ * @param data_buffer		Buffer for the read data;
+ *
+ */
+HAL_StatusTypeDef I2C_Device::LLR_16Bits_Stream(uint8_t register_address, uint16_t *data_buffer){
+	// Clear a stuck bus first and hold its queue, a recovery invalidates the pointer
+	if(!I2C_Device::acquireBus()) return HAL_BUSY;
+
+	// If the pointer is elsewhere do a full read, which also moves it
+	if(!I2C_Device::_register_pointer_valid || I2C_Device::_register_pointer != register_address){
+		I2C_Device::releaseBus();
+		return I2C_Device::LLR_16Bits(register_address, data_buffer);
+	}
+
+	// Create buffer for data, zero if the read fails
+	uint8_t buffer[2] = {};
+
+	// I2C receive, without pointer write, completed by the interrupts within the timeout
+	uint32_t start = cycleCounterRead();
+	HAL_StatusTypeDef error = HAL_I2C_Master_Receive_IT(
+			I2C_Device::_device_handle,
+			I2C_Device::_device_address,
+			buffer,
+			2
+			);
+	error = I2C_Device::waitTransfer(error, 2, start);
+
+	// Concatenate and save data
+	*data_buffer = I2C_Device::concat_8to16Bits(buffer);
+
+	// Update statistics and register pointer, release the bus, then return error if any
+	I2C_Device::recordTransfer(error, 2, start);
+	I2C_Device::trackRegisterPointer(register_address, error);
+	I2C_Device::releaseBus();
 	return error;
 }
 
@@ -82,16 +187,26 @@ HAL_StatusTypeDef I2C_Device::LLR_16Bits(uint8_t register_address, uint16_t *dat
  *
  */
 HAL_StatusTypeDef I2C_Device::LLW_8Bits(uint8_t register_address, uint8_t data_buffer){
-	// I2C write
-	return HAL_I2C_Mem_Write(
+	// Clear a stuck bus first and hold its queue
+	if(!I2C_Device::acquireBus()) return HAL_BUSY;
+
+	// I2C write, completed by the interrupts within the timeout
+	uint32_t start = cycleCounterRead();
+	HAL_StatusTypeDef error = HAL_I2C_Mem_Write_IT(
 			I2C_Device::_device_handle,
 			I2C_Device::_device_address,
 			register_address,
 			I2C_MEMADD_SIZE_8BIT,
 			&data_buffer,
-			1,
-			I2C_Device::_response_delay
+			1
 			);
+	error = I2C_Device::waitTransfer(error, 1, start);
+
+	// Update statistics and register pointer, release the bus, then return error if any
+	I2C_Device::recordTransfer(error, 1, start);
+	I2C_Device::trackRegisterPointer(register_address, error);
+	I2C_Device::releaseBus();
+	return error;
 }
 
 /*
@@ -105,39 +220,446 @@ HAL_StatusTypeDef I2C_Device::LLW_16Bits(uint8_t register_address, uint16_t data
 	// Break data to smaller chunks for transfer
 	I2C_Device::break_16to8Bits(data_buffer, buffer);
 
-	// I2C write
-	HAL_StatusTypeDef error = HAL_I2C_Mem_Write(
+	// Clear a stuck bus first and hold its queue
+	if(!I2C_Device::acquireBus()) return HAL_BUSY;
+
+	// I2C write, completed by the interrupts within the timeout
+	uint32_t start = cycleCounterRead();
+	HAL_StatusTypeDef error = HAL_I2C_Mem_Write_IT(
 			I2C_Device::_device_handle,
 			I2C_Device::_device_address,
 			register_address,
 			I2C_MEMADD_SIZE_8BIT,
 			buffer,
-			2,
-			I2C_Device::_response_delay
+			2
 			);
+	error = I2C_Device::waitTransfer(error, 2, start);
+
+	// Update statistics and register pointer, release the bus, then return error if any
+	I2C_Device::recordTransfer(error, 2, start);
+	I2C_Device::trackRegisterPointer(register_address, error);
+	I2C_Device::releaseBus();
+	return error;
+}
+
+
+// --- Asynchronous I2C methods ---------------------------------------------------------
+
+// --- Read
+
+/*
+ * @brief Queues a read of consecutive registers on the bus engine. The buffer must stay
+ * valid until the callback is called (from interrupt context).
+ *
+ * @param register_address	Address of the first register;
+ * @param data_buffer		Buffer for the read bytes;
+ * @param length			Number of bytes to read;
+ * @param callback			Function called on completion;
+ * @param context			Argument passed to the callback;
+ *
+ */
+HAL_StatusTypeDef I2C_Device::LLR_Async(
+uint8_t register_address,
+uint8_t *data_buffer,
+uint16_t length,
+I2C_Bus::Callback callback,
+void *context
+){
+	// Find the engine for the device bus
+	I2C_Bus *bus = I2C_Bus::getBus(I2C_Device::_device_handle);
+	if(bus == nullptr) return HAL_ERROR;
+
+	// Describe and queue the transaction
+	I2C_Bus::Transaction transaction = {};
+	transaction.device_address = I2C_Device::_device_address;
+	transaction.register_address = register_address;
+	transaction.direction = I2C_Bus::READ;
+	transaction.length = length;
+	transaction.data_buffer = data_buffer;
+	transaction.callback = callback;
+	transaction.context = context;
+	transaction.statistics = &(I2C_Device::_statistics);
+
+	// The pointer moves when the transaction runs
+	I2C_Device::_register_pointer_valid = false;
+
+	return bus->submit(&transaction);
+}
+
+
+// --- Write
+
+/*
+ * @brief Queues a single-byte write on the bus engine. The data is copied.
+ *
+ */
+HAL_StatusTypeDef I2C_Device::LLW_Async_8Bits(
+uint8_t register_address,
+uint8_t data_buffer,
+I2C_Bus::Callback callback,
+void *context
+){
+	// Find the engine for the device bus
+	I2C_Bus *bus = I2C_Bus::getBus(I2C_Device::_device_handle);
+	if(bus == nullptr) return HAL_ERROR;
+
+	// Describe and queue the transaction, data travels in the payload
+	I2C_Bus::Transaction transaction = {};
+	transaction.device_address = I2C_Device::_device_address;
+	transaction.register_address = register_address;
+	transaction.direction = I2C_Bus::WRITE;
+	transaction.length = 1;
+	transaction.payload[0] = data_buffer;
+	transaction.callback = callback;
+	transaction.context = context;
+	transaction.statistics = &(I2C_Device::_statistics);
+
+	// The pointer moves when the transaction runs
+	I2C_Device::_register_pointer_valid = false;
+
+	return bus->submit(&transaction);
+}
+
+/*
+ * @brief Queues a multiple-byte write on the bus engine. The data is copied.
+ *
+ */
+HAL_StatusTypeDef I2C_Device::LLW_Async_16Bits(
+uint8_t register_address,
+uint16_t data_buffer,
+I2C_Bus::Callback callback,
+void *context
+){
+	// Find the engine for the device bus
+	I2C_Bus *bus = I2C_Bus::getBus(I2C_Device::_device_handle);
+	if(bus == nullptr) return HAL_ERROR;
+
+	// Describe and queue the transaction, data travels in the payload
+	I2C_Bus::Transaction transaction = {};
+	transaction.device_address = I2C_Device::_device_address;
+	transaction.register_address = register_address;
+	transaction.direction = I2C_Bus::WRITE;
+	transaction.length = 2;
+	I2C_Device::break_16to8Bits(data_buffer, transaction.payload);
+	transaction.callback = callback;
+	transaction.context = context;
+	transaction.statistics = &(I2C_Device::_statistics);
+
+	// The pointer moves when the transaction runs
+	I2C_Device::_register_pointer_valid = false;
+
+	return bus->submit(&transaction);
+}
+
+
+// --- Shadow register file -------------------------------------------------------------
+
+/*
+ * @brief Marks all shadowed registers as unknown, the next access reads the device.
+ *
+ */
+void I2C_Device::invalidateShadow(void){
+	for(uint8_t i = 0; i < I2C_DEVICE_SHADOW_SIZE; i++) I2C_Device::_shadow[i].valid = false;
+}
+
+/*
+ * @brief Marks a shadowed register as unknown, the next access reads the device.
+ *
+ * @param register_address	Register to invalidate;
+ *
+ */
+void I2C_Device::invalidateShadow(uint8_t register_address){
+	I2C_Device::Shadow_Register *shadow = I2C_Device::findShadow(register_address);
+	if(shadow != nullptr) shadow->valid = false;
+}
+
+/*
+ * @brief Reads all shadowed registers from the device. Returns false if any read fails
+ * (that register stays invalid).
+ *
+ */
+bool I2C_Device::resyncShadow(void){
+	bool success = true;
+
+	for(uint8_t i = 0; i < I2C_DEVICE_SHADOW_SIZE; i++){
+		I2C_Device::Shadow_Register *shadow = &I2C_Device::_shadow[i];
+		if(shadow->size == 0) continue;
+
+		uint16_t register_content;
+		HAL_StatusTypeDef error = I2C_Device::readDevice(shadow, &register_content);
+
+		shadow->value = register_content;
+		shadow->valid = (error == HAL_OK);
+		if(error != HAL_OK) success = false;
+	}
+
+	return success;
+}
+
+
+// --- Shadowed register access ---------------------------------------------------------
+
+/*
+ * @brief Declares a register to shadow. No bus access, the first read fills it.
+ *
+ * @param register_address	Register to shadow (first byte for 16 bit registers);
+ * @param size				Register size in bytes, 1 or 2;
+ *
+ */
+bool I2C_Device::addShadowRegister(uint8_t register_address, uint8_t size){
+	// Refuse other sizes and duplicates
+	if(size != 1 && size != 2) return false;
+	if(I2C_Device::findShadow(register_address) != nullptr) return false;
+
+	// Take the first free slot
+	for(uint8_t i = 0; i < I2C_DEVICE_SHADOW_SIZE; i++){
+		I2C_Device::Shadow_Register *shadow = &I2C_Device::_shadow[i];
+		if(shadow->size != 0) continue;
+
+		shadow->register_address = register_address;
+		shadow->size = size;
+		shadow->valid = false;
+		return true;
+	}
+
+	// Return failure as default
+	return false;
+}
+
+/*
+ * @brief Reads a single-byte register from the shadow, or from the device if the shadow
+ * is not valid, not declared or in verify mode.
+ *
+ */
+HAL_StatusTypeDef I2C_Device::readShadow_8Bits(uint8_t register_address, uint8_t *data_buffer){
+	// If not shadowed read the device
+	if(I2C_Device::findShadow(register_address) == nullptr) return I2C_Device::LLR_8Bits(register_address, data_buffer);
+
+	uint16_t register_content;
+	HAL_StatusTypeDef error = I2C_Device::readShadow_16Bits(register_address, &register_content);
+
+	*data_buffer = (uint8_t)register_content;
+	return error;
+}
+
+/*
+ * @brief Reads a register from the shadow, or from the device if the shadow is not
+ * valid, not declared or in verify mode (a difference is counted as a mismatch). If the
+ * device read of a shadowed register fails the buffer gets the last value of the shadow.
+ *
+ */
+HAL_StatusTypeDef I2C_Device::readShadow_16Bits(uint8_t register_address, uint16_t *data_buffer){
+	// If not shadowed read the device
+	I2C_Device::Shadow_Register *shadow = I2C_Device::findShadow(register_address);
+	if(shadow == nullptr) return I2C_Device::LLR_16Bits(register_address, data_buffer);
+
+	// If valid no bus access (value and flag taken together, storeShadow runs in interrupts)
+	if(!I2C_Device::_shadow_verify){
+		uint16_t value;
+		if(I2C_Device::loadShadow(register_address, &value)){
+			I2C_Device::_shadow_hits++;
+			*data_buffer = value;
+			return HAL_OK;
+		}
+	}
+
+	// Read the device, if it fails the shadow is unknown but its last value is given
+	uint16_t register_content;
+	HAL_StatusTypeDef error = I2C_Device::readDevice(shadow, &register_content);
+	if(error != HAL_OK){
+		shadow->valid = false;
+		*data_buffer = shadow->value;
+		return error;
+	}
+
+	// Verify mode: count a stale shadow, the device wins
+	if(shadow->valid && shadow->value != register_content) I2C_Device::_shadow_mismatches++;
+
+	shadow->value = register_content;
+	shadow->valid = true;
+
+	*data_buffer = register_content;
+	return HAL_OK;
+}
+
+/*
+ * @brief Writes a single-byte register through the shadow.
+ *
+ */
+HAL_StatusTypeDef I2C_Device::writeShadow_8Bits(uint8_t register_address, uint8_t data_buffer){
+	// If not shadowed write the device
+	if(I2C_Device::findShadow(register_address) == nullptr) return I2C_Device::LLW_8Bits(register_address, data_buffer);
+
+	return I2C_Device::writeShadow_16Bits(register_address, data_buffer);
+}
+
+/*
+ * @brief Writes a register through the shadow: the shadow takes the value only if the
+ * write succeeds, otherwise it becomes unknown. In verify mode the register is read back.
+ *
+ */
+HAL_StatusTypeDef I2C_Device::writeShadow_16Bits(uint8_t register_address, uint16_t data_buffer){
+	// If not shadowed write the device
+	I2C_Device::Shadow_Register *shadow = I2C_Device::findShadow(register_address);
+	if(shadow == nullptr) return I2C_Device::LLW_16Bits(register_address, data_buffer);
+
+	// Write the device
+	HAL_StatusTypeDef error = I2C_Device::writeDevice(shadow, data_buffer);
+
+	shadow->value = data_buffer;
+	shadow->valid = (error == HAL_OK);
+	if(error != HAL_OK || !I2C_Device::_shadow_verify) return error;
+
+	// Verify mode: read back
+	uint16_t register_content;
+	error = I2C_Device::readDevice(shadow, &register_content);
+	if(error == HAL_OK && register_content != data_buffer){
+		I2C_Device::_shadow_mismatches++;
+		shadow->value = register_content;
+	}
+	shadow->valid = (error == HAL_OK);
 
-	// Return error if any
 	return error;
 }
 
+/*
+ * @brief Changes the bits in the mask of a single-byte register.
+ *
+ * @param register_address	Register to change;
+ * @param mask				Bits to change;
+ * @param bits				New value of the bits (outside the mask ignored);
+ *
+ */
+HAL_StatusTypeDef I2C_Device::updateShadow_8Bits(uint8_t register_address, uint8_t mask, uint8_t bits){
+	// Read previous content to change only interested bits
+	uint8_t register_content;
+	HAL_StatusTypeDef error = I2C_Device::readShadow_8Bits(register_address, &register_content);
+	if(error != HAL_OK) return error;
+
+	// Mask, set and write
+	register_content = (register_content & ~mask) | (bits & mask);
+	return I2C_Device::writeShadow_8Bits(register_address, register_content);
+}
+
+/*
+ * @brief Changes the bits in the mask of a register.
+ *
+ * @param register_address	Register to change;
+ * @param mask				Bits to change;
+ * @param bits				New value of the bits (outside the mask ignored);
+ *
+ */
+HAL_StatusTypeDef I2C_Device::updateShadow_16Bits(uint8_t register_address, uint16_t mask, uint16_t bits){
+	// Read previous content to change only interested bits
+	uint16_t register_content;
+	HAL_StatusTypeDef error = I2C_Device::readShadow_16Bits(register_address, &register_content);
+	if(error != HAL_OK) return error;
+
+	// Mask, set and write
+	register_content = (register_content & ~mask) | (bits & mask);
+	return I2C_Device::writeShadow_16Bits(register_address, register_content);
+}
+
+/*
+ * @brief Records a value written without the shadow (e.g. by an asynchronous write).
+ * Atomic against the thread-mode accesses, it can be called from interrupts.
+ *
+ * @param register_address	Register written;
+ * @param value				Value written;
+ *
+ */
+void I2C_Device::storeShadow(uint8_t register_address, uint16_t value){
+	I2C_Device::Shadow_Register *shadow = I2C_Device::findShadow(register_address);
+	if(shadow == nullptr) return;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	shadow->value = value;
+	shadow->valid = true;
+
+	__set_PRIMASK(primask);
+}
+
+/*
+ * @brief Returns a shadowed value without bus access (e.g. from interrupts), value and
+ * flag read atomically. Returns false if the register is not shadowed or not valid.
+ *
+ * @param register_address	Register to read;
+ * @param value				Buffer for the shadowed value;
+ *
+ */
+bool I2C_Device::loadShadow(uint8_t register_address, uint16_t *value){
+	I2C_Device::Shadow_Register *shadow = I2C_Device::findShadow(register_address);
+	if(shadow == nullptr) return false;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	bool valid = shadow->valid;
+	if(valid) *value = shadow->value;
+
+	__set_PRIMASK(primask);
+
+	return valid;
+}
+
+
+// --- Getter methods -------------------------------------------------------------------
+
+/*
+ * @brief Returns the time allowed to a blocking transfer: the address and data bytes
+ * (9 clocks each) at half the bus speed, plus the response delay of the device.
+ *
+ * @param length	Data bytes of the transfer;
+ *
+ */
+uint32_t I2C_Device::getTransferTimeout_us(uint16_t length){
+	uint32_t clock_speed = I2C_Device::_device_handle->Init.ClockSpeed;
+	if(clock_speed == 0) clock_speed = 100000;
+
+	uint32_t byte_us = (2 * 9 * 1000000) / clock_speed;
+
+	return (length + I2C_DEVICE_ADDRESS_BYTES) * byte_us + I2C_Device::_response_delay_us;
+}
+
 
 // --- Utility methods ------------------------------------------------------------------
 
 /*
- * @brief Checks if the device is connected and working.
+ * @brief Checks if the device is connected: address probes (no data) completed by the
+ * interrupts within the transfer timeout, up to I2C_DEVICE_PROBE_TRIALS until the
+ * device acknowledges (a device busy for a moment is not reported missing, a missing
+ * one costs a few address bytes).
  *
  */
 bool I2C_Device::isConnected(void){
-	// I2C check
-	HAL_StatusTypeDef success =	HAL_I2C_IsDeviceReady(
-			I2C_Device::_device_handle,
-			I2C_Device::_device_address,
-			5,
-			I2C_Device::_response_delay
-			);
+	// Clear a stuck bus first and hold its queue
+	if(!I2C_Device::acquireBus()) return false;
+
+	HAL_StatusTypeDef error = HAL_ERROR;
+	for(uint8_t trial = 0; trial < I2C_DEVICE_PROBE_TRIALS && error != HAL_OK; trial++){
+		if(trial > 0) I2C_Device::_statistics.recordRetry();
+
+		// Address only, no busy-waiting in the HAL
+		uint32_t start = cycleCounterRead();
+		error = HAL_I2C_Master_Transmit_IT(
+				I2C_Device::_device_handle,
+				I2C_Device::_device_address,
+				nullptr,
+				0
+				);
+		error = I2C_Device::waitTransfer(error, 0, start);
+
+		// Update statistics
+		I2C_Device::recordTransfer(error, 0, start);
+	}
+
+	// Release the bus
+	I2C_Device::releaseBus();
 
 	// If device responds return success
-	if(success == HAL_OK){
+	if(error == HAL_OK){
 		return true;
 	}
 
@@ -146,44 +668,217 @@ bool I2C_Device::isConnected(void){
 }
 
 
-// --- Utility methods for bit operations -----------------------------------------------
+// --- Shadow register file -------------------------------------------------------------
 
-// --- Protected
+/*
+ * @brief Finds the shadow of a register, null if not shadowed.
+ *
+ * @param register_address	Register to find;
+ *
+ */
+I2C_Device::Shadow_Register *I2C_Device::findShadow(uint8_t register_address){
+	for(uint8_t i = 0; i < I2C_DEVICE_SHADOW_SIZE; i++){
+		I2C_Device::Shadow_Register *shadow = &I2C_Device::_shadow[i];
+		if(shadow->size != 0 && shadow->register_address == register_address) return shadow;
+	}
+
+	// Return nothing as default
+	return nullptr;
+}
+
+/*
+ * @brief Reads a shadowed register from the device, with its size.
+ *
+ */
+HAL_StatusTypeDef I2C_Device::readDevice(I2C_Device::Shadow_Register *shadow, uint16_t *data_buffer){
+	// Single byte
+	if(shadow->size == 1){
+		uint8_t register_content = 0;
+		HAL_StatusTypeDef error = I2C_Device::LLR_8Bits(shadow->register_address, &register_content);
+
+		*data_buffer = register_content;
+		return error;
+	}
+
+	return I2C_Device::LLR_16Bits(shadow->register_address, data_buffer);
+}
+
+/*
+ * @brief Writes a shadowed register to the device, with its size.
+ *
+ */
+HAL_StatusTypeDef I2C_Device::writeDevice(I2C_Device::Shadow_Register *shadow, uint16_t data_buffer){
+	// Single byte
+	if(shadow->size == 1) return I2C_Device::LLW_8Bits(shadow->register_address, (uint8_t)data_buffer);
+
+	return I2C_Device::LLW_16Bits(shadow->register_address, data_buffer);
+}
+
+
+// --- Register pointer tracking --------------------------------------------------------
 
 /*
- * @brief Apply a mask to the 8 bit data. Optionally invert the mask.
+ * @brief Records the register addressed by a blocking transfer, before the bus is
+ * released. After an error the device pointer is unknown, and so it is with queued
+ * transactions pending: held by the blocking transfer, they run after it and may move
+ * the pointer (their submit, also from an interrupt, drops it as well).
  *
- * @param data			Data to mask;
- * @param mask			Mask for the data;
- * @param invert_mask	Optionally, can invert the mask;
+ * @param register_address	Register addressed by the transfer;
+ * @param error				Result of the transfer;
  *
  */
-uint8_t I2C_Device::mask_8Bits(uint8_t data, uint8_t mask, bool invert_mask){
-	// If requested invert mask and return masked data
-	if(invert_mask) return data & ~mask;
+void I2C_Device::trackRegisterPointer(uint8_t register_address, HAL_StatusTypeDef error){
+	I2C_Bus *bus = I2C_Bus::getBus(I2C_Device::_device_handle);
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	I2C_Device::_register_pointer = register_address;
+	I2C_Device::_register_pointer_valid = (error == HAL_OK) && (bus == nullptr || bus->getPendingCount() == 0);
+
+	__set_PRIMASK(primask);
+}
 
-	// Return masked data as default
-	return data & mask;
+
+// --- Bus recovery ---------------------------------------------------------------------
+
+/*
+ * @brief Recovers a stuck bus before a blocking transfer (the HAL would wait 25 ms for
+ * the BUSY flag), then drops the cached state if the bus was recovered since the last
+ * check. Devices without a bus engine are not checked.
+ *
+ */
+void I2C_Device::checkBus(void){
+	I2C_Bus *bus = I2C_Bus::getBus(I2C_Device::_device_handle);
+	if(bus == nullptr) return;
+
+	if(bus->isFaulted() || bus->isStuck()) bus->recover();
+
+	if(bus->getRecoveryCount() != I2C_Device::_recovery_count){
+		I2C_Device::_recovery_count = bus->getRecoveryCount();
+		I2C_Device::onBusRecovered();
+	}
 }
 
 /*
- * @brief Apply a mask to the 16 bit data. Optionally invert the mask.
+ * @brief Prepares the bus for a blocking transfer: recovers it if stuck and holds its
+ * queue, so the interrupts start no queued transfer inside the blocking HAL call.
+ * Returns false if a queued transfer still occupies the bus (see I2C_Bus::acquire).
+ * Devices without a bus engine always get it.
  *
- * @param data			Data to mask;
- * @param mask			Mask for the data;
- * @param invert_mask	Optionally, can invert the mask;
+ */
+bool I2C_Device::acquireBus(void){
+	I2C_Device::checkBus();
+
+	I2C_Bus *bus = I2C_Bus::getBus(I2C_Device::_device_handle);
+	if(bus == nullptr) return true;
+
+	return bus->acquire();
+}
+
+/*
+ * @brief Ends the hold of acquireBus(), once the result of the transfer was read from
+ * the handle (a queued transfer restarting resets it).
  *
  */
-uint16_t I2C_Device::mask_16Bits(uint16_t data, uint16_t mask, bool invert_mask){
-	// If requested invert mask and return masked data
-	if(invert_mask) return data & ~mask;
+void I2C_Device::releaseBus(void){
+	I2C_Bus *bus = I2C_Bus::getBus(I2C_Device::_device_handle);
+	if(bus != nullptr) bus->release();
+}
 
-	// Return masked data as default
-	return data & mask;
+/*
+ * @brief Drops the state cached before a bus recovery: a write cut by the fault may or
+ * may not have reached the device, so the shadow is read again on the next access.
+ *
+ */
+void I2C_Device::onBusRecovered(void){
+	I2C_Device::invalidateShadow();
+	I2C_Device::_register_pointer_valid = false;
 }
 
 
-// --- Private
+// --- Blocking transfer wait -----------------------------------------------------------
+
+/*
+ * @brief Waits for the interrupts to complete a blocking transfer, up to the transfer
+ * timeout. A transfer still running then is aborted, so it cannot write to the buffer
+ * of the caller afterwards. With interrupts masked or the cycle counter stopped it could
+ * neither complete nor time out: it is aborted at once and HAL_ERROR returned.
+ *
+ * @param error		Result of the transfer start;
+ * @param length	Data bytes of the transfer;
+ * @param start		Cycle counter before the transfer start;
+ *
+ */
+HAL_StatusTypeDef I2C_Device::waitTransfer(HAL_StatusTypeDef error, uint16_t length, uint32_t start){
+	// Without the cycle counter or with interrupts masked the transfer would never end
+	if(!cycleCounterIsRunning() || __get_PRIMASK() != 0){
+		if(error == HAL_OK) I2C_Device::abortTransfer();
+		return HAL_ERROR;
+	}
+
+	// If not started return the error
+	if(error != HAL_OK) return error;
+
+	uint32_t timeout = I2C_Device::getTransferTimeout_us(length) * (SystemCoreClock / 1000000);
+
+	while(HAL_I2C_GetState(I2C_Device::_device_handle) != HAL_I2C_STATE_READY){
+		if(cycleCounterElapsed(start) >= timeout){
+			I2C_Device::abortTransfer();
+			return HAL_TIMEOUT;
+		}
+	}
+
+	// NACK or bus error seen by the interrupts
+	if(HAL_I2C_GetError(I2C_Device::_device_handle) != HAL_I2C_ERROR_NONE) return HAL_ERROR;
+
+	return HAL_OK;
+}
+
+/*
+ * @brief Stops a transfer that timed out: the bus engine recovers the bus, otherwise
+ * (no engine, interrupt context, interrupts masked or no cycle counter for the recovery
+ * budget) the peripheral is only reset.
+ *
+ */
+void I2C_Device::abortTransfer(void){
+	I2C_Bus *bus = I2C_Bus::getBus(I2C_Device::_device_handle);
+	if(bus != nullptr && __get_IPSR() == 0 && __get_PRIMASK() == 0 && cycleCounterIsRunning()){
+		bus->recover();
+		return;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	HAL_I2C_DeInit(I2C_Device::_device_handle);
+	HAL_I2C_Init(I2C_Device::_device_handle);
+
+	__set_PRIMASK(primask);
+}
+
+
+// --- Transaction statistics -----------------------------------------------------------
+
+/*
+ * @brief Records a blocking transfer in the device statistics.
+ *
+ * @param error		Result of the transfer;
+ * @param length	Data bytes of the transfer;
+ * @param start		Cycle counter before the transfer;
+ *
+ */
+void I2C_Device::recordTransfer(HAL_StatusTypeDef error, uint16_t length, uint32_t start){
+	uint32_t cycles = cycleCounterElapsed(start);
+	uint32_t error_code = error == HAL_OK ? 0 : HAL_I2C_GetError(I2C_Device::_device_handle);
+
+	I2C_Device::_statistics.record(error, error_code, length, cycles);
+}
+
+
+// --- Utility methods for bit operations -----------------------------------------------
+
+// --- Protected
 
 /*
  * @brief Concatenate two 8 bit data to form a 16 bit data.
@@ -196,6 +891,9 @@ uint16_t I2C_Device::concat_8to16Bits(uint8_t *bytes){
 	return ((bytes[0] & 0xFF) << 8) | bytes[1];
 }
 
+
+// --- Private
+
 /*
  * @brief Breaks 16 bit data in to two 8 bit data.
  *
@@ -0,0 +1,408 @@
+/*
+ * i2c_scheduler.cpp
+ *
+ * Implementation of i2c_scheduler.hpp header file.
+ *
+ */
+
+#include "i2c_scheduler.hpp"
+
+
+
+// ----------------------------------------------- I2C_Scheduler class implementation ---
+
+// --- Scheduler constructor ------------------------------------------------------------
+
+/*
+ * @brief Constructs an empty scheduler. Add the streams, then call begin() before the
+ * tick starts.
+ *
+ * @param bus	Bus engine the streams use;
+ * @param tick	Control tick releasing the slots;
+ *
+ */
+I2C_Scheduler::I2C_Scheduler(I2C_Bus &bus, Control_Tick &tick) :
+		_bus(bus),
+		_tick(tick),
+		_channel(0),
+		_streams(),
+		_count(0),
+		_slot_count(0),
+		_cursor(0),
+		_built(false),
+		_active(I2C_SCHEDULER_NO_STREAM),
+		_release_phase(0),
+		_release_cycles(0),
+		_frames(0),
+		_statistics_frame(0),
+		_collisions(0),
+		_utilization(0)
+	{}
+
+
+// --- Scheduler core methods -----------------------------------------------------------
+
+/*
+ * @brief Adds a periodic stream. Streams cannot be added once the table is built.
+ *
+ * @param name			Stream name, for the debugger;
+ * @param period		Ticks between two releases, at least 1;
+ * @param cost_us		Bus time of one release [us];
+ * @param release_us	Earliest start in the tick [us];
+ * @param deadline_us	Latest end in the tick [us];
+ * @param job			Function queueing the transactions;
+ * @param context		Argument passed to the function;
+ *
+ */
+uint8_t I2C_Scheduler::addStream(
+const char *name,
+uint16_t period,
+uint16_t cost_us,
+uint16_t release_us,
+uint16_t deadline_us,
+I2C_Scheduler::Job job,
+void *context
+){
+	// Refuse a full or built table and streams that cannot fit their own window
+	if(I2C_Scheduler::_built || I2C_Scheduler::_count >= I2C_SCHEDULER_MAX_STREAMS) return I2C_SCHEDULER_NO_STREAM;
+	if(job == nullptr || period == 0 || cost_us == 0) return I2C_SCHEDULER_NO_STREAM;
+	if((uint32_t)release_us + cost_us > deadline_us) return I2C_SCHEDULER_NO_STREAM;
+
+	I2C_Scheduler::Stream &stream = I2C_Scheduler::_streams[I2C_Scheduler::_count];
+	stream = I2C_Scheduler::Stream();
+
+	stream.name = name;
+	stream.period = period;
+	stream.cost_us = cost_us;
+	stream.release_us = release_us;
+	stream.deadline_us = deadline_us;
+	stream.job = job;
+	stream.context = context;
+
+	return I2C_Scheduler::_count++;
+}
+
+/*
+ * @brief Builds the slot table in rate-monotonic order: shortest period first, then
+ * earliest deadline. Each stream takes the first tick of its period, and the earliest
+ * phase in it, free from the slots already placed. Returns false if a stream does not
+ * fit (it is left out of the table).
+ *
+ */
+bool I2C_Scheduler::build(void){
+	uint16_t period_us = I2C_Scheduler::_tick.getPeriod_us();
+
+	// Sort by priority (insertion sort, a handful of streams)
+	uint8_t order[I2C_SCHEDULER_MAX_STREAMS];
+	for(uint8_t i = 0; i < I2C_Scheduler::_count; i++){
+		const I2C_Scheduler::Stream &stream = I2C_Scheduler::_streams[i];
+
+		uint8_t j = i;
+		while(j > 0){
+			const I2C_Scheduler::Stream &previous = I2C_Scheduler::_streams[order[j - 1]];
+			if(previous.period < stream.period) break;
+			if(previous.period == stream.period && previous.deadline_us <= stream.deadline_us) break;
+
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	// Place the streams
+	bool placed = true;
+	for(uint8_t i = 0; i < I2C_Scheduler::_count; i++) I2C_Scheduler::_streams[i].placed = false;
+	for(uint8_t i = 0; i < I2C_Scheduler::_count; i++){
+		if(!I2C_Scheduler::place(order[i], period_us)) placed = false;
+	}
+
+	// Slots by phase, for the dispatch
+	I2C_Scheduler::_slot_count = 0;
+	I2C_Scheduler::_utilization = 0;
+	for(uint8_t i = 0; i < I2C_Scheduler::_count; i++){
+		const I2C_Scheduler::Stream &stream = I2C_Scheduler::_streams[i];
+		if(!stream.placed) continue;
+
+		uint8_t j = I2C_Scheduler::_slot_count++;
+		while(j > 0 && I2C_Scheduler::_streams[I2C_Scheduler::_slots[j - 1]].phase_us > stream.phase_us){
+			I2C_Scheduler::_slots[j] = I2C_Scheduler::_slots[j - 1];
+			j--;
+		}
+		I2C_Scheduler::_slots[j] = i;
+
+		I2C_Scheduler::_utilization += (float)stream.cost_us / ((uint32_t)stream.period * period_us);
+	}
+
+	I2C_Scheduler::_built = true;
+	return placed;
+}
+
+/*
+ * @brief Builds the table if needed, then releases its slots from a compare channel of
+ * the tick and closes them from the bus idle callback. Call it before the tick starts.
+ *
+ * @param channel	Control tick compare channel, 1 to 4;
+ *
+ */
+bool I2C_Scheduler::begin(uint8_t channel){
+	if(!I2C_Scheduler::_built && !I2C_Scheduler::build()) return false;
+	if(I2C_Scheduler::_slot_count == 0) return false;
+
+	I2C_Scheduler::_channel = channel;
+	I2C_Scheduler::_cursor = 0;
+
+	I2C_Scheduler::_bus.setIdleCallback(I2C_Scheduler::onBusIdle, this);
+
+	uint16_t first_phase = I2C_Scheduler::_streams[I2C_Scheduler::_slots[0]].phase_us;
+	return I2C_Scheduler::_tick.setPhaseHook(channel, first_phase, I2C_Scheduler::onSlot, this);
+}
+
+
+// --- Getter methods -------------------------------------------------------------------
+
+/*
+ * @brief Returns the start of the slot of a stream in its tick.
+ *
+ * @param stream	Stream index;
+ *
+ */
+uint16_t I2C_Scheduler::getPhase_us(uint8_t stream){
+	if(stream >= I2C_Scheduler::_count) return 0;
+
+	return I2C_Scheduler::_streams[stream].phase_us;
+}
+
+/*
+ * @brief Returns the measured bus share: sum of the release latencies over the elapsed
+ * ticks (waits for slow devices included).
+ *
+ */
+float I2C_Scheduler::getMeasuredUtilization(void){
+	// If no tick served return zero
+	uint32_t frames = I2C_Scheduler::_frames - I2C_Scheduler::_statistics_frame;
+	if(frames == 0) return 0;
+
+	uint32_t busy_us = 0;
+	for(uint8_t i = 0; i < I2C_Scheduler::_count; i++) busy_us += I2C_Scheduler::_streams[i].busy_us;
+
+	return (float)busy_us / ((float)frames * I2C_Scheduler::_tick.getPeriod_us());
+}
+
+/*
+ * @brief Returns the deadlines missed by all the streams.
+ *
+ */
+uint32_t I2C_Scheduler::getMissedDeadlines(void){
+	uint32_t missed = 0;
+	for(uint8_t i = 0; i < I2C_Scheduler::_count; i++) missed += I2C_Scheduler::_streams[i].missed;
+
+	return missed;
+}
+
+/*
+ * @brief Clears the stream statistics (the slot table is kept).
+ *
+ */
+void I2C_Scheduler::resetStatistics(void){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	for(uint8_t i = 0; i < I2C_Scheduler::_count; i++){
+		I2C_Scheduler::Stream &stream = I2C_Scheduler::_streams[i];
+
+		stream.releases = 0;
+		stream.skipped = 0;
+		stream.completions = 0;
+		stream.missed = 0;
+		stream.last_latency_us = 0;
+		stream.max_latency_us = 0;
+		stream.busy_us = 0;
+	}
+
+	// The frame count keeps the slots of the longer periods in place
+	I2C_Scheduler::_statistics_frame = I2C_Scheduler::_frames;
+	I2C_Scheduler::_collisions = 0;
+
+	__set_PRIMASK(primask);
+}
+
+
+// --- Slot table methods ---------------------------------------------------------------
+
+/*
+ * @brief Finds the first tick of the stream period and the earliest phase in it where
+ * the slot fits between its release and its deadline, clear of the placed slots.
+ *
+ * @param stream		Stream index;
+ * @param period_us		Tick period [us];
+ *
+ */
+bool I2C_Scheduler::place(uint8_t stream, uint16_t period_us){
+	I2C_Scheduler::Stream &candidate = I2C_Scheduler::_streams[stream];
+
+	uint32_t limit = candidate.deadline_us < period_us ? candidate.deadline_us : period_us;
+
+	for(uint16_t offset = 0; offset < candidate.period; offset++){
+		uint32_t phase = candidate.release_us;
+
+		// Move after every overlapping slot until nothing overlaps
+		bool moved = true;
+		while(moved && phase + candidate.cost_us <= limit){
+			moved = false;
+
+			for(uint8_t i = 0; i < I2C_Scheduler::_count; i++){
+				const I2C_Scheduler::Stream &other = I2C_Scheduler::_streams[i];
+				if(i == stream || !other.placed) continue;
+				if(!I2C_Scheduler::shareTick(stream, offset, i)) continue;
+
+				uint32_t other_end = (uint32_t)other.phase_us + other.cost_us;
+				if(phase < other_end && other.phase_us < phase + candidate.cost_us){
+					phase = other_end;
+					moved = true;
+				}
+			}
+		}
+
+		// If it fits take the slot
+		if(phase + candidate.cost_us <= limit){
+			candidate.offset = offset;
+			candidate.phase_us = phase;
+			candidate.placed = true;
+			return true;
+		}
+	}
+
+	// Return failure as default
+	return false;
+}
+
+/*
+ * @brief Checks if a stream placed at an offset is released in the same tick as another
+ * placed stream, at least once: the offsets must be equal modulo the GCD of the periods.
+ *
+ * @param stream	Stream index;
+ * @param offset	Candidate offset of the stream;
+ * @param other		Placed stream index;
+ *
+ */
+bool I2C_Scheduler::shareTick(uint8_t stream, uint16_t offset, uint8_t other){
+	uint16_t a = I2C_Scheduler::_streams[stream].period;
+	uint16_t b = I2C_Scheduler::_streams[other].period;
+	while(b != 0){
+		uint16_t r = a % b;
+		a = b;
+		b = r;
+	}
+
+	uint16_t other_offset = I2C_Scheduler::_streams[other].offset;
+	uint16_t difference = offset > other_offset ? offset - other_offset : other_offset - offset;
+
+	return difference % a == 0;
+}
+
+/*
+ * @brief Releases the slots due at the current phase, then arms the channel for the
+ * next phase. Slots whose phase already passed (late interrupt) are released at once.
+ *
+ */
+void I2C_Scheduler::dispatch(void){
+	while(true){
+		// Release every slot at this phase
+		uint16_t phase = I2C_Scheduler::_streams[I2C_Scheduler::_slots[I2C_Scheduler::_cursor]].phase_us;
+		while(I2C_Scheduler::_cursor < I2C_Scheduler::_slot_count &&
+				I2C_Scheduler::_streams[I2C_Scheduler::_slots[I2C_Scheduler::_cursor]].phase_us == phase){
+			I2C_Scheduler::release(I2C_Scheduler::_slots[I2C_Scheduler::_cursor]);
+			I2C_Scheduler::_cursor++;
+		}
+
+		// If the table is over wait for the next tick
+		if(I2C_Scheduler::_cursor >= I2C_Scheduler::_slot_count){
+			I2C_Scheduler::_cursor = 0;
+			I2C_Scheduler::_frames++;
+
+			uint16_t first_phase = I2C_Scheduler::_streams[I2C_Scheduler::_slots[0]].phase_us;
+			I2C_Scheduler::_tick.setPhaseHook(I2C_Scheduler::_channel, first_phase, I2C_Scheduler::onSlot, this);
+			return;
+		}
+
+		// Arm the next phase, unless it already passed
+		uint16_t next_phase = I2C_Scheduler::_streams[I2C_Scheduler::_slots[I2C_Scheduler::_cursor]].phase_us;
+		I2C_Scheduler::_tick.setPhaseHook(I2C_Scheduler::_channel, next_phase, I2C_Scheduler::onSlot, this);
+		if(I2C_Scheduler::_tick.getTime_us() < next_phase) return;
+	}
+}
+
+/*
+ * @brief Runs the job of a stream if its slot is in this tick.
+ *
+ * @param stream	Stream index;
+ *
+ */
+void I2C_Scheduler::release(uint8_t stream){
+	I2C_Scheduler::Stream &slot = I2C_Scheduler::_streams[stream];
+	if(I2C_Scheduler::_frames % slot.period != slot.offset) return;
+
+	// If the previous release still holds the bus it overran its slot
+	if(I2C_Scheduler::_active != I2C_SCHEDULER_NO_STREAM){
+		I2C_Scheduler::_streams[I2C_Scheduler::_active].missed++;
+		I2C_Scheduler::_collisions++;
+		I2C_Scheduler::_active = I2C_SCHEDULER_NO_STREAM;
+	}
+
+	slot.releases++;
+	I2C_Scheduler::_release_phase = I2C_Scheduler::_tick.getTime_us();
+	I2C_Scheduler::_release_cycles = cycleCounterRead();
+	I2C_Scheduler::_active = stream;
+
+	// If nothing to do this time free the bus (transfers failing at once are closed by
+	// the idle callback)
+	if(!slot.job(slot.context)){
+		slot.skipped++;
+		if(I2C_Scheduler::_active == stream) I2C_Scheduler::_active = I2C_SCHEDULER_NO_STREAM;
+	}
+}
+
+/*
+ * @brief Closes the active release: latency, deadline and statistics.
+ *
+ */
+void I2C_Scheduler::complete(void){
+	uint8_t active = I2C_Scheduler::_active;
+	if(active == I2C_SCHEDULER_NO_STREAM) return;
+	I2C_Scheduler::_active = I2C_SCHEDULER_NO_STREAM;
+
+	I2C_Scheduler::Stream &stream = I2C_Scheduler::_streams[active];
+
+	uint32_t latency = cycleCounterElapsed(I2C_Scheduler::_release_cycles) / (SystemCoreClock / 1000000);
+	if(latency > 0xFFFF) latency = 0xFFFF;
+
+	stream.completions++;
+	stream.last_latency_us = latency;
+	if(latency > stream.max_latency_us) stream.max_latency_us = latency;
+	stream.busy_us += latency;
+
+	if(I2C_Scheduler::_release_phase + latency > stream.deadline_us) stream.missed++;
+}
+
+
+// --- Hooks ----------------------------------------------------------------------------
+
+/*
+ * @brief Compare channel hook, slot phase reached.
+ *
+ */
+void I2C_Scheduler::onSlot(void *context){
+	((I2C_Scheduler *)context)->dispatch();
+}
+
+/*
+ * @brief Bus idle callback, the active release is over.
+ *
+ */
+void I2C_Scheduler::onBusIdle(void *context, HAL_StatusTypeDef status){
+	(void)status;
+	((I2C_Scheduler *)context)->complete();
+}
+
+
+// END OF FILE
@@ -0,0 +1,181 @@
+/*
+ * i2c_statistics.cpp
+ *
+ * Implementation of i2c_statistics.hpp header file.
+ *
+ */
+
+#include "i2c_statistics.hpp"
+
+#include <stdio.h>
+
+
+
+// ---------------------------------------------- I2C_Statistics class implementation ---
+
+// --- Statistics constructor -----------------------------------------------------------
+
+/*
+ * @brief Constructs empty statistics.
+ *
+ */
+I2C_Statistics::I2C_Statistics(void){
+	I2C_Statistics::reset();
+}
+
+
+// --- Recording methods ----------------------------------------------------------------
+
+/*
+ * @brief Records a finished transfer. Called from the main loop and from the bus
+ * interrupts, so the update is done with interrupts masked.
+ *
+ * @param status		Result of the transfer;
+ * @param error_code	HAL error code of the handle (NACK, timeout flags);
+ * @param bytes			Data bytes of the transfer;
+ * @param cycles		Duration of the transfer [CPU cycles];
+ *
+ */
+void I2C_Statistics::record(HAL_StatusTypeDef status, uint32_t error_code, uint16_t bytes, uint32_t cycles){
+	uint32_t latency = cycles / (SystemCoreClock / 1000000);
+	if(latency > 0xFFFF) latency = 0xFFFF;
+
+	// Find the histogram bin
+	uint8_t bin = 0;
+	uint32_t limit = I2C_STATISTICS_FIRST_BIN_US;
+	while(bin < I2C_STATISTICS_BINS - 1 && latency >= limit){
+		limit <<= 1;
+		bin++;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	I2C_Statistics::_transactions++;
+
+	// Classify the result
+	if(status == HAL_OK) I2C_Statistics::_bytes += bytes;
+	else {
+		I2C_Statistics::_errors++;
+
+		if(status == HAL_BUSY) I2C_Statistics::_busy++;
+		else if(status == HAL_TIMEOUT || (error_code & HAL_I2C_ERROR_TIMEOUT)) I2C_Statistics::_timeouts++;
+		else if(error_code & HAL_I2C_ERROR_AF) I2C_Statistics::_nacks++;
+	}
+
+	// Update latency
+	I2C_Statistics::_last_latency = latency;
+	if(latency < I2C_Statistics::_min_latency) I2C_Statistics::_min_latency = latency;
+	if(latency > I2C_Statistics::_max_latency) I2C_Statistics::_max_latency = latency;
+	I2C_Statistics::_latency_sum += latency;
+	I2C_Statistics::_histogram[bin]++;
+
+	__set_PRIMASK(primask);
+}
+
+/*
+ * @brief Counts a repeated transfer.
+ *
+ */
+void I2C_Statistics::recordRetry(void){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	I2C_Statistics::_retries++;
+
+	__set_PRIMASK(primask);
+}
+
+/*
+ * @brief Clears all the counters.
+ *
+ */
+void I2C_Statistics::reset(void){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	I2C_Statistics::_transactions = 0;
+	I2C_Statistics::_bytes = 0;
+
+	I2C_Statistics::_nacks = 0;
+	I2C_Statistics::_timeouts = 0;
+	I2C_Statistics::_busy = 0;
+	I2C_Statistics::_errors = 0;
+	I2C_Statistics::_retries = 0;
+
+	I2C_Statistics::_last_latency = 0;
+	I2C_Statistics::_min_latency = 0xFFFF;
+	I2C_Statistics::_max_latency = 0;
+	I2C_Statistics::_latency_sum = 0;
+
+	for(uint8_t i = 0; i < I2C_STATISTICS_BINS; i++) I2C_Statistics::_histogram[i] = 0;
+
+	__set_PRIMASK(primask);
+}
+
+
+// --- Getter methods -------------------------------------------------------------------
+
+/*
+ * @brief Returns the average transaction latency.
+ *
+ */
+uint16_t I2C_Statistics::getAverageLatency_us(void){
+	// If no transactions return zero
+	if(I2C_Statistics::_transactions == 0) return 0;
+
+	return I2C_Statistics::_latency_sum / I2C_Statistics::_transactions;
+}
+
+/*
+ * @brief Returns the upper limit of a histogram bin.
+ *
+ * @param bin	Bin index;
+ *
+ */
+uint32_t I2C_Statistics::getBinLimit_us(uint8_t bin){
+	if(bin >= I2C_STATISTICS_BINS - 1) return 0;
+
+	return (uint32_t)I2C_STATISTICS_FIRST_BIN_US << bin;
+}
+
+
+// --- Dump -----------------------------------------------------------------------------
+
+/*
+ * @brief Prints the counters and the histogram, one line each (integers only, fits the
+ * nano printf).
+ *
+ * @param name	Label of the device;
+ *
+ */
+void I2C_Statistics::print(const char *name){
+	printf("%s: %lu transactions, %lu bytes, %lu errors (%lu NACK, %lu timeout, %lu busy), %lu retries\r\n",
+			name,
+			(unsigned long)I2C_Statistics::_transactions,
+			(unsigned long)I2C_Statistics::_bytes,
+			(unsigned long)I2C_Statistics::_errors,
+			(unsigned long)I2C_Statistics::_nacks,
+			(unsigned long)I2C_Statistics::_timeouts,
+			(unsigned long)I2C_Statistics::_busy,
+			(unsigned long)I2C_Statistics::_retries
+			);
+
+	printf("%s: latency min %u us, avg %u us, max %u us\r\n",
+			name,
+			(unsigned)I2C_Statistics::getMinLatency_us(),
+			(unsigned)I2C_Statistics::getAverageLatency_us(),
+			(unsigned)I2C_Statistics::_max_latency
+			);
+
+	printf("%s: histogram", name);
+	for(uint8_t i = 0; i < I2C_STATISTICS_BINS; i++){
+		uint32_t limit = I2C_Statistics::getBinLimit_us(i);
+		if(limit != 0) printf(" <%lu:%lu", (unsigned long)limit, (unsigned long)I2C_Statistics::_histogram[i]);
+		else printf(" more:%lu", (unsigned long)I2C_Statistics::_histogram[i]);
+	}
+	printf("\r\n");
+}
+
+
+// END OF FILE
@@ -21,17 +21,34 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "i2c_bus.hpp"
+#include "i2c_scheduler.hpp"
+#include "control_tick.hpp"
+#include "benchmark.hpp"
+#include "cascade_controller.hpp"
+#include "observer.hpp"
+#include "multiturn_tracker.hpp"
+#include "angle_tracker.hpp"
 #include "AS5600.hpp"
-#include "INA219.hpp"
+#include "AS5600_analog.hpp"
+#include "AS5600_pwm.hpp"
+#include "motor_power_stage.hpp"
+#include "conversion_policy.hpp"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN PTD */
+struct Angle_Read {						// Angle slot of the encoder, read into a handle
+	AS5600 *encoder;
+	Async_Result<uint16_t> result;		// Ready if the read of the last slot arrived
+};
 
 /* USER CODE END PTD */
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define AS5600_OUT_PWM	1		// AS5600 OUT pin (PA0) decoded as PWM on TIM2, else sampled by ADC1
+#define ENCODER_ON_I2C2	0		// AS5600 on its own bus (I2C2, PB10/PB11), else shares I2C1 with the INA219s
 
 /* USER CODE END PD */
 
@@ -42,8 +59,12 @@
 
 /* Private variables ---------------------------------------------------------*/
 I2C_HandleTypeDef hi2c1;
+I2C_HandleTypeDef hi2c2;
+DMA_HandleTypeDef hdma_i2c1_rx;
+DMA_HandleTypeDef hdma_i2c1_tx;
 
 TIM_HandleTypeDef htim1;
+TIM_HandleTypeDef htim3;
 
 /* USER CODE BEGIN PV */
 
@@ -53,15 +74,40 @@ TIM_HandleTypeDef htim1;
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_TIM1_Init(void);
 static void MX_I2C1_Init(void);
+void MX_I2C2_Init(void);
+static void MX_TIM3_Init(void);
 /* USER CODE BEGIN PFP */
 
-float i1 = 0, i2 = 0, i = 0;
+q16_t i1 = 0, i2 = 0, i = 0;				// Q16.16 [A]
 
-float v_bus1 = 0, v_bus2 = 0, v = 0;
+q16_t v_bus1 = 0, v_bus2 = 0, v = 0;		// Q16.16 [V]
+
+q16_t angle = 0;							// Q16.16 [deg]
+
+q16_t duty = 0;								// Q16.16 [-1, 1]
+
+q16_t speed_estimate = 0;					// Q16.16 [rad/s], motor
+q16_t output_velocity = 0, output_acceleration = 0;	// Q16.16 [rad/s], [rad/s^2], output shaft
+
+uint16_t current_latency = 0;				// INA219 conversion seen on the bus [us]
+uint8_t power_transactions = 0;				// I2C transactions of the last power stage batch
+
+uint32_t bus_missed_deadlines = 0;			// I2C schedulers, all streams
+uint16_t encoder_bus_latency = 0;			// Slot release to angle read [us]
+uint32_t angle_stale = 0;					// Ticks without the angle of the last slot (failed or late)
+uint16_t angle_ready_us = 0;				// Tick time the I2C angle is in [us], 505 on I2C1, 315 on I2C2 in the SIL loop
+uint8_t magnet_status = 0;					// AS5600 MH, ML and MD bits, every 100 ms
+
+uint32_t encoder_bus_errors = 0;			// AS5600 failed transfers (NACK, timeout, busy)
+uint16_t encoder_max_latency = 0;			// AS5600 slowest transfer [us]
+uint32_t bus_recoveries = 0;				// Stuck bus recoveries, all buses
+
+bool use_out_angle = false;			// Angle from the OUT pin or over I2C, can be switched at runtime
+float out_sample_rate = 0;
 
-float angle = 0;
 
 /* USER CODE END PFP */
 
@@ -76,11 +122,67 @@ float angle = 0;
 int main(void)
 {
   /* USER CODE BEGIN 1 */
-	AS5600 Encoder(&hi2c1, 0x36, AS5600::CLOCK_WISE, 0x01);
+	I2C_Bus Bus1(&hi2c1, I2C_Bus::DMA);
+#if ENCODER_ON_I2C2
+	I2C_Bus Bus2(&hi2c2, I2C_Bus::INTERRUPT);		// Two byte reads, no DMA channel needed
+	I2C_HandleTypeDef *const encoder_i2c = &hi2c2;
+#else
+	I2C_HandleTypeDef *const encoder_i2c = &hi2c1;
+#endif
+
+	Control_Tick Tick(&htim3);		// 1 ms control period (uc.Ts)
+
+	AS5600 Encoder(encoder_i2c, 0x36, AS5600::CLOCK_WISE, 50);		// Blocking reads give up after about 275 us
+	Angle_Read EncoderAngle = {&Encoder, Async_Result<uint16_t>()};
+#if AS5600_OUT_PWM
+	AS5600_PWM EncoderOut(&Encoder, AS5600::PWM_920Hz, AS5600::CLOCK_WISE);		// Falls back to I2C
+#else
+	AS5600_Analog EncoderOut(0, AS5600::ANALOG_FULL_RANGE, AS5600::CLOCK_WISE);
+#endif
 
 	const float shunt_resistor = 0.1, max_expected_current = 3.0;	// Ohms, Amps
-	INA219 CurrentSensor1(&hi2c1, max_expected_current, shunt_resistor, 0x40, 0x01);
-	INA219 CurrentSensor2(&hi2c1, max_expected_current, shunt_resistor, 0x44, 0x01);
+	Motor_Power_Stage PowerStage(&hi2c1, max_expected_current, shunt_resistor, 0x40, 0x44, 50);
+
+	// Bus slots after the tick work (no blocking I2C in flight), 400 kHz: CONF write about
+	// 95 us with its STOP, register read about 117 us. Power conversions end by 622 us (both
+	// CONF writes + 232 us), the angle is read in the middle of them (slot moved after the
+	// trigger, at 390 us), the four power reads end by 1000 us.
+	// Magnet diagnostics take the start of a tick, once every 100 ms.
+	// On its own bus the encoder has its own table: the angle is read during the power
+	// trigger. Measured in the SIL loop (bench_i2c_bus.cpp): angle ready at 315 us instead
+	// of 505 us, I2C1 busy 654 us per tick instead of 771.
+	I2C_Scheduler Scheduler(Bus1, Tick);
+#if ENCODER_ON_I2C2
+	I2C_Scheduler EncoderScheduler(Bus2, Tick);
+	I2C_Scheduler &EncoderSlots = EncoderScheduler;
+	const uint16_t encoder_release_us = 200;
+#else
+	I2C_Scheduler &EncoderSlots = Scheduler;
+	const uint16_t encoder_release_us = 380;
+#endif
+
+	const uint8_t power_trigger_stream = Scheduler.addStream("power trigger", 1, 190, 200, 400,
+			[](void *context){ return ((Motor_Power_Stage *)context)->trigger(); }, &PowerStage);
+	const uint8_t power_collect_stream = Scheduler.addStream("power collect", 1, 470, 530, 1000,
+			[](void *context){ return ((Motor_Power_Stage *)context)->collect(); }, &PowerStage);
+	const uint8_t encoder_stream = EncoderSlots.addStream("encoder angle", 1, 112, encoder_release_us, 530,
+			[](void *context){ Angle_Read *read = (Angle_Read *)context; return read->encoder->readRawAngleAsync(read->result); }, &EncoderAngle);
+	EncoderSlots.addStream("magnet status", 100, 90, 0, 200,
+			[](void *context){ return ((AS5600 *)context)->requestStatus(); }, &Encoder);
+	EncoderSlots.addStream("magnet strength", 100, 140, 0, 200,
+			[](void *context){ return ((AS5600 *)context)->requestMagnitude(); }, &Encoder);
+
+	Conversion_Policy PowerPolicy(PowerStage);	// ADC settings from the controller state
+
+	Cascade_Controller Controller;	// Disabled until a mode is selected
+
+	Observer SpeedObserver;			// Speed from angle and current (Observer_Tune.m)
+
+	Multiturn_Tracker OutputShaft(1000, SATURATION_SPEED * OBSERVER_GEARBOX);	// 1 kHz, sat.w at the output
+	Angle_Tracker OutputTracker(1000);	// Velocity and acceleration from the counts
+
+	Benchmark SensorsProbe("sensors"), ObserverProbe("observer"), ControllerProbe("controller");
+	Benchmark AngleI2CProbe("angle i2c"), AngleOutProbe("angle out"), TrackerProbe("tracker");
 
   /* USER CODE END 1 */
 
@@ -102,9 +204,54 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_TIM1_Init();
   MX_I2C1_Init();
+  MX_TIM3_Init();
   /* USER CODE BEGIN 2 */
+  Bus1.begin();
+#if ENCODER_ON_I2C2
+  // Call not generated and not static (see the .ioc), the pins stay free without the option
+  MX_I2C2_Init();
+  Bus2.begin();
+#endif
+
+#ifdef DEBUG
+  // Check the configuration shadows against the chips during the setup
+  Encoder.setShadowVerify(true);
+  PowerStage.getSensor(1).setShadowVerify(true);
+  PowerStage.getSensor(2).setShadowVerify(true);
+#endif
+
+  cycleCounterBegin();
+
+#if AS5600_OUT_PWM
+  Encoder.setPWMFrequency(AS5600::PWM_920Hz);
+  Encoder.setOutputMode(AS5600::DIGITAL_PWM);
+  EncoderOut.begin();
+  HAL_Delay(5);
+#else
+  Encoder.setOutputMode(AS5600::ANALOG_FULL_RANGE);
+  EncoderOut.begin();
+  EncoderOut.calibrate(Encoder);
+#endif
+  out_sample_rate = EncoderOut.measureSampleRate_Hz();
+  OutputShaft.reset(Encoder.getRawAngle());
+  SpeedObserver.reset(OutputShaft.getAngle());
+
+  Scheduler.build();
+  PowerStage.begin(Tick.getPeriod_us(), Scheduler.getPhase_us(power_trigger_stream), Scheduler.getPhase_us(power_collect_stream));
+#ifdef DEBUG
+  // Setup checked, the loop reads the shadows without bus time
+  Encoder.setShadowVerify(false);
+  PowerStage.getSensor(1).setShadowVerify(false);
+  PowerStage.getSensor(2).setShadowVerify(false);
+#endif
+  Scheduler.begin();
+#if ENCODER_ON_I2C2
+  EncoderScheduler.begin(I2C_SCHEDULER_CHANNEL + 1);
+#endif
+  Tick.begin();
 
   /* USER CODE END 2 */
 
@@ -114,21 +261,92 @@ int main(void)
   {
     /* USER CODE END WHILE */
 
+	Tick.wait();
+
+	SensorsProbe.start();
+
+	// Batch converted in the previous period, both chips taken at the trigger phase
+	PowerStage.update();
+	current_latency = PowerStage.getSensor(1).getConversionLatency_us();
+	power_transactions = PowerStage.getLastTransactionCount();
+
+	i1 = PowerStage.getSensorCurrent_Q16(1);
+	i2 = PowerStage.getSensorCurrent_Q16(2);
+	i = PowerStage.getCurrent_Q16();
+
+	v_bus1 = PowerStage.getSensorBusVoltage_Q16(1);
+	v_bus2 = PowerStage.getSensorBusVoltage_Q16(2);
+	v = PowerStage.getVoltage_Q16();
+
+	SensorsProbe.stop();
+
+	// Estimate the motor speed from the output angle, current and armature voltage. Over
+	// I2C the angle was read by its bus slot, in the middle of the power conversions
+	Benchmark &AngleProbe = use_out_angle ? AngleOutProbe : AngleI2CProbe;
+
+	AngleProbe.start();
+	uint16_t counts = use_out_angle ? EncoderOut.getRawAngle() : Encoder.getSampleRawAngle();
+	AngleProbe.stop();
+
+	// The handle tells if the read of the slot arrived, else the previous angle is used
+	if(!use_out_angle && !EncoderAngle.result.isReady()) angle_stale++;
+
+	angle = (q16_t)counts * 5760;		// Degrees, 360 in Q16.16 over 4096 counts
+
+	OutputShaft.update(counts);
+
+	TrackerProbe.start();
+	OutputTracker.update(counts);
+	TrackerProbe.stop();
+
+	output_velocity = OutputTracker.getVelocity();
+	output_acceleration = OutputTracker.getAcceleration();
+
+	// Between batches (HOLD profile) the power sample is repeated: the controller gets the
+	// current estimate instead, and the observer is not corrected from the old reading
+	bool current_fresh = PowerStage.getSample().fresh;
+
+	q16_t position = OutputShaft.getPosition();
+	q16_t current = current_fresh ? i : SpeedObserver.getCurrent();
+
+	ObserverProbe.start();
+	SpeedObserver.update(OutputShaft.getAngle(), current, v, current_fresh);
+	ObserverProbe.stop();
+
+	q16_t speed = SpeedObserver.getSpeed();
+	speed_estimate = speed;
+
+	// Run the controller and drive the H-bridge (CH1 forward, CH3 reverse)
+	ControllerProbe.start();
+	q16_t output = Controller.update(position, speed, current);
+	ControllerProbe.stop();
+	duty = output;
 
-	bool connected = CurrentSensor1.isConnected();
-	connected = CurrentSensor2.isConnected();
+	PowerPolicy.update(Controller, speed, current);
 
-	i1 = CurrentSensor1.getCurrent_A();
-	i2 = CurrentSensor2.getCurrent_A();
-	i = (i1 - i2) / 2;
+	uint32_t compare = ((int64_t)(output < 0 ? -output : output) * (htim1.Init.Period + 1)) >> 16;
+	__HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_1, output > 0 ? compare : 0);
+	__HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_3, output < 0 ? compare : 0);
 
-	v_bus1 = CurrentSensor1.getBusVoltage_V();
-	v_bus2 = CurrentSensor2.getBusVoltage_V();
-	v = (v_bus2 - v_bus1);
+	bus_missed_deadlines = Scheduler.getMissedDeadlines();
+	encoder_bus_latency = EncoderSlots.getStream(encoder_stream).last_latency_us;
+	angle_ready_us = EncoderSlots.getPhase_us(encoder_stream) + encoder_bus_latency;
+	magnet_status = Encoder.getSampleStatus();
+	encoder_bus_errors = Encoder.getStatistics().getErrors();
+	encoder_max_latency = Encoder.getStatistics().getMaxLatency_us();
+	bus_recoveries = Bus1.getRecoveryCount();
+#if ENCODER_ON_I2C2
+	bus_missed_deadlines += EncoderScheduler.getMissedDeadlines();
+	bus_recoveries += Bus2.getRecoveryCount();
+#endif
 
-	angle = Encoder.getRealAngle(AS5600::DEGREES);
+	// Restart queued transfers held back by a blocking read, recover a stuck bus
+	Bus1.service();
+#if ENCODER_ON_I2C2
+	Bus2.service();
+#endif
 
-	HAL_Delay(1);
+	Tick.done();
 
     /* USER CODE BEGIN 3 */
   }
@@ -207,6 +425,40 @@ static void MX_I2C1_Init(void)
 
 }
 
+/**
+  * @brief I2C2 Initialization Function
+  * @param None
+  * @retval None
+  */
+void MX_I2C2_Init(void)
+{
+
+  /* USER CODE BEGIN I2C2_Init 0 */
+
+  /* USER CODE END I2C2_Init 0 */
+
+  /* USER CODE BEGIN I2C2_Init 1 */
+
+  /* USER CODE END I2C2_Init 1 */
+  hi2c2.Instance = I2C2;
+  hi2c2.Init.ClockSpeed = 400000;
+  hi2c2.Init.DutyCycle = I2C_DUTYCYCLE_2;
+  hi2c2.Init.OwnAddress1 = 0;
+  hi2c2.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+  hi2c2.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+  hi2c2.Init.OwnAddress2 = 0;
+  hi2c2.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+  hi2c2.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+  if (HAL_I2C_Init(&hi2c2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN I2C2_Init 2 */
+
+  /* USER CODE END I2C2_Init 2 */
+
+}
+
 /**
   * @brief TIM1 Initialization Function
   * @param None
@@ -286,6 +538,95 @@ static void MX_TIM1_Init(void)
 
 }
 
+/**
+  * @brief TIM3 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM3_Init(void)
+{
+
+  /* USER CODE BEGIN TIM3_Init 0 */
+
+  /* USER CODE END TIM3_Init 0 */
+
+  TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+  TIM_OC_InitTypeDef sConfigOC = {0};
+
+  /* USER CODE BEGIN TIM3_Init 1 */
+
+  /* USER CODE END TIM3_Init 1 */
+  htim3.Instance = TIM3;
+  htim3.Init.Prescaler = 63;
+  htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim3.Init.Period = 999;
+  htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+  if (HAL_TIM_Base_Init(&htim3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+  if (HAL_TIM_ConfigClockSource(&htim3, &sClockSourceConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_TIM_OC_Init(&htim3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim3, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfigOC.OCMode = TIM_OCMODE_TIMING;
+  sConfigOC.Pulse = 0;
+  sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+  sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+  if (HAL_TIM_OC_ConfigChannel(&htim3, &sConfigOC, TIM_CHANNEL_1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_TIM_OC_ConfigChannel(&htim3, &sConfigOC, TIM_CHANNEL_2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_TIM_OC_ConfigChannel(&htim3, &sConfigOC, TIM_CHANNEL_3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_TIM_OC_ConfigChannel(&htim3, &sConfigOC, TIM_CHANNEL_4) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM3_Init 2 */
+
+  /* USER CODE END TIM3_Init 2 */
+
+}
+
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Channel6_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+  /* DMA1_Channel7_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
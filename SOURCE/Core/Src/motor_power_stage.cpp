@@ -0,0 +1,323 @@
+/*
+ * motor_power_stage.cpp
+ *
+ * Implementation of motor_power_stage.hpp header file.
+ *
+ */
+
+#include "motor_power_stage.hpp"
+
+
+
+// ------------------------------------------- Motor_Power_Stage class implementation ---
+
+// --- Stage constructor ----------------------------------------------------------------
+
+/*
+ * @brief Constructs the stage and its two sensors, with no correction.
+ *
+ * @param device_handle			I2C bus handle object;
+ * @param max_expected_current	Highest current through each shunt resistor;
+ * @param shunt_resistor		Value of the shunt resistors;
+ * @param address_1				Address of the sensor seeing the motor current;
+ * @param address_2				Address of the sensor seeing the opposite current;
+ * @param response_delay_us		Extra time allowed for the blocking accesses [us];
+ *
+ */
+Motor_Power_Stage::Motor_Power_Stage(
+I2C_HandleTypeDef *device_handle,
+float max_expected_current,
+float shunt_resistor,
+uint8_t address_1,
+uint8_t address_2,
+uint32_t response_delay_us
+) :
+		_sensor_1(device_handle, max_expected_current, shunt_resistor, address_1, response_delay_us),
+		_sensor_2(device_handle, max_expected_current, shunt_resistor, address_2, response_delay_us),
+		_sample(),
+		_connected(false),
+		_period(0),
+		_trigger_phase(0),
+		_collect_phase(0),
+		_divider(1),
+		_window(0),
+		_collected(false),
+		_batches(0),
+		_published(0),
+		_late(0),
+		_failed(0),
+		_restarts(0),
+		_last_transactions(0)
+	{
+		for(uint8_t i = 0; i < 2; i++){
+			Motor_Power_Stage::_current_gain[i] = qGainFromFloat(1);
+			Motor_Power_Stage::_current_offset[i] = 0;
+			Motor_Power_Stage::_voltage_gain[i] = qGainFromFloat(1);
+			Motor_Power_Stage::_voltage_offset[i] = 0;
+
+			Motor_Power_Stage::_sensor_current[i] = 0;
+			Motor_Power_Stage::_sensor_bus_voltage[i] = 0;
+		}
+	}
+
+
+// --- Stage core methods ---------------------------------------------------------------
+
+/*
+ * @brief Puts both chips in triggered mode (blocking accesses, call it before the tick
+ * starts) and schedules the batch on the tick phase hooks.
+ *
+ * @param tick				Control tick running the batch;
+ * @param trigger_phase_us	Conversion start after the tick event [us];
+ * @param collect_phase_us	Readout start, after the conversion time [us];
+ *
+ */
+bool Motor_Power_Stage::begin(Control_Tick &tick, uint16_t trigger_phase_us, uint16_t collect_phase_us){
+	// Configure both chips
+	if(!Motor_Power_Stage::begin(tick.getPeriod_us(), trigger_phase_us, collect_phase_us)) return false;
+
+	// Schedule the batch
+	if(!tick.setPhaseHook(MOTOR_POWER_STAGE_TRIGGER_CHANNEL, trigger_phase_us, Motor_Power_Stage::onTriggerPhase, this)) return false;
+	if(!tick.setPhaseHook(MOTOR_POWER_STAGE_COLLECT_CHANNEL, collect_phase_us, Motor_Power_Stage::onCollectPhase, this)) return false;
+
+	return true;
+}
+
+/*
+ * @brief Puts both chips in triggered mode (blocking accesses) without scheduling the
+ * batch: trigger() and collect() must then run every tick at the given phases, e.g.
+ * from bus scheduler slots.
+ *
+ * @param period_us			Control tick period [us];
+ * @param trigger_phase_us	Conversion start after the tick event [us];
+ * @param collect_phase_us	Readout start, after the conversion time [us];
+ *
+ */
+bool Motor_Power_Stage::begin(uint16_t period_us, uint16_t trigger_phase_us, uint16_t collect_phase_us){
+	// The readout must follow the trigger in the same period
+	if(collect_phase_us <= trigger_phase_us || collect_phase_us >= period_us) return false;
+
+	Motor_Power_Stage::_period = period_us;
+	Motor_Power_Stage::_trigger_phase = trigger_phase_us;
+	Motor_Power_Stage::_collect_phase = collect_phase_us;
+
+	// Configure both chips
+	if(!Motor_Power_Stage::_sensor_1.beginTriggered(INA219::BOTH_VOLTAGE_TRGD)) return false;
+	if(!Motor_Power_Stage::_sensor_2.beginTriggered(INA219::BOTH_VOLTAGE_TRGD)) return false;
+
+	return Motor_Power_Stage::setConversion(MOTOR_POWER_STAGE_SHUNT_RESOLUTION, MOTOR_POWER_STAGE_BUS_RESOLUTION);
+}
+
+/*
+ * @brief Publishes the batch collected in the previous period: applies the corrections
+ * and fuses the two chips. If no batch was collected, or either chip is not ready, the
+ * previous sample is kept, not fresh.
+ *
+ */
+bool Motor_Power_Stage::update(void){
+	INA219 *sensors[2] = {&(Motor_Power_Stage::_sensor_1), &(Motor_Power_Stage::_sensor_2)};
+
+	// If the batch is still converting nothing new
+	Motor_Power_Stage::_sample.fresh = false;
+	if(!Motor_Power_Stage::_collected) return false;
+	Motor_Power_Stage::_collected = false;
+
+	// Check both chips
+	bool ready = true, failed = false;
+	for(INA219 *sensor : sensors){
+		INA219::ACQUISITION_STATE state = sensor->getAcquisitionState();
+		if(state != INA219::ACQUISITION_READY) ready = false;
+		if(state == INA219::ACQUISITION_FAILED) failed = true;
+	}
+
+	Motor_Power_Stage::_connected = !failed;
+
+	// If not ready keep the previous sample
+	if(!ready){
+		if(failed) Motor_Power_Stage::_failed++;
+		else Motor_Power_Stage::_late++;
+
+		return false;
+	}
+
+	// Corrected chip readings
+	for(uint8_t i = 0; i < 2; i++){
+		int64_t current = qGainApply(Motor_Power_Stage::_current_gain[i], sensors[i]->getSampleCurrent_Q16());
+		int64_t voltage = qGainApply(Motor_Power_Stage::_voltage_gain[i], sensors[i]->getSampleBusVoltage_Q16());
+
+		Motor_Power_Stage::_sensor_current[i] = q16Clamp(current + Motor_Power_Stage::_current_offset[i], Q16_MAX);
+		Motor_Power_Stage::_sensor_bus_voltage[i] = q16Clamp(voltage + Motor_Power_Stage::_voltage_offset[i], Q16_MAX);
+	}
+
+	// Configuration writes, CNVR polls and shunt reads
+	Motor_Power_Stage::_last_transactions = 4 + sensors[0]->getPollCount() + sensors[1]->getPollCount();
+
+	// Fuse the legs: opposite currents, voltage across the motor
+	Motor_Power_Stage::Sample &sample = Motor_Power_Stage::_sample;
+
+	sample.current = (q16_t)(((int64_t)Motor_Power_Stage::_sensor_current[0] - Motor_Power_Stage::_sensor_current[1]) / 2);
+	sample.voltage = q16Clamp((int64_t)Motor_Power_Stage::_sensor_bus_voltage[1] - Motor_Power_Stage::_sensor_bus_voltage[0], Q16_MAX);
+	sample.power = q16Multiply(sample.voltage, sample.current);
+
+	if(sample.voltage > MOTOR_POWER_STAGE_DIRECTION_THRESHOLD) sample.direction = Motor_Power_Stage::FORWARD;
+	else if(sample.voltage < -MOTOR_POWER_STAGE_DIRECTION_THRESHOLD) sample.direction = Motor_Power_Stage::REVERSE;
+	else sample.direction = Motor_Power_Stage::STOPPED;
+
+	sample.fresh = true;
+	Motor_Power_Stage::_published++;
+	return true;
+}
+
+
+// --- Conversion settings --------------------------------------------------------------
+
+/*
+ * @brief Changes the ADC settings of both chips, applied by the next trigger with no
+ * extra bus access. The divider is the fewest ticks that fit the conversion between the
+ * trigger writes and the collect phase. If the running batch has more ticks left than a
+ * whole new one, it is dropped: the next trigger restarts the conversions.
+ *
+ * @param shunt		Shunt ADC resolution or averaging;
+ * @param bus		Bus ADC resolution or averaging;
+ *
+ */
+bool Motor_Power_Stage::setConversion(INA219::SHUNT_ADC_RESOLUTION shunt, INA219::BUS_ADC_RESOLUTION bus){
+	// Needs the batch timing from begin()
+	if(Motor_Power_Stage::_period == 0) return false;
+
+	if(!Motor_Power_Stage::_sensor_1.setTriggeredResolution(shunt, bus)) return false;
+	if(!Motor_Power_Stage::_sensor_2.setTriggeredResolution(shunt, bus)) return false;
+
+	// Conversion time in the first period: each chip is read one transaction after the
+	// end of its trigger write
+	int32_t budget = (int32_t)Motor_Power_Stage::_collect_phase - Motor_Power_Stage::_trigger_phase - MOTOR_POWER_STAGE_WRITE_TIME_US;
+	int32_t conversion = Motor_Power_Stage::_sensor_1.getTriggeredConversionTime_us();
+
+	// Add whole periods until the conversion fits
+	uint32_t divider = 1;
+	while(budget < conversion && divider < MOTOR_POWER_STAGE_MAX_DIVIDER){
+		budget += Motor_Power_Stage::_period;
+		divider++;
+	}
+
+	// The phase hooks move the window too
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(Motor_Power_Stage::_window > divider){
+		Motor_Power_Stage::_window = 0;
+		Motor_Power_Stage::_restarts++;
+	}
+	Motor_Power_Stage::_divider = divider;
+
+	__set_PRIMASK(primask);
+
+	return budget >= conversion;
+}
+
+
+// --- Batch steps ----------------------------------------------------------------------
+
+/*
+ * @brief Starts the conversions on both chips, without polling, if the previous batch
+ * window is over.
+ *
+ */
+bool Motor_Power_Stage::trigger(void){
+	if(Motor_Power_Stage::_window != 0) return false;
+
+	Motor_Power_Stage::_window = Motor_Power_Stage::_divider;
+	Motor_Power_Stage::_batches++;
+
+	bool queued = Motor_Power_Stage::_sensor_1.trigger(false);
+	queued |= Motor_Power_Stage::_sensor_2.trigger(false);
+
+	return queued;
+}
+
+/*
+ * @brief Queues the readout of both chips in the last tick of the batch window.
+ *
+ */
+bool Motor_Power_Stage::collect(void){
+	if(Motor_Power_Stage::_window == 0) return false;
+	if(--Motor_Power_Stage::_window != 0) return false;
+
+	bool queued = Motor_Power_Stage::_sensor_1.collect();
+	queued |= Motor_Power_Stage::_sensor_2.collect();
+	Motor_Power_Stage::_collected = true;
+
+	return queued;
+}
+
+
+// --- Getter methods -------------------------------------------------------------------
+
+/*
+ * @brief Returns the corrected current of one chip in the last batch.
+ *
+ * @param sensor	Sensor 1 or 2;
+ *
+ */
+q16_t Motor_Power_Stage::getSensorCurrent_Q16(uint8_t sensor){
+	if(sensor < 1 || sensor > 2) return 0;
+
+	return Motor_Power_Stage::_sensor_current[sensor - 1];
+}
+
+/*
+ * @brief Returns the corrected bus voltage of one chip in the last batch.
+ *
+ * @param sensor	Sensor 1 or 2;
+ *
+ */
+q16_t Motor_Power_Stage::getSensorBusVoltage_Q16(uint8_t sensor){
+	if(sensor < 1 || sensor > 2) return 0;
+
+	return Motor_Power_Stage::_sensor_bus_voltage[sensor - 1];
+}
+
+
+// --- Correction -----------------------------------------------------------------------
+
+/*
+ * @brief Sets the gain and offset correction of one chip, applied from the next batch.
+ *
+ * @param sensor		Sensor 1 or 2;
+ * @param correction	Current and bus voltage corrections;
+ *
+ */
+bool Motor_Power_Stage::setCorrection(uint8_t sensor, const Motor_Power_Stage::Correction &correction){
+	if(sensor < 1 || sensor > 2) return false;
+
+	uint8_t i = sensor - 1;
+
+	Motor_Power_Stage::_current_gain[i] = qGainFromFloat(correction.current_gain);
+	Motor_Power_Stage::_current_offset[i] = q16FromFloat(correction.current_offset);
+	Motor_Power_Stage::_voltage_gain[i] = qGainFromFloat(correction.voltage_gain);
+	Motor_Power_Stage::_voltage_offset[i] = q16FromFloat(correction.voltage_offset);
+
+	return true;
+}
+
+
+// --- Hooks ----------------------------------------------------------------------------
+
+/*
+ * @brief Trigger phase hook.
+ *
+ */
+void Motor_Power_Stage::onTriggerPhase(void *context){
+	((Motor_Power_Stage *)context)->trigger();
+}
+
+/*
+ * @brief Collect phase hook.
+ *
+ */
+void Motor_Power_Stage::onCollectPhase(void *context){
+	((Motor_Power_Stage *)context)->collect();
+}
+
+
+// END OF FILE
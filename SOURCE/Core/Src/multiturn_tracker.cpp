@@ -0,0 +1,90 @@
+/*
+ * multiturn_tracker.cpp
+ *
+ * Implementation of multiturn_tracker.hpp header file.
+ *
+ */
+
+#include "multiturn_tracker.hpp"
+
+
+
+// ------------------------------------------- Multiturn_Tracker class implementation ---
+
+// --- Tracker constructor --------------------------------------------------------------
+
+/*
+ * @brief Constructs the tracker. The first update() sets the starting point.
+ *
+ * @param sample_rate	Rate of the update() calls [Hz];
+ * @param max_speed		Maximum speed of the measured shaft [rad/s];
+ *
+ */
+Multiturn_Tracker::Multiturn_Tracker(float sample_rate, float max_speed) :
+		_initialized(false),
+		_last_raw(0),
+		_count(0),
+		_last_step(0),
+		_missed_samples(0)
+	{
+		// Counts covered in one sample at maximum speed, at least 1 LSB of noise
+		float step = max_speed / 6.2831853f * MULTITURN_COUNTS_PER_TURN / sample_rate;
+
+		if(step < 1) step = 1;
+		if(step > MULTITURN_COUNTS_PER_TURN) step = MULTITURN_COUNTS_PER_TURN;
+
+		Multiturn_Tracker::_max_step = (uint16_t)(step + 1);
+	}
+
+
+// --- Tracker core methods -------------------------------------------------------------
+
+/*
+ * @brief Adds a new single-turn reading and returns the multi-turn count.
+ *
+ * @param raw_angle		12-bit angle reading [counts];
+ *
+ */
+int32_t Multiturn_Tracker::update(uint16_t raw_angle){
+	raw_angle &= 0x0FFF;
+
+	// If first sample start from it
+	if(!Multiturn_Tracker::_initialized){
+		Multiturn_Tracker::reset(raw_angle);
+		return Multiturn_Tracker::_count;
+	}
+
+	// Compute step the shortest way round
+	int32_t step = (int32_t)raw_angle - Multiturn_Tracker::_last_raw;
+	if(step >= MULTITURN_HALF_TURN) step -= MULTITURN_COUNTS_PER_TURN;
+	if(step < -MULTITURN_HALF_TURN) step += MULTITURN_COUNTS_PER_TURN;
+
+	// A step the shaft cannot make in one period means lost samples
+	if(step > Multiturn_Tracker::_max_step || step < -Multiturn_Tracker::_max_step) Multiturn_Tracker::_missed_samples++;
+
+	// Accumulate
+	Multiturn_Tracker::_count += step;
+	Multiturn_Tracker::_last_step = step;
+	Multiturn_Tracker::_last_raw = raw_angle;
+
+	return Multiturn_Tracker::_count;
+}
+
+/*
+ * @brief Restarts counting from a reading.
+ *
+ * @param raw_angle		12-bit angle reading [counts];
+ * @param turns			Whole turns to start from;
+ *
+ */
+void Multiturn_Tracker::reset(uint16_t raw_angle, int32_t turns){
+	raw_angle &= 0x0FFF;
+
+	Multiturn_Tracker::_last_raw = raw_angle;
+	Multiturn_Tracker::_count = turns * MULTITURN_COUNTS_PER_TURN + raw_angle;
+	Multiturn_Tracker::_last_step = 0;
+	Multiturn_Tracker::_initialized = true;
+}
+
+
+// END OF FILE
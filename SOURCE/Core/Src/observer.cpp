@@ -0,0 +1,88 @@
+/*
+ * observer.cpp
+ *
+ * Implementation of observer.hpp header file.
+ *
+ */
+
+#include "observer.hpp"
+
+
+
+// ---------------------------------------------------- Observer class implementation ---
+
+// --- Observer constructor -------------------------------------------------------------
+
+/*
+ * @brief Constructs the observer with all the states at zero.
+ *
+ */
+Observer::Observer(void) :
+		_angle(0),
+		_speed(0),
+		_current(0)
+	{}
+
+
+// --- Observer core methods ------------------------------------------------------------
+
+/*
+ * @brief Advances the estimate by one sampling period. All the products use the states
+ * of the previous step, matrices are unrolled (zero entries skipped).
+ *
+ * @param angle			Measured output angle in [0, 2pi) [rad];
+ * @param current		Measured armature current [A];
+ * @param voltage		Armature voltage applied during the last period [V];
+ * @param current_fresh	False if the current is a repeated sample: not corrected from it;
+ *
+ */
+void Observer::update(q16_t angle, q16_t current, q16_t voltage, bool current_fresh){
+	q16_t angle_hat = (q16_t)(Observer::_angle >> 16);
+	q16_t speed_hat = (q16_t)(Observer::_speed >> 16);
+	q16_t current_hat = (q16_t)(Observer::_current >> 16);
+
+	// Compute output errors (angle error on the shortest way)
+	q16_t angle_error = angle - angle_hat;
+	if(angle_error > OBSERVER_HALF_TURN) angle_error -= 2 * OBSERVER_HALF_TURN;
+	if(angle_error < -OBSERVER_HALF_TURN) angle_error += 2 * OBSERVER_HALF_TURN;
+
+	q16_t current_error = current_fresh ? current - current_hat : 0;
+
+	// x += Ts * (A x + B v + L e)
+	Observer::_angle += qGainApplyQ32(OBSERVER_A12, speed_hat)
+					  + qGainApplyQ32(OBSERVER_L1, angle_error);
+
+	Observer::_speed += qGainApplyQ32(OBSERVER_A23, current_hat)
+					  + qGainApplyQ32(OBSERVER_L2, angle_error);
+
+	Observer::_current += qGainApplyQ32(OBSERVER_A32, speed_hat)
+						+ qGainApplyQ32(OBSERVER_A33, current_hat)
+						+ qGainApplyQ32(OBSERVER_B3, voltage)
+						+ qGainApplyQ32(OBSERVER_L3, current_error);
+
+	// Keep the angle in one turn
+	const int64_t full_turn = (int64_t)(2 * OBSERVER_HALF_TURN) << 16;
+	if(Observer::_angle >= full_turn) Observer::_angle -= full_turn;
+	if(Observer::_angle < 0) Observer::_angle += full_turn;
+
+	// Saturate the speed (large angle errors, e.g. at start-up)
+	const int64_t speed_limit = (int64_t)OBSERVER_SPEED_LIMIT << 16;
+	if(Observer::_speed > speed_limit) Observer::_speed = speed_limit;
+	if(Observer::_speed < -speed_limit) Observer::_speed = -speed_limit;
+}
+
+/*
+ * @brief Restarts the estimate from a measured angle and current, at standstill.
+ *
+ * @param angle		Measured output angle [rad];
+ * @param current	Measured armature current [A];
+ *
+ */
+void Observer::reset(q16_t angle, q16_t current){
+	Observer::_angle = (int64_t)angle << 16;
+	Observer::_speed = 0;
+	Observer::_current = (int64_t)current << 16;
+}
+
+
+// END OF FILE
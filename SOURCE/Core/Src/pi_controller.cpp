@@ -0,0 +1,107 @@
+/*
+ * pi_controller.cpp
+ *
+ * Implementation of pi_controller.hpp header file.
+ *
+ */
+
+#include "pi_controller.hpp"
+
+
+
+// ----------------------------------------------- PI_Controller class implementation ---
+
+// --- Controller constructor -----------------------------------------------------------
+
+/*
+ * @brief Constructs a PI controller.
+ *
+ * @param kp				Proportional gain;
+ * @param ki				Integral gain [1/s];
+ * @param sampling_time		Time between updates [s];
+ * @param output_limit		Symmetric saturation of the output;
+ *
+ */
+PI_Controller::PI_Controller(float kp, float ki, float sampling_time, float output_limit) :
+		_limit(q16FromFloat(output_limit)),
+		_integral(0),
+		_output(0)
+	{
+		PI_Controller::setGains(kp, ki, sampling_time);
+	}
+
+
+// --- Controller core methods ----------------------------------------------------------
+
+/*
+ * @brief Computes the new output. The integral is frozen while the output is saturated
+ * in the direction of the error (conditional integration) and clamped to the output
+ * limit, so the controller recovers from saturation without overshoot.
+ *
+ * @param reference	Desired value;
+ * @param measure	Measured value;
+ *
+ */
+q16_t PI_Controller::update(q16_t reference, q16_t measure){
+	// Compute error
+	q16_t error = q16Clamp((int64_t)reference - measure, Q16_MAX);
+
+	// Proportional term
+	int64_t proportional = qGainApply(PI_Controller::_kp, error);
+
+	// Integral increment in Q32.32
+	int64_t increment = qGainApplyQ32(PI_Controller::_ki_ts, error);
+
+	int64_t integral = PI_Controller::_integral + increment;
+
+	// Sum terms and saturate, dropping the increment if it pushes further into saturation
+	int64_t output = proportional + (integral >> 16);
+
+	if(output > PI_Controller::_limit){
+		output = PI_Controller::_limit;
+		if(increment > 0) integral = PI_Controller::_integral;
+	}
+	else if(output < -PI_Controller::_limit){
+		output = -PI_Controller::_limit;
+		if(increment < 0) integral = PI_Controller::_integral;
+	}
+
+	// Clamp the integral to the output range
+	int64_t integral_limit = (int64_t)PI_Controller::_limit << 16;
+	if(integral > integral_limit) integral = integral_limit;
+	if(integral < -integral_limit) integral = -integral_limit;
+
+	// Save state and return result
+	PI_Controller::_integral = integral;
+	PI_Controller::_output = (q16_t)output;
+
+	return PI_Controller::_output;
+}
+
+/*
+ * @brief Clears the integral and the output.
+ *
+ */
+void PI_Controller::reset(void){
+	PI_Controller::_integral = 0;
+	PI_Controller::_output = 0;
+}
+
+
+// --- Controller parameters ------------------------------------------------------------
+
+/*
+ * @brief Sets the gains (converted to fixed-point here, not in the update).
+ *
+ * @param kp				Proportional gain;
+ * @param ki				Integral gain [1/s];
+ * @param sampling_time		Time between updates [s];
+ *
+ */
+void PI_Controller::setGains(float kp, float ki, float sampling_time){
+	PI_Controller::_kp = qGainFromFloat(kp);
+	PI_Controller::_ki_ts = qGainFromFloat(ki * sampling_time);
+}
+
+
+// END OF FILE
@@ -0,0 +1,79 @@
+/*
+ * bench_drivers.cpp
+ *
+ * Micro-benchmarks of the blocking driver reads: simulated bus time per read (DWT
+ * cycles at 64 MHz) and host compute time of the register decoding.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "as5600_model.hpp"
+#include "ina219_model.hpp"
+
+#include "AS5600.hpp"
+#include "INA219.hpp"
+
+
+
+// --- Benchmark settings ---------------------------------------------------------------
+
+const uint32_t BENCH_DRIVER_READS = 1000;
+
+
+
+// --- Blocking reads -------------------------------------------------------------------
+
+BENCH(driver_blocking_reads){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model encoder_model;
+	INA219_Model sensor_model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &encoder_model);
+	fakeI2cAttach(I2C1, INA219_DEFAULT_ADDRESS, &sensor_model);
+
+	AS5600 encoder(&hi2c);
+	INA219 sensor(&hi2c, 3.2f, 0.01f);
+
+	// AS5600 raw angle
+	uint64_t start = fakeHalCycles();
+	for(uint32_t i = 0; i < BENCH_DRIVER_READS; i++) encoder.getRawAngle();
+	double angle_us = fixtureCycles_us(fakeHalCycles() - start) / BENCH_DRIVER_READS;
+
+	// INA219 current
+	start = fakeHalCycles();
+	for(uint32_t i = 0; i < BENCH_DRIVER_READS; i++) sensor.getCurrent_Q16();
+	double current_us = fixtureCycles_us(fakeHalCycles() - start) / BENCH_DRIVER_READS;
+
+	benchReport("AS5600::getRawAngle", "simulated time", angle_us, "us/read");
+	benchReport("INA219::getCurrent_Q16", "simulated time", current_us, "us/read");
+
+	CHECK(angle_us > 0 && current_us > 0);
+}
+
+
+// --- Decoding -------------------------------------------------------------------------
+
+BENCH(driver_decoding){
+	const Q_Gain current_lsb = qGainFromFloat(1e-4f * 65536);
+	volatile q16_t fixed_sink = 0;
+	volatile float float_sink = 0;
+
+	// Register to amps, as INA219::getCurrent_Q16
+	double start = benchHostTime_ns();
+	for(int32_t i = 0; i < 1000000; i++) fixed_sink = (q16_t)qGainApply(current_lsb, (int16_t)i);
+	double fixed_ns = (benchHostTime_ns() - start) / 1000000;
+
+	start = benchHostTime_ns();
+	for(int32_t i = 0; i < 1000000; i++) float_sink = (int16_t)i * 1e-4f;
+	double float_ns = (benchHostTime_ns() - start) / 1000000;
+
+	benchReport("qGainApply", "host time", fixed_ns, "ns/call");
+	benchReport("float multiply", "host time", float_ns, "ns/call");
+
+	CHECK(fixed_sink != 0 && float_sink != 0);
+}
+
+
+// END OF FILE
@@ -0,0 +1,101 @@
+/*
+ * bench_i2c_bus.cpp
+ *
+ * Micro-benchmarks of the asynchronous I2C bus engine: throughput of back to back
+ * queued reads against blocking ones, and the angle acquisition in the loop of main with
+ * the encoder on the shared bus or on its own (simulated time at 400 kHz).
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "as5600_model.hpp"
+#include "sil_runner.hpp"
+
+#include "AS5600.hpp"
+#include "i2c_bus.hpp"
+
+
+
+// --- Benchmark settings ---------------------------------------------------------------
+
+const uint32_t BENCH_BUS_READS = 1000;
+
+
+
+// --- Throughput -----------------------------------------------------------------------
+
+BENCH(bus_queue_throughput){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+
+	// Blocking: the thread waits for every read
+	uint64_t start = fakeHalCycles();
+	for(uint32_t i = 0; i < BENCH_BUS_READS; i++) encoder.getRawAngle();
+	double blocking_us = fixtureCycles_us(fakeHalCycles() - start) / BENCH_BUS_READS;
+
+	// Queued: the queue is kept full, the thread only submits
+	uint8_t buffer[2];
+	I2C_Bus::Transaction transaction = {};
+	transaction.device_address = AS5600_DEFAULT_ADDRESS << 1;
+	transaction.register_address = 0x0C;
+	transaction.direction = I2C_Bus::READ;
+	transaction.length = 2;
+	transaction.data_buffer = buffer;
+
+	uint32_t submitted = 0;
+	start = fakeHalCycles();
+	while(submitted < BENCH_BUS_READS || !bus.isIdle()){
+		if(submitted < BENCH_BUS_READS && bus.getPendingCount() < I2C_BUS_QUEUE_SIZE){
+			if(bus.submit(&transaction) == HAL_OK) submitted++;
+		}
+		else fakeHalAdvance_us(1);
+	}
+	double queued_us = fixtureCycles_us(fakeHalCycles() - start) / BENCH_BUS_READS;
+
+	// Wire time of a 2 byte register read: 5 bytes of 9 clocks and the START
+	double wire_us = (5 * 9 + 1) * 1e6 / hi2c.Init.ClockSpeed;
+
+	benchReport("blocking read", "simulated time", blocking_us, "us/read");
+	benchReport("queued read", "simulated time", queued_us, "us/read");
+	benchReport("queued read", "bus utilisation", 100.0 * wire_us / queued_us, "%");
+
+	// Same wire, same rate: the gain is the thread left free during the transfers
+	CHECK(bus.getCompletedCount() == BENCH_BUS_READS);
+	CHECK_NEAR(queued_us, blocking_us, 1.0);
+}
+
+
+// --- Bus layout -----------------------------------------------------------------------
+
+BENCH(bus_encoder_layout_acquisition){
+	const char *names[2] = {"encoder on I2C1", "encoder on I2C2"};
+
+	for(uint8_t layout = 0; layout < 2; layout++){
+		Sil_Runner runner(PLANT_DEFAULT_PARAMETERS, layout == 0 ? Sil_Runner::ENCODER_SHARED_I2C1 : Sil_Runner::ENCODER_OWN_I2C2);
+		CHECK(runner.begin());
+
+		runner.getController().setMode(Cascade_Controller::SPEED);
+		runner.getController().setSpeedReference(q16FromFloat(400));
+		runner.run(BENCH_BUS_READS);
+
+		I2C_Scheduler &encoder_slots = runner.getEncoderScheduler();
+		uint8_t stream = runner.getEncoderStream();
+
+		benchReport(names[layout], "angle ready", encoder_slots.getPhase_us(stream) + encoder_slots.getStream(stream).max_latency_us, "us");
+		benchReport(names[layout], "I2C1 busy", runner.getScheduler().getMeasuredUtilization() * runner.getTick().getPeriod_us(), "us/tick");
+
+		CHECK(encoder_slots.getMissedDeadlines() == 0);
+	}
+}
+
+
+// END OF FILE
@@ -0,0 +1,62 @@
+/*
+ * as5600_model.hpp
+ *
+ * Module containing a register model of the AS5600 encoder, attached to a fake I2C bus.
+ *
+ * The address pointer auto-increments, except when a read starts on the high byte of
+ * RAW ANGLE, ANGLE or MAGNITUDE: the pointer then wraps between that pair of registers
+ * (see data-sheet page 13). ANGLE follows RAW ANGLE and the zero position. Bytes read
+ * from the reserved addresses are counted.
+ *
+ */
+
+#pragma once
+
+#include "fake_hal.hpp"
+
+
+
+// --------------------------------------------------- AS5600_Model class declaration ---
+
+class AS5600_Model : public Fake_I2C_Slave {
+
+public:
+	AS5600_Model(void);
+
+	// --- Scripted values --------------------------------------------------------------
+
+	void setRawAngle(uint16_t raw_angle);
+	void setStatus(uint8_t status);
+	void setAGC(uint8_t agc);
+	void setMagnitude(uint16_t magnitude);
+
+	uint8_t getRegister(uint8_t address) const { return _registers[address]; };
+	void setRegister(uint8_t address, uint8_t value);
+
+	uint32_t getReads(void) const { return _reads; };		// Read transfers served
+	uint32_t getWrites(void) const { return _writes; };		// Write transfers, pointer only included
+	uint32_t getReservedReads(void) const { return _reserved_reads; };	// Bytes
+
+
+	// --- Bus side ---------------------------------------------------------------------
+
+	void write(const uint8_t *data, uint16_t length) override;
+	void read(uint8_t *data, uint16_t length) override;
+
+
+private:
+	uint8_t _registers[256];
+	uint8_t _pointer;
+	bool _wrapping;
+
+	uint32_t _reads;
+	uint32_t _writes;
+	uint32_t _reserved_reads;
+
+	void updateAngle(void);
+
+	bool isReserved(uint8_t address);
+};
+
+
+// END OF FILE
@@ -0,0 +1,113 @@
+/*
+ * fake_hal.hpp
+ *
+ * Module containing the control side of the host HAL simulation (see stm32f1xx_hal.h):
+ * simulated time, interrupts, I2C slaves and fault injection.
+ *
+ * Time only moves when the code under test reads the cycle counter (a few cycles per
+ * read), sleeps (__WFI), or a test advances it. Interrupts due are run at those points,
+ * unless masked (PRIMASK) or lower in priority than the running one:
+ *
+ * 			priority 0	I2C1 and I2C2 events (transfer completions)
+ * 			priority 1	timer update and compare events (control tick)
+ *
+ * I2C transfers last their bits at the bus speed (9 clocks a byte), the slaves attached
+ * to the bus exchange the bytes when the transfer completes. A transfer to an address
+ * with no slave ends with an acknowledge failure after the address byte. After every
+ * transfer the STOP keeps the BUSY flag (and CR1 STOP) set for one bit.
+ *
+ * Faults, per bus:
+ *
+ * 			hold SDA		a slave holds SDA low until clocked out on the GPIO pins,
+ * 							the BUSY flag stays latched until the peripheral is reset
+ * 			latch BUSY		BUSY set with free lines, cleared by HAL_I2C_Init
+ * 			lose completion	transfers end on the wire but never interrupt
+ * 			force NACK		transfers to an address fail at the address byte
+ * 			stretch			every transfer lasts longer (slave clock stretching)
+ *
+ * A start hook runs as a priority 1 interrupt inside the next thread-mode HAL start on a
+ * bus, between its state check and its lock, to reproduce a preemption in that window.
+ * A start on a handle already in that window is counted as a reentry.
+ *
+ */
+
+#pragma once
+
+#include "stm32f1xx_hal.h"
+
+
+
+// --- Simulation constants -------------------------------------------------------------
+
+const uint32_t FAKE_HAL_CORE_CLOCK = 64000000;		// Default SystemCoreClock	[Hz]
+const uint32_t FAKE_HAL_CYCLES_PER_READ = 4;		// Time of a cycle counter read
+const uint32_t FAKE_HAL_BUSY_TIMEOUT_MS = 25;		// HAL wait for the BUSY flag
+
+const uint8_t FAKE_I2C_MAX_SLAVES = 8;				// Slaves per bus
+const uint8_t FAKE_I2C_HOLD_FOREVER = 0xFF;			// SDA never released by clocking
+
+
+
+// ------------------------------------------------- Fake_I2C_Slave class declaration ---
+
+class Fake_I2C_Slave {
+
+public:
+	virtual ~Fake_I2C_Slave(){};
+
+	// Bytes written after the address byte (register pointer first), none for a probe
+	virtual void write(const uint8_t *data, uint16_t length) = 0;
+
+	// Bytes read after the address byte
+	virtual void read(uint8_t *data, uint16_t length) = 0;
+};
+
+
+
+// --- Simulation control ---------------------------------------------------------------
+
+typedef void (*Fake_Hook)(void *context);
+
+void fakeHalReset(void);					// Time zero, peripherals reset, slaves detached
+
+uint64_t fakeHalCycles(void);				// Simulated time		[cycles]
+uint32_t fakeHalTime_us(void);				// Simulated time		[us]
+
+void fakeHalAdvance_us(uint32_t time_us);	// Runs the interrupts due meanwhile
+void fakeHalAdvanceCycles(uint64_t cycles);
+
+bool fakeHalInInterrupt(void);
+
+uint32_t fakeHalMaxInterrupt_us(uint8_t priority);	// Longest interrupt of a priority
+void fakeHalResetInterruptStatistics(void);
+
+
+
+// --- I2C simulation -------------------------------------------------------------------
+
+void fakeI2cAttach(I2C_TypeDef *bus, uint8_t address, Fake_I2C_Slave *slave);	// 7 bit address
+void fakeI2cDetach(I2C_TypeDef *bus, uint8_t address);
+
+// Fault injection
+void fakeI2cHoldSda(I2C_TypeDef *bus, uint8_t clocks);	// Released after this many SCL pulses
+void fakeI2cLatchBusy(I2C_TypeDef *bus);
+void fakeI2cLoseCompletion(I2C_TypeDef *bus, uint32_t transfers);
+void fakeI2cForceNack(I2C_TypeDef *bus, uint8_t address, uint32_t transfers);
+void fakeI2cSetStretch_us(I2C_TypeDef *bus, uint32_t stretch_us);
+
+void fakeI2cSetStartHook(I2C_TypeDef *bus, Fake_Hook hook, void *context);	// Next thread-mode start
+
+// Counters
+uint32_t fakeI2cGetTransfers(I2C_TypeDef *bus);		// Started on the wire
+uint32_t fakeI2cGetBytes(I2C_TypeDef *bus);			// Bytes on the wire, addresses included
+uint32_t fakeI2cGetDmaTransfers(I2C_TypeDef *bus);
+uint32_t fakeI2cGetInits(I2C_TypeDef *bus);			// HAL_I2C_Init calls
+uint32_t fakeI2cGetBusyWaits(I2C_TypeDef *bus);		// Starts that waited FAKE_HAL_BUSY_TIMEOUT_MS
+uint32_t fakeI2cGetReentries(I2C_TypeDef *bus);		// Starts nested in another start
+uint32_t fakeI2cGetProbes(I2C_TypeDef *bus);		// HAL_I2C_IsDeviceReady calls
+uint32_t fakeI2cGetSclPulses(I2C_TypeDef *bus);		// Recovery clocks on the GPIO pins
+
+bool fakeI2cIsSdaHeld(I2C_TypeDef *bus);
+
+
+// END OF FILE
@@ -0,0 +1,73 @@
+/*
+ * ina219_model.hpp
+ *
+ * Module containing a register model of the INA219 current sensor, attached to a fake
+ * I2C bus.
+ *
+ * Registers are 16 bit, big endian. A write of one byte sets the register pointer, of
+ * three bytes the pointer and the register; reads start at the pointer and do not move
+ * it (see data-sheet page 15). CURRENT and POWER follow the scripted shunt and bus
+ * voltages through the calibration register.
+ *
+ * A configuration write in a triggered mode starts a conversion lasting the time set by
+ * the ADC settings (simulated time); the CNVR flag of the bus voltage register sets when
+ * it ends and clears on a POWER read or a configuration write.
+ *
+ */
+
+#pragma once
+
+#include "fake_hal.hpp"
+
+
+
+// --------------------------------------------------- INA219_Model class declaration ---
+
+class INA219_Model : public Fake_I2C_Slave {
+
+public:
+	INA219_Model(void);
+
+	// --- Scripted values --------------------------------------------------------------
+
+	void setShuntVoltage_uV(int32_t shunt_voltage);	// 10 uV resolution
+	void setBusVoltage_mV(uint32_t bus_voltage);	// 4 mV resolution
+	void setOverflow(bool overflow);
+
+	uint16_t getRegister(uint8_t address) const;
+	void setRegister(uint8_t address, uint16_t value);
+
+	bool isConverting(void) const;
+	uint32_t getConversions(void) const { return _conversions; };	// Triggered conversions started
+	uint32_t getReads(void) const { return _reads; };
+	uint32_t getWrites(void) const { return _writes; };			// Pointer only included
+
+
+	// --- Bus side ---------------------------------------------------------------------
+
+	void write(const uint8_t *data, uint16_t length) override;
+	void read(uint8_t *data, uint16_t length) override;
+
+
+private:
+	uint16_t _registers[6];
+	uint8_t _pointer;
+
+	int16_t _shunt_voltage;					// LSB 10 uV
+	uint16_t _bus_voltage;					// LSB 4 mV
+	bool _overflow;
+
+	bool _converting;
+	bool _ready;
+	uint64_t _conversion_end;
+
+	uint32_t _conversions;
+	uint32_t _reads;
+	uint32_t _writes;
+
+	void writeConfiguration(uint16_t value);
+	void updateConversion(void);
+};
+
+
+// END OF FILE
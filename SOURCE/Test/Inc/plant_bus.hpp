@@ -0,0 +1,104 @@
+/*
+ * plant_bus.hpp
+ *
+ * Module containing the sensors of a simulated plant on a fake I2C bus: an AS5600 and
+ * two INA219 register models, fed with the plant state. The AS5600 can sit on a bus of
+ * its own.
+ *
+ * The plant runs in simulated time: every access of the bus to a sensor first advances
+ * it to the current time (whole plant steps), so a register read returns the state at
+ * the moment of the transfer. The H-bridge duty is applied from the moment it is set.
+ *
+ */
+
+#pragma once
+
+#include "plant_model.hpp"
+#include "as5600_model.hpp"
+#include "ina219_model.hpp"
+
+
+
+// --- Plant bus settings ---------------------------------------------------------------
+
+// Plant step, 27 of them are the bridge delay (999 us)
+const uint32_t PLANT_BUS_STEP_US = 37;
+
+
+
+// ------------------------------------------------------ Plant_Bus class declaration ---
+
+class Plant_Bus {
+
+public:
+	Plant_Bus(
+			I2C_TypeDef *bus,
+			uint8_t encoder_address = 0x36,
+			uint8_t sensor_1_address = 0x40,
+			uint8_t sensor_2_address = 0x44,
+			const PLANT_PARAMETERS &parameters = PLANT_DEFAULT_PARAMETERS,
+			I2C_TypeDef *encoder_bus = nullptr		// Same bus as the INA219s if none
+			);
+	~Plant_Bus();
+
+
+	// --- Plant inputs -----------------------------------------------------------------
+
+	void setDuty(float duty);				// H-bridge duty in [-1, 1], from now on
+	void setLoadTorque(float load_torque);	// On the output shaft		[N*m]
+
+	void advance(void);						// Plant to the current simulated time
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	Plant_Model &getPlant(void){ return _plant; };
+	AS5600_Model &getEncoder(void){ return _encoder; };
+	INA219_Model &getSensor(uint8_t sensor){ return sensor == 2 ? _sensor_2 : _sensor_1; };
+
+
+private:
+	// --- Sensor proxy -----------------------------------------------------------------
+
+	// Advances the plant before the register model sees the transfer
+	class Plant_Slave : public Fake_I2C_Slave {
+
+	public:
+		Plant_Slave(Plant_Bus *owner, Fake_I2C_Slave *model) : _owner(owner), _model(model) {};
+
+		void write(const uint8_t *data, uint16_t length) override;
+		void read(uint8_t *data, uint16_t length) override;
+
+	private:
+		Plant_Bus *_owner;
+		Fake_I2C_Slave *_model;
+	};
+
+
+	// --- Variables --------------------------------------------------------------------
+
+	I2C_TypeDef *_bus;
+	I2C_TypeDef *_encoder_bus;
+	uint8_t _addresses[3];
+
+	Plant_Model _plant;
+	uint64_t _plant_cycles;					// Simulated time reached by the plant
+	float _duty;
+	float _load_torque;
+
+	AS5600_Model _encoder;
+	INA219_Model _sensor_1;
+	INA219_Model _sensor_2;
+
+	Plant_Slave _encoder_slave;
+	Plant_Slave _sensor_1_slave;
+	Plant_Slave _sensor_2_slave;
+
+
+	// --- Private methods --------------------------------------------------------------
+
+	void updateSensors(void);
+};
+
+
+// END OF FILE
@@ -0,0 +1,116 @@
+/*
+ * plant_model.hpp
+ *
+ * Module containing a simulator of the servo plant: H-bridge, DC motor and gearbox, plus
+ * the register values the AS5600 and the INA219 sensors would return for its state.
+ *
+ * Built from MODELS_AND_SIMULATIONS/Full_Model_params.m (same model as Full_Model_sim.slx)
+ * and free of HAL dependencies. Part of the host harness, the firmware does not link it:
+ * Plant_Bus serves its state as sensor registers on the fake I2C bus, and Sil_Runner
+ * closes the control loop of main against it (software-in-the-loop).
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+
+
+// --- Plant parameters -----------------------------------------------------------------
+
+struct PLANT_PARAMETERS {
+	float Ra;								// motor.Ra, armature resistance		[Ohm]
+	float La;								// motor.La, armature inductance		[H]
+	float Kphi;								// motor.Kphi, geometry constant		[V*s]
+	float J;								// motor.J, rotor inertia				[kg*m^2]
+	float B;								// motor.B, viscous friction			[N*m*s]
+	float gearbox;							// motor.gearbox, output / motor		[-]
+
+	float bridge_gain;						// bridge.gain, duty to voltage			[V]
+	float bridge_delay;						// bridge.Tdelay						[s]
+
+	float shunt_resistor;					// INA219 shunt							[Ohm]
+	float current_lsb;						// INA219 current register LSB			[A]
+};
+
+const PLANT_PARAMETERS PLANT_DEFAULT_PARAMETERS = {
+	2.0,									// Ra
+	7e-3,									// La
+	5.0 / (12000 * 0.104719755),			// Kphi = Vn / wmo
+	1.2e-7,									// J = 1.2 g*cm^2
+	0.0,									// B
+	11.0 / (61 * 36),						// gearbox
+	5.0,									// bridge_gain = pwr.Vcc
+	999.0 * 64 / 64e6,						// bridge_delay = 1 / uc.fpwm, 64 MHz / (999 * 64)
+	0.1,									// shunt_resistor
+	3.0 / 32768,							// current_lsb = max expected current / 2^15
+};
+
+const uint8_t PLANT_MAX_DELAY_STEPS = 32;		// Bridge delay line length
+const float PLANT_MAX_INTEGRATION_STEP = 20e-6;	// Below Te / 10 = 350 us		[s]
+
+
+
+// ---------------------------------------------------- Plant_Model class declaration ---
+
+class Plant_Model {
+
+public:
+	// --- Plant constructor ------------------------------------------------------------
+
+	Plant_Model(float sampling_time = 1e-3, const PLANT_PARAMETERS &parameters = PLANT_DEFAULT_PARAMETERS);
+
+
+	// --- Simulation methods -----------------------------------------------------------
+
+	void step(float duty, float load_torque = 0);
+
+	void reset(float position = 0);
+
+
+	// --- Plant state ------------------------------------------------------------------
+
+	float getTime(void){ return _time; };
+
+	float getPosition(void){ return _position; };		// Output shaft		[rad]
+	float getSpeed(void){ return _speed; };				// Motor shaft		[rad/s]
+	float getCurrent(void){ return _current; };			// Armature			[A]
+	float getVoltage(void){ return _voltage; };			// Armature			[V]
+
+
+	// --- Synthetic sensor registers ---------------------------------------------------
+
+	uint16_t getAS5600RawAngle(void);
+
+	uint16_t getINA219ShuntVoltage(uint8_t sensor);
+	uint16_t getINA219BusVoltage(uint8_t sensor);
+	uint16_t getINA219Current(uint8_t sensor);
+
+
+private:
+	// --- Plant variables --------------------------------------------------------------
+
+	PLANT_PARAMETERS _parameters;
+
+	float _sampling_time;
+	uint16_t _substeps;
+	uint8_t _delay_steps;
+
+	float _duty_line[PLANT_MAX_DELAY_STEPS];
+	uint8_t _duty_index;
+
+	float _time;
+	float _position;
+	float _speed;
+	float _current;
+	float _voltage;
+
+
+	// --- Private methods --------------------------------------------------------------
+
+	float getSensorCurrent(uint8_t sensor);
+};
+
+
+// END OF FILE
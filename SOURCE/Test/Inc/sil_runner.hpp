@@ -0,0 +1,142 @@
+/*
+ * sil_runner.hpp
+ *
+ * Module containing a software-in-the-loop runner: the control loop of main.cpp (angle
+ * over I2C, on the I2C1 bus shared with the INA219s or on I2C2 as with ENCODER_ON_I2C2)
+ * running on the fake HAL against the plant model.
+ *
+ * The firmware objects are the ones of main, built the same way: bus engine with DMA,
+ * 1 ms control tick on TIM3, bus slot table, power stage and conversion policy, output
+ * shaft tracker, speed observer and cascade controller. The duty of every
+ * tick drives the plant through Plant_Bus, and the sensors are read back on the bus.
+ *
+ */
+
+#pragma once
+
+#include "plant_bus.hpp"
+
+#include "i2c_bus.hpp"
+#include "i2c_scheduler.hpp"
+#include "control_tick.hpp"
+#include "AS5600.hpp"
+#include "motor_power_stage.hpp"
+#include "conversion_policy.hpp"
+#include "cascade_controller.hpp"
+#include "observer.hpp"
+#include "multiturn_tracker.hpp"
+
+
+
+// -------------------------------------------------- Sil_Hardware struct declaration ---
+
+// Peripherals as main.c initialises them, before the firmware objects are built
+struct Sil_Hardware {
+	Sil_Hardware(void);
+
+	I2C_HandleTypeDef hi2c1;
+	I2C_HandleTypeDef hi2c2;
+	DMA_HandleTypeDef hdma_i2c1_rx;
+	DMA_HandleTypeDef hdma_i2c1_tx;
+	TIM_HandleTypeDef htim3;
+};
+
+
+
+// ----------------------------------------------------- Sil_Runner class declaration ---
+
+class Sil_Runner {
+
+public:
+	// --- Bus layout -------------------------------------------------------------------
+
+	enum ENCODER_BUS : uint8_t {			// Bus of the AS5600, ENCODER_ON_I2C2 of main
+		ENCODER_SHARED_I2C1 	= 0x00,		// With the INA219s, one slot table
+		ENCODER_OWN_I2C2 		= 0x01,		// Own bus and slot table, no DMA
+	};
+
+
+	// --- Loop signals -----------------------------------------------------------------
+
+	struct Signals {						// As main computes them in the last tick
+		uint16_t counts;					// AS5600 raw angle
+		bool angle_fresh;					// Read of the last slot arrived, else previous
+		q16_t position;						// Output shaft, multi-turn	[rad]
+		q16_t speed;						// Motor, observer			[rad/s]
+		q16_t current;						// Motor, power stage		[A]
+		bool current_fresh;					// Else repeated, observer current used
+		q16_t voltage;						// Motor, power stage		[V]
+		q16_t duty;							// Controller output		[-1, 1]
+	};
+
+
+	// --- Runner constructor -----------------------------------------------------------
+
+	Sil_Runner(
+			const PLANT_PARAMETERS &parameters = PLANT_DEFAULT_PARAMETERS,
+			Sil_Runner::ENCODER_BUS encoder_bus = Sil_Runner::ENCODER_SHARED_I2C1
+			);
+
+
+	// --- Runner methods ---------------------------------------------------------------
+
+	bool begin(void);						// Setup of main, then the tick starts
+
+	void tick(void);						// One iteration of the main loop
+	void run(uint32_t ticks);
+
+
+	// --- Getter methods ---------------------------------------------------------------
+
+	const Sil_Runner::Signals &getSignals(void){ return _signals; };
+
+	Plant_Bus &getPlantBus(void){ return _plant_bus; };
+	Plant_Model &getPlant(void){ return _plant_bus.getPlant(); };
+
+	I2C_Bus &getBus(void){ return _bus; };
+	I2C_Bus &getEncoderBus(void){ return _encoder_bus == ENCODER_OWN_I2C2 ? _bus2 : _bus; };
+	Control_Tick &getTick(void){ return _tick; };
+	I2C_Scheduler &getScheduler(void){ return _scheduler; };
+	I2C_Scheduler &getEncoderScheduler(void){ return _encoder_bus == ENCODER_OWN_I2C2 ? _encoder_scheduler : _scheduler; };
+	uint8_t getEncoderStream(void){ return _encoder_stream; };	// In the encoder scheduler
+	const Async_Result<uint16_t> &getAngleResult(void){ return _angle_result; };	// Of the last slot
+	AS5600 &getEncoder(void){ return _encoder; };
+	Motor_Power_Stage &getPowerStage(void){ return _power_stage; };
+	Conversion_Policy &getPolicy(void){ return _policy; };
+	Cascade_Controller &getController(void){ return _controller; };
+	Observer &getObserver(void){ return _observer; };
+
+
+private:
+	// --- Variables, in construction order ---------------------------------------------
+
+	const Sil_Runner::ENCODER_BUS _encoder_bus;
+
+	Sil_Hardware _hardware;
+	Plant_Bus _plant_bus;
+
+	I2C_Bus _bus;
+	I2C_Bus _bus2;
+	Control_Tick _tick;
+
+	AS5600 _encoder;
+	Async_Result<uint16_t> _angle_result;
+	Motor_Power_Stage _power_stage;
+
+	I2C_Scheduler _scheduler;
+	I2C_Scheduler _encoder_scheduler;
+	uint8_t _power_trigger_stream;
+	uint8_t _power_collect_stream;
+	uint8_t _encoder_stream;
+
+	Conversion_Policy _policy;
+
+	Cascade_Controller _controller;
+	Observer _observer;
+	Multiturn_Tracker _output_shaft;
+
+	Sil_Runner::Signals _signals;
+};
+
+
+// END OF FILE
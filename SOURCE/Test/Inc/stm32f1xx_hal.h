@@ -0,0 +1,353 @@
+/*
+ * stm32f1xx_hal.h
+ *
+ * Host stand-in for the STM32F1 HAL, used by the unit tests and the benchmarks: the
+ * types, macros and functions the drivers use, backed by the simulation in fake_hal.hpp
+ * (cycle counter, interrupts, I2C peripherals with their slaves, timers and GPIO).
+ *
+ * Only what the host build compiles is declared. Register layouts are kept where the
+ * drivers access registers directly, values of the flags and modes are the simulation
+ * ones (the drivers never depend on the numbers).
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+
+// --- Status ---------------------------------------------------------------------------
+
+typedef enum {
+	HAL_OK 			= 0x00U,
+	HAL_ERROR 		= 0x01U,
+	HAL_BUSY 		= 0x02U,
+	HAL_TIMEOUT 	= 0x03U,
+} HAL_StatusTypeDef;
+
+#define __IO volatile
+
+
+
+// --- Core (CMSIS) ---------------------------------------------------------------------
+
+// Simulated cycle counter: every read advances the simulated time by a few cycles and
+// runs the interrupts due, so the busy-wait loops of the drivers make progress
+
+class Fake_Cycle_Counter {
+
+public:
+	operator uint32_t() const;
+	Fake_Cycle_Counter &operator=(uint32_t value);
+};
+
+typedef struct {
+	volatile uint32_t CTRL;
+	Fake_Cycle_Counter CYCCNT;
+} DWT_Type;
+
+typedef struct {
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type fake_dwt;
+extern CoreDebug_Type fake_core_debug;
+
+#define DWT 		(&fake_dwt)
+#define CoreDebug 	(&fake_core_debug)
+
+#define DWT_CTRL_CYCCNTENA_Msk 		(1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk 	(1UL << 24)
+
+extern "C" {
+
+extern uint32_t SystemCoreClock;
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+uint32_t __get_IPSR(void);					// Exception number, 0 in thread mode
+
+void __WFI(void);							// Jumps to the next interrupt
+
+}
+
+
+
+// --- GPIO -----------------------------------------------------------------------------
+
+typedef struct {
+	volatile uint32_t CRL;
+	volatile uint32_t CRH;
+	volatile uint32_t IDR;
+	volatile uint32_t ODR;
+	volatile uint32_t BSRR;
+	volatile uint32_t BRR;
+	volatile uint32_t LCKR;
+} GPIO_TypeDef;
+
+typedef struct {
+	volatile uint32_t EVCR;
+	volatile uint32_t MAPR;
+} AFIO_TypeDef;
+
+typedef struct {
+	uint32_t Pin;
+	uint32_t Mode;
+	uint32_t Pull;
+	uint32_t Speed;
+} GPIO_InitTypeDef;
+
+typedef enum {
+	GPIO_PIN_RESET = 0U,
+	GPIO_PIN_SET,
+} GPIO_PinState;
+
+extern GPIO_TypeDef fake_gpioa;
+extern GPIO_TypeDef fake_gpiob;
+extern AFIO_TypeDef fake_afio;
+
+#define GPIOA 	(&fake_gpioa)
+#define GPIOB 	(&fake_gpiob)
+#define AFIO 	(&fake_afio)
+
+#define GPIO_PIN_0 		((uint16_t)0x0001)
+#define GPIO_PIN_1 		((uint16_t)0x0002)
+#define GPIO_PIN_2 		((uint16_t)0x0004)
+#define GPIO_PIN_3 		((uint16_t)0x0008)
+#define GPIO_PIN_4 		((uint16_t)0x0010)
+#define GPIO_PIN_5 		((uint16_t)0x0020)
+#define GPIO_PIN_6 		((uint16_t)0x0040)
+#define GPIO_PIN_7 		((uint16_t)0x0080)
+#define GPIO_PIN_8 		((uint16_t)0x0100)
+#define GPIO_PIN_9 		((uint16_t)0x0200)
+#define GPIO_PIN_10 	((uint16_t)0x0400)
+#define GPIO_PIN_11 	((uint16_t)0x0800)
+#define GPIO_PIN_12 	((uint16_t)0x1000)
+#define GPIO_PIN_13 	((uint16_t)0x2000)
+#define GPIO_PIN_14 	((uint16_t)0x4000)
+#define GPIO_PIN_15 	((uint16_t)0x8000)
+
+#define GPIO_MODE_INPUT 		0x00000000U
+#define GPIO_MODE_OUTPUT_PP 	0x00000001U
+#define GPIO_MODE_OUTPUT_OD 	0x00000011U
+#define GPIO_MODE_AF_OD 		0x00000012U
+
+#define GPIO_NOPULL 			0x00000000U
+#define GPIO_SPEED_FREQ_HIGH 	0x00000003U
+
+#define AFIO_MAPR_I2C1_REMAP 	(1UL << 1)
+
+extern "C" {
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+}
+
+
+
+// --- DMA ------------------------------------------------------------------------------
+
+typedef struct {
+	void *Instance;
+} DMA_HandleTypeDef;
+
+
+
+// --- I2C ------------------------------------------------------------------------------
+
+typedef struct {
+	volatile uint32_t CR1;
+	volatile uint32_t CR2;
+	volatile uint32_t OAR1;
+	volatile uint32_t OAR2;
+	volatile uint32_t DR;
+	volatile uint32_t SR1;
+	volatile uint32_t SR2;
+	volatile uint32_t CCR;
+	volatile uint32_t TRISE;
+} I2C_TypeDef;
+
+typedef struct {
+	uint32_t ClockSpeed;
+	uint32_t DutyCycle;
+	uint32_t OwnAddress1;
+	uint32_t AddressingMode;
+	uint32_t DualAddressMode;
+	uint32_t OwnAddress2;
+	uint32_t GeneralCallMode;
+	uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef enum {
+	HAL_I2C_STATE_RESET 	= 0x00U,
+	HAL_I2C_STATE_READY 	= 0x20U,
+	HAL_I2C_STATE_BUSY 		= 0x24U,
+	HAL_I2C_STATE_BUSY_TX 	= 0x21U,
+	HAL_I2C_STATE_BUSY_RX 	= 0x22U,
+	HAL_I2C_STATE_ABORT 	= 0x60U,
+} HAL_I2C_StateTypeDef;
+
+typedef struct {
+	I2C_TypeDef *Instance;
+	I2C_InitTypeDef Init;
+	uint8_t *pBuffPtr;
+	uint16_t XferSize;
+	volatile uint16_t XferCount;
+	DMA_HandleTypeDef *hdmatx;
+	DMA_HandleTypeDef *hdmarx;
+	volatile HAL_I2C_StateTypeDef State;
+	volatile uint32_t ErrorCode;
+} I2C_HandleTypeDef;
+
+extern I2C_TypeDef fake_i2c1;
+extern I2C_TypeDef fake_i2c2;
+
+#define I2C1 	(&fake_i2c1)
+#define I2C2 	(&fake_i2c2)
+
+#define I2C_CR1_PE 		(1UL << 0)
+#define I2C_CR1_START 	(1UL << 8)
+#define I2C_CR1_STOP 	(1UL << 9)
+#define I2C_CR1_SWRST 	(1UL << 15)
+
+#define I2C_SR2_BUSY 	(1UL << 1)
+
+#define I2C_FLAG_BUSY 	0x00100002U
+
+#define I2C_MEMADD_SIZE_8BIT 	0x00000001U
+
+#define HAL_I2C_ERROR_NONE 		0x00000000U
+#define HAL_I2C_ERROR_BERR 		0x00000001U
+#define HAL_I2C_ERROR_ARLO 		0x00000002U
+#define HAL_I2C_ERROR_AF 		0x00000004U
+#define HAL_I2C_ERROR_OVR 		0x00000008U
+#define HAL_I2C_ERROR_DMA 		0x00000010U
+#define HAL_I2C_ERROR_TIMEOUT 	0x00000020U
+
+#define __HAL_I2C_GET_FLAG(__HANDLE__, __FLAG__)	fakeI2cGetFlag((__HANDLE__), (__FLAG__))
+
+extern "C" {
+
+uint32_t fakeI2cGetFlag(I2C_HandleTypeDef *hi2c, uint32_t flag);
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint32_t Trials, uint32_t Timeout);
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c);
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c);
+
+// Weak callbacks, overridden by the bus engine
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c);
+
+}
+
+
+
+
+// --- Timers ---------------------------------------------------------------------------
+
+typedef struct {
+	volatile uint32_t CR1;
+	volatile uint32_t CR2;
+	volatile uint32_t SMCR;
+	volatile uint32_t DIER;
+	volatile uint32_t SR;
+	volatile uint32_t EGR;
+	volatile uint32_t CCMR1;
+	volatile uint32_t CCMR2;
+	volatile uint32_t CCER;
+	volatile uint32_t CNT;
+	volatile uint32_t PSC;
+	volatile uint32_t ARR;
+	volatile uint32_t RCR;
+	volatile uint32_t CCR1;
+	volatile uint32_t CCR2;
+	volatile uint32_t CCR3;
+	volatile uint32_t CCR4;
+} TIM_TypeDef;
+
+typedef struct {
+	uint32_t Prescaler;
+	uint32_t CounterMode;
+	uint32_t Period;
+	uint32_t ClockDivision;
+	uint32_t RepetitionCounter;
+	uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef enum {
+	HAL_TIM_ACTIVE_CHANNEL_1 		= 0x01U,
+	HAL_TIM_ACTIVE_CHANNEL_2 		= 0x02U,
+	HAL_TIM_ACTIVE_CHANNEL_3 		= 0x04U,
+	HAL_TIM_ACTIVE_CHANNEL_4 		= 0x08U,
+	HAL_TIM_ACTIVE_CHANNEL_CLEARED 	= 0x00U,
+} HAL_TIM_ActiveChannel;
+
+typedef struct {
+	TIM_TypeDef *Instance;
+	TIM_Base_InitTypeDef Init;
+	HAL_TIM_ActiveChannel Channel;
+} TIM_HandleTypeDef;
+
+extern TIM_TypeDef fake_tim1;
+extern TIM_TypeDef fake_tim2;
+extern TIM_TypeDef fake_tim3;
+
+#define TIM1 	(&fake_tim1)
+#define TIM2 	(&fake_tim2)
+#define TIM3 	(&fake_tim3)
+
+#define TIM_CHANNEL_1 	0x00000000U
+#define TIM_CHANNEL_2 	0x00000004U
+#define TIM_CHANNEL_3 	0x00000008U
+#define TIM_CHANNEL_4 	0x0000000CU
+
+#define TIM_IT_UPDATE 	(1UL << 0)
+#define TIM_IT_CC1 		(1UL << 1)
+#define TIM_FLAG_UPDATE (1UL << 0)
+#define TIM_FLAG_CC1 	(1UL << 1)
+
+#define __HAL_TIM_GET_COUNTER(__HANDLE__)		fakeTimGetCounter(__HANDLE__)
+#define __HAL_TIM_GET_AUTORELOAD(__HANDLE__)	((__HANDLE__)->Instance->ARR)
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CHANNEL__, __COMPARE__)	\
+		(*(&((__HANDLE__)->Instance->CCR1) + ((__CHANNEL__) >> 2U)) = (__COMPARE__))
+#define __HAL_TIM_ENABLE_IT(__HANDLE__, __INTERRUPT__)	((__HANDLE__)->Instance->DIER |= (__INTERRUPT__))
+#define __HAL_TIM_DISABLE_IT(__HANDLE__, __INTERRUPT__)	((__HANDLE__)->Instance->DIER &= ~(__INTERRUPT__))
+#define __HAL_TIM_CLEAR_FLAG(__HANDLE__, __FLAG__)		((__HANDLE__)->Instance->SR = ~(uint32_t)(__FLAG__))
+
+extern "C" {
+
+uint32_t fakeTimGetCounter(TIM_HandleTypeDef *htim);
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim);
+
+// Weak callbacks, overridden by the control tick
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim);
+
+}
+
+
+// END OF FILE
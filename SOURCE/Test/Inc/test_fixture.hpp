@@ -0,0 +1,60 @@
+/*
+ * test_fixture.hpp
+ *
+ * Module containing the set-up shared by the host tests and benchmarks: peripherals
+ * initialised as main.cpp does, on the reset simulation.
+ *
+ */
+
+#pragma once
+
+#include "fake_hal.hpp"
+#include "cycle_counter.hpp"
+
+
+
+// --- Peripheral set-up ----------------------------------------------------------------
+
+/*
+ * @brief Initialises an I2C peripheral and starts the cycle counter.
+ *
+ * @param handle		Handle to initialise;
+ * @param instance		I2C1 or I2C2;
+ * @param clock_speed	Bus speed [Hz];
+ *
+ */
+inline void fixtureI2cInit(I2C_HandleTypeDef *handle, I2C_TypeDef *instance, uint32_t clock_speed = 400000){
+	*handle = I2C_HandleTypeDef();
+	handle->Instance = instance;
+	handle->Init.ClockSpeed = clock_speed;
+	HAL_I2C_Init(handle);
+
+	cycleCounterBegin();
+}
+
+/*
+ * @brief Initialises a timer counting at 1 MHz, as the control tick needs.
+ *
+ * @param handle		Handle to initialise;
+ * @param instance		TIM2 or TIM3;
+ * @param period_us		Period [us];
+ *
+ */
+inline void fixtureTickTimerInit(TIM_HandleTypeDef *handle, TIM_TypeDef *instance, uint32_t period_us = 1000){
+	*handle = TIM_HandleTypeDef();
+	handle->Instance = instance;
+	handle->Init.Prescaler = SystemCoreClock / 1000000 - 1;
+	handle->Init.Period = period_us - 1;
+	HAL_TIM_Base_Init(handle);
+}
+
+/*
+ * @brief Converts simulated cycles to microseconds.
+ *
+ */
+inline double fixtureCycles_us(uint64_t cycles){
+	return (double)cycles / (SystemCoreClock / 1000000);
+}
+
+
+// END OF FILE
@@ -0,0 +1,71 @@
+/*
+ * test_runner.hpp
+ *
+ * Module containing a minimal host test runner, shared by the unit tests and the
+ * micro-benchmarks:
+ *
+ * 			TEST(queue_keeps_order){ ... CHECK(a == b); CHECK_NEAR(x, 1.0, 1e-3); }
+ * 			BENCH(blocking_read){ ... benchReport("blocking_read", "bus", cycles, "cycles"); }
+ *
+ * Every case starts on a reset simulation (see fakeHalReset()). A failed check is
+ * reported and the case goes on; the runner returns non-zero if any check failed.
+ * Arguments filter the cases by name prefix.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+
+
+// --- Test registry --------------------------------------------------------------------
+
+typedef void (*Test_Function)(void);
+
+struct Test_Case {
+	const char *name;
+	Test_Function function;
+	Test_Case *next;
+};
+
+class Test_Registrar {
+
+public:
+	Test_Registrar(Test_Case *test_case);
+};
+
+#define TEST(name)															\
+	static void test_##name(void);											\
+	static Test_Case test_case_##name = {#name, test_##name, nullptr};		\
+	static Test_Registrar test_registrar_##name(&test_case_##name);		\
+	static void test_##name(void)
+
+#define BENCH(name) TEST(name)
+
+
+
+// --- Checks ---------------------------------------------------------------------------
+
+void testFail(const char *file, int line, const char *condition);
+
+#define CHECK(condition)													\
+	do { if(!(condition)) testFail(__FILE__, __LINE__, #condition); } while(0)
+
+#define CHECK_NEAR(value, expected, tolerance)								\
+	do {																	\
+		double check_error = (double)(value) - (double)(expected);			\
+		if(check_error < 0) check_error = -check_error;						\
+		if(!(check_error <= (double)(tolerance))) testFail(__FILE__, __LINE__, #value " near " #expected);	\
+	} while(0)
+
+
+
+// --- Reports --------------------------------------------------------------------------
+
+void benchReport(const char *name, const char *metric, double value, const char *unit);
+
+double benchHostTime_ns(void);				// Host monotonic clock, for compute timings
+
+
+// END OF FILE
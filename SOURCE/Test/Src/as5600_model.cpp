@@ -0,0 +1,141 @@
+/*
+ * as5600_model.cpp
+ *
+ * Implementation of as5600_model.hpp header file.
+ *
+ */
+
+#include "as5600_model.hpp"
+
+#include <string.h>
+
+
+
+// --- Register map ---------------------------------------------------------------------
+
+const uint8_t MODEL_ZPOS_H = 0x01;
+const uint8_t MODEL_ZPOS_L = 0x02;
+const uint8_t MODEL_CONF_L = 0x08;
+const uint8_t MODEL_STATUS = 0x0B;
+const uint8_t MODEL_RAW_ANGLE_H = 0x0C;
+const uint8_t MODEL_RAW_ANGLE_L = 0x0D;
+const uint8_t MODEL_ANGLE_H = 0x0E;
+const uint8_t MODEL_ANGLE_L = 0x0F;
+const uint8_t MODEL_AGC = 0x1A;
+const uint8_t MODEL_MAGNITUDE_H = 0x1B;
+const uint8_t MODEL_MAGNITUDE_L = 0x1C;
+const uint8_t MODEL_BURN = 0xFF;
+
+const uint8_t MODEL_MAGNET_DETECTED = 0x20;
+
+
+
+// ------------------------------------------------ AS5600_Model class implementation ---
+
+/*
+ * @brief Constructor of the model: magnet detected, angle zero, mid-range AGC.
+ *
+ */
+AS5600_Model::AS5600_Model(void) :
+		_pointer(0),
+		_wrapping(false),
+		_reads(0),
+		_writes(0),
+		_reserved_reads(0)
+	{
+		memset(AS5600_Model::_registers, 0, sizeof(AS5600_Model::_registers));
+
+		AS5600_Model::_registers[MODEL_STATUS] = MODEL_MAGNET_DETECTED;
+		AS5600_Model::_registers[MODEL_AGC] = 0x80;
+		AS5600_Model::setMagnitude(2048);
+	}
+
+
+// --- Scripted values ------------------------------------------------------------------
+
+void AS5600_Model::setRawAngle(uint16_t raw_angle){
+	AS5600_Model::_registers[MODEL_RAW_ANGLE_H] = (raw_angle >> 8) & 0x0F;
+	AS5600_Model::_registers[MODEL_RAW_ANGLE_L] = raw_angle & 0xFF;
+	AS5600_Model::updateAngle();
+}
+
+void AS5600_Model::setStatus(uint8_t status){
+	AS5600_Model::_registers[MODEL_STATUS] = status;
+}
+
+void AS5600_Model::setAGC(uint8_t agc){
+	AS5600_Model::_registers[MODEL_AGC] = agc;
+}
+
+void AS5600_Model::setMagnitude(uint16_t magnitude){
+	AS5600_Model::_registers[MODEL_MAGNITUDE_H] = (magnitude >> 8) & 0x0F;
+	AS5600_Model::_registers[MODEL_MAGNITUDE_L] = magnitude & 0xFF;
+}
+
+void AS5600_Model::setRegister(uint8_t address, uint8_t value){
+	AS5600_Model::_registers[address] = value;
+	AS5600_Model::updateAngle();
+}
+
+
+// --- Bus side -------------------------------------------------------------------------
+
+/*
+ * @brief Sets the address pointer, then writes the following bytes from it.
+ *
+ */
+void AS5600_Model::write(const uint8_t *data, uint16_t length){
+	AS5600_Model::_writes++;
+	if(length == 0) return;
+
+	AS5600_Model::_pointer = data[0];
+	AS5600_Model::_wrapping = data[0] == MODEL_RAW_ANGLE_H || data[0] == MODEL_ANGLE_H || data[0] == MODEL_MAGNITUDE_H;
+
+	for(uint16_t i = 1; i < length; i++) AS5600_Model::_registers[(uint8_t)(data[0] + i - 1)] = data[i];
+	if(length > 1) AS5600_Model::updateAngle();
+}
+
+/*
+ * @brief Reads from the address pointer, wrapping on the output register pairs.
+ *
+ */
+void AS5600_Model::read(uint8_t *data, uint16_t length){
+	AS5600_Model::_reads++;
+
+	uint8_t first = AS5600_Model::_pointer;
+	for(uint16_t i = 0; i < length; i++){
+		uint8_t address = AS5600_Model::_wrapping ? (uint8_t)(first + (i & 1)) : AS5600_Model::_pointer++;
+
+		if(AS5600_Model::isReserved(address)) AS5600_Model::_reserved_reads++;
+		data[i] = AS5600_Model::_registers[address];
+	}
+}
+
+/*
+ * @brief Derives ANGLE from RAW ANGLE and the zero position (full range).
+ *
+ */
+void AS5600_Model::updateAngle(void){
+	uint16_t raw_angle = ((AS5600_Model::_registers[MODEL_RAW_ANGLE_H] & 0x0F) << 8) | AS5600_Model::_registers[MODEL_RAW_ANGLE_L];
+	uint16_t zero = ((AS5600_Model::_registers[MODEL_ZPOS_H] & 0x0F) << 8) | AS5600_Model::_registers[MODEL_ZPOS_L];
+	uint16_t angle = (raw_angle - zero) & 0x0FFF;
+
+	AS5600_Model::_registers[MODEL_ANGLE_H] = angle >> 8;
+	AS5600_Model::_registers[MODEL_ANGLE_L] = angle & 0xFF;
+}
+
+
+/*
+ * @brief Checks if an address is outside the register map (data-sheet page 18).
+ *
+ */
+bool AS5600_Model::isReserved(uint8_t address){
+	if(address <= MODEL_CONF_L) return false;
+	if(address >= MODEL_STATUS && address <= MODEL_ANGLE_L) return false;
+	if(address >= MODEL_AGC && address <= MODEL_MAGNITUDE_L) return false;
+
+	return address != MODEL_BURN;
+}
+
+
+// END OF FILE
@@ -0,0 +1,1043 @@
+/*
+ * fake_hal.cpp
+ *
+ * Implementation of fake_hal.hpp header file, and of the HAL functions declared by the
+ * host stm32f1xx_hal.h.
+ *
+ */
+
+#include "fake_hal.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+// --- Simulation limits ----------------------------------------------------------------
+
+const uint64_t FAKE_HAL_MAX_CYCLES = 1ULL << 42;	// About 19 simulated hours, runaway guard
+
+const uint8_t FAKE_HAL_THREAD_PRIORITY = 0xFF;
+const uint8_t FAKE_HAL_I2C_PRIORITY = 0;
+const uint8_t FAKE_HAL_TIM_PRIORITY = 1;
+
+const uint32_t FAKE_HAL_I2C1_EXCEPTION = 16 + 31;	// I2C1_EV_IRQn
+const uint32_t FAKE_HAL_I2C2_EXCEPTION = 16 + 33;	// I2C2_EV_IRQn
+const uint32_t FAKE_HAL_TIM_EXCEPTION = 16 + 29;	// TIM3_IRQn
+
+const uint8_t FAKE_HAL_BUS_COUNT = 2;
+const uint8_t FAKE_HAL_TIMER_COUNT = 3;
+const uint8_t FAKE_HAL_TIMER_CHANNELS = 4;
+
+
+
+// --- Peripherals and core registers ---------------------------------------------------
+
+DWT_Type fake_dwt;
+CoreDebug_Type fake_core_debug;
+
+GPIO_TypeDef fake_gpioa;
+GPIO_TypeDef fake_gpiob;
+AFIO_TypeDef fake_afio;
+
+I2C_TypeDef fake_i2c1;
+I2C_TypeDef fake_i2c2;
+
+TIM_TypeDef fake_tim1;
+TIM_TypeDef fake_tim2;
+TIM_TypeDef fake_tim3;
+
+uint32_t SystemCoreClock = FAKE_HAL_CORE_CLOCK;
+
+
+
+// --- Simulation state -----------------------------------------------------------------
+
+enum FAKE_TRANSFER : uint8_t {				// HAL transfer started on a bus
+	TRANSFER_MASTER_TX 	= 0x00,
+	TRANSFER_MASTER_RX 	= 0x01,
+	TRANSFER_MEM_TX 	= 0x02,
+	TRANSFER_MEM_RX 	= 0x03,
+};
+
+enum FAKE_EVENT : uint8_t {					// Interrupt sources
+	EVENT_I2C_COMPLETE 	= 0x00,
+	EVENT_TIM_UPDATE 	= 0x01,
+	EVENT_TIM_COMPARE 	= 0x02,
+};
+
+struct Fake_Event {
+	uint64_t due;
+	uint8_t priority;
+	FAKE_EVENT kind;
+	uint8_t index;							// Bus or timer
+	uint8_t channel;						// Compare channel, 0 to 3
+};
+
+struct Fake_Slave_Slot {
+	uint8_t address;
+	Fake_I2C_Slave *slave;
+};
+
+struct Fake_I2C_Bus {
+	I2C_TypeDef *instance;
+	uint32_t exception;
+	Fake_Slave_Slot slaves[FAKE_I2C_MAX_SLAVES];
+
+	// Transfer on the wire
+	bool active;
+	I2C_HandleTypeDef *handle;
+	FAKE_TRANSFER transfer;
+	uint8_t address;
+	uint8_t register_address;
+	uint8_t *buffer;
+	uint16_t length;
+	bool nack;
+	bool lost;
+	uint64_t end_cycles;
+	uint64_t stop_end_cycles;				// BUSY held by the STOP until then
+	bool in_start;
+
+	// Faults
+	bool sda_held;
+	uint8_t sda_clocks;
+	bool busy_latched;
+	uint32_t lose_count;
+	uint8_t nack_address;
+	uint32_t nack_count;
+	uint32_t stretch_us;
+	Fake_Hook start_hook;
+	void *start_context;
+
+	// Counters
+	uint32_t transfers;
+	uint32_t bytes;
+	uint32_t dma_transfers;
+	uint32_t inits;
+	uint32_t busy_waits;
+	uint32_t reentries;
+	uint32_t probes;
+	uint32_t scl_pulses;
+};
+
+struct Fake_Timer {
+	TIM_TypeDef *instance;
+	TIM_HandleTypeDef *handle;
+	bool running;
+	uint64_t start_cycles;
+	uint32_t periods;						// Update events so far
+	uint64_t compare_checked[FAKE_HAL_TIMER_CHANNELS];	// Matches up to then are served
+};
+
+static uint64_t fake_now = 0;
+static uint64_t fake_counter_origin = 0;	// Simulated time of CYCCNT zero
+static uint32_t fake_counter_held = 0;		// CYCCNT while disabled
+
+static uint32_t fake_primask = 0;
+static uint8_t fake_priority = FAKE_HAL_THREAD_PRIORITY;
+static uint32_t fake_exception = 0;
+
+static uint64_t fake_max_interrupt[2] = {};
+
+static Fake_I2C_Bus fake_buses[FAKE_HAL_BUS_COUNT];
+static Fake_Timer fake_timers[FAKE_HAL_TIMER_COUNT];
+
+
+
+// --- Private helpers ------------------------------------------------------------------
+
+/*
+ * @brief Stops the simulation on a harness misuse.
+ *
+ */
+static void fakeAbort(const char *reason){
+	fprintf(stderr, "fake HAL: %s\n", reason);
+	abort();
+}
+
+/*
+ * @brief Converts microseconds to simulated cycles.
+ *
+ */
+static uint64_t fakeCycles_us(uint64_t time_us){
+	return time_us * (SystemCoreClock / 1000000);
+}
+
+/*
+ * @brief Finds the simulation of an I2C peripheral.
+ *
+ */
+static Fake_I2C_Bus *fakeI2cFind(I2C_TypeDef *instance){
+	for(uint8_t i = 0; i < FAKE_HAL_BUS_COUNT; i++){
+		if(fake_buses[i].instance == instance) return &fake_buses[i];
+	}
+
+	fakeAbort("unknown I2C instance");
+	return nullptr;
+}
+
+/*
+ * @brief Returns the GPIOB pins of a bus, following the I2C1 remap.
+ *
+ */
+static void fakeI2cPins(Fake_I2C_Bus *bus, uint16_t *scl, uint16_t *sda){
+	if(bus->instance == I2C2){
+		*scl = GPIO_PIN_10;
+		*sda = GPIO_PIN_11;
+		return;
+	}
+
+	bool remapped = (fake_afio.MAPR & AFIO_MAPR_I2C1_REMAP) != 0;
+	*scl = remapped ? GPIO_PIN_8 : GPIO_PIN_6;
+	*sda = remapped ? GPIO_PIN_9 : GPIO_PIN_7;
+}
+
+/*
+ * @brief Returns the cycles of one bit at the bus speed.
+ *
+ */
+static uint64_t fakeI2cBitCycles(I2C_HandleTypeDef *hi2c){
+	uint32_t clock_speed = hi2c->Init.ClockSpeed;
+	if(clock_speed == 0) clock_speed = 100000;
+
+	return SystemCoreClock / clock_speed;
+}
+
+/*
+ * @brief Finds the slave answering an address, null if none.
+ *
+ */
+static Fake_I2C_Slave *fakeI2cSlave(Fake_I2C_Bus *bus, uint8_t address){
+	for(uint8_t i = 0; i < FAKE_I2C_MAX_SLAVES; i++){
+		if(bus->slaves[i].slave != nullptr && bus->slaves[i].address == address) return bus->slaves[i].slave;
+	}
+
+	return nullptr;
+}
+
+/*
+ * @brief Updates the line state of the buses at the current time: transfers whose
+ * completion is lost end on the wire, BUSY and STOP follow the lines.
+ *
+ */
+static void fakeUpdateLines(void){
+	for(uint8_t i = 0; i < FAKE_HAL_BUS_COUNT; i++){
+		Fake_I2C_Bus *bus = &fake_buses[i];
+
+		if(bus->active && bus->lost && fake_now >= bus->end_cycles){
+			bus->active = false;
+			bus->stop_end_cycles = bus->end_cycles + (bus->handle != nullptr ? fakeI2cBitCycles(bus->handle) : 0);
+		}
+
+		bool stopping = !bus->active && fake_now < bus->stop_end_cycles;
+		bool busy = bus->active || stopping || bus->busy_latched || bus->sda_held;
+
+		if(busy) bus->instance->SR2 |= I2C_SR2_BUSY;
+		else bus->instance->SR2 &= ~I2C_SR2_BUSY;
+
+		if(stopping) bus->instance->CR1 |= I2C_CR1_STOP;
+		else bus->instance->CR1 &= ~I2C_CR1_STOP;
+	}
+}
+
+/*
+ * @brief Returns the period of a timer in cycles.
+ *
+ */
+static uint64_t fakeTimerPeriod(Fake_Timer *timer){
+	return (uint64_t)(timer->instance->ARR + 1) * (timer->instance->PSC + 1);
+}
+
+/*
+ * @brief Finds the earliest interrupt source with a priority above the given one.
+ *
+ * @param event			Earliest event found;
+ * @param priority		Running priority, only higher ones (lower numbers) can fire;
+ *
+ */
+static bool fakeNextEvent(Fake_Event *event, uint8_t priority){
+	bool found = false;
+
+	// Bus completions, lost transfers raise none
+	if(FAKE_HAL_I2C_PRIORITY < priority){
+		for(uint8_t i = 0; i < FAKE_HAL_BUS_COUNT; i++){
+			Fake_I2C_Bus *bus = &fake_buses[i];
+			if(!bus->active || bus->lost) continue;
+
+			if(!found || bus->end_cycles < event->due){
+				*event = {bus->end_cycles, FAKE_HAL_I2C_PRIORITY, EVENT_I2C_COMPLETE, i, 0};
+				found = true;
+			}
+		}
+	}
+
+	if(FAKE_HAL_TIM_PRIORITY >= priority) return found;
+
+	// Timer updates and compare matches (the update first on a tie)
+	for(uint8_t i = 0; i < FAKE_HAL_TIMER_COUNT; i++){
+		Fake_Timer *timer = &fake_timers[i];
+		if(!timer->running) continue;
+
+		uint64_t period = fakeTimerPeriod(timer);
+		uint64_t update = timer->start_cycles + (timer->periods + 1) * period;
+
+		if(!found || update < event->due){
+			*event = {update, FAKE_HAL_TIM_PRIORITY, EVENT_TIM_UPDATE, i, 0};
+			found = true;
+		}
+
+		for(uint8_t channel = 0; channel < FAKE_HAL_TIMER_CHANNELS; channel++){
+			// A channel enabled late only matches from its next compare value
+			if(!(timer->instance->DIER & (TIM_IT_CC1 << channel))){
+				timer->compare_checked[channel] = fake_now;
+				continue;
+			}
+
+			uint32_t compare = (&timer->instance->CCR1)[channel];
+			uint64_t checked = timer->compare_checked[channel];
+			uint64_t period_start = timer->start_cycles + (checked - timer->start_cycles) / period * period;
+			uint64_t due = period_start + (uint64_t)compare * (timer->instance->PSC + 1);
+			if(due <= checked) due += period;
+
+			// Not before the update of its period
+			if(due > update) continue;
+
+			if(!found || due < event->due){
+				*event = {due, FAKE_HAL_TIM_PRIORITY, EVENT_TIM_COMPARE, i, channel};
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+/*
+ * @brief Runs a function as an interrupt of a priority, recording its duration.
+ *
+ */
+static void fakeRunInterrupt(uint8_t priority, uint32_t exception, Fake_Hook hook, void *context){
+	uint8_t previous_priority = fake_priority;
+	uint32_t previous_exception = fake_exception;
+	uint64_t start = fake_now;
+
+	fake_priority = priority;
+	fake_exception = exception;
+
+	hook(context);
+
+	fake_priority = previous_priority;
+	fake_exception = previous_exception;
+
+	uint64_t duration = fake_now - start;
+	if(duration > fake_max_interrupt[priority]) fake_max_interrupt[priority] = duration;
+}
+
+/*
+ * @brief Completes the transfer on the wire of a bus, from its event interrupt.
+ *
+ */
+static void fakeI2cComplete(void *context){
+	Fake_I2C_Bus *bus = (Fake_I2C_Bus *)context;
+	I2C_HandleTypeDef *hi2c = bus->handle;
+
+	bus->active = false;
+	bus->stop_end_cycles = fake_now + fakeI2cBitCycles(hi2c);
+	fakeUpdateLines();
+
+	// Address not acknowledged
+	if(bus->nack){
+		hi2c->ErrorCode |= HAL_I2C_ERROR_AF;
+		hi2c->State = HAL_I2C_STATE_READY;
+		HAL_I2C_ErrorCallback(hi2c);
+		return;
+	}
+
+	// Exchange the bytes with the slave
+	Fake_I2C_Slave *slave = fakeI2cSlave(bus, bus->address);
+	hi2c->XferCount = 0;
+
+	switch(bus->transfer){
+		case TRANSFER_MEM_RX:
+			slave->write(&bus->register_address, 1);
+			slave->read(bus->buffer, bus->length);
+			hi2c->State = HAL_I2C_STATE_READY;
+			HAL_I2C_MemRxCpltCallback(hi2c);
+			break;
+
+		case TRANSFER_MEM_TX: {
+			uint8_t bytes[257];
+			bytes[0] = bus->register_address;
+			memcpy(&bytes[1], bus->buffer, bus->length);
+			slave->write(bytes, bus->length + 1);
+			hi2c->State = HAL_I2C_STATE_READY;
+			HAL_I2C_MemTxCpltCallback(hi2c);
+			break;
+		}
+
+		case TRANSFER_MASTER_RX:
+			slave->read(bus->buffer, bus->length);
+			hi2c->State = HAL_I2C_STATE_READY;
+			HAL_I2C_MasterRxCpltCallback(hi2c);
+			break;
+
+		case TRANSFER_MASTER_TX:
+			slave->write(bus->buffer, bus->length);
+			hi2c->State = HAL_I2C_STATE_READY;
+			HAL_I2C_MasterTxCpltCallback(hi2c);
+			break;
+	}
+}
+
+/*
+ * @brief Fires a timer update event.
+ *
+ */
+static void fakeTimerUpdate(void *context){
+	Fake_Timer *timer = (Fake_Timer *)context;
+
+	timer->periods++;
+	timer->instance->SR |= TIM_FLAG_UPDATE;
+	HAL_TIM_PeriodElapsedCallback(timer->handle);
+}
+
+static uint8_t fake_compare_channel = 0;
+
+/*
+ * @brief Fires a timer compare event, channel in fake_compare_channel.
+ *
+ */
+static void fakeTimerCompare(void *context){
+	Fake_Timer *timer = (Fake_Timer *)context;
+
+	timer->instance->SR |= TIM_FLAG_CC1 << fake_compare_channel;
+	timer->handle->Channel = (HAL_TIM_ActiveChannel)(HAL_TIM_ACTIVE_CHANNEL_1 << fake_compare_channel);
+	HAL_TIM_OC_DelayElapsedCallback(timer->handle);
+	timer->handle->Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+}
+
+/*
+ * @brief Runs one interrupt event.
+ *
+ */
+static void fakeRunEvent(const Fake_Event &event){
+	if(event.kind == EVENT_I2C_COMPLETE){
+		Fake_I2C_Bus *bus = &fake_buses[event.index];
+		fakeRunInterrupt(FAKE_HAL_I2C_PRIORITY, bus->exception, fakeI2cComplete, bus);
+		return;
+	}
+
+	Fake_Timer *timer = &fake_timers[event.index];
+
+	if(event.kind == EVENT_TIM_UPDATE){
+		fakeRunInterrupt(FAKE_HAL_TIM_PRIORITY, FAKE_HAL_TIM_EXCEPTION, fakeTimerUpdate, timer);
+		return;
+	}
+
+	timer->compare_checked[event.channel] = event.due;
+	fake_compare_channel = event.channel;
+	fakeRunInterrupt(FAKE_HAL_TIM_PRIORITY, FAKE_HAL_TIM_EXCEPTION, fakeTimerCompare, timer);
+}
+
+/*
+ * @brief Moves the simulated time to a target, running the interrupts due meanwhile in
+ * time order (those allowed by PRIMASK and the running priority).
+ *
+ */
+static void fakeAdvanceTo(uint64_t target){
+	Fake_Event event;
+
+	while(fake_primask == 0 && fakeNextEvent(&event, fake_priority) && event.due <= target){
+		if(event.due > fake_now) fake_now = event.due;
+		fakeUpdateLines();
+		fakeRunEvent(event);
+	}
+
+	if(target > fake_now) fake_now = target;
+	if(fake_now > FAKE_HAL_MAX_CYCLES) fakeAbort("simulated time runaway (waiting on something that never happens?)");
+
+	fakeUpdateLines();
+}
+
+
+
+// ----------------------------------------------------- Simulation control functions ---
+
+/*
+ * @brief Resets the simulation: time zero, interrupts enabled, peripherals in their reset
+ * state (cycle counter stopped), slaves detached and faults cleared.
+ *
+ */
+void fakeHalReset(void){
+	fake_now = 0;
+	fake_counter_origin = 0;
+	fake_counter_held = 0;
+
+	fake_primask = 0;
+	fake_priority = FAKE_HAL_THREAD_PRIORITY;
+	fake_exception = 0;
+
+	SystemCoreClock = FAKE_HAL_CORE_CLOCK;
+
+	fake_dwt.CTRL = 0;
+	fake_core_debug.DEMCR = 0;
+
+	memset(&fake_gpioa, 0, sizeof(fake_gpioa));
+	memset(&fake_gpiob, 0, sizeof(fake_gpiob));
+	memset(&fake_afio, 0, sizeof(fake_afio));
+	fake_gpioa.ODR = 0xFFFF;				// Pulled up
+	fake_gpiob.ODR = 0xFFFF;
+
+	memset(&fake_i2c1, 0, sizeof(fake_i2c1));
+	memset(&fake_i2c2, 0, sizeof(fake_i2c2));
+	memset(&fake_tim1, 0, sizeof(fake_tim1));
+	memset(&fake_tim2, 0, sizeof(fake_tim2));
+	memset(&fake_tim3, 0, sizeof(fake_tim3));
+
+	for(uint8_t i = 0; i < FAKE_HAL_BUS_COUNT; i++) memset(&fake_buses[i], 0, sizeof(Fake_I2C_Bus));
+	fake_buses[0].instance = I2C1;
+	fake_buses[0].exception = FAKE_HAL_I2C1_EXCEPTION;
+	fake_buses[1].instance = I2C2;
+	fake_buses[1].exception = FAKE_HAL_I2C2_EXCEPTION;
+
+	for(uint8_t i = 0; i < FAKE_HAL_TIMER_COUNT; i++) memset(&fake_timers[i], 0, sizeof(Fake_Timer));
+	fake_timers[0].instance = TIM1;
+	fake_timers[1].instance = TIM2;
+	fake_timers[2].instance = TIM3;
+
+	fakeHalResetInterruptStatistics();
+}
+
+uint64_t fakeHalCycles(void){
+	return fake_now;
+}
+
+uint32_t fakeHalTime_us(void){
+	return (uint32_t)(fake_now / (SystemCoreClock / 1000000));
+}
+
+/*
+ * @brief Advances the simulated time, running the interrupts due meanwhile.
+ *
+ * @param time_us	Time to advance [us];
+ *
+ */
+void fakeHalAdvance_us(uint32_t time_us){
+	fakeAdvanceTo(fake_now + fakeCycles_us(time_us));
+}
+
+void fakeHalAdvanceCycles(uint64_t cycles){
+	fakeAdvanceTo(fake_now + cycles);
+}
+
+bool fakeHalInInterrupt(void){
+	return fake_exception != 0;
+}
+
+/*
+ * @brief Returns the longest interrupt of a priority since the last reset, nested higher
+ * priority interrupts included.
+ *
+ * @param priority	0 for the I2C events, 1 for the timers;
+ *
+ */
+uint32_t fakeHalMaxInterrupt_us(uint8_t priority){
+	if(priority > 1) return 0;
+
+	return (uint32_t)(fake_max_interrupt[priority] / (SystemCoreClock / 1000000));
+}
+
+void fakeHalResetInterruptStatistics(void){
+	fake_max_interrupt[0] = 0;
+	fake_max_interrupt[1] = 0;
+}
+
+
+
+// ------------------------------------------------------------ I2C control functions ---
+
+/*
+ * @brief Attaches a slave to a bus.
+ *
+ * @param bus		I2C1 or I2C2;
+ * @param address	7 bit address;
+ * @param slave		Register model answering the address;
+ *
+ */
+void fakeI2cAttach(I2C_TypeDef *bus, uint8_t address, Fake_I2C_Slave *slave){
+	Fake_I2C_Bus *fake = fakeI2cFind(bus);
+
+	for(uint8_t i = 0; i < FAKE_I2C_MAX_SLAVES; i++){
+		if(fake->slaves[i].slave == nullptr || fake->slaves[i].address == address){
+			fake->slaves[i].address = address;
+			fake->slaves[i].slave = slave;
+			return;
+		}
+	}
+
+	fakeAbort("too many slaves on the bus");
+}
+
+void fakeI2cDetach(I2C_TypeDef *bus, uint8_t address){
+	Fake_I2C_Bus *fake = fakeI2cFind(bus);
+
+	for(uint8_t i = 0; i < FAKE_I2C_MAX_SLAVES; i++){
+		if(fake->slaves[i].address == address) fake->slaves[i].slave = nullptr;
+	}
+}
+
+/*
+ * @brief A slave holds SDA low: BUSY latches until the peripheral is reset, and SDA is
+ * released after the given number of SCL pulses on the GPIO pins.
+ *
+ * @param bus		I2C1 or I2C2;
+ * @param clocks	Pulses needed, FAKE_I2C_HOLD_FOREVER to never release it;
+ *
+ */
+void fakeI2cHoldSda(I2C_TypeDef *bus, uint8_t clocks){
+	Fake_I2C_Bus *fake = fakeI2cFind(bus);
+
+	fake->sda_held = clocks != 0;
+	fake->sda_clocks = clocks;
+	fake->busy_latched = true;
+	fakeUpdateLines();
+}
+
+void fakeI2cLatchBusy(I2C_TypeDef *bus){
+	fakeI2cFind(bus)->busy_latched = true;
+	fakeUpdateLines();
+}
+
+void fakeI2cLoseCompletion(I2C_TypeDef *bus, uint32_t transfers){
+	fakeI2cFind(bus)->lose_count = transfers;
+}
+
+void fakeI2cForceNack(I2C_TypeDef *bus, uint8_t address, uint32_t transfers){
+	Fake_I2C_Bus *fake = fakeI2cFind(bus);
+
+	fake->nack_address = address;
+	fake->nack_count = transfers;
+}
+
+void fakeI2cSetStretch_us(I2C_TypeDef *bus, uint32_t stretch_us){
+	fakeI2cFind(bus)->stretch_us = stretch_us;
+}
+
+/*
+ * @brief Runs a function as a priority 1 interrupt inside the next thread-mode start on
+ * the bus, after the HAL checked the handle state and before it owns the peripheral.
+ *
+ * @param bus		I2C1 or I2C2;
+ * @param hook		Function to run;
+ * @param context	Argument passed to the function;
+ *
+ */
+void fakeI2cSetStartHook(I2C_TypeDef *bus, Fake_Hook hook, void *context){
+	Fake_I2C_Bus *fake = fakeI2cFind(bus);
+
+	fake->start_hook = hook;
+	fake->start_context = context;
+}
+
+uint32_t fakeI2cGetTransfers(I2C_TypeDef *bus){ return fakeI2cFind(bus)->transfers; }
+uint32_t fakeI2cGetBytes(I2C_TypeDef *bus){ return fakeI2cFind(bus)->bytes; }
+uint32_t fakeI2cGetDmaTransfers(I2C_TypeDef *bus){ return fakeI2cFind(bus)->dma_transfers; }
+uint32_t fakeI2cGetInits(I2C_TypeDef *bus){ return fakeI2cFind(bus)->inits; }
+uint32_t fakeI2cGetBusyWaits(I2C_TypeDef *bus){ return fakeI2cFind(bus)->busy_waits; }
+uint32_t fakeI2cGetReentries(I2C_TypeDef *bus){ return fakeI2cFind(bus)->reentries; }
+uint32_t fakeI2cGetProbes(I2C_TypeDef *bus){ return fakeI2cFind(bus)->probes; }
+uint32_t fakeI2cGetSclPulses(I2C_TypeDef *bus){ return fakeI2cFind(bus)->scl_pulses; }
+
+bool fakeI2cIsSdaHeld(I2C_TypeDef *bus){ return fakeI2cFind(bus)->sda_held; }
+
+
+
+// --------------------------------------------------------------------- Core (CMSIS) ---
+
+/*
+ * @brief Reads the cycle counter: costs FAKE_HAL_CYCLES_PER_READ cycles and runs the
+ * interrupts due. Holds its value while disabled.
+ *
+ */
+Fake_Cycle_Counter::operator uint32_t() const {
+	fakeAdvanceTo(fake_now + FAKE_HAL_CYCLES_PER_READ);
+
+	if(!(fake_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk)) return fake_counter_held;
+	return (uint32_t)(fake_now - fake_counter_origin);
+}
+
+Fake_Cycle_Counter &Fake_Cycle_Counter::operator=(uint32_t value){
+	fake_counter_held = value;
+	fake_counter_origin = fake_now - value;
+	return *this;
+}
+
+uint32_t __get_PRIMASK(void){
+	return fake_primask;
+}
+
+void __set_PRIMASK(uint32_t primask){
+	fake_primask = primask & 1;
+	if(fake_primask == 0) fakeAdvanceTo(fake_now);
+}
+
+void __disable_irq(void){
+	fake_primask = 1;
+}
+
+void __enable_irq(void){
+	fake_primask = 0;
+	fakeAdvanceTo(fake_now);
+}
+
+uint32_t __get_IPSR(void){
+	return fake_exception;
+}
+
+/*
+ * @brief Sleeps until the next interrupt of a priority above the running one, taken if
+ * not masked. Stops the simulation if nothing can wake the core.
+ *
+ */
+void __WFI(void){
+	Fake_Event event;
+	if(!fakeNextEvent(&event, fake_priority)) fakeAbort("__WFI with no interrupt source");
+
+	if(event.due > fake_now) fake_now = event.due;
+	fakeAdvanceTo(fake_now);
+}
+
+
+
+// ----------------------------------------------------------------------------- GPIO ---
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init){
+	(void)GPIOx;
+	(void)GPIO_Init;
+}
+
+/*
+ * @brief Drives pins. A rising SCL edge of a bus counts as a recovery clock, and clocks
+ * out a slave holding SDA.
+ *
+ */
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState){
+	uint32_t previous = GPIOx->ODR;
+
+	if(PinState == GPIO_PIN_SET) GPIOx->ODR |= GPIO_Pin;
+	else GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+
+	if(GPIOx != GPIOB || PinState != GPIO_PIN_SET) return;
+
+	for(uint8_t i = 0; i < FAKE_HAL_BUS_COUNT; i++){
+		Fake_I2C_Bus *bus = &fake_buses[i];
+
+		uint16_t scl, sda;
+		fakeI2cPins(bus, &scl, &sda);
+		if(!(GPIO_Pin & scl) || (previous & scl)) continue;
+
+		bus->scl_pulses++;
+		if(bus->sda_held && bus->sda_clocks != FAKE_I2C_HOLD_FOREVER && --bus->sda_clocks == 0) bus->sda_held = false;
+	}
+
+	fakeUpdateLines();
+}
+
+/*
+ * @brief Reads a pin: the driven level, low if a slave holds the SDA line.
+ *
+ */
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin){
+	if(GPIOx == GPIOB){
+		for(uint8_t i = 0; i < FAKE_HAL_BUS_COUNT; i++){
+			uint16_t scl, sda;
+			fakeI2cPins(&fake_buses[i], &scl, &sda);
+			if(GPIO_Pin == sda && fake_buses[i].sda_held) return GPIO_PIN_RESET;
+		}
+	}
+
+	return (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+
+
+// ------------------------------------------------------------------------------ I2C ---
+
+/*
+ * @brief Returns a flag of the peripheral, only BUSY is simulated.
+ *
+ */
+uint32_t fakeI2cGetFlag(I2C_HandleTypeDef *hi2c, uint32_t flag){
+	fakeUpdateLines();
+
+	if(flag == I2C_FLAG_BUSY) return (hi2c->Instance->SR2 & I2C_SR2_BUSY) ? 1 : 0;
+	return 0;
+}
+
+/*
+ * @brief Starts a transfer as the HAL interrupt and DMA functions do: fails if the
+ * handle is not ready, waits for the BUSY flag (FAKE_HAL_BUSY_TIMEOUT_MS if it never
+ * clears), then puts the bytes on the wire.
+ *
+ */
+static HAL_StatusTypeDef fakeI2cStart(
+I2C_HandleTypeDef *hi2c,
+FAKE_TRANSFER transfer,
+uint16_t address,
+uint8_t register_address,
+uint8_t *data,
+uint16_t length,
+bool dma
+){
+	Fake_I2C_Bus *bus = fakeI2cFind(hi2c->Instance);
+	if(hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+
+	// Started from an interrupt that preempted another start
+	if(bus->in_start) bus->reentries++;
+
+	// Wait for the bus: a STOP still on the wire ends in a bit, a held bus never does
+	fakeUpdateLines();
+	if(hi2c->Instance->SR2 & I2C_SR2_BUSY){
+		if(!bus->active && !bus->busy_latched && !bus->sda_held) fakeAdvanceTo(bus->stop_end_cycles);
+		else {
+			fakeAdvanceTo(fake_now + fakeCycles_us(FAKE_HAL_BUSY_TIMEOUT_MS * 1000));
+			bus->busy_waits++;
+			hi2c->ErrorCode |= HAL_I2C_ERROR_TIMEOUT;
+			return HAL_BUSY;
+		}
+	}
+
+	// Window between the state check and the lock, an interrupt may start a transfer
+	Fake_Hook hook = bus->start_hook;
+	if(hook != nullptr && fake_exception == 0 && fake_primask == 0){
+		bus->start_hook = nullptr;
+		bus->in_start = true;
+		fakeRunInterrupt(FAKE_HAL_TIM_PRIORITY, FAKE_HAL_TIM_EXCEPTION, hook, bus->start_context);
+		bus->in_start = false;
+
+		if(hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+	}
+
+	hi2c->State = (transfer == TRANSFER_MASTER_RX || transfer == TRANSFER_MEM_RX) ? HAL_I2C_STATE_BUSY_RX : HAL_I2C_STATE_BUSY_TX;
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	hi2c->pBuffPtr = data;
+	hi2c->XferSize = length;
+	hi2c->XferCount = length;
+
+	// Describe the transfer on the wire
+	bus->active = true;
+	bus->handle = hi2c;
+	bus->transfer = transfer;
+	bus->address = (uint8_t)(address >> 1);
+	bus->register_address = register_address;
+	bus->buffer = data;
+	bus->length = length;
+	bus->nack = fakeI2cSlave(bus, bus->address) == nullptr;
+	if(bus->nack_count > 0 && bus->nack_address == bus->address){
+		bus->nack_count--;
+		bus->nack = true;
+	}
+
+	bus->lost = bus->lose_count > 0;
+	if(bus->lost) bus->lose_count--;
+
+	// Bytes: address, register and repeated address for memory reads
+	uint32_t bytes = 1 + length;
+	if(transfer == TRANSFER_MEM_TX) bytes = 2 + length;
+	if(transfer == TRANSFER_MEM_RX) bytes = 3 + length;
+	if(bus->nack) bytes = 1;
+
+	// START, 9 clocks a byte
+	uint64_t cycles = (bytes * 9 + 1) * fakeI2cBitCycles(hi2c) + fakeCycles_us(bus->stretch_us);
+	bus->end_cycles = fake_now + cycles;
+
+	bus->transfers++;
+	bus->bytes += bytes;
+	if(dma) bus->dma_transfers++;
+
+	fakeUpdateLines();
+	return HAL_OK;
+}
+
+/*
+ * @brief Resets and enables the peripheral: clears a latched BUSY flag (unless a slave
+ * still holds SDA).
+ *
+ */
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c){
+	Fake_I2C_Bus *bus = fakeI2cFind(hi2c->Instance);
+
+	bus->inits++;
+	if(!bus->sda_held) bus->busy_latched = false;
+
+	hi2c->State = HAL_I2C_STATE_READY;
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+
+	fakeUpdateLines();
+	return HAL_OK;
+}
+
+/*
+ * @brief Disables the peripheral, a transfer on the wire is cut.
+ *
+ */
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c){
+	Fake_I2C_Bus *bus = fakeI2cFind(hi2c->Instance);
+
+	bus->active = false;
+	bus->stop_end_cycles = fake_now;
+
+	hi2c->State = HAL_I2C_STATE_RESET;
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+
+	fakeUpdateLines();
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size){
+	return fakeI2cStart(hi2c, TRANSFER_MASTER_TX, DevAddress, 0, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size){
+	return fakeI2cStart(hi2c, TRANSFER_MASTER_RX, DevAddress, 0, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size){
+	(void)MemAddSize;
+	return fakeI2cStart(hi2c, TRANSFER_MEM_TX, DevAddress, (uint8_t)MemAddress, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size){
+	(void)MemAddSize;
+	return fakeI2cStart(hi2c, TRANSFER_MEM_RX, DevAddress, (uint8_t)MemAddress, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size){
+	(void)MemAddSize;
+	return fakeI2cStart(hi2c, TRANSFER_MEM_TX, DevAddress, (uint8_t)MemAddress, pData, Size, true);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size){
+	(void)MemAddSize;
+	return fakeI2cStart(hi2c, TRANSFER_MEM_RX, DevAddress, (uint8_t)MemAddress, pData, Size, true);
+}
+
+/*
+ * @brief Polls the address as the HAL does (busy-waiting, trials back to back).
+ *
+ */
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint32_t Trials, uint32_t Timeout){
+	(void)Timeout;
+
+	Fake_I2C_Bus *bus = fakeI2cFind(hi2c->Instance);
+	if(hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+
+	bus->probes++;
+
+	fakeUpdateLines();
+	if(hi2c->Instance->SR2 & I2C_SR2_BUSY){
+		if(!bus->active && !bus->busy_latched && !bus->sda_held) fakeAdvanceTo(bus->stop_end_cycles);
+		else {
+			fakeAdvanceTo(fake_now + fakeCycles_us(FAKE_HAL_BUSY_TIMEOUT_MS * 1000));
+			bus->busy_waits++;
+			return HAL_BUSY;
+		}
+	}
+
+	uint8_t address = (uint8_t)(DevAddress >> 1);
+	for(uint32_t trial = 0; trial < Trials; trial++){
+		fakeAdvanceTo(fake_now + 11 * fakeI2cBitCycles(hi2c));
+		bus->transfers++;
+		bus->bytes++;
+
+		bool forced = bus->nack_count > 0 && bus->nack_address == address;
+		if(forced) bus->nack_count--;
+		if(!forced && fakeI2cSlave(bus, address) != nullptr) return HAL_OK;
+	}
+
+	return HAL_ERROR;
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c){
+	return hi2c->State;
+}
+
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c){
+	return hi2c->ErrorCode;
+}
+
+__attribute__((weak)) void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c){ (void)hi2c; }
+__attribute__((weak)) void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c){ (void)hi2c; }
+__attribute__((weak)) void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c){ (void)hi2c; }
+__attribute__((weak)) void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c){ (void)hi2c; }
+__attribute__((weak)) void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c){ (void)hi2c; }
+__attribute__((weak)) void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c){ (void)hi2c; }
+
+
+
+// --------------------------------------------------------------------------- Timers ---
+
+/*
+ * @brief Finds the simulation of a timer.
+ *
+ */
+static Fake_Timer *fakeTimerFind(TIM_TypeDef *instance){
+	for(uint8_t i = 0; i < FAKE_HAL_TIMER_COUNT; i++){
+		if(fake_timers[i].instance == instance) return &fake_timers[i];
+	}
+
+	fakeAbort("unknown timer instance");
+	return nullptr;
+}
+
+/*
+ * @brief Returns the counter of a running timer, from the simulated time.
+ *
+ */
+uint32_t fakeTimGetCounter(TIM_HandleTypeDef *htim){
+	Fake_Timer *timer = fakeTimerFind(htim->Instance);
+	if(!timer->running) return htim->Instance->CNT;
+
+	uint64_t counts = (fake_now - timer->start_cycles) / (htim->Instance->PSC + 1);
+	return (uint32_t)(counts % (htim->Instance->ARR + 1));
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim){
+	htim->Instance->PSC = htim->Init.Prescaler;
+	htim->Instance->ARR = htim->Init.Period;
+	return HAL_OK;
+}
+
+/*
+ * @brief Starts the counter from zero with its update interrupt.
+ *
+ */
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim){
+	Fake_Timer *timer = fakeTimerFind(htim->Instance);
+
+	timer->handle = htim;
+	timer->running = true;
+	timer->start_cycles = fake_now;
+	timer->periods = 0;
+	for(uint8_t i = 0; i < FAKE_HAL_TIMER_CHANNELS; i++) timer->compare_checked[i] = fake_now;
+
+	htim->Instance->DIER |= TIM_IT_UPDATE;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim){
+	Fake_Timer *timer = fakeTimerFind(htim->Instance);
+
+	htim->Instance->CNT = fakeTimGetCounter(htim);
+	timer->running = false;
+
+	htim->Instance->DIER &= ~TIM_IT_UPDATE;
+	return HAL_OK;
+}
+
+__attribute__((weak)) void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim){ (void)htim; }
+__attribute__((weak)) void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim){ (void)htim; }
+
+
+// END OF FILE
@@ -0,0 +1,189 @@
+/*
+ * ina219_model.cpp
+ *
+ * Implementation of ina219_model.hpp header file.
+ *
+ */
+
+#include "ina219_model.hpp"
+
+
+
+// --- Register map ---------------------------------------------------------------------
+
+const uint8_t MODEL_CONF = 0x00;
+const uint8_t MODEL_SHUNT_VOLTAGE = 0x01;
+const uint8_t MODEL_BUS_VOLTAGE = 0x02;
+const uint8_t MODEL_POWER = 0x03;
+const uint8_t MODEL_CURRENT = 0x04;
+const uint8_t MODEL_CALIBRATION = 0x05;
+
+const uint16_t MODEL_CONF_RESET = 0x399F;
+const uint16_t MODEL_CONF_RST = 0x8000;
+
+// Data-sheet page 19, table 5: conversion time for each 4 bit ADC setting [us]
+const uint32_t MODEL_CONVERSION_TIME_US[16] = {
+		84, 148, 276, 532, 84, 148, 276, 532,
+		532, 1060, 2130, 4260, 8510, 17020, 34050, 68100
+};
+
+
+
+// ------------------------------------------------ INA219_Model class implementation ---
+
+/*
+ * @brief Constructor of the model, registers at their power-on values.
+ *
+ */
+INA219_Model::INA219_Model(void) :
+		_registers(),
+		_pointer(0),
+		_shunt_voltage(0),
+		_bus_voltage(0),
+		_overflow(false),
+		_converting(false),
+		_ready(false),
+		_conversion_end(0),
+		_conversions(0),
+		_reads(0),
+		_writes(0)
+	{
+		INA219_Model::_registers[MODEL_CONF] = MODEL_CONF_RESET;
+	}
+
+
+// --- Scripted values ------------------------------------------------------------------
+
+void INA219_Model::setShuntVoltage_uV(int32_t shunt_voltage){
+	INA219_Model::_shunt_voltage = (int16_t)(shunt_voltage / 10);
+}
+
+void INA219_Model::setBusVoltage_mV(uint32_t bus_voltage){
+	INA219_Model::_bus_voltage = (uint16_t)(bus_voltage / 4);
+}
+
+void INA219_Model::setOverflow(bool overflow){
+	INA219_Model::_overflow = overflow;
+}
+
+/*
+ * @brief Returns a register as the sensor would output it now.
+ *
+ */
+uint16_t INA219_Model::getRegister(uint8_t address) const {
+	int32_t calibration = INA219_Model::_registers[MODEL_CALIBRATION];
+	int32_t current = (int32_t)INA219_Model::_shunt_voltage * calibration / 4096;
+
+	switch(address){
+		case MODEL_SHUNT_VOLTAGE:
+			return (uint16_t)INA219_Model::_shunt_voltage;
+
+		case MODEL_BUS_VOLTAGE:
+			return (INA219_Model::_bus_voltage << 3) | (INA219_Model::_ready ? 0x02 : 0x00) | (INA219_Model::_overflow ? 0x01 : 0x00);
+
+		case MODEL_POWER:
+			return (uint16_t)((current < 0 ? -current : current) * INA219_Model::_bus_voltage / 5000);
+
+		case MODEL_CURRENT:
+			return (uint16_t)(int16_t)current;
+
+		default:
+			return address < 6 ? INA219_Model::_registers[address] : 0;
+	}
+}
+
+void INA219_Model::setRegister(uint8_t address, uint16_t value){
+	if(address < 6) INA219_Model::_registers[address] = value;
+}
+
+bool INA219_Model::isConverting(void) const {
+	return INA219_Model::_converting && fakeHalCycles() < INA219_Model::_conversion_end;
+}
+
+
+// --- Bus side -------------------------------------------------------------------------
+
+/*
+ * @brief Sets the register pointer, and the register if a value follows.
+ *
+ */
+void INA219_Model::write(const uint8_t *data, uint16_t length){
+	INA219_Model::_writes++;
+	if(length == 0) return;
+
+	INA219_Model::_pointer = data[0];
+	if(length < 3) return;
+
+	uint16_t value = (data[1] << 8) | data[2];
+	if(data[0] == MODEL_CONF) INA219_Model::writeConfiguration(value);
+	else if(data[0] == MODEL_CALIBRATION) INA219_Model::_registers[MODEL_CALIBRATION] = value & 0xFFFE;
+}
+
+/*
+ * @brief Reads the register at the pointer, the pointer does not move.
+ *
+ */
+void INA219_Model::read(uint8_t *data, uint16_t length){
+	INA219_Model::_reads++;
+	INA219_Model::updateConversion();
+
+	uint16_t value = INA219_Model::getRegister(INA219_Model::_pointer);
+	for(uint16_t i = 0; i < length; i++) data[i] = (i & 1) ? (value & 0xFF) : (value >> 8);
+
+	if(INA219_Model::_pointer == MODEL_POWER) INA219_Model::_ready = false;
+}
+
+/*
+ * @brief Stores the configuration, resets the device or starts a conversion.
+ *
+ */
+void INA219_Model::writeConfiguration(uint16_t value){
+	if(value & MODEL_CONF_RST){
+		for(uint8_t i = 0; i < 6; i++) INA219_Model::_registers[i] = 0;
+		INA219_Model::_registers[MODEL_CONF] = MODEL_CONF_RESET;
+		INA219_Model::_converting = false;
+		INA219_Model::_ready = false;
+		return;
+	}
+
+	INA219_Model::_registers[MODEL_CONF] = value;
+	INA219_Model::_ready = false;
+
+	uint8_t mode = value & 0x07;
+	uint32_t shunt_time = MODEL_CONVERSION_TIME_US[(value >> 3) & 0x0F];
+	uint32_t bus_time = MODEL_CONVERSION_TIME_US[(value >> 7) & 0x0F];
+
+	// Continuous modes always hold a converted sample
+	if(mode >= 0x05){
+		INA219_Model::_converting = false;
+		INA219_Model::_ready = true;
+		return;
+	}
+
+	if(mode == 0x00 || mode == 0x04){
+		INA219_Model::_converting = false;
+		return;
+	}
+
+	uint32_t time = 0;
+	if(mode & 0x01) time += shunt_time;
+	if(mode & 0x02) time += bus_time;
+
+	INA219_Model::_converting = true;
+	INA219_Model::_conversion_end = fakeHalCycles() + (uint64_t)time * (SystemCoreClock / 1000000);
+	INA219_Model::_conversions++;
+}
+
+/*
+ * @brief Ends the running conversion if its time is over.
+ *
+ */
+void INA219_Model::updateConversion(void){
+	if(!INA219_Model::_converting || fakeHalCycles() < INA219_Model::_conversion_end) return;
+
+	INA219_Model::_converting = false;
+	INA219_Model::_ready = true;
+}
+
+
+// END OF FILE
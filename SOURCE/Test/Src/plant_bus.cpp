@@ -0,0 +1,117 @@
+/*
+ * plant_bus.cpp
+ *
+ * Implementation of plant_bus.hpp header file.
+ *
+ */
+
+#include "plant_bus.hpp"
+
+
+
+// --------------------------------------------------- Plant_Bus class implementation ---
+
+/*
+ * @brief Attaches the sensors of a plant at rest to a bus.
+ *
+ * @param bus				I2C1 or I2C2;
+ * @param encoder_address	7 bit address of the AS5600;
+ * @param sensor_1_address	7 bit address of the INA219 on the first motor lead;
+ * @param sensor_2_address	7 bit address of the INA219 on the second motor lead;
+ * @param parameters		Physical parameters of the plant;
+ * @param encoder_bus		Bus of the AS5600, nullptr for the same bus;
+ *
+ */
+Plant_Bus::Plant_Bus(
+I2C_TypeDef *bus,
+uint8_t encoder_address,
+uint8_t sensor_1_address,
+uint8_t sensor_2_address,
+const PLANT_PARAMETERS &parameters,
+I2C_TypeDef *encoder_bus
+) :
+		_bus(bus),
+		_encoder_bus(encoder_bus != nullptr ? encoder_bus : bus),
+		_addresses{encoder_address, sensor_1_address, sensor_2_address},
+		_plant(PLANT_BUS_STEP_US * 1e-6f, parameters),
+		_plant_cycles(fakeHalCycles()),
+		_duty(0),
+		_load_torque(0),
+		_encoder_slave(this, &_encoder),
+		_sensor_1_slave(this, &_sensor_1),
+		_sensor_2_slave(this, &_sensor_2)
+	{
+		Plant_Bus::updateSensors();
+
+		fakeI2cAttach(Plant_Bus::_encoder_bus, encoder_address, &_encoder_slave);
+		fakeI2cAttach(bus, sensor_1_address, &_sensor_1_slave);
+		fakeI2cAttach(bus, sensor_2_address, &_sensor_2_slave);
+	}
+
+Plant_Bus::~Plant_Bus(){
+	fakeI2cDetach(Plant_Bus::_encoder_bus, Plant_Bus::_addresses[0]);
+	for(uint8_t i = 1; i < 3; i++) fakeI2cDetach(Plant_Bus::_bus, Plant_Bus::_addresses[i]);
+}
+
+
+// --- Plant inputs ---------------------------------------------------------------------
+
+void Plant_Bus::setDuty(float duty){
+	Plant_Bus::advance();
+	Plant_Bus::_duty = duty;
+}
+
+void Plant_Bus::setLoadTorque(float load_torque){
+	Plant_Bus::advance();
+	Plant_Bus::_load_torque = load_torque;
+}
+
+/*
+ * @brief Steps the plant up to the current simulated time and updates the registers.
+ *
+ */
+void Plant_Bus::advance(void){
+	uint64_t step = (uint64_t)PLANT_BUS_STEP_US * (SystemCoreClock / 1000000);
+
+	while(Plant_Bus::_plant_cycles + step <= fakeHalCycles()){
+		Plant_Bus::_plant.step(Plant_Bus::_duty, Plant_Bus::_load_torque);
+		Plant_Bus::_plant_cycles += step;
+	}
+
+	Plant_Bus::updateSensors();
+}
+
+
+// --- Private methods ------------------------------------------------------------------
+
+/*
+ * @brief Writes the plant state into the register models.
+ *
+ */
+void Plant_Bus::updateSensors(void){
+	Plant_Bus::_encoder.setRawAngle(Plant_Bus::_plant.getAS5600RawAngle());
+
+	for(uint8_t sensor = 1; sensor <= 2; sensor++){
+		INA219_Model &model = Plant_Bus::getSensor(sensor);
+
+		model.setShuntVoltage_uV((int16_t)Plant_Bus::_plant.getINA219ShuntVoltage(sensor) * 10);
+		model.setBusVoltage_mV((Plant_Bus::_plant.getINA219BusVoltage(sensor) >> 3) * 4);
+	}
+}
+
+
+
+// ------------------------------------------------------- Plant_Slave implementation ---
+
+void Plant_Bus::Plant_Slave::write(const uint8_t *data, uint16_t length){
+	Plant_Bus::Plant_Slave::_owner->advance();
+	Plant_Bus::Plant_Slave::_model->write(data, length);
+}
+
+void Plant_Bus::Plant_Slave::read(uint8_t *data, uint16_t length){
+	Plant_Bus::Plant_Slave::_owner->advance();
+	Plant_Bus::Plant_Slave::_model->read(data, length);
+}
+
+
+// END OF FILE
@@ -0,0 +1,168 @@
+/*
+ * plant_model.cpp
+ *
+ * Implementation of plant_model.hpp header file.
+ *
+ */
+
+#include "plant_model.hpp"
+
+#include <math.h>
+
+
+
+// ------------------------------------------------- Plant_Model class implementation ---
+
+// --- Plant constructor ----------------------------------------------------------------
+
+/*
+ * @brief Constructs the plant at rest.
+ *
+ * @param sampling_time		Period between step() calls (control period) [s];
+ * @param parameters		Physical parameters;
+ *
+ */
+Plant_Model::Plant_Model(float sampling_time, const PLANT_PARAMETERS &parameters) :
+		_parameters(parameters),
+		_sampling_time(sampling_time)
+	{
+		// Integrate with sub-steps short enough for the electrical time constant
+		Plant_Model::_substeps = (uint16_t)ceilf(sampling_time / PLANT_MAX_INTEGRATION_STEP);
+		if(Plant_Model::_substeps == 0) Plant_Model::_substeps = 1;
+
+		// Bridge delay as a whole number of sampling periods
+		Plant_Model::_delay_steps = (uint8_t)lroundf(parameters.bridge_delay / sampling_time);
+		if(Plant_Model::_delay_steps >= PLANT_MAX_DELAY_STEPS) Plant_Model::_delay_steps = PLANT_MAX_DELAY_STEPS - 1;
+
+		Plant_Model::reset();
+	}
+
+
+// --- Simulation methods ---------------------------------------------------------------
+
+/*
+ * @brief Advances the simulation by one sampling period.
+ *
+ * @param duty			H-bridge duty cycle in [-1, 1] (held for the whole period);
+ * @param load_torque	Torque on the output shaft [N*m];
+ *
+ */
+void Plant_Model::step(float duty, float load_torque){
+	// Saturate and delay the duty cycle (bridge.Tdelay)
+	if(duty > 1) duty = 1;
+	if(duty < -1) duty = -1;
+
+	Plant_Model::_duty_line[Plant_Model::_duty_index] = duty;
+	uint8_t delayed = (Plant_Model::_duty_index + PLANT_MAX_DELAY_STEPS - Plant_Model::_delay_steps) % PLANT_MAX_DELAY_STEPS;
+	Plant_Model::_duty_index = (Plant_Model::_duty_index + 1) % PLANT_MAX_DELAY_STEPS;
+
+	Plant_Model::_voltage = Plant_Model::_parameters.bridge_gain * Plant_Model::_duty_line[delayed];
+
+	// Load seen from the motor shaft
+	float motor_load = load_torque * Plant_Model::_parameters.gearbox;
+
+	// Integrate the electrical and mechanical equations (semi-implicit Euler)
+	float dt = Plant_Model::_sampling_time / Plant_Model::_substeps;
+
+	for(uint16_t i = 0; i < Plant_Model::_substeps; i++){
+		// La di/dt = v - Ra i - Kphi w
+		float di = (Plant_Model::_voltage - Plant_Model::_parameters.Ra * Plant_Model::_current - Plant_Model::_parameters.Kphi * Plant_Model::_speed) / Plant_Model::_parameters.La;
+		Plant_Model::_current += di * dt;
+
+		// J dw/dt = Kphi i - B w - load
+		float dw = (Plant_Model::_parameters.Kphi * Plant_Model::_current - Plant_Model::_parameters.B * Plant_Model::_speed - motor_load) / Plant_Model::_parameters.J;
+		Plant_Model::_speed += dw * dt;
+
+		// d(theta)/dt = gearbox w
+		Plant_Model::_position += Plant_Model::_parameters.gearbox * Plant_Model::_speed * dt;
+	}
+
+	Plant_Model::_time += Plant_Model::_sampling_time;
+}
+
+/*
+ * @brief Restarts the simulation at rest.
+ *
+ * @param position	Initial output angle [rad];
+ *
+ */
+void Plant_Model::reset(float position){
+	for(uint8_t i = 0; i < PLANT_MAX_DELAY_STEPS; i++) Plant_Model::_duty_line[i] = 0;
+	Plant_Model::_duty_index = 0;
+
+	Plant_Model::_time = 0;
+	Plant_Model::_position = position;
+	Plant_Model::_speed = 0;
+	Plant_Model::_current = 0;
+	Plant_Model::_voltage = 0;
+}
+
+
+// --- Synthetic sensor registers -------------------------------------------------------
+
+/*
+ * @brief Returns the RAW ANGLE register content for the output shaft angle.
+ *
+ */
+uint16_t Plant_Model::getAS5600RawAngle(void){
+	// Wrap to one turn and quantize to 12 bits
+	float turn = Plant_Model::_position / (2 * (float)M_PI);
+	turn -= floorf(turn);
+
+	return (uint16_t)(turn * 4096) & 0x0FFF;
+}
+
+/*
+ * @brief Returns the SHUNT VOLTAGE register content (10 uV LSB, signed).
+ *
+ * @param sensor	1 or 2, as CurrentSensor1 and CurrentSensor2 in main;
+ *
+ */
+uint16_t Plant_Model::getINA219ShuntVoltage(uint8_t sensor){
+	float shunt_voltage = Plant_Model::getSensorCurrent(sensor) * Plant_Model::_parameters.shunt_resistor;
+
+	return (uint16_t)(int16_t)lroundf(shunt_voltage / 10e-6);
+}
+
+/*
+ * @brief Returns the BUS VOLTAGE register content (4 mV LSB, conversion ready flag set).
+ * Sensor 1 sits on the lead that goes low for positive duty cycles, sensor 2 on the
+ * other one, so that their difference is the armature voltage.
+ *
+ * @param sensor	1 or 2, as CurrentSensor1 and CurrentSensor2 in main;
+ *
+ */
+uint16_t Plant_Model::getINA219BusVoltage(uint8_t sensor){
+	float half = Plant_Model::_voltage / 2;
+	float bus_voltage = Plant_Model::_parameters.bridge_gain / 2 + (sensor == 1 ? -half : half);
+	if(bus_voltage < 0) bus_voltage = 0;
+
+	return ((uint16_t)lroundf(bus_voltage / 4e-3) << 3) | 0x0002;
+}
+
+/*
+ * @brief Returns the CURRENT register content for the default calibration.
+ *
+ * @param sensor	1 or 2, as CurrentSensor1 and CurrentSensor2 in main;
+ *
+ */
+uint16_t Plant_Model::getINA219Current(uint8_t sensor){
+	return (uint16_t)(int16_t)lroundf(Plant_Model::getSensorCurrent(sensor) / Plant_Model::_parameters.current_lsb);
+}
+
+
+// --- Private methods ------------------------------------------------------------------
+
+/*
+ * @brief Returns the current through a sensor: the two shunts see the armature current
+ * with opposite signs (main computes i = (i1 - i2) / 2).
+ *
+ * @param sensor	1 or 2;
+ *
+ */
+float Plant_Model::getSensorCurrent(uint8_t sensor){
+	return sensor == 1 ? Plant_Model::_current : -Plant_Model::_current;
+}
+
+
+// END OF FILE
@@ -0,0 +1,151 @@
+/*
+ * sil_runner.cpp
+ *
+ * Implementation of sil_runner.hpp header file.
+ *
+ */
+
+#include "sil_runner.hpp"
+#include "test_fixture.hpp"
+
+
+
+// ------------------------------------------------------ Sil_Hardware implementation ---
+
+/*
+ * @brief Initialises I2C1 (400 kHz, DMA channels linked), I2C2 (400 kHz), TIM3 (1 ms at
+ * 1 MHz) and the cycle counter.
+ *
+ */
+Sil_Hardware::Sil_Hardware(void) :
+		hdma_i2c1_rx(),
+		hdma_i2c1_tx()
+	{
+		fixtureI2cInit(&hi2c1, I2C1);
+		Sil_Hardware::hi2c1.hdmarx = &hdma_i2c1_rx;
+		Sil_Hardware::hi2c1.hdmatx = &hdma_i2c1_tx;
+
+		fixtureI2cInit(&hi2c2, I2C2);
+
+		fixtureTickTimerInit(&htim3, TIM3, 1000);
+	}
+
+
+
+// -------------------------------------------------- Sil_Runner class implementation ---
+
+// --- Runner constructor ---------------------------------------------------------------
+
+/*
+ * @brief Builds the firmware objects of main around a plant at rest.
+ *
+ * @param parameters	Physical parameters of the plant;
+ * @param encoder_bus	Bus of the AS5600 (ENCODER_ON_I2C2 of main);
+ *
+ */
+Sil_Runner::Sil_Runner(const PLANT_PARAMETERS &parameters, Sil_Runner::ENCODER_BUS encoder_bus) :
+		_encoder_bus(encoder_bus),
+		_hardware(),
+		_plant_bus(I2C1, 0x36, 0x40, 0x44, parameters, encoder_bus == ENCODER_OWN_I2C2 ? I2C2 : I2C1),
+		_bus(&_hardware.hi2c1, I2C_Bus::DMA),
+		_bus2(&_hardware.hi2c2, I2C_Bus::INTERRUPT),
+		_tick(&_hardware.htim3),
+		_encoder(encoder_bus == ENCODER_OWN_I2C2 ? &_hardware.hi2c2 : &_hardware.hi2c1, 0x36, AS5600::CLOCK_WISE, 50),
+		_angle_result(),
+		_power_stage(&_hardware.hi2c1, 3.0, 0.1, 0x40, 0x44, 50),
+		_scheduler(_bus, _tick),
+		_encoder_scheduler(_bus2, _tick),
+		_power_trigger_stream(I2C_SCHEDULER_NO_STREAM),
+		_power_collect_stream(I2C_SCHEDULER_NO_STREAM),
+		_encoder_stream(I2C_SCHEDULER_NO_STREAM),
+		_policy(_power_stage),
+		_controller(),
+		_observer(),
+		_output_shaft(1000, SATURATION_SPEED * OBSERVER_GEARBOX),
+		_signals()
+	{}
+
+
+// --- Runner methods -------------------------------------------------------------------
+
+/*
+ * @brief Runs the setup of main (bus slots as in main.cpp) and starts the tick. On its
+ * own bus the encoder angle is released at 200 us, during the power trigger.
+ *
+ */
+bool Sil_Runner::begin(void){
+	bool own_bus = Sil_Runner::_encoder_bus == ENCODER_OWN_I2C2;
+
+	if(!Sil_Runner::_bus.begin()) return false;
+	if(own_bus && !Sil_Runner::_bus2.begin()) return false;
+
+	I2C_Scheduler &encoder_slots = Sil_Runner::getEncoderScheduler();
+	uint16_t encoder_release_us = own_bus ? 200 : 380;
+
+	Sil_Runner::_power_trigger_stream = Sil_Runner::_scheduler.addStream("power trigger", 1, 190, 200, 400,
+			[](void *context){ return ((Motor_Power_Stage *)context)->trigger(); }, &_power_stage);
+	Sil_Runner::_power_collect_stream = Sil_Runner::_scheduler.addStream("power collect", 1, 470, 530, 1000,
+			[](void *context){ return ((Motor_Power_Stage *)context)->collect(); }, &_power_stage);
+	Sil_Runner::_encoder_stream = encoder_slots.addStream("encoder angle", 1, 112, encoder_release_us, 530,
+			[](void *context){ Sil_Runner *runner = (Sil_Runner *)context; return runner->_encoder.readRawAngleAsync(runner->_angle_result); }, this);
+	encoder_slots.addStream("magnet status", 100, 90, 0, 200,
+			[](void *context){ return ((AS5600 *)context)->requestStatus(); }, &_encoder);
+	encoder_slots.addStream("magnet strength", 100, 140, 0, 200,
+			[](void *context){ return ((AS5600 *)context)->requestMagnitude(); }, &_encoder);
+
+	Sil_Runner::_output_shaft.reset(Sil_Runner::_encoder.getRawAngle());
+	Sil_Runner::_observer.reset(Sil_Runner::_output_shaft.getAngle());
+
+	if(!Sil_Runner::_scheduler.build()) return false;
+
+	uint16_t trigger_phase = Sil_Runner::_scheduler.getPhase_us(Sil_Runner::_power_trigger_stream);
+	uint16_t collect_phase = Sil_Runner::_scheduler.getPhase_us(Sil_Runner::_power_collect_stream);
+	if(!Sil_Runner::_power_stage.begin(Sil_Runner::_tick.getPeriod_us(), trigger_phase, collect_phase)) return false;
+
+	if(!Sil_Runner::_scheduler.begin()) return false;
+	if(own_bus && !Sil_Runner::_encoder_scheduler.begin(I2C_SCHEDULER_CHANNEL + 1)) return false;
+	return Sil_Runner::_tick.begin();
+}
+
+/*
+ * @brief Runs one iteration of the main loop: waits for the tick, reads the samples the
+ * bus slots collected, runs the observer, the controller and the conversion policy,
+ * drives the plant.
+ *
+ */
+void Sil_Runner::tick(void){
+	Sil_Runner::_tick.wait();
+
+	Sil_Runner::_power_stage.update();
+
+	Sil_Runner::Signals &signals = Sil_Runner::_signals;
+	signals.current_fresh = Sil_Runner::_power_stage.getSample().fresh;
+	signals.current = signals.current_fresh ? Sil_Runner::_power_stage.getCurrent_Q16() : Sil_Runner::_observer.getCurrent();
+	signals.voltage = Sil_Runner::_power_stage.getVoltage_Q16();
+
+	signals.counts = Sil_Runner::_encoder.getSampleRawAngle();
+	signals.angle_fresh = Sil_Runner::_angle_result.isReady();
+	Sil_Runner::_output_shaft.update(signals.counts);
+	signals.position = Sil_Runner::_output_shaft.getPosition();
+
+	Sil_Runner::_observer.update(Sil_Runner::_output_shaft.getAngle(), signals.current, signals.voltage, signals.current_fresh);
+	signals.speed = Sil_Runner::_observer.getSpeed();
+
+	signals.duty = Sil_Runner::_controller.update(signals.position, signals.speed, signals.current);
+
+	Sil_Runner::_policy.update(Sil_Runner::_controller, signals.speed, signals.current);
+
+	Sil_Runner::_plant_bus.setDuty(q16ToFloat(signals.duty));
+
+	Sil_Runner::_bus.service();
+	if(Sil_Runner::_encoder_bus == ENCODER_OWN_I2C2) Sil_Runner::_bus2.service();
+
+	Sil_Runner::_tick.done();
+}
+
+void Sil_Runner::run(uint32_t ticks){
+	for(uint32_t i = 0; i < ticks; i++) Sil_Runner::tick();
+}
+
+
+// END OF FILE
@@ -0,0 +1,96 @@
+/*
+ * test_runner.cpp
+ *
+ * Implementation of test_runner.hpp header file, and main() of the host runners.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "fake_hal.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+
+
+// --- Runner state ---------------------------------------------------------------------
+
+static Test_Case *test_cases = nullptr;
+static Test_Case *test_last = nullptr;
+
+static const char *test_current = "";
+static uint32_t test_failures = 0;
+
+
+
+// -------------------------------------------------------------------- Test registry ---
+
+/*
+ * @brief Appends a case to the registry, in definition order.
+ *
+ */
+Test_Registrar::Test_Registrar(Test_Case *test_case){
+	if(test_last == nullptr) test_cases = test_case;
+	else test_last->next = test_case;
+
+	test_last = test_case;
+}
+
+/*
+ * @brief Reports a failed check of the running case.
+ *
+ */
+void testFail(const char *file, int line, const char *condition){
+	test_failures++;
+	printf("  FAILED %s:%d: %s (in %s)\n", file, line, condition, test_current);
+}
+
+
+
+// -------------------------------------------------------------------------- Reports ---
+
+void benchReport(const char *name, const char *metric, double value, const char *unit){
+	printf("  %-28s %-22s %14.2f %s\n", name, metric, value, unit);
+}
+
+double benchHostTime_ns(void){
+	std::chrono::nanoseconds now = std::chrono::steady_clock::now().time_since_epoch();
+	return (double)now.count();
+}
+
+
+
+// ----------------------------------------------------------------------------- Main ---
+
+/*
+ * @brief Runs the cases matching the name prefixes given, all without arguments.
+ *
+ */
+int main(int argc, char **argv){
+	uint32_t run = 0;
+	uint32_t failed = 0;
+
+	for(Test_Case *test_case = test_cases; test_case != nullptr; test_case = test_case->next){
+		bool selected = argc < 2;
+		for(int i = 1; i < argc && !selected; i++) selected = strncmp(test_case->name, argv[i], strlen(argv[i])) == 0;
+		if(!selected) continue;
+
+		uint32_t failures = test_failures;
+		test_current = test_case->name;
+
+		printf("[ RUN  ] %s\n", test_case->name);
+		fakeHalReset();
+		test_case->function();
+
+		run++;
+		if(test_failures != failures) failed++;
+		printf("[ %s ] %s\n", test_failures != failures ? "FAIL" : " OK ", test_case->name);
+	}
+
+	printf("%u cases, %u failed\n", run, failed);
+	return failed == 0 && run > 0 ? 0 : 1;
+}
+
+
+// END OF FILE
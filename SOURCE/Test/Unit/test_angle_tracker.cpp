@@ -0,0 +1,83 @@
+/*
+ * test_angle_tracker.cpp
+ *
+ * Unit tests of the angle tracking loop: pole placement of the discrete gains and tracing
+ * of an accelerating shaft across turns.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+
+#include "angle_tracker.hpp"
+
+#include <math.h>
+
+
+
+// --- Pole placement -------------------------------------------------------------------
+
+// Error after a step, with a triple pole at p: e[k+3] = 3p e[k+2] - 3p^2 e[k+1] + p^3 e[k]
+static float trackerStepResidual(float normalized_bandwidth){
+	const uint16_t step = 1000;
+	const uint8_t samples = 16;
+
+	Angle_Tracker tracker(1000, normalized_bandwidth * 1000);
+	tracker.update(0);
+
+	float error[samples];
+	for(uint8_t k = 0; k < samples; k++){
+		tracker.update(step);
+		error[k] = q16ToFloat(tracker.getAngleCounts()) - step;
+	}
+
+	float p = expf(-normalized_bandwidth);
+	float residual = 0;
+	for(uint8_t k = 0; k + 3 < samples; k++){
+		float r = error[k + 3] - 3 * p * error[k + 2] + 3 * p * p * error[k + 1] - p * p * p * error[k];
+		residual = fmaxf(residual, fabsf(r));
+	}
+
+	return residual;
+}
+
+TEST(tracker_step_has_triple_pole){
+	// Up to the bandwidth limit, a step of 1000 counts within Q16 rounding
+	CHECK(trackerStepResidual(0.05f) < 0.01f);
+	CHECK(trackerStepResidual(0.2f) < 0.01f);
+	CHECK(trackerStepResidual(ANGLE_TRACKER_MAX_NORMALIZED) < 0.01f);
+
+	Angle_Tracker tracker(1000);
+	CHECK(!tracker.setBandwidth(ANGLE_TRACKER_MAX_NORMALIZED * 1000 * 1.01f));
+	CHECK(tracker.getBandwidth() == ANGLE_TRACKER_DEFAULT_BANDWIDTH);
+}
+
+
+// --- Tracing --------------------------------------------------------------------------
+
+TEST(tracker_traces_constant_acceleration){
+	const float sample_rate = 1000;
+	const float acceleration = 100;					// [rad/s^2]
+	const float count = 2 * M_PI / ANGLE_TRACKER_COUNTS;
+
+	Angle_Tracker tracker(sample_rate);
+
+	// Quadratic trajectory, two turns in 500 ms (type 3: no lag once settled)
+	for(uint16_t k = 0; k <= 500; k++){
+		float t = k / sample_rate;
+		tracker.update((uint16_t)lroundf(0.5f * acceleration * t * t / count) & 0x0FFF);
+	}
+
+	// The states predict the next sample
+	float t = 501 / sample_rate;
+	float angle = 0.5f * acceleration * t * t;
+	float velocity = acceleration * t;
+
+	float wrapped = fmodf(angle, 2 * M_PI);
+	CHECK_NEAR(q16ToFloat(tracker.getAngle()), wrapped, 2 * count);
+	CHECK_NEAR(q16ToFloat(tracker.getVelocity()), velocity, 0.5);
+	CHECK_NEAR(q16ToFloat(tracker.getAcceleration()), acceleration, 10);
+}
+
+
+// END OF FILE
@@ -0,0 +1,147 @@
+/*
+ * test_as5600.cpp
+ *
+ * Unit tests of the AS5600 driver against its register model: configuration setters,
+ * the shadow register file and the snapshot windows.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "as5600_model.hpp"
+
+#include "AS5600.hpp"
+
+
+
+// --- Configuration --------------------------------------------------------------------
+
+TEST(as5600_setters_address_their_conf_byte){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	AS5600 encoder(&hi2c);
+
+	// CONF_L: power mode, hysteresis, output stage, PWM frequency
+	CHECK(encoder.setPowerMode(AS5600::LPM1));
+	CHECK(encoder.setHysteresis(AS5600::HYST_2));
+	CHECK(encoder.setOutputMode(AS5600::DIGITAL_PWM));
+	CHECK(encoder.setPWMFrequency(AS5600::PWM_920Hz));
+
+	// CONF_H: slow filter, fast filter threshold, watchdog
+	CHECK(encoder.setSlowFilter(AS5600::SLOW_FILTER_4x));
+	CHECK(encoder.setFastFilter(AS5600::FAST_FILTER_9_LSBs));
+	CHECK(encoder.setWatchDog(AS5600::WATCHDOG_ON));
+
+	// Every field kept the others of its byte
+	CHECK(model.getRegister(0x08) == (AS5600::LPM1 | AS5600::HYST_2 | AS5600::DIGITAL_PWM | AS5600::PWM_920Hz));
+	CHECK(model.getRegister(0x07) == (AS5600::SLOW_FILTER_4x | AS5600::FAST_FILTER_9_LSBs | AS5600::WATCHDOG_ON));
+
+	CHECK(encoder.getOutputMode() == AS5600::DIGITAL_PWM);
+	CHECK(encoder.getPWMFrequency() == AS5600::PWM_920Hz);
+	CHECK(encoder.getSlowFilter() == AS5600::SLOW_FILTER_4x);
+}
+
+
+// --- Shadow register file -------------------------------------------------------------
+
+TEST(as5600_shadow_serves_reads_and_single_write_setters){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	AS5600 encoder(&hi2c);
+
+	// First setter reads CONF once, then writes it
+	uint32_t transfers = fakeI2cGetTransfers(I2C1);
+	CHECK(encoder.setHysteresis(AS5600::HYST_2));
+	CHECK(fakeI2cGetTransfers(I2C1) - transfers == 2);
+
+	// Next setters only write, getters stay off the bus
+	transfers = fakeI2cGetTransfers(I2C1);
+	CHECK(encoder.setSlowFilter(AS5600::SLOW_FILTER_4x));
+	CHECK(fakeI2cGetTransfers(I2C1) - transfers == 1);
+
+	transfers = fakeI2cGetTransfers(I2C1);
+	CHECK(encoder.getSlowFilter() == AS5600::SLOW_FILTER_4x);
+	CHECK(fakeI2cGetTransfers(I2C1) - transfers == 0);
+	CHECK(encoder.getShadowHits() > 0);
+
+	// A change behind the driver is seen by the verify mode, then resynchronised
+	model.setRegister(0x07, AS5600::SLOW_FILTER_8x);
+	encoder.setShadowVerify(true);
+	CHECK(encoder.getSlowFilter() == AS5600::SLOW_FILTER_8x);
+	CHECK(encoder.getShadowMismatches() == 1);
+
+	encoder.setShadowVerify(false);
+	CHECK(encoder.getSlowFilter() == AS5600::SLOW_FILTER_8x);
+}
+
+
+// --- Snapshot -------------------------------------------------------------------------
+
+TEST(as5600_snapshot_angles_differ_with_zero_position){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRegister(0x01, 0x00);
+	model.setRegister(0x02, 100);		// ZPOS
+	model.setRawAngle(1000);
+	model.setStatus(0x20);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	AS5600 encoder(&hi2c);
+	uint32_t reads = model.getReads();
+
+	AS5600::SNAPSHOT snapshot = {};
+	CHECK(encoder.getSnapshot(&snapshot, AS5600::WINDOW_STATUS_ANGLES));
+
+	CHECK(snapshot.status == 0x20);
+	CHECK(snapshot.raw_angle == 1000);
+	CHECK(snapshot.angle == 900);
+	CHECK(snapshot.agc == 0 && snapshot.magnitude == 0);
+	CHECK(model.getReads() - reads == 1);
+}
+
+TEST(as5600_snapshot_full_skips_reserved_registers){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0ABC);
+	model.setAGC(0x42);
+	model.setMagnitude(0x0765);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	AS5600 encoder(&hi2c);
+	uint32_t reads = model.getReads();
+
+	AS5600::SNAPSHOT snapshot = {};
+	CHECK(encoder.getSnapshot(&snapshot, AS5600::WINDOW_FULL));
+
+	CHECK(snapshot.raw_angle == 0x0ABC);
+	CHECK(snapshot.angle == 0x0ABC);
+	CHECK(snapshot.agc == 0x42);
+	CHECK(snapshot.magnitude == 0x0765);
+	CHECK(model.getReads() - reads == 2);
+	CHECK(model.getReservedReads() == 0);
+}
+
+TEST(as5600_snapshot_fails_without_device){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600 encoder(&hi2c);
+
+	AS5600::SNAPSHOT snapshot = {};
+	CHECK(!encoder.getSnapshot(&snapshot));
+}
+
+
+// END OF FILE
@@ -0,0 +1,289 @@
+/*
+ * test_async_result.cpp
+ *
+ * Unit tests of the handle-based asynchronous reads of the drivers, on a bus with a
+ * simulated latency (slave clock stretching): progress of the handle, pending slots of
+ * the drivers, failures and the loop of main.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "as5600_model.hpp"
+#include "ina219_model.hpp"
+#include "sil_runner.hpp"
+
+#include "AS5600.hpp"
+#include "INA219.hpp"
+#include "i2c_bus.hpp"
+
+
+
+// --- Handle helpers -------------------------------------------------------------------
+
+const uint32_t ASYNC_STRETCH_US = 300;		// Slow slave, on top of the wire time
+
+// Wire time of a 2 byte register read: 5 bytes of 9 clocks and the START
+static uint32_t asyncWire_us(I2C_HandleTypeDef *hi2c){
+	return (5 * 9 + 1) * 1000000 / hi2c->Init.ClockSpeed;
+}
+
+struct Async_Chain {
+	AS5600 *encoder;
+	Async_Result<uint16_t> *next;
+	bool started;
+};
+
+static void asyncChainCallback(void *context, const Async_Result<uint16_t> &result){
+	Async_Chain *chain = (Async_Chain *)context;
+	chain->started = chain->encoder->readRawAngleAsync(*chain->next);
+}
+
+struct Async_Preemption {
+	AS5600 *encoder;
+	Async_Result<uint16_t> *result;
+	bool started;
+};
+
+static void asyncStartFromInterrupt(void *context){
+	Async_Preemption *preemption = (Async_Preemption *)context;
+	preemption->started = preemption->encoder->readRawAngleAsync(*preemption->result);
+}
+
+
+
+// --- Progress -------------------------------------------------------------------------
+
+TEST(async_read_completes_after_bus_latency){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0ABC);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+	fakeI2cSetStretch_us(I2C1, ASYNC_STRETCH_US);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+
+	// The start returns at once, the handle stays pending for the whole transfer
+	Async_Result<uint16_t> angle;
+	CHECK(angle.getState() == Async_Result<uint16_t>::IDLE);
+
+	uint32_t start = fakeHalTime_us();
+	CHECK(encoder.readRawAngleAsync(angle));
+	CHECK(fakeHalTime_us() - start < 10);
+	CHECK(angle.isPending());
+
+	fakeHalAdvance_us(ASYNC_STRETCH_US / 2);
+	CHECK(angle.isPending() && !angle.isDone());
+
+	// A short wait gives up, a long one gets the value
+	CHECK(!angle.await(10));
+	CHECK(angle.await(asyncWire_us(&hi2c) + ASYNC_STRETCH_US));
+
+	CHECK(angle.isReady());
+	CHECK(angle.getValue() == 0x0ABC);
+	CHECK(angle.getStatus() == HAL_OK);
+	CHECK(encoder.getSampleRawAngle() == 0x0ABC);
+
+	uint32_t expected_us = asyncWire_us(&hi2c) + ASYNC_STRETCH_US;
+	CHECK(angle.getLatency_us() >= expected_us && angle.getLatency_us() <= expected_us + 10);
+}
+
+TEST(async_reads_overlap_on_both_sensors){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	INA219_Model model;
+	model.setShuntVoltage_uV(10000);		// 1 A through 10 mOhm
+	model.setBusVoltage_mV(12000);
+	fakeI2cAttach(I2C1, INA219_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	INA219 sensor(&hi2c, 3.2f, 0.01f);
+	fakeI2cSetStretch_us(I2C1, ASYNC_STRETCH_US);
+
+	// Both queued back to back, the second completes one transfer later
+	Async_Result<q16_t> current, bus_voltage;
+	CHECK(sensor.readCurrentAsync(current));
+	CHECK(sensor.readBusVoltageAsync(bus_voltage));
+
+	CHECK(current.await(2 * (asyncWire_us(&hi2c) + ASYNC_STRETCH_US)));
+	CHECK(bus_voltage.await(2 * (asyncWire_us(&hi2c) + ASYNC_STRETCH_US)));
+
+	CHECK_NEAR(q16ToFloat(current.getValue()), 1.0, 0.01);
+	CHECK_NEAR(q16ToFloat(bus_voltage.getValue()), 12.0, 0.01);
+	CHECK(bus_voltage.getLatency_us() > current.getLatency_us() + ASYNC_STRETCH_US);
+}
+
+
+// --- Pending slots --------------------------------------------------------------------
+
+TEST(async_pending_slot_refuses_second_read){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+	fakeI2cSetStretch_us(I2C1, ASYNC_STRETCH_US);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+
+	// One raw angle read at a time per driver, and a pending handle cannot restart
+	Async_Result<uint16_t> first, second;
+	CHECK(encoder.readRawAngleAsync(first));
+	CHECK(!encoder.readRawAngleAsync(second));
+	CHECK(!encoder.readRawAngleAsync(first));
+	CHECK(second.getState() == Async_Result<uint16_t>::IDLE);
+
+	// Another kind of read has its own slot
+	Async_Result<q16_t> real_angle;
+	CHECK(encoder.readRealAngleAsync(real_angle));
+
+	CHECK(first.await(1000) && real_angle.await(1000));
+	CHECK(bus.getCompletedCount() == 2);
+
+	CHECK(encoder.readRawAngleAsync(second));
+	CHECK(second.await(1000));
+}
+
+TEST(async_slot_shared_with_interrupts){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0789);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+
+	// A tick interrupt claims the slot inside the HAL start of a blocking read
+	Async_Result<uint16_t> thread_result, interrupt_result;
+	Async_Preemption preemption = {&encoder, &interrupt_result, false};
+	fakeI2cSetStartHook(I2C1, asyncStartFromInterrupt, &preemption);
+
+	CHECK(encoder.getRawAngle() == 0x0789);
+	CHECK(preemption.started);
+
+	// Thread mode finds it taken until the queued read completes
+	CHECK(interrupt_result.isPending());
+	CHECK(!encoder.readRawAngleAsync(thread_result));
+	CHECK(thread_result.getState() == Async_Result<uint16_t>::IDLE);
+
+	CHECK(interrupt_result.await(1000));
+	CHECK(interrupt_result.getValue() == 0x0789);
+
+	CHECK(encoder.readRawAngleAsync(thread_result));
+	CHECK(thread_result.await(1000));
+}
+
+TEST(async_callback_chains_next_read){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0321);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+	fakeI2cSetStretch_us(I2C1, ASYNC_STRETCH_US);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+
+	// The slot is free when the callback runs
+	Async_Result<uint16_t> second;
+	Async_Chain chain = {&encoder, &second, false};
+	Async_Result<uint16_t> first(asyncChainCallback, &chain);
+
+	CHECK(encoder.readRawAngleAsync(first));
+	CHECK(first.await(1000));
+	CHECK(chain.started);
+
+	CHECK(second.await(1000));
+	CHECK(second.getValue() == 0x0321);
+	CHECK(second.getLatency_us() >= ASYNC_STRETCH_US);
+}
+
+
+// --- Failures -------------------------------------------------------------------------
+
+TEST(async_failure_keeps_previous_value){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0456);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+
+	Async_Result<uint16_t> angle;
+	CHECK(encoder.readRawAngleAsync(angle));
+	CHECK(angle.await(1000));
+
+	// A NACK fails the handle, the value and the sample stay
+	model.setRawAngle(0x0567);
+	fakeI2cForceNack(I2C1, AS5600_DEFAULT_ADDRESS, 1);
+
+	CHECK(encoder.readRawAngleAsync(angle));
+	CHECK(!angle.await(1000));
+	CHECK(angle.getState() == Async_Result<uint16_t>::FAILED);
+	CHECK(angle.getStatus() != HAL_OK);
+	CHECK(angle.getValue() == 0x0456);
+	CHECK(encoder.getSampleRawAngle() == 0x0456);
+	CHECK(encoder.getSampleErrors() == 1);
+
+	// The slot was freed
+	CHECK(encoder.readRawAngleAsync(angle));
+	CHECK(angle.await(1000));
+	CHECK(angle.getValue() == 0x0567);
+}
+
+
+// --- Loop of main ---------------------------------------------------------------------
+
+TEST(async_angle_slot_tolerates_slow_encoder){
+	Sil_Runner runner(PLANT_DEFAULT_PARAMETERS, Sil_Runner::ENCODER_OWN_I2C2);
+	CHECK(runner.begin());
+
+	runner.getController().setMode(Cascade_Controller::SPEED);
+	runner.getController().setSpeedReference(q16FromFloat(200));
+	runner.run(100);
+
+	CHECK(runner.getSignals().angle_fresh);
+	uint16_t latency = runner.getAngleResult().getLatency_us();
+
+	// On its own bus the angle read stretched by 100 us still arrives every tick, within
+	// its deadline
+	fakeI2cSetStretch_us(I2C2, 100);
+	uint16_t fresh = 0;
+	for(uint16_t i = 0; i < 100; i++){
+		runner.tick();
+		if(runner.getSignals().angle_fresh) fresh++;
+	}
+
+	CHECK(fresh == 100);
+	CHECK(runner.getAngleResult().getLatency_us() >= latency + 100);
+	const I2C_Scheduler::Stream &stream = runner.getEncoderScheduler().getStream(runner.getEncoderStream());
+	CHECK(stream.missed == 0);
+	CHECK(stream.release_us + stream.max_latency_us <= stream.deadline_us);
+	CHECK(runner.getTick().getOverrunCount() == 0);
+}
+
+
+// END OF FILE
@@ -0,0 +1,109 @@
+/*
+ * test_cascade_controller.cpp
+ *
+ * Step responses of the cascaded controller against the plant model (DC motor, gearbox
+ * and H-bridge of MODELS_AND_SIMULATIONS/Full_Model_params.m), sensors ideal.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "plant_model.hpp"
+
+#include "cascade_controller.hpp"
+
+#include <math.h>
+
+
+
+// --- Plant ----------------------------------------------------------------------------
+
+/*
+ * @brief Runs one tick: the controller reads the motor, the motor applies the duty.
+ *
+ */
+static void controllerTick(Cascade_Controller *controller, Plant_Model *motor){
+	q16_t duty = controller->update(q16FromFloat(motor->getPosition()), q16FromFloat(motor->getSpeed()), q16FromFloat(motor->getCurrent()));
+	motor->step(q16ToFloat(duty));
+}
+
+
+
+// --- Step responses -------------------------------------------------------------------
+
+TEST(controller_position_step_matches_tuning){
+	Cascade_Controller controller;
+	Plant_Model motor(CONTROLLER_SAMPLING_TIME);
+
+	// Step small enough to keep the speed reference below its limit
+	const float step = 0.1f;
+	const float count = 2 * M_PI / 4096;
+
+	controller.setMode(Cascade_Controller::POSITION);
+	controller.setPositionReference(q16FromFloat(step));
+
+	// First order at the crossover of the tuning (Rp.wc = 22 rad/s): 63 % after 1 / wc
+	float overshoot = 0;
+	for(uint16_t i = 0; i < 300; i++){
+		controllerTick(&controller, &motor);
+		if(i == 45) CHECK_NEAR(motor.getPosition(), 0.63f * step, 0.1f * step);
+		overshoot = fmaxf(overshoot, motor.getPosition() - step);
+	}
+
+	// Settled within an encoder count, no overshoot with 88.6 deg of margin
+	CHECK_NEAR(motor.getPosition(), step, count);
+	CHECK(overshoot < count);
+}
+
+/*
+ * @brief Runs a speed step, returns the overshoot relative to the step.
+ *
+ */
+static float controllerSpeedStep(float reference, float *max_current){
+	Cascade_Controller controller;
+	Plant_Model motor(CONTROLLER_SAMPLING_TIME);
+
+	controller.setMode(Cascade_Controller::SPEED);
+	controller.setSpeedReference(q16FromFloat(reference));
+
+	float max_speed = 0;
+	*max_current = 0;
+	for(uint16_t i = 0; i < 1000; i++){
+		controllerTick(&controller, &motor);
+		max_speed = fmaxf(max_speed, motor.getSpeed());
+		*max_current = fmaxf(*max_current, q16ToFloat(controller.getCurrentReference()));
+		CHECK(fabsf(q16ToFloat(controller.getDuty())) <= SATURATION_DUTY);
+	}
+
+	CHECK_NEAR(motor.getSpeed(), reference, reference * 0.01f);
+	return max_speed / reference - 1;
+}
+
+TEST(controller_speed_step_respects_limits){
+	// A small step stays linear
+	float max_current;
+	float linear_overshoot = controllerSpeedStep(20, &max_current);
+	CHECK(max_current < SATURATION_CURRENT);
+
+	// A large one saturates the current reference at sat.I, with anti-windup the
+	// integrator does not add to the overshoot of the linear loop
+	float limited_overshoot = controllerSpeedStep(400, &max_current);
+	CHECK_NEAR(max_current, SATURATION_CURRENT, 1e-3);
+	CHECK(limited_overshoot < linear_overshoot);
+}
+
+TEST(controller_disabled_outputs_zero){
+	Cascade_Controller controller;
+	Plant_Model motor(CONTROLLER_SAMPLING_TIME);
+
+	controller.setMode(Cascade_Controller::SPEED);
+	controller.setSpeedReference(q16FromFloat(400));
+	for(uint16_t i = 0; i < 10; i++) controllerTick(&controller, &motor);
+	CHECK(controller.getDuty() != 0);
+
+	controller.setMode(Cascade_Controller::DISABLED);
+	controllerTick(&controller, &motor);
+	CHECK(controller.getDuty() == 0);
+}
+
+
+// END OF FILE
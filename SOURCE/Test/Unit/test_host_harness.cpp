@@ -0,0 +1,112 @@
+/*
+ * test_host_harness.cpp
+ *
+ * Unit tests of the host harness itself and of the drivers over it: register models,
+ * bus timing and the cycle benchmark probe.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "as5600_model.hpp"
+#include "ina219_model.hpp"
+
+#include "AS5600.hpp"
+#include "INA219.hpp"
+#include "benchmark.hpp"
+
+
+
+// --- Register models ------------------------------------------------------------------
+
+TEST(harness_as5600_raw_angle){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(1234);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	AS5600 encoder(&hi2c);
+	CHECK(encoder.getRawAngle() == 1234);
+	CHECK(model.getReads() == 1);
+
+	// 5 bytes at 400 kHz, 9 clocks each plus the START
+	uint64_t start = fakeHalCycles();
+	encoder.getRawAngle();
+	CHECK_NEAR(fixtureCycles_us(fakeHalCycles() - start), (5 * 9 + 1) * 2.5, 10);
+}
+
+TEST(harness_as5600_pointer_wraps_on_output_pairs){
+	AS5600_Model model;
+	model.setRawAngle(0x0ABC);
+
+	uint8_t pointer = 0x0C;
+	uint8_t bytes[4];
+	model.write(&pointer, 1);
+	model.read(bytes, 4);
+
+	CHECK(bytes[0] == 0x0A && bytes[1] == 0xBC);
+	CHECK(bytes[2] == 0x0A && bytes[3] == 0xBC);
+}
+
+TEST(harness_ina219_current_and_conversion){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	INA219_Model model;
+	model.setShuntVoltage_uV(10000);		// 1 A through 10 mOhm
+	model.setBusVoltage_mV(12000);
+	fakeI2cAttach(I2C1, INA219_DEFAULT_ADDRESS, &model);
+
+	INA219 sensor(&hi2c, 3.2f, 0.01f);
+	CHECK(model.getRegister(0x05) != 0);
+	CHECK_NEAR(q16ToFloat(sensor.getCurrent_Q16()), 1.0, 0.01);
+	CHECK_NEAR(q16ToFloat(sensor.getBusVoltage_Q16()), 12.0, 0.01);
+
+	// Triggered conversion of both voltages at 12 bits
+	uint8_t conf[3] = {0x00, 0x01, 0x9B};
+	model.write(conf, 3);
+	CHECK(model.isConverting());
+	fakeHalAdvance_us(2 * 532);
+	CHECK(!model.isConverting());
+	CHECK(model.getConversions() == 1);
+}
+
+TEST(harness_nack_without_slave){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600 encoder(&hi2c);
+	CHECK(!encoder.isConnected());
+
+	// The address byte only, each probe is a transfer too
+	uint32_t bytes = fakeI2cGetBytes(I2C1);
+	encoder.getRawAngle();
+	CHECK(fakeI2cGetBytes(I2C1) == bytes + 1);
+	CHECK(encoder.getStatistics().getNacks() == I2C_DEVICE_PROBE_TRIALS + 1);
+}
+
+
+// --- Benchmark probe ------------------------------------------------------------------
+
+TEST(harness_benchmark_follows_core_clock){
+	cycleCounterBegin();
+
+	Benchmark probe("probe");
+	probe.start();
+	fakeHalAdvanceCycles(6400);
+	probe.stop();
+
+	CHECK(probe.getCount() == 1);
+	CHECK(probe.getLastCycles() >= 6400 && probe.getLastCycles() <= 6400 + 2 * FAKE_HAL_CYCLES_PER_READ);
+	CHECK_NEAR(probe.getAvg_us(), 100.0, 0.5);
+
+	// Same cycles at half the clock take twice the time
+	SystemCoreClock = FAKE_HAL_CORE_CLOCK / 2;
+	CHECK_NEAR(probe.getAvg_us(), 200.0, 1.0);
+	CHECK_NEAR(probe.getMax_us(), 200.0, 1.0);
+}
+
+
+// END OF FILE
@@ -0,0 +1,326 @@
+/*
+ * test_i2c_bus.cpp
+ *
+ * Unit tests of the asynchronous I2C bus engine: queue order and limits, NACKs and DMA
+ * transfers, starts on a held bus, and blocking transfers sharing the peripheral with
+ * the queue.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "as5600_model.hpp"
+
+#include "AS5600.hpp"
+#include "i2c_bus.hpp"
+
+
+
+// --- Queue helpers --------------------------------------------------------------------
+
+struct Bus_Log {
+	uint8_t order[I2C_BUS_QUEUE_SIZE + 1];
+	HAL_StatusTypeDef status[I2C_BUS_QUEUE_SIZE + 1];
+	uint8_t count;
+};
+
+struct Bus_Entry {
+	Bus_Log *log;
+	uint8_t id;
+};
+
+static void busLogCallback(void *context, HAL_StatusTypeDef status){
+	Bus_Entry *entry = (Bus_Entry *)context;
+
+	entry->log->order[entry->log->count] = entry->id;
+	entry->log->status[entry->log->count] = status;
+	entry->log->count++;
+}
+
+static I2C_Bus::Transaction busRawAngleRead(uint8_t *buffer, Bus_Entry *entry){
+	I2C_Bus::Transaction transaction = {};
+	transaction.device_address = AS5600_DEFAULT_ADDRESS << 1;
+	transaction.register_address = 0x0C;
+	transaction.direction = I2C_Bus::READ;
+	transaction.length = 2;
+	transaction.data_buffer = buffer;
+	transaction.callback = busLogCallback;
+	transaction.context = entry;
+	return transaction;
+}
+
+static void busWaitIdle(I2C_Bus *bus, uint32_t timeout_us){
+	for(uint32_t i = 0; i < timeout_us && !bus->isIdle(); i++) fakeHalAdvance_us(1);
+}
+
+
+
+// --- Queue ----------------------------------------------------------------------------
+
+TEST(bus_queue_completes_in_order){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0321);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	CHECK(bus.begin());
+
+	Bus_Log log = {};
+	Bus_Entry entries[3];
+	uint8_t buffers[3][2] = {};
+
+	for(uint8_t i = 0; i < 3; i++){
+		entries[i] = {&log, i};
+		I2C_Bus::Transaction transaction = busRawAngleRead(buffers[i], &entries[i]);
+		CHECK(bus.submit(&transaction) == HAL_OK);
+	}
+
+	busWaitIdle(&bus, 1000);
+
+	CHECK(log.count == 3);
+	for(uint8_t i = 0; i < 3; i++){
+		CHECK(log.order[i] == i);
+		CHECK(log.status[i] == HAL_OK);
+		CHECK(buffers[i][0] == 0x03 && buffers[i][1] == 0x21);
+	}
+	CHECK(bus.getCompletedCount() == 3);
+	CHECK(bus.getErrorCount() == 0);
+}
+
+TEST(bus_full_queue_refuses){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	// One on the wire, the queue keeps the others until it is full
+	Bus_Log log = {};
+	Bus_Entry entry = {&log, 0};
+	uint8_t buffer[2];
+	I2C_Bus::Transaction transaction = busRawAngleRead(buffer, &entry);
+
+	for(uint8_t i = 0; i < I2C_BUS_QUEUE_SIZE; i++) CHECK(bus.submit(&transaction) == HAL_OK);
+	CHECK(bus.submit(&transaction) == HAL_BUSY);
+
+	// Empty transfers and reads without a buffer are refused
+	I2C_Bus::Transaction empty = transaction;
+	empty.length = 0;
+	CHECK(bus.submit(&empty) == HAL_ERROR);
+
+	I2C_Bus::Transaction no_buffer = transaction;
+	no_buffer.data_buffer = nullptr;
+	CHECK(bus.submit(&no_buffer) == HAL_ERROR);
+
+	busWaitIdle(&bus, 5000);
+	CHECK(log.count == I2C_BUS_QUEUE_SIZE);
+}
+
+TEST(bus_nack_completes_with_error){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	// No slave: the read fails at the address byte, the next one still runs
+	Bus_Log log = {};
+	Bus_Entry entries[2] = {{&log, 0}, {&log, 1}};
+	uint8_t buffers[2][2];
+	for(uint8_t i = 0; i < 2; i++){
+		I2C_Bus::Transaction transaction = busRawAngleRead(buffers[i], &entries[i]);
+		bus.submit(&transaction);
+	}
+
+	busWaitIdle(&bus, 1000);
+
+	CHECK(log.count == 2);
+	CHECK(log.status[0] == HAL_ERROR && log.status[1] == HAL_ERROR);
+	CHECK(bus.getErrorCount() == 2);
+}
+
+
+// --- Transfer modes -------------------------------------------------------------------
+
+TEST(bus_dma_mode_skips_single_bytes){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	DMA_HandleTypeDef hdma_rx = {}, hdma_tx = {};
+	hi2c.hdmarx = &hdma_rx;
+	hi2c.hdmatx = &hdma_tx;
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c, I2C_Bus::DMA);
+	bus.begin();
+
+	// A 2 byte read on DMA, a short write from the payload through the interrupts
+	Bus_Log log = {};
+	Bus_Entry entries[2] = {{&log, 0}, {&log, 1}};
+	uint8_t buffer[2];
+	I2C_Bus::Transaction read = busRawAngleRead(buffer, &entries[0]);
+	bus.submit(&read);
+
+	I2C_Bus::Transaction write = {};
+	write.device_address = AS5600_DEFAULT_ADDRESS << 1;
+	write.register_address = 0x08;
+	write.direction = I2C_Bus::WRITE;
+	write.length = 1;
+	write.payload[0] = 0x1C;
+	write.callback = busLogCallback;
+	write.context = &entries[1];
+	bus.submit(&write);
+
+	busWaitIdle(&bus, 1000);
+
+	CHECK(log.count == 2);
+	CHECK(fakeI2cGetDmaTransfers(I2C1) == 1);
+	CHECK(model.getRegister(0x08) == 0x1C);
+}
+
+
+// --- Held bus -------------------------------------------------------------------------
+
+TEST(bus_held_flag_is_left_to_service){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	// The start checks the flag once, no wait for it to clear
+	fakeI2cLatchBusy(I2C1);
+
+	Bus_Log log = {};
+	Bus_Entry entry = {&log, 0};
+	uint8_t buffer[2];
+	I2C_Bus::Transaction transaction = busRawAngleRead(buffer, &entry);
+
+	uint64_t start = fakeHalCycles();
+	CHECK(bus.submit(&transaction) == HAL_OK);
+	CHECK(fixtureCycles_us(fakeHalCycles() - start) < 2);
+
+	CHECK(bus.getPendingCount() == 1);
+	CHECK(!bus.isFaulted());
+	CHECK(fakeI2cGetBusyWaits(I2C1) == 0);
+
+	// The main loop finds the bus stuck, recovers it and restarts the queue
+	bus.service();
+	busWaitIdle(&bus, 1000);
+
+	CHECK(bus.getRecoveryCount() == 1);
+	CHECK(log.count == 1 && log.status[0] == HAL_OK);
+	CHECK(fakeI2cGetBusyWaits(I2C1) == 0);
+}
+
+TEST(bus_stop_on_the_wire_does_not_defer){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	// Back to back transfers start from the completion interrupt during the STOP
+	Bus_Log log = {};
+	Bus_Entry entry = {&log, 0};
+	uint8_t buffer[2];
+	I2C_Bus::Transaction transaction = busRawAngleRead(buffer, &entry);
+
+	for(uint8_t i = 0; i < 4; i++) bus.submit(&transaction);
+	busWaitIdle(&bus, 1000);
+
+	CHECK(log.count == 4);
+	CHECK(bus.getRecoveryCount() == 0);
+	CHECK(fakeHalMaxInterrupt_us(0) < 5);
+}
+
+
+// --- Blocking transfers ---------------------------------------------------------------
+
+struct Bus_Preemption {
+	I2C_Bus *bus;
+	I2C_Bus::Transaction transaction;
+	HAL_StatusTypeDef submitted;
+};
+
+static void busSubmitFromInterrupt(void *context){
+	Bus_Preemption *preemption = (Bus_Preemption *)context;
+	preemption->submitted = preemption->bus->submit(&preemption->transaction);
+}
+
+TEST(bus_blocking_transfer_holds_queue){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0456);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+
+	// A tick interrupt queues a read inside the HAL start of the blocking read
+	Bus_Log log = {};
+	Bus_Entry entry = {&log, 0};
+	uint8_t buffer[2] = {};
+	Bus_Preemption preemption = {&bus, busRawAngleRead(buffer, &entry), HAL_ERROR};
+	fakeI2cSetStartHook(I2C1, busSubmitFromInterrupt, &preemption);
+
+	CHECK(encoder.getRawAngle() == 0x0456);
+	CHECK(preemption.submitted == HAL_OK);
+	CHECK(fakeI2cGetReentries(I2C1) == 0);
+
+	// The queued read starts once the blocking one is done
+	busWaitIdle(&bus, 1000);
+	CHECK(log.count == 1 && log.status[0] == HAL_OK);
+	CHECK(buffer[0] == 0x04 && buffer[1] == 0x56);
+}
+
+TEST(bus_blocking_transfer_waits_for_queue){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0789);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+
+	// Two queued reads: the blocking read waits for the one on the wire only
+	Bus_Log log = {};
+	Bus_Entry entries[2] = {{&log, 0}, {&log, 1}};
+	uint8_t buffers[2][2];
+	for(uint8_t i = 0; i < 2; i++){
+		I2C_Bus::Transaction transaction = busRawAngleRead(buffers[i], &entries[i]);
+		bus.submit(&transaction);
+	}
+
+	CHECK(encoder.getRawAngle() == 0x0789);
+	CHECK(log.count == 1);
+	CHECK(encoder.getStatistics().getErrors() == 0);
+
+	busWaitIdle(&bus, 1000);
+	CHECK(log.count == 2);
+}
+
+
+// END OF FILE
@@ -0,0 +1,188 @@
+/*
+ * test_i2c_device.cpp
+ *
+ * Unit tests of the blocking transfers of I2C_Device: the address probe, the conditions
+ * the interrupt-driven wait needs and the register pointer kept between reads.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "as5600_model.hpp"
+#include "ina219_model.hpp"
+
+#include "AS5600.hpp"
+#include "INA219.hpp"
+#include "i2c_bus.hpp"
+
+
+
+// --- Address probe --------------------------------------------------------------------
+
+TEST(device_probe_is_interrupt_driven){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+	encoder.getStatistics().reset();
+	uint32_t writes = model.getWrites();
+
+	// One address byte on the wire, no HAL polling
+	uint32_t start = fakeHalTime_us();
+	CHECK(encoder.isConnected());
+	CHECK(fakeHalTime_us() - start < 2 * 9 * 1000000 / 400000);
+
+	CHECK(fakeI2cGetProbes(I2C1) == 0);
+	CHECK(model.getWrites() - writes == 1);
+	CHECK(encoder.getStatistics().getTransactions() == 1);
+	CHECK(encoder.getStatistics().getBytes() == 0);
+
+	// A device busy for a moment: the second probe finds it
+	fakeI2cForceNack(I2C1, AS5600_DEFAULT_ADDRESS, 1);
+	CHECK(encoder.isConnected());
+	CHECK(encoder.getStatistics().getNacks() == 1);
+	CHECK(encoder.getStatistics().getRetries() == 1);
+
+	// No device: a NACK on each probe, each within the transfer timeout
+	fakeI2cDetach(I2C1, AS5600_DEFAULT_ADDRESS);
+	encoder.getStatistics().reset();
+
+	start = fakeHalTime_us();
+	CHECK(!encoder.isConnected());
+	CHECK(fakeHalTime_us() - start <= I2C_DEVICE_PROBE_TRIALS * encoder.getTransferTimeout_us(0));
+	CHECK(encoder.getStatistics().getNacks() == I2C_DEVICE_PROBE_TRIALS);
+	CHECK(encoder.getStatistics().getRetries() == I2C_DEVICE_PROBE_TRIALS - 1);
+}
+
+
+// --- Wait conditions ------------------------------------------------------------------
+
+TEST(device_wait_refuses_stopped_cycle_counter){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0111);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	AS5600 encoder(&hi2c);
+	CHECK(cycleCounterIsRunning());
+	CHECK(encoder.getRawAngle() == 0x0111);
+
+	// The timeout could not expire: the read fails at once, the peripheral is left ready
+	DWT->CTRL &= ~DWT_CTRL_CYCCNTENA_Msk;
+	CHECK(!cycleCounterIsRunning());
+
+	model.setRawAngle(0x0222);
+	CHECK(encoder.getRawAngle() == 0x0111);
+	CHECK(HAL_I2C_GetState(&hi2c) == HAL_I2C_STATE_READY);
+
+	cycleCounterBegin();
+	CHECK(encoder.getRawAngle() == 0x0222);
+}
+
+TEST(device_wait_refuses_masked_interrupts){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0333);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+
+	// The completion could not interrupt: the read fails at once, without a recovery
+	__disable_irq();
+	uint32_t start = fakeHalTime_us();
+	CHECK(encoder.getRawAngle() == 0);
+	CHECK(fakeHalTime_us() - start < 10);
+	__set_PRIMASK(0);
+
+	CHECK(encoder.getStatistics().getErrors() == 1);
+	CHECK(bus.getRecoveryCount() == 0);
+	CHECK(HAL_I2C_GetState(&hi2c) == HAL_I2C_STATE_READY);
+
+	CHECK(encoder.getRawAngle() == 0x0333);
+}
+
+
+
+// --- Register pointer -----------------------------------------------------------------
+
+struct Device_Preemption {
+	INA219 *sensor;
+	Async_Result<q16_t> *result;
+};
+
+static void deviceQueueFromInterrupt(void *context){
+	Device_Preemption *preemption = (Device_Preemption *)context;
+	preemption->sensor->readBusVoltageAsync(*preemption->result);
+}
+
+TEST(device_pointer_kept_between_samples){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	INA219_Model model;
+	model.setShuntVoltage_uV(10000);
+	fakeI2cAttach(I2C1, INA219_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	INA219 sensor(&hi2c, 3.2f, 0.01f);
+	sensor.setStreamingMode(true);
+
+	// The first sample sets the pointer: address, register, address and 2 data bytes
+	uint32_t bytes = fakeI2cGetBytes(I2C1);
+	CHECK(sensor.getRawShuntVoltage() == 1000);
+	CHECK(fakeI2cGetBytes(I2C1) - bytes == 5);
+
+	// The next ones only receive: address and 2 data bytes
+	bytes = fakeI2cGetBytes(I2C1);
+	CHECK(sensor.getRawShuntVoltage() == 1000);
+	CHECK(sensor.getRawShuntVoltage() == 1000);
+	CHECK(fakeI2cGetBytes(I2C1) - bytes == 2 * 3);
+}
+
+TEST(device_pointer_dropped_by_queued_read){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	INA219_Model model;
+	model.setShuntVoltage_uV(10000);
+	model.setBusVoltage_mV(12000);
+	fakeI2cAttach(I2C1, INA219_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	INA219 sensor(&hi2c, 3.2f, 0.01f);
+	sensor.setStreamingMode(true);
+	CHECK(sensor.getRawShuntVoltage() == 1000);
+
+	// A tick interrupt queues a bus voltage read inside the next sample, held until it ends
+	Async_Result<q16_t> bus_voltage;
+	Device_Preemption preemption = {&sensor, &bus_voltage};
+	fakeI2cSetStartHook(I2C1, deviceQueueFromInterrupt, &preemption);
+
+	CHECK(sensor.getRawShuntVoltage() == 1000);
+	CHECK(bus_voltage.await(1000));
+
+	// The queued read moved the pointer: the next sample sets it again
+	uint32_t bytes = fakeI2cGetBytes(I2C1);
+	CHECK(sensor.getRawShuntVoltage() == 1000);
+	CHECK(fakeI2cGetBytes(I2C1) - bytes == 5);
+}
+
+
+// END OF FILE
@@ -0,0 +1,228 @@
+/*
+ * test_i2c_recovery.cpp
+ *
+ * Unit tests of the bus fault recovery, on the faults of the simulation: a slave holding
+ * SDA, a latched BUSY flag and a lost completion interrupt, seen by blocking and by
+ * queued transfers.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "as5600_model.hpp"
+
+#include "AS5600.hpp"
+#include "i2c_bus.hpp"
+
+
+
+// --- Recovery helpers -----------------------------------------------------------------
+
+struct Recovery_Log {
+	HAL_StatusTypeDef status;
+	uint8_t count;
+};
+
+static void recoveryLogCallback(void *context, HAL_StatusTypeDef status){
+	Recovery_Log *log = (Recovery_Log *)context;
+
+	log->status = status;
+	log->count++;
+}
+
+static HAL_StatusTypeDef recoverySubmitRead(I2C_Bus *bus, uint8_t *buffer, Recovery_Log *log){
+	I2C_Bus::Transaction transaction = {};
+	transaction.device_address = AS5600_DEFAULT_ADDRESS << 1;
+	transaction.register_address = 0x0C;
+	transaction.direction = I2C_Bus::READ;
+	transaction.length = 2;
+	transaction.data_buffer = buffer;
+	transaction.callback = recoveryLogCallback;
+	transaction.context = log;
+	return bus->submit(&transaction);
+}
+
+// Recovery bound: the line steps budget, the peripheral reset and the stuck check on top
+static const uint32_t RECOVERY_BOUND_US = I2C_BUS_RECOVERY_BUDGET_US + I2C_BUS_RELEASE_TIMEOUT_US + 50;
+
+
+
+// --- Held SDA -------------------------------------------------------------------------
+
+TEST(recovery_clocks_out_held_sda){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0234);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+	encoder.getZPosition();
+	uint32_t reads = model.getReads();
+
+	// A slave keeps SDA low for 4 more clocks, the blocking read recovers the bus first
+	fakeI2cHoldSda(I2C1, 4);
+
+	uint32_t start = fakeHalTime_us();
+	CHECK(encoder.getRawAngle() == 0x0234);
+	CHECK(fakeHalTime_us() - start < RECOVERY_BOUND_US + 200);
+
+	CHECK(!fakeI2cIsSdaHeld(I2C1));
+	CHECK(fakeI2cGetSclPulses(I2C1) == 4 + 1);		// Clock out, then the STOP
+	CHECK(fakeI2cGetBusyWaits(I2C1) == 0);
+
+	CHECK(bus.getRecoveryCount() == 1);
+	CHECK(bus.getRecoveryFailures() == 0);
+	CHECK(bus.getRecoveryStage() == I2C_Bus::RECOVERY_DONE);
+	CHECK(bus.getLastRecovery_us() <= RECOVERY_BOUND_US);
+	CHECK(encoder.getRecoveryCount() == 1);
+
+	// The shadow from before the recovery is read again
+	encoder.getZPosition();
+	CHECK(model.getReads() - reads == 2);
+}
+
+TEST(recovery_gives_up_on_sda_held_forever){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	fakeI2cHoldSda(I2C1, FAKE_I2C_HOLD_FOREVER);
+
+	// The queue waits for service(), which fails within the budget and drops the queue
+	Recovery_Log log = {};
+	uint8_t buffer[2];
+	CHECK(recoverySubmitRead(&bus, buffer, &log) == HAL_OK);
+
+	uint32_t start = fakeHalTime_us();
+	bus.service();
+	CHECK(fakeHalTime_us() - start <= RECOVERY_BOUND_US);
+
+	CHECK(bus.isFaulted());
+	CHECK(bus.getRecoveryFailures() == 1);
+	CHECK(bus.getRecoveryStage() == I2C_Bus::RECOVERY_RESET);
+	CHECK(fakeI2cGetSclPulses(I2C1) == I2C_BUS_RECOVERY_CLOCKS + 1);	// All the clocks, the STOP finds SDA low
+	CHECK(log.count == 1 && log.status == HAL_ERROR);
+	CHECK(fakeI2cGetBusyWaits(I2C1) == 0);
+
+	// Once the slave lets go, the next service frees the bus
+	fakeI2cHoldSda(I2C1, 0);
+	bus.service();
+
+	CHECK(!bus.isFaulted());
+	CHECK(bus.getRecoveryStage() == I2C_Bus::RECOVERY_DONE);
+	CHECK(recoverySubmitRead(&bus, buffer, &log) == HAL_OK);
+	for(uint16_t i = 0; i < 1000 && !bus.isIdle(); i++) fakeHalAdvance_us(1);
+	CHECK(log.count == 2 && log.status == HAL_OK);
+}
+
+
+// --- Latched BUSY ---------------------------------------------------------------------
+
+TEST(recovery_clears_latched_busy_before_blocking_read){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0345);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+
+	// Free lines, only the flag: no clocks, a STOP and the reset
+	fakeI2cLatchBusy(I2C1);
+	uint32_t inits = fakeI2cGetInits(I2C1);
+
+	uint32_t start = fakeHalTime_us();
+	CHECK(encoder.getRawAngle() == 0x0345);
+	CHECK(fakeHalTime_us() - start < RECOVERY_BOUND_US + 200);
+
+	CHECK(fakeI2cGetBusyWaits(I2C1) == 0);
+	CHECK(fakeI2cGetSclPulses(I2C1) == 1);
+	CHECK(fakeI2cGetInits(I2C1) - inits == 1);
+	CHECK(bus.getRecoveryCount() == 1);
+	CHECK(encoder.getStatistics().getErrors() == 0);
+}
+
+
+// --- Lost completion ------------------------------------------------------------------
+
+TEST(recovery_after_lost_blocking_completion){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0456);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+	CHECK(encoder.getRawAngle() == 0x0456);
+
+	// The read times out after its own timeout and recovers the bus, the last good angle stays
+	model.setRawAngle(0x0567);
+	fakeI2cLoseCompletion(I2C1, 1);
+
+	uint32_t start = fakeHalTime_us();
+	CHECK(encoder.getRawAngle() == 0x0456);
+	CHECK(fakeHalTime_us() - start <= encoder.getTransferTimeout_us(2) + RECOVERY_BOUND_US);
+
+	CHECK(encoder.getStatistics().getTimeouts() == 1);
+	CHECK(bus.getRecoveryCount() == 1);
+	CHECK(!bus.isFaulted());
+
+	// The next read goes through
+	CHECK(encoder.getRawAngle() == 0x0567);
+	CHECK(encoder.getStatistics().getErrors() == 1);
+}
+
+TEST(recovery_after_lost_queued_completion){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	fakeI2cLoseCompletion(I2C1, 1);
+
+	Recovery_Log log = {};
+	uint8_t buffers[2][2];
+	CHECK(recoverySubmitRead(&bus, buffers[0], &log) == HAL_OK);
+	CHECK(recoverySubmitRead(&bus, buffers[1], &log) == HAL_OK);
+
+	// Before the transfer timeout service() leaves the transfer alone
+	fakeHalAdvance_us(I2C_BUS_TRANSFER_TIMEOUT_US / 2);
+	bus.service();
+	CHECK(bus.getRecoveryCount() == 0);
+	CHECK(log.count == 0);
+
+	// After it the lost transfer ends with HAL_TIMEOUT, the queue restarts
+	fakeHalAdvance_us(I2C_BUS_TRANSFER_TIMEOUT_US);
+	bus.service();
+	CHECK(bus.getRecoveryCount() == 1);
+	CHECK(log.count == 1 && log.status == HAL_TIMEOUT);
+
+	for(uint16_t i = 0; i < 1000 && !bus.isIdle(); i++) fakeHalAdvance_us(1);
+	CHECK(log.count == 2 && log.status == HAL_OK);
+	CHECK(!bus.isFaulted());
+}
+
+
+// END OF FILE
@@ -0,0 +1,79 @@
+/*
+ * test_i2c_scheduler.cpp
+ *
+ * Unit tests of the I2C bus scheduler: slot table of main and its statistics in the
+ * closed loop.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "sil_runner.hpp"
+
+
+
+// --- Slot table -----------------------------------------------------------------------
+
+TEST(scheduler_table_of_main){
+	Sil_Runner runner;
+	CHECK(runner.begin());
+
+	I2C_Scheduler &scheduler = runner.getScheduler();
+	CHECK(scheduler.getStreamCount() == 5);
+
+	// Power trigger at its release, encoder slot moved after it, collect at its release
+	const I2C_Scheduler::Stream &trigger = scheduler.getStream(0);
+	const I2C_Scheduler::Stream &collect = scheduler.getStream(1);
+	const I2C_Scheduler::Stream &encoder = scheduler.getStream(2);
+
+	CHECK(trigger.placed && collect.placed && encoder.placed);
+	CHECK(trigger.phase_us == 200);
+	CHECK(encoder.phase_us == 390);
+	CHECK(collect.phase_us == 530);
+
+	// The 100 ms diagnostics share the start of the tick, in separate ticks
+	const I2C_Scheduler::Stream &status = scheduler.getStream(3);
+	const I2C_Scheduler::Stream &strength = scheduler.getStream(4);
+
+	CHECK(status.phase_us == 0 && strength.phase_us == 0);
+	CHECK(status.offset != strength.offset);
+
+	CHECK(scheduler.getUtilization() > 0.7f && scheduler.getUtilization() < 0.8f);
+}
+
+TEST(scheduler_rejects_overlapping_stream){
+	Sil_Runner runner;
+	I2C_Scheduler &scheduler = runner.getScheduler();
+
+	// A second 1 ms stream that cannot fit in its window
+	scheduler.addStream("a", 1, 400, 100, 500, [](void *){ return false; });
+	scheduler.addStream("b", 1, 400, 100, 500, [](void *){ return false; });
+
+	CHECK(!scheduler.build());
+}
+
+
+// --- Statistics -----------------------------------------------------------------------
+
+TEST(scheduler_measures_the_slots){
+	Sil_Runner runner;
+	CHECK(runner.begin());
+	runner.run(200);
+
+	I2C_Scheduler &scheduler = runner.getScheduler();
+	const I2C_Scheduler::Stream &encoder = scheduler.getStream(2);
+
+	// One angle read a tick, release to bus idle about one register read
+	CHECK(encoder.releases >= 199);
+	CHECK(encoder.completions == encoder.releases - encoder.skipped);
+	CHECK(encoder.max_latency_us >= 100 && encoder.max_latency_us <= 130);
+
+	// Diagnostics every 100 ticks
+	CHECK(scheduler.getStream(3).releases == 2);
+
+	CHECK(scheduler.getMissedDeadlines() == 0);
+	CHECK(scheduler.getCollisions() == 0);
+}
+
+
+// END OF FILE
@@ -0,0 +1,218 @@
+/*
+ * test_i2c_statistics.cpp
+ *
+ * Unit tests of the I2C transaction statistics: classification of the results, latency
+ * histogram, the recording of blocking and queued transfers by the devices, and the
+ * values the getters keep on a failed read.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "as5600_model.hpp"
+#include "ina219_model.hpp"
+
+#include "AS5600.hpp"
+#include "INA219.hpp"
+#include "i2c_bus.hpp"
+#include "i2c_statistics.hpp"
+
+
+
+// --- Recording helpers ----------------------------------------------------------------
+
+static uint32_t statisticsCycles(uint32_t latency_us){
+	return latency_us * (SystemCoreClock / 1000000);
+}
+
+static uint32_t statisticsHistogramSum(I2C_Statistics &statistics){
+	uint32_t sum = 0;
+	for(uint8_t i = 0; i < I2C_STATISTICS_BINS; i++) sum += statistics.getHistogram(i);
+	return sum;
+}
+
+
+
+// --- Classification -------------------------------------------------------------------
+
+TEST(statistics_classify_results){
+	I2C_Statistics statistics;
+
+	statistics.record(HAL_OK, HAL_I2C_ERROR_NONE, 2, statisticsCycles(100));
+	statistics.record(HAL_ERROR, HAL_I2C_ERROR_AF, 2, statisticsCycles(30));
+	statistics.record(HAL_TIMEOUT, HAL_I2C_ERROR_NONE, 2, statisticsCycles(400));
+	statistics.record(HAL_ERROR, HAL_I2C_ERROR_TIMEOUT | HAL_I2C_ERROR_AF, 2, statisticsCycles(400));
+	statistics.record(HAL_BUSY, HAL_I2C_ERROR_NONE, 2, 0);
+	statistics.recordRetry();
+
+	CHECK(statistics.getTransactions() == 5);
+	CHECK(statistics.getBytes() == 2);				// Only the successful transfer
+	CHECK(statistics.getErrors() == 4);
+	CHECK(statistics.getNacks() == 1);
+	CHECK(statistics.getTimeouts() == 2);			// The timeout flag wins over the NACK
+	CHECK(statistics.getBusy() == 1);
+	CHECK(statistics.getRetries() == 1);
+
+	statistics.reset();
+	CHECK(statistics.getTransactions() == 0 && statistics.getErrors() == 0 && statistics.getRetries() == 0);
+	CHECK(statistics.getMinLatency_us() == 0 && statistics.getMaxLatency_us() == 0);
+	CHECK(statisticsHistogramSum(statistics) == 0);
+}
+
+
+// --- Latency --------------------------------------------------------------------------
+
+TEST(statistics_latency_bins_and_extremes){
+	I2C_Statistics statistics;
+	CHECK(statistics.getAverageLatency_us() == 0);
+
+	// Bin limits: 32, 64, ... 2048 us, then the rest
+	CHECK(I2C_Statistics::getBinLimit_us(0) == 32);
+	CHECK(I2C_Statistics::getBinLimit_us(6) == 2048);
+	CHECK(I2C_Statistics::getBinLimit_us(7) == 0);
+
+	statistics.record(HAL_OK, HAL_I2C_ERROR_NONE, 2, statisticsCycles(31));
+	statistics.record(HAL_OK, HAL_I2C_ERROR_NONE, 2, statisticsCycles(32));
+	statistics.record(HAL_OK, HAL_I2C_ERROR_NONE, 2, statisticsCycles(127));
+	statistics.record(HAL_OK, HAL_I2C_ERROR_NONE, 2, statisticsCycles(2047));
+	statistics.record(HAL_OK, HAL_I2C_ERROR_NONE, 2, statisticsCycles(2048));
+
+	CHECK(statistics.getHistogram(0) == 1);
+	CHECK(statistics.getHistogram(1) == 1);
+	CHECK(statistics.getHistogram(2) == 1);
+	CHECK(statistics.getHistogram(6) == 1);
+	CHECK(statistics.getHistogram(7) == 1);
+	CHECK(statistics.getHistogram(I2C_STATISTICS_BINS) == 0);
+
+	CHECK(statistics.getMinLatency_us() == 31);
+	CHECK(statistics.getMaxLatency_us() == 2048);
+	CHECK(statistics.getLastLatency_us() == 2048);
+	CHECK(statistics.getAverageLatency_us() == (31 + 32 + 127 + 2047 + 2048) / 5);
+
+	// A stuck transfer saturates the 16 bit latency, in the last bin
+	statistics.record(HAL_TIMEOUT, HAL_I2C_ERROR_NONE, 2, statisticsCycles(100000));
+	CHECK(statistics.getMaxLatency_us() == 0xFFFF);
+	CHECK(statistics.getHistogram(7) == 2);
+}
+
+
+// --- Device recording -----------------------------------------------------------------
+
+TEST(statistics_record_blocking_transfers){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0123);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+	I2C_Statistics &statistics = encoder.getStatistics();
+	statistics.reset();
+
+	// A raw angle read: 5 bytes at 400 kHz, about 112 us on the wire
+	CHECK(encoder.getRawAngle() == 0x0123);
+	CHECK(statistics.getTransactions() == 1);
+	CHECK(statistics.getBytes() == 2);
+	CHECK(statistics.getErrors() == 0);
+	CHECK(statistics.getLastLatency_us() >= 112 && statistics.getLastLatency_us() < 128);
+	CHECK(statistics.getHistogram(2) == 1);
+
+	// A NACK on the next one keeps the last good angle, the failure is counted
+	fakeI2cForceNack(I2C1, AS5600_DEFAULT_ADDRESS, 1);
+	CHECK(encoder.getRawAngle() == 0x0123);
+	CHECK(statistics.getTransactions() == 2);
+	CHECK(statistics.getErrors() == 1);
+	CHECK(statistics.getNacks() == 1);
+	CHECK(statistics.getBytes() == 2);
+	CHECK(statisticsHistogramSum(statistics) == statistics.getTransactions());
+}
+
+TEST(statistics_getters_keep_last_value_on_nack){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	INA219_Model power_model;
+	power_model.setShuntVoltage_uV(10000);		// 1 A through 10 mOhm
+	power_model.setBusVoltage_mV(12000);
+	fakeI2cAttach(I2C1, INA219_DEFAULT_ADDRESS, &power_model);
+
+	AS5600_Model encoder_model;
+	encoder_model.setMagnitude(0x0456);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &encoder_model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	INA219 sensor(&hi2c, 3.2f, 0.01f);
+	AS5600 encoder(&hi2c);
+
+	q16_t bus_voltage = sensor.getBusVoltage_Q16();
+	q16_t current = sensor.getCurrent_Q16();
+	uint16_t configuration = sensor.getConfiguration();
+	CHECK(encoder.getMagnitude() == 0x0456);
+
+	power_model.setShuntVoltage_uV(-5000);
+	power_model.setBusVoltage_mV(5000);
+	encoder_model.setMagnitude(0x0789);
+	sensor.getStatistics().reset();
+
+	// Each NACK gives the last good value back, the failure is counted
+	fakeI2cForceNack(I2C1, INA219_DEFAULT_ADDRESS, 1);
+	CHECK(sensor.getBusVoltage_Q16() == bus_voltage);
+	fakeI2cForceNack(I2C1, INA219_DEFAULT_ADDRESS, 1);
+	CHECK(sensor.getRawShuntVoltage() == 0);			// Never read yet
+	CHECK(sensor.getStatistics().getNacks() == 2);
+
+	// The calibration check runs first after a bus error, the current read fails
+	fakeI2cForceNack(I2C1, INA219_DEFAULT_ADDRESS, 2);
+	CHECK(sensor.getCurrent_Q16() == current);
+
+	// An unknown shadow read from the device, its last value if it fails
+	sensor.invalidateShadow();
+	fakeI2cForceNack(I2C1, INA219_DEFAULT_ADDRESS, 1);
+	CHECK(sensor.getConfiguration() == configuration);
+
+	fakeI2cForceNack(I2C1, AS5600_DEFAULT_ADDRESS, 1);
+	CHECK(encoder.getMagnitude() == 0x0456);
+	CHECK(encoder.getStatistics().getNacks() == 1);
+
+	// The next good reads take the new values
+	CHECK_NEAR(q16ToFloat(sensor.getBusVoltage_Q16()), 5.0, 0.01);
+	CHECK_NEAR(q16ToFloat(sensor.getCurrent_Q16()), -0.5, 0.01);
+	CHECK(encoder.getMagnitude() == 0x0789);
+}
+
+TEST(statistics_record_queued_transfers_on_completion){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	AS5600_Model model;
+	model.setRawAngle(0x0321);
+	fakeI2cAttach(I2C1, AS5600_DEFAULT_ADDRESS, &model);
+
+	I2C_Bus bus(&hi2c);
+	bus.begin();
+
+	AS5600 encoder(&hi2c);
+	I2C_Statistics &statistics = encoder.getStatistics();
+	statistics.reset();
+
+	// Recorded by the bus when the transfer ends, not when queued
+	CHECK(encoder.requestRawAngle());
+	CHECK(statistics.getTransactions() == 0);
+
+	for(uint16_t i = 0; i < 1000 && !bus.isIdle(); i++) fakeHalAdvance_us(1);
+
+	CHECK(encoder.getSampleRawAngle() == 0x0321);
+	CHECK(statistics.getTransactions() == 1);
+	CHECK(statistics.getBytes() == 2);
+	CHECK(statistics.getErrors() == 0);
+	CHECK(statistics.getLastLatency_us() >= 112 && statistics.getLastLatency_us() < 128);
+}
+
+
+// END OF FILE
@@ -0,0 +1,135 @@
+/*
+ * test_plant_model.cpp
+ *
+ * Unit tests of the plant model, of its sensors on the fake bus and of the closed loop
+ * of main against it.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "plant_bus.hpp"
+#include "sil_runner.hpp"
+
+#include <math.h>
+
+
+
+// --- Plant model ----------------------------------------------------------------------
+
+TEST(plant_bridge_delay_is_one_pwm_period){
+	CHECK_NEAR(PLANT_DEFAULT_PARAMETERS.bridge_delay, 999e-6, 1e-9);
+
+	// 27 steps of 37 us
+	Plant_Model plant(37e-6f);
+	for(uint8_t i = 0; i < 27; i++){
+		plant.step(1.0f);
+		CHECK(plant.getVoltage() == 0);
+	}
+
+	plant.step(1.0f);
+	CHECK_NEAR(plant.getVoltage(), PLANT_DEFAULT_PARAMETERS.bridge_gain, 1e-6);
+}
+
+TEST(plant_reaches_no_load_speed){
+	Plant_Model plant(1e-3f);
+	for(uint16_t i = 0; i < 2000; i++) plant.step(1.0f);
+
+	// Free running: w = V / Kphi with no friction, the current decays to zero
+	CHECK_NEAR(plant.getSpeed(), PLANT_DEFAULT_PARAMETERS.bridge_gain / PLANT_DEFAULT_PARAMETERS.Kphi, 5.0);
+	CHECK_NEAR(plant.getCurrent(), 0, 0.01);
+}
+
+
+// --- Sensors on the bus ---------------------------------------------------------------
+
+TEST(plant_bus_serves_plant_state){
+	I2C_HandleTypeDef hi2c;
+	fixtureI2cInit(&hi2c, I2C1);
+
+	Plant_Bus plant_bus(I2C1);
+	AS5600 encoder(&hi2c);
+	INA219 sensor_1(&hi2c, 3.0f, 0.1f, 0x40);
+	INA219 sensor_2(&hi2c, 3.0f, 0.1f, 0x44);
+
+	plant_bus.setDuty(0.3f);
+	fakeHalAdvance_us(20000);
+
+	// Angle at the time of the transfer
+	uint16_t counts = encoder.getRawAngle();
+	CHECK(counts == plant_bus.getPlant().getAS5600RawAngle());
+	CHECK(counts != 0);
+
+	// Armature current through both shunts, opposite signs
+	float current = plant_bus.getPlant().getCurrent();
+	CHECK_NEAR(q16ToFloat(sensor_1.getCurrent_Q16()), current, 0.01);
+	CHECK_NEAR(q16ToFloat(sensor_2.getCurrent_Q16()), -current, 0.01);
+
+	// Lead voltages differ by the armature voltage
+	float voltage = q16ToFloat(sensor_2.getBusVoltage_Q16()) - q16ToFloat(sensor_1.getBusVoltage_Q16());
+	CHECK_NEAR(voltage, plant_bus.getPlant().getVoltage(), 0.01);
+}
+
+
+// --- Closed loop ----------------------------------------------------------------------
+
+TEST(sil_speed_loop_tracks_reference){
+	Sil_Runner runner;
+	CHECK(runner.begin());
+
+	runner.getController().setMode(Cascade_Controller::SPEED);
+	runner.getController().setSpeedReference(q16FromFloat(400));
+	runner.run(300);
+
+	// Mean over the last 200 ticks: the 12 bit angle on the output shaft leaves a ripple
+	// of about 100 rad/s around the reference
+	double plant_speed = 0, estimated_speed = 0;
+	for(uint16_t i = 0; i < 200; i++){
+		runner.tick();
+		plant_speed += runner.getPlant().getSpeed() / 200;
+		estimated_speed += q16ToFloat(runner.getSignals().speed) / 200;
+	}
+
+	CHECK_NEAR(plant_speed, 400, 20);
+	CHECK_NEAR(estimated_speed, 400, 20);
+
+	// The loop of main fits the tick, the slots their deadlines, the power stage batches
+	// are ready in time
+	CHECK(runner.getTick().getOverrunCount() == 0);
+	CHECK(runner.getScheduler().getMissedDeadlines() == 0);
+	CHECK(runner.getBus().getErrorCount() == 0);
+	CHECK(runner.getPowerStage().getLateCount() <= 1);
+	CHECK(runner.getPowerStage().getFailedCount() == 0);
+}
+
+TEST(sil_encoder_on_i2c2_reads_angle_earlier){
+	float ready_us[2], power_busy[2];
+
+	// Shared I2C1, then the AS5600 on its own I2C2 (ENCODER_ON_I2C2 of main)
+	for(uint8_t layout = 0; layout < 2; layout++){
+		Sil_Runner runner(PLANT_DEFAULT_PARAMETERS, layout == 0 ? Sil_Runner::ENCODER_SHARED_I2C1 : Sil_Runner::ENCODER_OWN_I2C2);
+		CHECK(runner.begin());
+
+		runner.getController().setMode(Cascade_Controller::SPEED);
+		runner.getController().setSpeedReference(q16FromFloat(400));
+		runner.run(500);
+
+		// Angle in hand: slot start plus the measured read
+		I2C_Scheduler &encoder_slots = runner.getEncoderScheduler();
+		uint8_t stream = runner.getEncoderStream();
+		ready_us[layout] = encoder_slots.getPhase_us(stream) + encoder_slots.getStream(stream).max_latency_us;
+		power_busy[layout] = runner.getScheduler().getMeasuredUtilization() * runner.getTick().getPeriod_us();
+
+		CHECK(runner.getEncoder().getSampleErrors() == 0);
+		CHECK(runner.getTick().getOverrunCount() == 0);
+		CHECK(runner.getScheduler().getMissedDeadlines() == 0);
+		CHECK(encoder_slots.getMissedDeadlines() == 0);
+	}
+
+	// About 505 us against 315 us, and I2C1 busy 771 us against 654 us per tick
+	CHECK(ready_us[0] - ready_us[1] >= 180);
+	CHECK(power_busy[0] - power_busy[1] >= 100);
+}
+
+
+// END OF FILE
@@ -0,0 +1,203 @@
+/*
+ * test_power_stage.cpp
+ *
+ * Unit tests of the power stage batches and of the conversion policy, in the loop of
+ * main: fused sample, bus cost, per chip correction, profile switches, the triggered
+ * configuration and repeated samples.
+ *
+ */
+
+#include "test_runner.hpp"
+#include "test_fixture.hpp"
+#include "sil_runner.hpp"
+
+#include <math.h>
+
+
+
+// --- Batches --------------------------------------------------------------------------
+
+TEST(power_stage_fuses_both_legs){
+	Sil_Runner runner;
+	CHECK(runner.begin());
+
+	Motor_Power_Stage &stage = runner.getPowerStage();
+
+	runner.getController().setMode(Cascade_Controller::SPEED);
+	runner.getController().setSpeedReference(q16FromFloat(400));
+	runner.run(50);
+
+	CHECK(stage.getSample().fresh);
+	CHECK(stage.isConnected());
+
+	// Opposite leg currents, voltage across the motor
+	q16_t i1 = stage.getSensorCurrent_Q16(1), i2 = stage.getSensorCurrent_Q16(2);
+	q16_t v1 = stage.getSensorBusVoltage_Q16(1), v2 = stage.getSensorBusVoltage_Q16(2);
+
+	CHECK(stage.getCurrent_Q16() == (i1 - i2) / 2);
+	CHECK(stage.getVoltage_Q16() == v2 - v1);
+	CHECK(stage.getPower_Q16() == q16Multiply(stage.getVoltage_Q16(), stage.getCurrent_Q16()));
+	CHECK(stage.getDirection() == Motor_Power_Stage::FORWARD);
+}
+
+TEST(power_stage_batch_uses_six_transactions){
+	Sil_Runner runner;
+	CHECK(runner.begin());
+	runner.run(10);
+
+	Motor_Power_Stage &stage = runner.getPowerStage();
+
+	// Two CONF writes, two bus voltage reads with CNVR set, two shunt reads
+	CHECK(stage.getLastTransactionCount() == 6);
+
+	// With the encoder read, 7 transfers a tick
+	uint32_t transfers = fakeI2cGetTransfers(I2C1);
+	runner.run(10);
+	CHECK(fakeI2cGetTransfers(I2C1) - transfers == 70);
+	CHECK(stage.getLateCount() == 0);
+}
+
+
+// --- Correction -----------------------------------------------------------------------
+
+TEST(power_stage_correction_applies_per_chip){
+	Sil_Runner runner;
+	CHECK(runner.begin());
+
+	Motor_Power_Stage &stage = runner.getPowerStage();
+	runner.run(10);
+
+	q16_t current = stage.getCurrent_Q16();
+	q16_t voltage = stage.getVoltage_Q16();
+
+	// Offset on chip 2 only: the current halves it, the voltage takes it whole
+	Motor_Power_Stage::Correction correction = {1.0f, 0.2f, 1.0f, 0.5f};
+	CHECK(stage.setCorrection(2, correction));
+	runner.run(1);
+
+	CHECK_NEAR(q16ToFloat(stage.getCurrent_Q16() - current), -0.1, 0.01);
+	CHECK_NEAR(q16ToFloat(stage.getVoltage_Q16() - voltage), 0.5, 0.01);
+
+	CHECK(!stage.setCorrection(3, correction));
+}
+
+
+// --- Conversion policy ----------------------------------------------------------------
+
+TEST(policy_follows_the_controller_state){
+	Sil_Runner runner;
+	CHECK(runner.begin());
+
+	Conversion_Policy &policy = runner.getPolicy();
+	Motor_Power_Stage &stage = runner.getPowerStage();
+
+	// Disabled: averaged MONITOR batches, collected a few ticks after their trigger
+	runner.run(CONVERSION_POLICY_HOLD_TICKS + 10);
+	CHECK(policy.getProfile() == Conversion_Policy::MONITOR);
+	CHECK(stage.getDivider() > 30);
+
+	// A step on the speed loop is a current transient: FAST at once
+	runner.getController().setMode(Cascade_Controller::SPEED);
+	runner.getController().setSpeedReference(q16FromFloat(400));
+	runner.run(2);
+	CHECK(policy.getProfile() == Conversion_Policy::FAST);
+
+	// Fixed profile, whatever the state
+	policy.setOverride(Conversion_Policy::NORMAL);
+	runner.run(5);
+	CHECK(policy.getProfile() == Conversion_Policy::NORMAL);
+	CHECK(stage.getDivider() == 1);
+}
+
+
+// --- Profile switches -----------------------------------------------------------------
+
+TEST(power_stage_shorter_settings_restart_batch){
+	Sil_Runner runner;
+	CHECK(runner.begin());
+
+	Motor_Power_Stage &stage = runner.getPowerStage();
+
+	// A 34 ms MONITOR batch is running
+	runner.getPolicy().setOverride(Conversion_Policy::MONITOR);
+	runner.run(5);
+	CHECK(stage.getDivider() > 30);
+
+	uint32_t published = stage.getPublishedCount();
+
+	// FAST drops it: the next trigger restarts the conversions, published in two ticks
+	runner.getPolicy().setOverride(Conversion_Policy::FAST);
+	CHECK(stage.getDivider() == 1);
+	runner.run(3);
+
+	CHECK(stage.getRestartCount() == 1);
+	CHECK(stage.getPublishedCount() > published);
+	CHECK(runner.getSignals().current_fresh);
+	CHECK(stage.getSensor(1).getTriggerOverruns() == 0);
+	CHECK(stage.getSensor(2).getTriggerOverruns() == 0);
+}
+
+TEST(power_stage_trigger_writes_shadowed_configuration){
+	Sil_Runner runner;
+	CHECK(runner.begin());
+
+	runner.getPolicy().setOverride(Conversion_Policy::HOLD);
+	runner.run(10);
+
+	// The settings live in the CONF shadow, the triggers write it to the chip
+	INA219 &sensor = runner.getPowerStage().getSensor(1);
+	uint32_t hits = sensor.getShadowHits();
+
+	CHECK(sensor.getShuntADCResolution() == INA219::SHUNT_ADC_4_SMPL);
+	CHECK(sensor.getShadowHits() == hits + 1);
+	CHECK(sensor.getConfiguration() == runner.getPlantBus().getSensor(1).getRegister(0x00));
+}
+
+
+// --- Repeated samples -----------------------------------------------------------------
+
+TEST(power_stage_hold_marks_repeated_current){
+	Sil_Runner runner;
+	CHECK(runner.begin());
+
+	runner.getController().setMode(Cascade_Controller::POSITION);
+	runner.getController().setPositionReference(q16FromFloat(0.05f));
+	runner.run(300);
+
+	// HOLD converts for 2.2 ms: one fresh sample every 3 ticks
+	runner.getPolicy().setOverride(Conversion_Policy::HOLD);
+	CHECK(runner.getPowerStage().getDivider() == 3);
+	runner.run(3);
+
+	uint16_t fresh = 0;
+	for(uint16_t i = 0; i < 30; i++){
+		runner.tick();
+		if(runner.getSignals().current_fresh) fresh++;
+		else CHECK(runner.getSignals().current != runner.getPowerStage().getCurrent_Q16() || runner.getPowerStage().getCurrent_Q16() == 0);
+	}
+	CHECK(fresh == 10);
+
+	// The held position is kept on the observer current
+	CHECK_NEAR(runner.getPlant().getPosition(), 0.05f, 2 * 2 * M_PI / 4096);
+}
+
+TEST(observer_ignores_repeated_current){
+	Observer reference, observer;
+
+	// Same angle and voltage, the current argument of a repeated sample is not used
+	for(uint8_t i = 0; i < 10; i++){
+		reference.update(q16FromFloat(0.1f), 0, q16FromFloat(1.0f), false);
+		observer.update(q16FromFloat(0.1f), q16FromFloat(0.5f), q16FromFloat(1.0f), false);
+	}
+
+	CHECK(observer.getCurrent() == reference.getCurrent());
+	CHECK(observer.getSpeed() == reference.getSpeed());
+
+	// A fresh sample corrects the estimate
+	observer.update(q16FromFloat(0.1f), q16FromFloat(0.5f), q16FromFloat(1.0f));
+	reference.update(q16FromFloat(0.1f), 0, q16FromFloat(1.0f));
+	CHECK(observer.getCurrent() != reference.getCurrent());
+}
+
+
+// END OF FILE
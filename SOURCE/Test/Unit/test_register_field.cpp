@@ -0,0 +1,37 @@
+/*
+ * test_register_field.cpp
+ *
+ * Unit tests of the compile-time register fields: the accessors fold to constants.
+ *
+ */
+
+#include "test_runner.hpp"
+
+#include "register_field.hpp"
+
+
+
+// --- Field accessors ------------------------------------------------------------------
+
+typedef Register_Field<uint16_t, 0x0078> TEST_SHUNT_FIELD;		// INA219 CONF, SADC
+typedef Register_Field<uint16_t, 0x0002> TEST_CNVR_FIELD;		// INA219 bus voltage
+
+static_assert(TEST_SHUNT_FIELD::shift() == 3, "Shift from the lowest mask bit");
+static_assert(TEST_SHUNT_FIELD::get(0x399F) == 0x03, "Right-aligned value");
+static_assert(TEST_SHUNT_FIELD::insert(0x399F, 0x0048) == 0x39CF, "Other bits kept");
+static_assert(TEST_CNVR_FIELD::isSet(0x1F42), "Single bit flag");
+
+TEST(register_field_accessors){
+	uint16_t conf = 0x399F;					// INA219 power-on configuration
+
+	CHECK(TEST_SHUNT_FIELD::extract(conf) == 0x0018);
+	CHECK(TEST_SHUNT_FIELD::set(conf, 0x09) == 0x39CF);
+	CHECK(TEST_SHUNT_FIELD::get(TEST_SHUNT_FIELD::set(conf, 0x0F)) == 0x0F);
+
+	// Values wider than the field are cut to its bits
+	CHECK(TEST_SHUNT_FIELD::set(0x0000, 0xFF) == 0x0078);
+	CHECK(!TEST_CNVR_FIELD::isSet(0xFFFD));
+}
+
+
+// END OF FILE